@@ -0,0 +1,367 @@
+// Copyright Cartesi and individual authors (see AUTHORS)
+// SPDX-License-Identifier: LGPL-3.0-or-later
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any
+// later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License along
+// with this program (see COPYING). If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "access-log-binary.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "access-log.h"
+#include "bracket-note.h"
+#include "machine-merkle-tree.h"
+
+namespace cartesi {
+
+using namespace std::string_literals;
+
+/// \brief Bits in the flags byte of the header
+enum ACCESS_LOG_BINARY_TYPE_flags : uint8_t {
+    ACCESS_LOG_BINARY_TYPE_ANNOTATIONS = 1,
+    ACCESS_LOG_BINARY_TYPE_LARGE_DATA = 2,
+};
+
+/// \brief Bits in the flags byte of each access
+enum ACCESS_LOG_BINARY_ACCESS_flags : uint8_t {
+    ACCESS_LOG_BINARY_ACCESS_WRITE = 1,
+    ACCESS_LOG_BINARY_ACCESS_READ_DATA = 2,
+    ACCESS_LOG_BINARY_ACCESS_WRITTEN_DATA = 4,
+    ACCESS_LOG_BINARY_ACCESS_WRITTEN_HASH = 8,
+    ACCESS_LOG_BINARY_ACCESS_SIBLING_HASHES = 16,
+};
+
+using hash_type = machine_merkle_tree::hash_type;
+
+/// \brief Returns log2 of the size of the data logged for an access
+static int get_data_log2_size(int log2_size) {
+    // Minimum logged data size is merkle tree word size
+    return std::max(log2_size, machine_merkle_tree::get_log2_word_size());
+}
+
+/// \brief Returns the number of sibling hashes in the proof for an access
+static int get_sibling_depth(int log2_size) {
+    return machine_merkle_tree::get_log2_root_size() - get_data_log2_size(log2_size);
+}
+
+namespace {
+
+/// \brief Appends binary encodings to a string
+class binary_writer {
+    std::string &m_out;
+
+public:
+    explicit binary_writer(std::string &out) : m_out(out) {}
+
+    void put_byte(uint8_t b) {
+        m_out.push_back(static_cast<char>(b));
+    }
+
+    void put_word32(uint32_t w) {
+        for (int i = 0; i < 4; ++i) {
+            put_byte(static_cast<uint8_t>(w >> (8 * i)));
+        }
+    }
+
+    void put_varint(uint64_t v) {
+        while (v >= 0x80) {
+            put_byte(static_cast<uint8_t>(v | 0x80));
+            v >>= 7;
+        }
+        put_byte(static_cast<uint8_t>(v));
+    }
+
+    void put_bytes(const void *data, uint64_t length) {
+        m_out.append(static_cast<const char *>(data), length);
+    }
+
+    void put_string(const std::string &s) {
+        put_varint(s.size());
+        put_bytes(s.data(), s.size());
+    }
+};
+
+/// \brief Consumes binary encodings from a buffer, checking bounds
+class binary_reader {
+    const unsigned char *m_data;
+    uint64_t m_length;
+    uint64_t m_offset{0};
+
+    void check(uint64_t length) const {
+        if (length > m_length - m_offset) {
+            throw std::invalid_argument{"binary access log is truncated"};
+        }
+    }
+
+public:
+    binary_reader(const unsigned char *data, uint64_t length) : m_data(data), m_length(length) {}
+
+    bool at_end() const {
+        return m_offset == m_length;
+    }
+
+    uint8_t get_byte() {
+        check(1);
+        return m_data[m_offset++];
+    }
+
+    uint32_t get_word32() {
+        uint32_t w = 0;
+        for (int i = 0; i < 4; ++i) {
+            w |= static_cast<uint32_t>(get_byte()) << (8 * i);
+        }
+        return w;
+    }
+
+    uint64_t get_varint() {
+        uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            const uint8_t b = get_byte();
+            v |= static_cast<uint64_t>(b & 0x7f) << shift;
+            if ((b & 0x80) == 0) {
+                return v;
+            }
+        }
+        throw std::invalid_argument{"binary access log has invalid varint"};
+    }
+
+    const unsigned char *get_bytes(uint64_t length) {
+        check(length);
+        const unsigned char *p = m_data + m_offset;
+        m_offset += length;
+        return p;
+    }
+
+    void get_hash(hash_type &hash) {
+        memcpy(hash.data(), get_bytes(hash.size()), hash.size());
+    }
+
+    access_data get_data(uint64_t length) {
+        const unsigned char *p = get_bytes(length);
+        return access_data(p, p + length);
+    }
+
+    std::string get_string() {
+        const uint64_t length = get_varint();
+        const unsigned char *p = get_bytes(length);
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        return std::string(reinterpret_cast<const char *>(p), length);
+    }
+};
+
+} // namespace
+
+/// \brief Counts sibling hashes, from the root down, that match those of the previous access at the same levels
+static uint64_t count_shared_siblings(const access::sibling_hashes_type *prev, int prev_log2_size,
+    const access::sibling_hashes_type &siblings, int log2_size) {
+    if (prev == nullptr) {
+        return 0;
+    }
+    const int depth = get_sibling_depth(log2_size);
+    const int prev_depth = get_sibling_depth(prev_log2_size);
+    uint64_t shared = 0;
+    // Index i corresponds to tree level data_log2_size + i, so the root-most sibling is the last one in both
+    while (shared < static_cast<uint64_t>(std::min(depth, prev_depth)) &&
+        siblings[depth - 1 - shared] == (*prev)[prev_depth - 1 - shared]) {
+        ++shared;
+    }
+    return shared;
+}
+
+std::string encode_access_log_binary(const access_log &log) {
+    std::string out;
+    binary_writer w(out);
+    const auto log_type = log.get_log_type();
+    const auto &accesses = log.get_accesses();
+    w.put_word32(ACCESS_LOG_BINARY_MAGIC);
+    w.put_byte(ACCESS_LOG_BINARY_VERSION);
+    w.put_byte((log_type.has_annotations() ? ACCESS_LOG_BINARY_TYPE_ANNOTATIONS : 0) |
+        (log_type.has_large_data() ? ACCESS_LOG_BINARY_TYPE_LARGE_DATA : 0));
+    w.put_varint(accesses.size());
+    uint64_t prev_address = 0;
+    const access::sibling_hashes_type *prev_siblings = nullptr;
+    int prev_log2_size = 0;
+    for (const auto &a : accesses) {
+        const bool write = a.get_type() == access_type::write;
+        const auto &read = a.get_read();
+        const auto &written = a.get_written();
+        const auto &written_hash = a.get_written_hash();
+        const auto &siblings = a.get_sibling_hashes();
+        const uint8_t flags = (write ? ACCESS_LOG_BINARY_ACCESS_WRITE : 0) |
+            (read.has_value() ? ACCESS_LOG_BINARY_ACCESS_READ_DATA : 0) |
+            (write && written.has_value() ? ACCESS_LOG_BINARY_ACCESS_WRITTEN_DATA : 0) |
+            (write && written_hash.has_value() ? ACCESS_LOG_BINARY_ACCESS_WRITTEN_HASH : 0) |
+            (siblings.has_value() ? ACCESS_LOG_BINARY_ACCESS_SIBLING_HASHES : 0);
+        w.put_byte(flags);
+        w.put_byte(static_cast<uint8_t>(a.get_log2_size()));
+        // Zigzag encoding of the difference, so nearby accesses in either direction take few bytes
+        const uint64_t delta = a.get_address() - prev_address;
+        w.put_varint((delta << 1) ^ (0 - (delta >> 63)));
+        prev_address = a.get_address();
+        w.put_bytes(a.get_read_hash().data(), a.get_read_hash().size());
+        if ((flags & ACCESS_LOG_BINARY_ACCESS_WRITTEN_HASH) != 0) {
+            // NOLINTNEXTLINE(bugprone-unchecked-optional-access)
+            w.put_bytes(written_hash.value().data(), written_hash.value().size());
+        }
+        const uint64_t data_length = UINT64_C(1) << get_data_log2_size(a.get_log2_size());
+        if (read.has_value()) {
+            if (read.value().size() != data_length) {
+                throw std::invalid_argument{"access read data size is inconsistent with its log2_size"};
+            }
+            w.put_bytes(read.value().data(), data_length);
+        }
+        if ((flags & ACCESS_LOG_BINARY_ACCESS_WRITTEN_DATA) != 0) {
+            // NOLINTNEXTLINE(bugprone-unchecked-optional-access)
+            if (written.value().size() != data_length) {
+                throw std::invalid_argument{"access written data size is inconsistent with its log2_size"};
+            }
+            // NOLINTNEXTLINE(bugprone-unchecked-optional-access)
+            w.put_bytes(written.value().data(), data_length);
+        }
+        if (siblings.has_value()) {
+            const int depth = get_sibling_depth(a.get_log2_size());
+            // NOLINTNEXTLINE(bugprone-unchecked-optional-access)
+            const auto &hashes = siblings.value();
+            if (hashes.size() != static_cast<uint64_t>(depth)) {
+                throw std::invalid_argument{"access sibling hashes are inconsistent with its log2_size"};
+            }
+            const uint64_t shared = count_shared_siblings(prev_siblings, prev_log2_size, hashes, a.get_log2_size());
+            w.put_varint(shared);
+            for (uint64_t i = 0; i < depth - shared; ++i) {
+                w.put_bytes(hashes[i].data(), hashes[i].size());
+            }
+            prev_siblings = &hashes;
+            prev_log2_size = a.get_log2_size();
+        } else {
+            prev_siblings = nullptr;
+        }
+    }
+    if (log_type.has_annotations()) {
+        const auto &notes = log.get_notes();
+        if (notes.size() != accesses.size()) {
+            throw std::invalid_argument{"access log notes are inconsistent with its accesses"};
+        }
+        w.put_varint(notes.size());
+        for (const auto &note : notes) {
+            w.put_string(note);
+        }
+        const auto &brackets = log.get_brackets();
+        w.put_varint(brackets.size());
+        for (const auto &b : brackets) {
+            w.put_byte(b.type == bracket_type::begin ? 0 : 1);
+            w.put_varint(b.where);
+            w.put_string(b.text);
+        }
+    }
+    return out;
+}
+
+access_log decode_access_log_binary(const unsigned char *data, uint64_t length) {
+    binary_reader r(data, length);
+    if (r.get_word32() != ACCESS_LOG_BINARY_MAGIC) {
+        throw std::invalid_argument{"not a binary access log"};
+    }
+    const uint8_t version = r.get_byte();
+    if (version != ACCESS_LOG_BINARY_VERSION) {
+        throw std::invalid_argument{"unsupported binary access log version "s + std::to_string(version)};
+    }
+    const uint8_t type_flags = r.get_byte();
+    const access_log::type log_type((type_flags & ACCESS_LOG_BINARY_TYPE_ANNOTATIONS) != 0,
+        (type_flags & ACCESS_LOG_BINARY_TYPE_LARGE_DATA) != 0, true);
+    const uint64_t count = r.get_varint();
+    std::vector<access> accesses;
+    // Each access takes at least one hash, so this bounds the allocation by the input length
+    accesses.reserve(std::min(count, length / sizeof(hash_type)));
+    uint64_t prev_address = 0;
+    for (uint64_t i = 0; i < count; ++i) {
+        access a;
+        const uint8_t flags = r.get_byte();
+        const bool write = (flags & ACCESS_LOG_BINARY_ACCESS_WRITE) != 0;
+        a.set_type(write ? access_type::write : access_type::read);
+        const int log2_size = r.get_byte();
+        if (log2_size >= machine_merkle_tree::get_log2_root_size()) {
+            throw std::invalid_argument{"binary access log has access with invalid log2_size"};
+        }
+        a.set_log2_size(log2_size);
+        const uint64_t zigzag = r.get_varint();
+        prev_address += (zigzag >> 1) ^ (0 - (zigzag & 1));
+        a.set_address(prev_address);
+        r.get_hash(a.get_read_hash());
+        if ((flags & ACCESS_LOG_BINARY_ACCESS_WRITTEN_HASH) != 0) {
+            r.get_hash(a.get_written_hash().emplace());
+        }
+        const uint64_t data_length = UINT64_C(1) << get_data_log2_size(log2_size);
+        if ((flags & ACCESS_LOG_BINARY_ACCESS_READ_DATA) != 0) {
+            a.set_read(r.get_data(data_length));
+        }
+        if ((flags & ACCESS_LOG_BINARY_ACCESS_WRITTEN_DATA) != 0) {
+            a.set_written(r.get_data(data_length));
+        }
+        if ((flags & ACCESS_LOG_BINARY_ACCESS_SIBLING_HASHES) != 0) {
+            const auto depth = static_cast<uint64_t>(get_sibling_depth(log2_size));
+            const uint64_t shared = r.get_varint();
+            // Sharing is only relative to an immediately preceding access that also has sibling hashes
+            const auto *prev = accesses.empty() ? nullptr : &accesses.back().get_sibling_hashes();
+            const uint64_t prev_depth = prev != nullptr && prev->has_value() ? prev->value().size() : 0;
+            if (shared > std::min(depth, prev_depth)) {
+                throw std::invalid_argument{"binary access log has access " + std::to_string(i) +
+                    " sharing too many sibling hashes"};
+            }
+            auto &siblings = a.get_sibling_hashes().emplace(depth);
+            for (uint64_t j = 0; j < depth - shared; ++j) {
+                r.get_hash(siblings[j]);
+            }
+            for (uint64_t j = 0; j < shared; ++j) {
+                // NOLINTNEXTLINE(bugprone-unchecked-optional-access)
+                siblings[depth - 1 - j] = prev->value()[prev_depth - 1 - j];
+            }
+        }
+        accesses.push_back(std::move(a));
+    }
+    std::vector<std::string> notes;
+    std::vector<bracket_note> brackets;
+    if (log_type.has_annotations()) {
+        const uint64_t note_count = r.get_varint();
+        if (note_count != accesses.size()) {
+            throw std::invalid_argument{"binary access log has " + std::to_string(note_count) + " notes for " +
+                std::to_string(accesses.size()) + " accesses"};
+        }
+        notes.reserve(note_count);
+        for (uint64_t i = 0; i < note_count; ++i) {
+            notes.push_back(r.get_string());
+        }
+        const uint64_t bracket_count = r.get_varint();
+        for (uint64_t i = 0; i < bracket_count; ++i) {
+            bracket_note b;
+            b.type = r.get_byte() == 0 ? bracket_type::begin : bracket_type::end;
+            b.where = r.get_varint();
+            if (b.where > accesses.size()) {
+                throw std::invalid_argument{"binary access log has bracket " + std::to_string(i) + " out of range"};
+            }
+            b.text = r.get_string();
+            brackets.push_back(std::move(b));
+        }
+    }
+    if (!r.at_end()) {
+        throw std::invalid_argument{"binary access log has trailing data"};
+    }
+    return access_log(std::move(accesses), std::move(brackets), std::move(notes), log_type);
+}
+
+} // namespace cartesi
@@ -0,0 +1,57 @@
+// Copyright Cartesi and individual authors (see AUTHORS)
+// SPDX-License-Identifier: LGPL-3.0-or-later
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any
+// later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License along
+// with this program (see COPYING). If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef ACCESS_LOG_BINARY_H
+#define ACCESS_LOG_BINARY_H
+
+#include <cstdint>
+#include <string>
+
+#include "access-log.h"
+
+/// \file
+/// \brief Compact binary serialization of access logs
+/// \details The format starts with a header holding a magic number, a version, the log type flags and the number of
+/// accesses. Each access follows, with its address encoded as a zigzag varint delta from the previous access, and
+/// its hashes and data stored raw. Sibling hashes are optional for each access. Those closest to the root that are
+/// identical to the ones of the previous access (at the same tree level) are not repeated. Annotations, if present,
+/// come last, as a count of notes followed by the notes, then a count of brackets followed by the brackets. All
+/// integers are little-endian. Decoding builds the same access objects as the JSON form, so verification costs
+/// the same once a log is decoded.
+
+namespace cartesi {
+
+/// \brief Access log binary format constants
+enum ACCESS_LOG_BINARY_constants : uint32_t {
+    ACCESS_LOG_BINARY_MAGIC = 0x4c414d43, ///< Little-endian word whose bytes spell "CMAL"
+    ACCESS_LOG_BINARY_VERSION = 1,        ///< Version of the format produced by encode_access_log_binary()
+};
+
+/// \brief Serializes an access log in the compact binary format
+/// \param log Access log to serialize
+/// \returns String holding the binary encoding
+std::string encode_access_log_binary(const access_log &log);
+
+/// \brief Deserializes an access log from the compact binary format
+/// \param data Pointer to start of encoding
+/// \param length Length of encoding in bytes
+/// \returns Access log, with a log type that is marked binary
+/// \details Throws std::invalid_argument if the encoding is malformed
+access_log decode_access_log_binary(const unsigned char *data, uint64_t length);
+
+} // namespace cartesi
+
+#endif
@@ -231,18 +231,22 @@ public:
     class type {
         bool m_annotations; ///< Includes annotations
         bool m_large_data;  ///< Includes data bigger than 8 bytes
+        bool m_binary;      ///< Serialized in the compact binary format
     public:
         /// \brief Default constructor
         /// \param annotations Include annotations (default false)
         /// \param large_data Include large data (default false)
-        explicit type(bool annotations = false, bool large_data = false) :
+        /// \param binary Serialize in the compact binary format (default false)
+        explicit type(bool annotations = false, bool large_data = false, bool binary = false) :
             m_annotations(annotations),
-            m_large_data(large_data) {
+            m_large_data(large_data),
+            m_binary(binary) {
             ;
         }
         explicit type(int log_type) :
             m_annotations(static_cast<bool>(log_type & CM_ACCESS_LOG_TYPE_ANNOTATIONS)),
-            m_large_data(static_cast<bool>(log_type & CM_ACCESS_LOG_TYPE_LARGE_DATA)) {
+            m_large_data(static_cast<bool>(log_type & CM_ACCESS_LOG_TYPE_LARGE_DATA)),
+            m_binary(static_cast<bool>(log_type & CM_ACCESS_LOG_TYPE_BINARY)) {
             ;
         }
 
@@ -255,6 +259,11 @@ public:
         bool has_large_data() const {
             return m_large_data;
         }
+
+        /// \brief Returns whether log is serialized in the compact binary format
+        bool is_binary() const {
+            return m_binary;
+        }
     };
 
 private:
@@ -0,0 +1,183 @@
+// Copyright Cartesi and individual authors (see AUTHORS)
+// SPDX-License-Identifier: LGPL-3.0-or-later
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any
+// later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License along
+// with this program (see COPYING). If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "async-run.h"
+
+#include <algorithm>
+#include <cassert>
+#include <utility>
+
+#include "machine-reg.h"
+
+namespace cartesi {
+
+async_run::async_run(i_virtual_machine &m, uint64_t mcycle_end, completion_callback on_completion) :
+    m_machine(m),
+    m_mcycle_end(mcycle_end),
+    m_on_completion(std::move(on_completion)) {
+#ifdef HAVE_THREADS
+    m_thread = std::thread([this] { run_loop(); });
+#endif
+}
+
+async_run::~async_run() {
+#ifdef HAVE_THREADS
+    if (m_thread.joinable()) {
+        pause();
+        if (m_thread.get_id() == std::this_thread::get_id()) {
+            // Only the completion callback can get here safely: the run loop still uses this object after
+            // inspection callbacks return
+            assert(is_done() && "async_run destroyed from an inspection callback");
+            m_thread.detach();
+        } else {
+            m_thread.join();
+        }
+    }
+#else
+    assert(!m_running && "async_run destroyed from one of its callbacks");
+    pause();
+    run_pending();
+#endif
+}
+
+void async_run::pause() {
+    const std::scoped_lock lock(m_mutex);
+    m_pause_requested = true;
+}
+
+void async_run::inspect(inspect_callback callback) {
+    {
+        const std::scoped_lock lock(m_mutex);
+        if (!m_done) {
+            m_inspections.push_back(std::move(callback));
+            return;
+        }
+    }
+    try {
+        callback(m_machine);
+    } catch (...) { // NOLINT(bugprone-empty-catch)
+    }
+}
+
+bool async_run::is_done() const {
+#ifndef HAVE_THREADS
+    run_pending();
+#endif
+    const std::scoped_lock lock(m_mutex);
+    return m_done;
+}
+
+interpreter_break_reason async_run::wait() const {
+#ifndef HAVE_THREADS
+    run_pending();
+#endif
+    std::unique_lock lock(m_mutex);
+    m_done_cv.wait(lock, [this] { return m_done; });
+    if (m_error) {
+        std::rethrow_exception(m_error);
+    }
+    return m_reason;
+}
+
+bool async_run::was_paused() const {
+#ifndef HAVE_THREADS
+    run_pending();
+#endif
+    const std::scoped_lock lock(m_mutex);
+    return m_paused;
+}
+
+#ifndef HAVE_THREADS
+void async_run::run_pending() const {
+    // Without a worker thread, the run happens on the first thread that needs it to be done, so that callbacks are
+    // never invoked before the constructor returns
+    if (!m_started) {
+        m_started = true;
+        m_running = true;
+        // Run objects are never created const, so this is safe
+        const_cast<async_run *>(this)->run_loop(); // NOLINT(cppcoreguidelines-pro-type-const-cast)
+        m_running = false;
+    }
+}
+#endif
+
+void async_run::run_inspections(std::unique_lock<std::mutex> &lock) {
+    while (!m_inspections.empty()) {
+        auto callback = std::move(m_inspections.front());
+        m_inspections.pop_front();
+        lock.unlock();
+        try {
+            callback(m_machine);
+        } catch (...) { // NOLINT(bugprone-empty-catch)
+        }
+        lock.lock();
+    }
+}
+
+void async_run::run_loop() {
+    auto reason = interpreter_break_reason::failed;
+    bool paused = false;
+    std::exception_ptr error;
+    try {
+        // Inspections may write to the machine, so mcycle is only known after servicing them
+        uint64_t mcycle = 0;
+        bool mcycle_known = false;
+        for (;;) {
+            {
+                std::unique_lock lock(m_mutex);
+                if (!m_inspections.empty()) {
+                    run_inspections(lock);
+                    mcycle_known = false;
+                }
+                if (m_pause_requested) {
+                    paused = true;
+                    break;
+                }
+            }
+            if (!mcycle_known) {
+                mcycle = m_machine.read_reg(machine_reg::mcycle);
+            }
+            // When mcycle_end is already past, let run() report it
+            const uint64_t slice_end = mcycle >= m_mcycle_end ? m_mcycle_end :
+                                                                mcycle + std::min(m_mcycle_end - mcycle, SLICE_MCYCLES);
+            reason = m_machine.run(slice_end);
+            if (reason != interpreter_break_reason::reached_target_mcycle || slice_end == m_mcycle_end) {
+                break;
+            }
+            mcycle = slice_end;
+            mcycle_known = true;
+        }
+    } catch (...) {
+        reason = interpreter_break_reason::failed;
+        error = std::current_exception();
+    }
+    // The completion callback may destroy this object, so it must not touch any members
+    auto on_completion = std::move(m_on_completion);
+    {
+        std::unique_lock lock(m_mutex);
+        run_inspections(lock);
+        m_reason = reason;
+        m_paused = paused;
+        m_error = error;
+        m_done = true;
+    }
+    m_done_cv.notify_all();
+    if (on_completion) {
+        on_completion(error, reason, paused);
+    }
+}
+
+} // namespace cartesi
@@ -0,0 +1,125 @@
+// Copyright Cartesi and individual authors (see AUTHORS)
+// SPDX-License-Identifier: LGPL-3.0-or-later
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any
+// later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License along
+// with this program (see COPYING). If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef ASYNC_RUN_H
+#define ASYNC_RUN_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+
+#include "i-virtual-machine.h"
+#include "interpret.h"
+#include "os-features.h"
+
+#ifdef HAVE_THREADS
+#include <thread>
+#endif
+
+/// \file
+/// \brief Runs a machine on a worker thread
+
+namespace cartesi {
+
+/// \class async_run
+/// \brief Runs a machine on its own worker thread until it reaches a target mcycle, yields, or halts
+/// \details The worker advances the machine in slices of at most SLICE_MCYCLES cycles. The points between slices are
+/// safe points: the machine is idle there, so pause requests and inspections are serviced only at them. While the run
+/// is active, the machine must not be accessed other than from inspection callbacks. Without thread support, there is
+/// no worker: the whole run happens the first time it is queried, or when it is destroyed, never in the constructor.
+class async_run final {
+public:
+    /// \brief Maximum number of cycles between safe points
+    static constexpr uint64_t SLICE_MCYCLES = UINT64_C(1) << 20;
+
+    /// \brief Called on the worker thread once the run completes
+    /// \details Receives the error that stopped the run (or nullptr), the break reason, and whether the run was paused.
+    /// Once it is called, the machine is idle again. It may destroy the async_run, unless the async_run is already
+    /// being destroyed. Without thread support, it must not destroy the async_run.
+    using completion_callback = std::function<void(std::exception_ptr error, interpreter_break_reason reason,
+        bool paused)>;
+
+    /// \brief Called at a safe point with exclusive access to the machine
+    /// \details It must not destroy the async_run, which the run still uses once the callback returns.
+    using inspect_callback = std::function<void(i_virtual_machine &m)>;
+
+    /// \brief Constructor
+    /// \param m Machine to run
+    /// \param mcycle_end End cycle value
+    /// \param on_completion Callback invoked when the run completes (can be empty)
+    async_run(i_virtual_machine &m, uint64_t mcycle_end, completion_callback on_completion);
+
+    async_run(const async_run &other) = delete;
+    async_run(async_run &&other) = delete;
+    async_run &operator=(const async_run &other) = delete;
+    async_run &operator=(async_run &&other) = delete;
+
+    /// \brief Destructor
+    /// \details Pauses the run and waits for it to complete.
+    /// If called from the completion callback itself, the worker thread is detached instead.
+    /// Must not be called from an inspection callback.
+    ~async_run();
+
+    /// \brief Asks the run to stop at the next safe point
+    void pause();
+
+    /// \brief Queues a callback to be invoked with exclusive access to the machine
+    /// \details Invoked on the worker thread at the next safe point. If the run has already completed,
+    /// it is invoked immediately on the calling thread. Exceptions thrown by the callback are ignored.
+    void inspect(inspect_callback callback);
+
+    /// \brief Tells whether the run has completed
+    bool is_done() const;
+
+    /// \brief Waits for the run to complete
+    /// \returns Break reason. Rethrows the error that stopped the run, if any.
+    interpreter_break_reason wait() const;
+
+    /// \brief Tells whether the completed run stopped because of a pause request
+    bool was_paused() const;
+
+private:
+    void run_loop();
+#ifndef HAVE_THREADS
+    void run_pending() const;
+#endif
+    void run_inspections(std::unique_lock<std::mutex> &lock);
+
+    i_virtual_machine &m_machine;                                        ///< Machine being run
+    uint64_t m_mcycle_end;                                               ///< Target mcycle
+    completion_callback m_on_completion;                                 ///< Invoked when the run completes
+    std::deque<inspect_callback> m_inspections;                          ///< Callbacks waiting for a safe point
+    bool m_pause_requested{false};                                       ///< Tells worker to stop at next safe point
+    bool m_paused{false};                                                ///< Whether the run stopped on a pause request
+    bool m_done{false};                                                  ///< Whether the run has completed
+    interpreter_break_reason m_reason{interpreter_break_reason::failed}; ///< Break reason of completed run
+    std::exception_ptr m_error;                                          ///< Error that stopped the run
+    mutable std::mutex m_mutex;                                          ///< Protects all fields above but the machine
+    mutable std::condition_variable m_done_cv;                           ///< Signaled when the run completes
+#ifdef HAVE_THREADS
+    std::thread m_thread; ///< Worker thread
+#else
+    mutable bool m_started{false}; ///< Whether the run was started
+    mutable bool m_running{false}; ///< Whether the run, or one of its callbacks, is executing
+#endif
+};
+
+} // namespace cartesi
+
+#endif
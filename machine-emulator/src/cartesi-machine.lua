@@ -241,12 +241,19 @@ where options are:
 
     <key>:<value> is one of
         update_merkle_tree:<number>
+        store_pmas:<number>
 
         update_merkle_tree (optional)
         defines the number of threads to use while calculating the merkle tree.
         when omitted or defined as 0, the number of hardware threads is used if
         it can be identified or else a single thread is used.
 
+        store_pmas (optional)
+        defines the number of threads to use while writing memory images
+        when storing the machine. when omitted or defined as 0, the number of
+        hardware threads is used if it can be identified or else a single
+        thread is used.
+
   --htif-no-console-putchar
     suppress any console output during machine run.
     this includes anything written to machine's stdout or stderr.
@@ -272,6 +279,12 @@ where options are:
 
     DON'T USE THIS OPTION IN PRODUCTION
 
+  --huge-pages
+    back RAM and flash drives with huge pages, reducing host TLB misses
+    for guests that touch a lot of memory.
+    explicit huge pages are used when the host has them reserved,
+    otherwise transparent huge pages are requested.
+
   --max-mcycle=<number>
     stop at a given mcycle (default: 2305843009213693952).
 
@@ -300,7 +313,9 @@ where options are:
     the filesystem will have a tag can be used to mount the host directory
     in the guest using the following command:
 
-        busybox mount -t 9p <tag> <mountpoint>
+        busybox mount -t 9p -o msize=512000 <tag> <mountpoint>
+
+    the msize option lets large reads and writes travel in a single message.
 
     NON REPRODUCIBLE OPTION, DON'T USE THIS OPTION IN PRODUCTION
 
@@ -403,6 +418,42 @@ where options are:
 
     NON REPRODUCIBLE OPTION, DON'T USE THIS OPTION IN PRODUCTION
 
+  --virtio-balloon
+    add a VirtIO memory balloon device with free page reporting.
+    pages the guest kernel reports as free are zeroed and their host
+    memory is released, so the emulator memory footprint shrinks when
+    the guest frees memory.
+    requires a guest kernel with CONFIG_VIRTIO_BALLOON and CONFIG_PAGE_REPORTING.
+
+    NON REPRODUCIBLE OPTION, DON'T USE THIS OPTION IN PRODUCTION
+
+  --virtio-blk=<key>:<value>[,<key>:<value>[,...]...]
+    add a VirtIO block device backed by a host disk image file.
+    unlike flash drives, the disk is not mapped into the machine memory,
+    so large disks cost neither address space nor hashing time.
+    the guest sees the disks as /dev/vda, /dev/vdb, ...
+    the image file is modified in place by guest writes.
+
+    <key>:<value> is one of
+        filename:<filename>
+        read_only
+        discard
+        mount:<string>
+
+        filename (mandatory)
+        gives the name of the disk image file (length must be multiple of 512).
+
+        read_only (optional)
+        the guest cannot write to the disk.
+
+        discard (optional)
+        sectors discarded by the guest release their space in the image file.
+
+        mount (optional)
+        mount point where the disk is mounted automatically in init.
+
+    NON REPRODUCIBLE OPTION, DON'T USE THIS OPTION IN PRODUCTION
+
   -it
     run in enhanced interactive mode using a VirtIO console device.
     the console is resizable, more responsive, and support more features
@@ -579,6 +630,7 @@ local unreproducible = false
 local virtio = {}
 local virtio_net_user_config
 local virtio_volume_count = 0
+local virtio_blk_count = 0
 local has_virtio_console = false
 local has_network = false
 local has_sync_init_date = false
@@ -596,9 +648,11 @@ local cmio
 local cmio_advance
 local cmio_inspect
 local concurrency_update_merkle_tree = 0
+local concurrency_store_pmas = 0
 local skip_root_hash_check = false
 local skip_root_hash_store = false
 local skip_version_check = false
+local huge_pages = false
 local htif_no_console_putchar = false
 local htif_console_getchar = false
 local htif_yield_automatic = true
@@ -681,7 +735,7 @@ local function handle_volume_option(host_directory, guest_directory)
     virtio_volume_count = virtio_volume_count + 1
     table.insert(virtio, { type = "p9fs", tag = tag, host_directory = host_directory })
     append_init = append_init .. "busybox mkdir -p " .. guest_directory .. " && "
-    append_init = append_init .. "busybox mount -t 9p " .. tag .. " " .. guest_directory .. "\n"
+    append_init = append_init .. "busybox mount -t 9p -o msize=512000 " .. tag .. " " .. guest_directory .. "\n"
     -- sync guest date with host date, otherwise file system updates will have wrong dates
     handle_sync_init_date(true)
     return true
@@ -807,6 +861,42 @@ local function handle_virtio_console(all)
     return true
 end
 
+local function handle_virtio_balloon(all)
+    if not all then return false end
+    unreproducible = true
+    table.insert(virtio, { type = "balloon" })
+    return true
+end
+
+local function handle_virtio_blk(all, opts)
+    if not opts then return false end
+    local b = util.parse_options(opts, {
+        filename = true,
+        read_only = true,
+        discard = true,
+        mount = true,
+    })
+    assert(b.filename and b.filename ~= true, "missing virtio block device filename in " .. all)
+    assert(not b.read_only or b.read_only == true, "invalid virtio block device read_only value in " .. all)
+    assert(not b.discard or b.discard == true, "invalid virtio block device discard value in " .. all)
+    unreproducible = true
+    table.insert(virtio, {
+        type = "blk",
+        image_filename = b.filename,
+        read_only = b.read_only or false,
+        discard = b.discard or false,
+    })
+    -- block devices are named in the order they are probed
+    local devname = "vd" .. string.char(string.byte("a") + virtio_blk_count)
+    virtio_blk_count = virtio_blk_count + 1
+    if b.mount and b.mount ~= true then
+        append_init = append_init .. 'busybox mkdir -p "' .. b.mount .. '" && busybox mount '
+        if b.read_only then append_init = append_init .. "-o ro " end
+        append_init = append_init .. "/dev/" .. devname .. ' "' .. b.mount .. '"\n'
+    end
+    return true
+end
+
 local function handle_interactive(all)
     if not all then return false end
     handle_virtio_console(true)
@@ -978,6 +1068,14 @@ local options = {
         "^%-%-virtio%-console$",
         handle_virtio_console,
     },
+    {
+        "^%-%-virtio%-balloon$",
+        handle_virtio_balloon,
+    },
+    {
+        "^(%-%-virtio%-blk%=(.+))$",
+        handle_virtio_blk,
+    },
     {
         "^%-%-virtio%-net%=([%w+]+),?([%w:,]*)$",
         handle_virtio_net,
@@ -1147,10 +1245,16 @@ local options = {
             if not opts then return false end
             local c = util.parse_options(opts, {
                 update_merkle_tree = true,
+                store_pmas = true,
             })
-            c.update_merkle_tree =
-                assert(util.parse_number(c.update_merkle_tree), "invalid update_merkle_tree number in " .. all)
-            concurrency_update_merkle_tree = c.update_merkle_tree
+            if c.update_merkle_tree then
+                concurrency_update_merkle_tree =
+                    assert(util.parse_number(c.update_merkle_tree), "invalid update_merkle_tree number in " .. all)
+            end
+            if c.store_pmas then
+                concurrency_store_pmas =
+                    assert(util.parse_number(c.store_pmas), "invalid store_pmas number in " .. all)
+            end
             return true
         end,
     },
@@ -1186,6 +1290,14 @@ local options = {
             return true
         end,
     },
+    {
+        "^%-%-huge%-pages$",
+        function(all)
+            if not all then return false end
+            huge_pages = true
+            return true
+        end,
+    },
     {
         "^(%-%-initial%-proof%=(.+))$",
         function(all, opts)
@@ -1671,6 +1783,7 @@ end
 local runtime_config = {
     concurrency = {
         update_merkle_tree = concurrency_update_merkle_tree,
+        store_pmas = concurrency_store_pmas,
     },
     htif = {
         no_console_putchar = htif_no_console_putchar,
@@ -1678,6 +1791,7 @@ local runtime_config = {
     skip_root_hash_check = skip_root_hash_check,
     skip_root_hash_store = skip_root_hash_store,
     skip_version_check = skip_version_check,
+    huge_pages = huge_pages,
 }
 
 if remote_spawn then
@@ -147,6 +147,39 @@ static int jsonrpc_machine_obj_index_delay_next_request(lua_State *L) {
     return 0;
 }
 
+/// \brief This is the machine:new_hosted_machine() method implementation.
+static int jsonrpc_machine_obj_index_new_hosted_machine(lua_State *L) {
+    lua_settop(L, 3);
+    auto &m = clua_check<clua_managed_cm_ptr<cm_machine>>(L, 1);
+    const auto template_handle = static_cast<uint64_t>(luaL_optinteger(L, 2, 0));
+    const char *runtime_config = !lua_isnil(L, 3) ? clua_check_json_string(L, 3) : nullptr;
+    auto &new_m = clua_push_to(L, clua_managed_cm_ptr<cm_machine>(nullptr));
+    if (cm_jsonrpc_new_hosted_machine(m.get(), template_handle, runtime_config, &new_m.get()) != 0) {
+        return luaL_error(L, "%s", cm_get_last_error_message());
+    }
+    return 1;
+}
+
+/// \brief This is the machine:new_hosted_template() method implementation.
+static int jsonrpc_machine_obj_index_new_hosted_template(lua_State *L) {
+    auto &m = clua_check<clua_managed_cm_ptr<cm_machine>>(L, 1);
+    uint64_t template_handle = 0;
+    if (cm_jsonrpc_new_hosted_template(m.get(), &template_handle) != 0) {
+        return luaL_error(L, "%s", cm_get_last_error_message());
+    }
+    lua_pushinteger(L, static_cast<lua_Integer>(template_handle));
+    return 1;
+}
+
+/// \brief This is the machine:delete_hosted_template() method implementation.
+static int jsonrpc_machine_obj_index_delete_hosted_template(lua_State *L) {
+    auto &m = clua_check<clua_managed_cm_ptr<cm_machine>>(L, 1);
+    if (cm_jsonrpc_delete_hosted_template(m.get(), static_cast<uint64_t>(luaL_checkinteger(L, 2))) != 0) {
+        return luaL_error(L, "%s", cm_get_last_error_message());
+    }
+    return 0;
+}
+
 /// \brief Contents of the machine object metatable __index table.
 static const auto jsonrpc_machine_obj_index = cartesi::clua_make_luaL_Reg_array(
     {{"set_timeout", jsonrpc_machine_obj_index_set_timeout}, {"get_timeout", jsonrpc_machine_obj_index_get_timeout},
@@ -158,7 +191,10 @@ static const auto jsonrpc_machine_obj_index = cartesi::clua_make_luaL_Reg_array(
         {"rebind_server", jsonrpc_machine_obj_index_rebind_server},
         {"shutdown_server", jsonrpc_machine_obj_index_shutdown_server},
         {"emancipate_server", jsonrpc_machine_obj_index_emancipate_server},
-        {"delay_next_request", jsonrpc_machine_obj_index_delay_next_request}});
+        {"delay_next_request", jsonrpc_machine_obj_index_delay_next_request},
+        {"new_hosted_machine", jsonrpc_machine_obj_index_new_hosted_machine},
+        {"new_hosted_template", jsonrpc_machine_obj_index_new_hosted_template},
+        {"delete_hosted_template", jsonrpc_machine_obj_index_delete_hosted_template}});
 
 /// \brief This is the jsonrpc.connect() method implementation.
 static int mod_connect_server(lua_State *L) {
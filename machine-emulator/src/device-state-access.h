@@ -146,6 +146,18 @@ private:
     bool do_write_memory(uint64_t paddr, const unsigned char *data, uint64_t length) override {
         return m_a.write_memory(paddr, data, length);
     }
+
+    bool do_discard_memory(uint64_t paddr, uint64_t length) override {
+        return m_a.discard_memory(paddr, length);
+    }
+
+    unsigned char *do_get_host_memory_range(uint64_t paddr, uint64_t length, bool writable) override {
+        return m_a.get_host_memory_range(paddr, length, writable);
+    }
+
+    bool do_mark_dirty_memory(uint64_t paddr, uint64_t length) override {
+        return m_a.mark_dirty_memory(paddr, length);
+    }
 };
 
 } // namespace cartesi
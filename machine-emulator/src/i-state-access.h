@@ -631,6 +631,36 @@ public:
         return derived().do_write_memory(paddr, data, length);
     }
 
+    /// \brief Zeroes a chunk of a memory PMA range, releasing the host memory that backs it when possible.
+    /// \param paddr Target physical address.
+    /// \param length Size of chunk.
+    /// \returns True if PMA was found and memory fully discarded, false otherwise.
+    /// \details The entire chunk must fit inside the same memory
+    /// PMA range, otherwise it fails. The search for the PMA range is implicit, and not logged.
+    bool discard_memory(uint64_t paddr, uint64_t length) {
+        return derived().do_discard_memory(paddr, length);
+    }
+
+    /// \brief Obtains a host pointer to a chunk of a memory PMA range, so devices can access it in place.
+    /// \param paddr Target physical address.
+    /// \param length Size of chunk.
+    /// \param writable True if the chunk will be written to through the pointer.
+    /// \returns Pointer to the host memory backing the chunk, or nullptr if it cannot be accessed in place.
+    /// \details The entire chunk must fit inside the same memory PMA range, otherwise it fails.
+    /// Writable chunks are marked dirty up front. The search for the PMA range is implicit, and not logged.
+    unsigned char *get_host_memory_range(uint64_t paddr, uint64_t length, bool writable) {
+        return derived().do_get_host_memory_range(paddr, length, writable);
+    }
+
+    /// \brief Marks a chunk of a memory PMA range as dirty, after it was written through a host pointer.
+    /// \param paddr Target physical address.
+    /// \param length Size of chunk.
+    /// \returns True if successful, false otherwise.
+    /// \details The entire chunk must fit inside the same memory PMA range, otherwise it fails.
+    bool mark_dirty_memory(uint64_t paddr, uint64_t length) {
+        return derived().do_mark_dirty_memory(paddr, length);
+    }
+
     /// \brief Reads a word from memory.
     /// \tparam T Type of word to read.
     /// \param paddr Target physical address.
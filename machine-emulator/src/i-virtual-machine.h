@@ -19,12 +19,14 @@
 
 #include <cstdint>
 #include <string>
+#include <vector>
 
 #include "access-log.h"
 #include "interpret.h"
 #include "machine-config.h"
 #include "machine-memory-range-descr.h"
 #include "machine-merkle-tree.h"
+#include "machine-template.h"
 #include "machine.h"
 #include "uarch-interpret.h"
 
@@ -78,6 +80,16 @@ public:
         do_load(directory, runtime);
     }
 
+    /// \brief Create a machine from template
+    void create_from_template(const machine_template &t, const machine_runtime_config &runtime = {}) {
+        do_create_from_template(t, runtime);
+    }
+
+    /// \brief Create a template holding a snapshot of the machine
+    machine_template *create_template() const {
+        return do_create_template();
+    }
+
     /// \brief Runs the machine until mcycle reaches mcycle_end or the machine halts.
     interpreter_break_reason run(uint64_t mcycle_end) {
         return do_run(mcycle_end);
@@ -118,6 +130,11 @@ public:
         return do_read_reg(r);
     }
 
+    /// \brief Reads the values of several registers at once
+    std::vector<uint64_t> read_regs(const std::vector<reg> &regs) const {
+        return do_read_regs(regs);
+    }
+
     /// \brief Writes the value of any register
     void write_reg(reg w, uint64_t val) {
         do_write_reg(w, val);
@@ -133,6 +150,16 @@ public:
         do_write_memory(address, data, length);
     }
 
+    /// \brief Obtains a host pointer to a chunk of the machine memory.
+    unsigned char *get_host_memory(uint64_t address, uint64_t length) {
+        return do_get_host_memory(address, length);
+    }
+
+    /// \brief Marks a chunk of the machine memory written through a host pointer as modified.
+    void mark_dirty_memory(uint64_t address, uint64_t length) {
+        do_mark_dirty_memory(address, length);
+    }
+
     /// \brief Reads a chunk of data from the machine virtual memory.
     void read_virtual_memory(uint64_t address, unsigned char *data, uint64_t length) {
         do_read_virtual_memory(address, data, length);
@@ -231,6 +258,12 @@ public:
         return do_verify_step(root_hash_before, log_filename, mcycle_count, root_hash_after);
     }
 
+    /// \brief Checks the validity of many state transitions caused by log_step.
+    std::vector<interpreter_break_reason> verify_steps(const std::vector<machine::step_log_entry> &entries,
+        bool chained, uint64_t concurrency) const {
+        return do_verify_steps(entries, chained, concurrency);
+    }
+
     /// \brief Checks the validity of a state transition caused by log_step_uarch.
     void verify_step_uarch(const hash_type &root_hash_before, const access_log &log,
         const hash_type &root_hash_after) const {
@@ -259,6 +292,8 @@ private:
     virtual bool do_is_empty() const = 0;
     virtual void do_create(const machine_config &config, const machine_runtime_config &runtime) = 0;
     virtual void do_load(const std::string &directory, const machine_runtime_config &runtime) = 0;
+    virtual void do_create_from_template(const machine_template &t, const machine_runtime_config &runtime) = 0;
+    virtual machine_template *do_create_template() const = 0;
     virtual interpreter_break_reason do_run(uint64_t mcycle_end) = 0;
     virtual void do_store(const std::string &dir) const = 0;
     virtual interpreter_break_reason do_log_step(uint64_t mcycle_count, const std::string &filename) = 0;
@@ -267,9 +302,12 @@ private:
     virtual void do_get_root_hash(hash_type &hash) const = 0;
     virtual bool do_verify_merkle_tree() const = 0;
     virtual uint64_t do_read_reg(reg r) const = 0;
+    virtual std::vector<uint64_t> do_read_regs(const std::vector<reg> &regs) const = 0;
     virtual void do_write_reg(reg w, uint64_t val) = 0;
     virtual void do_read_memory(uint64_t address, unsigned char *data, uint64_t length) const = 0;
     virtual void do_write_memory(uint64_t address, const unsigned char *data, uint64_t length) = 0;
+    virtual unsigned char *do_get_host_memory(uint64_t address, uint64_t length) = 0;
+    virtual void do_mark_dirty_memory(uint64_t address, uint64_t length) = 0;
     virtual void do_read_virtual_memory(uint64_t address, unsigned char *data, uint64_t length) = 0;
     virtual void do_write_virtual_memory(uint64_t address, const unsigned char *data, uint64_t length) = 0;
     virtual uint64_t do_translate_virtual_address(uint64_t vaddr) = 0;
@@ -291,6 +329,8 @@ private:
     virtual machine_config do_get_default_config() const = 0;
     virtual interpreter_break_reason do_verify_step(const hash_type &root_hash_before, const std::string &log_filename,
         uint64_t mcycle_count, const hash_type &root_hash_after) const = 0;
+    virtual std::vector<interpreter_break_reason> do_verify_steps(const std::vector<machine::step_log_entry> &entries,
+        bool chained, uint64_t concurrency) const = 0;
     virtual void do_verify_step_uarch(const hash_type &root_hash_before, const access_log &log,
         const hash_type &root_hash_after) const = 0;
     virtual void do_verify_reset_uarch(const hash_type &root_hash_before, const access_log &log,
@@ -28,6 +28,7 @@
 #include <variant>
 #include <vector>
 
+#include "access-log-binary.h"
 #include "access-log.h"
 #include "base64.h"
 #include "bracket-note.h"
@@ -550,6 +551,25 @@ static interpreter_break_reason interpreter_break_reason_from_name(const std::st
     return got->second;
 }
 
+static std::string interpreter_break_reason_name(interpreter_break_reason reason) {
+    using ibr = interpreter_break_reason;
+    switch (reason) {
+        case ibr::failed:
+            return "failed";
+        case ibr::halted:
+            return "halted";
+        case ibr::yielded_manually:
+            return "yielded_manually";
+        case ibr::yielded_automatically:
+            return "yielded_automatically";
+        case ibr::yielded_softly:
+            return "yielded_softly";
+        case ibr::reached_target_mcycle:
+            return "reached_target_mcycle";
+    }
+    throw std::domain_error{"invalid interpreter break reason"};
+}
+
 static uarch_interpreter_break_reason uarch_interpreter_break_reason_from_name(const std::string &name) {
     using uibr = uarch_interpreter_break_reason;
     if (name == "reached_target_cycle") {
@@ -772,6 +792,7 @@ void ju_get_opt_field(const nlohmann::json &j, const K &key, concurrency_runtime
         return;
     }
     ju_get_opt_field(j[key], "update_merkle_tree"s, value.update_merkle_tree, path + to_string(key) + "/");
+    ju_get_opt_field(j[key], "store_pmas"s, value.store_pmas, path + to_string(key) + "/");
 }
 
 template void ju_get_opt_field<uint64_t>(const nlohmann::json &j, const uint64_t &key,
@@ -805,6 +826,8 @@ void ju_get_opt_field(const nlohmann::json &j, const K &key, machine_runtime_con
     ju_get_opt_field(j[key], "skip_root_hash_store"s, value.skip_root_hash_store, path + to_string(key) + "/");
     ju_get_opt_field(j[key], "skip_version_check"s, value.skip_version_check, path + to_string(key) + "/");
     ju_get_opt_field(j[key], "soft_yield"s, value.soft_yield, path + to_string(key) + "/");
+    ju_get_opt_field(j[key], "huge_pages"s, value.huge_pages, path + to_string(key) + "/");
+    ju_get_opt_field(j[key], "share_pages"s, value.share_pages, path + to_string(key) + "/");
 }
 
 template void ju_get_opt_field<uint64_t>(const nlohmann::json &j, const uint64_t &key, machine_runtime_config &value,
@@ -1102,7 +1125,9 @@ void ju_get_opt_field(const nlohmann::json &j, const K &key, not_default_constru
     ju_get_field(jk, "has_annotations"s, has_annotations, new_path);
     bool has_large_data = false;
     ju_get_field(jk, "has_large_data"s, has_large_data, new_path);
-    optional.emplace(has_annotations, has_large_data);
+    bool is_binary = false;
+    ju_get_opt_field(jk, "is_binary"s, is_binary, new_path);
+    optional.emplace(has_annotations, has_large_data, is_binary);
 }
 
 template void ju_get_opt_field<uint64_t>(const nlohmann::json &j, const uint64_t &key,
@@ -1119,6 +1144,26 @@ void ju_get_opt_field(const nlohmann::json &j, const K &key, not_default_constru
         return;
     }
     const auto &jk = j[key];
+    // Logs in the compact binary format are carried in base64 strings
+    if (jk.is_string()) {
+        const auto bin = decode_base64(jk.template get<std::string>());
+        try {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+            optional.emplace(decode_access_log_binary(reinterpret_cast<const unsigned char *>(bin.data()), bin.size()));
+        } catch (const std::invalid_argument &e) {
+            throw std::invalid_argument("field \""s + path + to_string(key) + "\" " + e.what());
+        }
+        // The binary format can carry accesses without proofs, but logs must have them, as in the JSON form
+        const auto &accesses = optional.value().get_accesses();
+        for (unsigned i = 0; i < accesses.size(); ++i) {
+            if (!accesses[i].get_sibling_hashes().has_value()) {
+                optional = {};
+                throw std::invalid_argument(
+                    "field \""s + path + to_string(key) + "/accesses/" + to_string(i) + "\" missing sibling hashes");
+            }
+        }
+        return;
+    }
     const auto new_path = path + to_string(key) + "/";
     not_default_constructible<access_log::type> log_type;
     ju_get_field(jk, "log_type"s, log_type, new_path);
@@ -1406,6 +1451,14 @@ void ju_get_opt_field(const nlohmann::json &j, const K &key, virtio_device_confi
         virtio_net_tuntap_config net_tuntap_config;
         ju_get_opt_field(jconfig, "iface"s, net_tuntap_config.iface, new_path);
         value.emplace<virtio_net_tuntap_config>(std::move(net_tuntap_config));
+    } else if (type == "balloon") {
+        value.emplace<virtio_balloon_config>(virtio_balloon_config{});
+    } else if (type == "blk") {
+        virtio_blk_config blk_config;
+        ju_get_opt_field(jconfig, "image_filename"s, blk_config.image_filename, new_path);
+        ju_get_opt_field(jconfig, "read_only"s, blk_config.read_only, new_path);
+        ju_get_opt_field(jconfig, "discard"s, blk_config.discard, new_path);
+        value.emplace<virtio_blk_config>(std::move(blk_config));
     } else {
         throw std::domain_error("invalid virtio device type \""s + type + "\""s);
     }
@@ -1761,9 +1814,16 @@ void to_json(nlohmann::json &j, const std::vector<access> &as) {
 
 void to_json(nlohmann::json &j, const access_log::type &log_type) {
     j = nlohmann::json{{"has_annotations", log_type.has_annotations()}, {"has_large_data", log_type.has_large_data()}};
+    if (log_type.is_binary()) {
+        j["is_binary"] = true;
+    }
 }
 
 void to_json(nlohmann::json &j, const access_log &log) {
+    if (log.get_log_type().is_binary()) {
+        j = encode_base64(encode_access_log_binary(log));
+        return;
+    }
     j = nlohmann::json{{"log_type", log.get_log_type()}, {"accesses", log.get_accesses()}};
     if (log.get_log_type().has_annotations()) {
         j["notes"] = log.get_notes();
@@ -1837,6 +1897,11 @@ void to_json(nlohmann::json &j, const virtio_device_config &config) {
                 j = nlohmann::json{{"type", "net-user"}, {"hostfwd", std::move(jhostfwd)}};
             } else if constexpr (std::is_same_v<T, cartesi::virtio_net_tuntap_config>) {
                 j = nlohmann::json{{"type", "net-tuntap"}, {"iface", vdev_config.iface}};
+            } else if constexpr (std::is_same_v<T, cartesi::virtio_balloon_config>) {
+                j = nlohmann::json{{"type", "balloon"}};
+            } else if constexpr (std::is_same_v<T, cartesi::virtio_blk_config>) {
+                j = nlohmann::json{{"type", "blk"}, {"image_filename", vdev_config.image_filename},
+                    {"read_only", vdev_config.read_only}, {"discard", vdev_config.discard}};
             } else {
                 throw std::domain_error("invalid virtio device configuration");
             }
@@ -1974,6 +2039,7 @@ void to_json(nlohmann::json &j, const machine_config &config) {
 void to_json(nlohmann::json &j, const concurrency_runtime_config &config) {
     j = nlohmann::json{
         {"update_merkle_tree", config.update_merkle_tree},
+        {"store_pmas", config.store_pmas},
     };
 }
 
@@ -1991,6 +2057,8 @@ void to_json(nlohmann::json &j, const machine_runtime_config &runtime) {
         {"skip_root_hash_store", runtime.skip_root_hash_store},
         {"skip_version_check", runtime.skip_version_check},
         {"soft_yield", runtime.soft_yield},
+        {"huge_pages", runtime.huge_pages},
+        {"share_pages", runtime.share_pages},
     };
 }
 
@@ -2004,6 +2072,13 @@ void to_json(nlohmann::json &j, const machine_memory_range_descrs &mrds) {
         [](const auto &a) -> nlohmann::json { return a; });
 }
 
+void to_json(nlohmann::json &j, const machine::divergence &d) {
+    j = nlohmann::json{{"diverged", d.diverged}, {"mcycle", d.mcycle}, {"mcycle_a", d.mcycle_a},
+        {"mcycle_b", d.mcycle_b}, {"break_reason_a", interpreter_break_reason_name(d.break_reason_a)},
+        {"break_reason_b", interpreter_break_reason_name(d.break_reason_b)}, {"root_hash_a", d.root_hash_a},
+        {"root_hash_b", d.root_hash_b}, {"page_addresses", d.page_addresses}};
+}
+
 void to_json(nlohmann::json &j, const fork_result &fork_result) {
     j = nlohmann::json{{"address", fork_result.address}, {"pid", fork_result.pid}};
 }
@@ -627,6 +627,7 @@ void to_json(nlohmann::json &j, const machine_runtime_config &runtime);
 void to_json(nlohmann::json &j, const machine::reg &reg);
 void to_json(nlohmann::json &j, const machine_memory_range_descr &mrd);
 void to_json(nlohmann::json &j, const machine_memory_range_descrs &mrds);
+void to_json(nlohmann::json &j, const machine::divergence &d);
 void to_json(nlohmann::json &j, const fork_result &fork_result);
 void to_json(nlohmann::json &j, const semantic_version &version);
 
@@ -0,0 +1,81 @@
+// Copyright Cartesi and individual authors (see AUTHORS)
+// SPDX-License-Identifier: LGPL-3.0-or-later
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any
+// later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License along
+// with this program (see COPYING). If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef JSONRPC_BINARY_FRAME_H
+#define JSONRPC_BINARY_FRAME_H
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+
+/// \file
+/// \brief Framing used by the binary JSONRPC transport
+/// \details Requests and responses posted to JSONRPC_BINARY_TARGET carry a 4-byte little-endian length, followed by
+/// that many bytes of an ordinary JSONRPC object, followed by a raw payload that runs to the end of the body. Methods
+/// that move memory, hashes, or access logs take their bulk arguments from the request payload and return their bulk
+/// results in the response payload, instead of embedding them in the JSON as base64.
+
+namespace cartesi {
+
+/// \brief HTTP target that serves binary frames
+constexpr const char *JSONRPC_BINARY_TARGET = "/binary";
+
+/// \brief Content type of binary frames
+constexpr const char *JSONRPC_BINARY_CONTENT_TYPE = "application/octet-stream";
+
+/// \brief Builds a binary frame
+/// \param j Serialized JSONRPC object
+/// \param payload Raw payload
+/// \returns Frame holding both
+static inline std::string jsonrpc_binary_frame_encode(std::string_view j, std::string_view payload) {
+    if (j.size() > UINT32_MAX) {
+        throw std::invalid_argument{"binary frame JSON is too long"};
+    }
+    const auto length = static_cast<uint32_t>(j.size());
+    std::string frame;
+    frame.reserve(sizeof(length) + j.size() + payload.size());
+    for (unsigned i = 0; i < sizeof(length); ++i) {
+        frame.push_back(static_cast<char>((length >> (8 * i)) & 0xff));
+    }
+    frame.append(j);
+    frame.append(payload);
+    return frame;
+}
+
+/// \brief Splits a binary frame into its JSON and payload parts
+/// \param frame Frame to split
+/// \returns Pair with views of the JSON and of the payload
+/// \details Throws std::invalid_argument if the frame is malformed
+static inline std::pair<std::string_view, std::string_view> jsonrpc_binary_frame_decode(std::string_view frame) {
+    uint32_t length = 0;
+    if (frame.size() < sizeof(length)) {
+        throw std::invalid_argument{"binary frame is truncated"};
+    }
+    for (unsigned i = 0; i < sizeof(length); ++i) {
+        length |= static_cast<uint32_t>(static_cast<unsigned char>(frame[i])) << (8 * i);
+    }
+    frame.remove_prefix(sizeof(length));
+    if (frame.size() < length) {
+        throw std::invalid_argument{"binary frame is truncated"};
+    }
+    return {frame.substr(0, length), frame.substr(length)};
+}
+
+} // namespace cartesi
+
+#endif // JSONRPC_BINARY_FRAME_H
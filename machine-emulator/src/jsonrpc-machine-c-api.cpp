@@ -22,6 +22,7 @@
 #include <cstring>
 #include <exception>
 #include <memory>
+#include <optional>
 #include <stdexcept>
 #include <string>
 
@@ -199,6 +200,47 @@ cm_error cm_jsonrpc_get_server_version(const cm_machine *m, const char **version
     return cm_result_failure();
 }
 
+cm_error cm_jsonrpc_new_hosted_machine(const cm_machine *m, uint64_t template_handle, const char *runtime_config,
+    cm_machine **new_m) try {
+    if (new_m == nullptr) {
+        throw std::invalid_argument("invalid new machine output");
+    }
+    const auto *cpp_m = convert_from_c(m);
+    std::optional<cartesi::machine_runtime_config> r;
+    if (runtime_config != nullptr) {
+        r = cartesi::from_json<cartesi::machine_runtime_config>(runtime_config);
+    }
+    *new_m = convert_to_c(cpp_m->new_hosted_machine(template_handle, r));
+    return cm_result_success();
+} catch (...) {
+    if (new_m != nullptr) {
+        *new_m = nullptr;
+    }
+    return cm_result_failure();
+}
+
+cm_error cm_jsonrpc_new_hosted_template(const cm_machine *m, uint64_t *template_handle) try {
+    if (template_handle == nullptr) {
+        throw std::invalid_argument("invalid template handle output");
+    }
+    const auto *cpp_m = convert_from_c(m);
+    *template_handle = cpp_m->new_hosted_template();
+    return cm_result_success();
+} catch (...) {
+    if (template_handle != nullptr) {
+        *template_handle = 0;
+    }
+    return cm_result_failure();
+}
+
+cm_error cm_jsonrpc_delete_hosted_template(const cm_machine *m, uint64_t template_handle) try {
+    const auto *cpp_m = convert_from_c(m);
+    cpp_m->delete_hosted_template(template_handle);
+    return cm_result_success();
+} catch (...) {
+    return cm_result_failure();
+}
+
 cm_error cm_jsonrpc_shutdown_server(cm_machine *m) try {
     auto *cpp_m = convert_from_c(m);
     cpp_m->shutdown_server();
@@ -128,6 +128,38 @@ CM_API cm_error cm_jsonrpc_get_server_version(const cm_machine *m, const char **
 /// This function makes it the leader of its own process group.
 CM_API cm_error cm_jsonrpc_emancipate_server(cm_machine *m);
 
+/// \brief Asks the server to host a new machine alongside the one it already serves.
+/// \param m Pointer to a valid JSONRPC remote machine object.
+/// \param template_handle Handle of a template kept by the server, as returned by cm_jsonrpc_new_hosted_template(),
+/// or 0 for an empty machine.
+/// \param runtime_config Machine runtime configuration as a JSON object in a string,
+/// used when instantiating the template (can be NULL). Must be NULL when template_handle is 0.
+/// \param new_m Receives the pointer to the new JSONRPC remote machine object talking to the hosted machine.
+/// Set to NULL on failure.
+/// \returns 0 for success, non zero code for error.
+/// \details Requests to different hosted machines are served concurrently by the worker threads of the server.
+/// Server functions such as cm_jsonrpc_fork_server() are unavailable once the server hosts machines.
+/// \details The hosted machine is deleted from the server on cm_delete(), unless the cleanup call is
+/// changed to CM_JSONRPC_NOTHING with cm_jsonrpc_set_cleanup_call().
+/// \details The communication timeout is inherited from the original machine object.
+CM_API cm_error cm_jsonrpc_new_hosted_machine(const cm_machine *m, uint64_t template_handle,
+    const char *runtime_config, cm_machine **new_m);
+
+/// \brief Asks the server to keep a template of the machine.
+/// \param m Pointer to a valid JSONRPC remote machine object.
+/// \param template_handle Receives the handle of the new template. Set to 0 on failure.
+/// \returns 0 for success, non zero code for error.
+/// \details Machines instantiated from the template with cm_jsonrpc_new_hosted_machine() share its pages
+/// copy-on-write, until the template is deleted with cm_jsonrpc_delete_hosted_template().
+CM_API cm_error cm_jsonrpc_new_hosted_template(const cm_machine *m, uint64_t *template_handle);
+
+/// \brief Asks the server to delete a template it keeps.
+/// \param m Pointer to a valid JSONRPC remote machine object.
+/// \param template_handle Handle of the template to delete.
+/// \returns 0 for success, non zero code for error.
+/// \details Machines previously instantiated from the template are unaffected.
+CM_API cm_error cm_jsonrpc_delete_hosted_template(const cm_machine *m, uint64_t template_handle);
+
 // -----------------------------------------------------------------------------
 // Client API functions
 // -----------------------------------------------------------------------------
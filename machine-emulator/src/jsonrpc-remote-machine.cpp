@@ -22,17 +22,23 @@
 #include <algorithm>
 #include <array>
 #include <cerrno>
+#include <charconv>
+#include <cinttypes>
 #include <chrono>
 #include <climits>
+#include <condition_variable>
 #include <csignal>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <ctime>
+#include <deque>
 #include <exception>
+#include <functional>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <sstream>
 #include <stdexcept>
 #include <string>
@@ -48,12 +54,17 @@
 
 #include <fcntl.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#include <boost/asio/generic/stream_protocol.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
 #include <boost/asio/signal_set.hpp>
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
@@ -62,15 +73,18 @@
 
 #include <json.hpp>
 
+#include "access-log-binary.h"
 #include "access-log.h"
 #include "base64.h"
 #include "interpret.h"
 #include "json-util.h"
+#include "jsonrpc-binary-frame.h"
 #include "jsonrpc-discover.h"
 #include "jsonrpc-version.h"
 #include "machine-config.h"
 #include "machine-merkle-tree.h"
 #include "machine-runtime-config.h"
+#include "machine-template.h"
 #include "machine.h"
 #include "os.h"
 #include "uarch-interpret.h"
@@ -82,10 +96,13 @@
 // NOLINTNEXTLINE(cppcoreguidelines-macro-usage)
 #define PROGRAM_NAME "cartesi-jsonrpc-machine"
 
-namespace beast = boost::beast; // from <boost/beast.hpp>
-namespace http = beast::http;   // from <boost/beast/http.hpp>
-namespace asio = boost::asio;   // from <boost/asio.hpp>
-using tcp = asio::ip::tcp;      // from <boost/asio/ip/tcp.hpp>
+namespace beast = boost::beast;                        // from <boost/beast.hpp>
+namespace http = beast::http;                          // from <boost/beast/http.hpp>
+namespace asio = boost::asio;                          // from <boost/asio.hpp>
+using tcp = asio::ip::tcp;                             // from <boost/asio/ip/tcp.hpp>
+using unix_stream = asio::local::stream_protocol;      // from <boost/asio/local/stream_protocol.hpp>
+using generic_stream = asio::generic::stream_protocol; // from <boost/asio/generic/stream_protocol.hpp>
+using generic_acceptor = asio::basic_socket_acceptor<generic_stream>;
 
 /// \brief Type for printing time, log severity level, program name, pid, and ppid prefix to each log line
 struct log_prefix {
@@ -145,20 +162,284 @@ static void install_signal_handlers() {
 
 //------------------------------------------------------------------------------
 
+/// \brief Prefix that selects Unix domain socket addresses
+constexpr std::string_view unix_address_prefix = "unix:";
+
+/// \brief Parse a address from a string to an endpoint.
+/// \param address Address string (e.g "127.0.0.1:8000" or "unix:/tmp/machine.sock")
+/// \returns Endpoint address
+static generic_stream::endpoint address_to_endpoint(const std::string &address) {
+    try {
+        if (address.starts_with(unix_address_prefix)) {
+            const std::string path = address.substr(unix_address_prefix.size());
+            if (path.empty()) {
+                throw std::runtime_error{"empty path"};
+            }
+            return unix_stream::endpoint{path};
+        }
+        const auto pos = address.find_last_of(':');
+        const std::string ip = address.substr(0, pos);
+        const int port = std::stoi(address.substr(pos + 1));
+        if (port < 0 || port > 65535) {
+            throw std::runtime_error{"invalid port"};
+        }
+        return tcp::endpoint{asio::ip::make_address(ip), static_cast<uint16_t>(port)};
+    } catch (std::exception &e) {
+        throw std::runtime_error{"invalid endpoint address \"" + address + "\""};
+    }
+}
+
+/// \brief Converts a generic endpoint to a specific protocol endpoint
+/// \tparam ENDPOINT Specific endpoint type
+/// \param endpoint Generic endpoint
+/// \returns Specific endpoint
+template <typename ENDPOINT>
+static ENDPOINT endpoint_cast(const generic_stream::endpoint &endpoint) {
+    ENDPOINT specific;
+    if (endpoint.size() > specific.capacity()) {
+        throw std::runtime_error{"endpoint is too large"};
+    }
+    std::memcpy(specific.data(), endpoint.data(), endpoint.size());
+    specific.resize(endpoint.size());
+    return specific;
+}
+
+/// \brief Returns whether an endpoint is a Unix domain socket endpoint
+static bool is_unix_endpoint(const generic_stream::endpoint &endpoint) {
+    return endpoint.protocol().family() == AF_UNIX;
+}
+
+static std::string endpoint_to_string(const generic_stream::endpoint &endpoint) {
+    if (is_unix_endpoint(endpoint)) {
+        return std::string{unix_address_prefix} + endpoint_cast<unix_stream::endpoint>(endpoint).path();
+    }
+    std::ostringstream ss;
+    ss << endpoint_cast<tcp::endpoint>(endpoint);
+    return ss.str();
+}
+
+/// \brief Removes a Unix domain socket left behind by a server that is gone (e.g. after it crashed)
+/// \param ioc IO context
+/// \param path Unix domain socket path
+/// \details The socket is only removed when nobody accepts connections at it anymore.
+static void remove_stale_unix_socket(asio::io_context &ioc, const std::string &path) {
+    struct stat st{};
+    if (lstat(path.c_str(), &st) != 0 || !S_ISSOCK(st.st_mode)) {
+        return;
+    }
+    unix_stream::socket probe{ioc};
+    beast::error_code ec;
+    std::ignore = probe.connect(unix_stream::endpoint{path}, ec);
+    if (ec == asio::error::connection_refused) {
+        std::ignore = unlink(path.c_str());
+    }
+}
+
+/// \brief Creates an acceptor listening at an endpoint
+/// \param ioc IO context
+/// \param endpoint Endpoint to listen at
+/// \returns Acceptor
+/// \details Stale Unix domain sockets at the endpoint are removed first, so binding does not fail because of them.
+static generic_acceptor make_acceptor(asio::io_context &ioc, const generic_stream::endpoint &endpoint) {
+    if (is_unix_endpoint(endpoint)) {
+        remove_stale_unix_socket(ioc, endpoint_cast<unix_stream::endpoint>(endpoint).path());
+    }
+    return generic_acceptor{ioc, endpoint};
+}
+
+//------------------------------------------------------------------------------
+
+/// \brief Prefix of request targets addressed to hosted machines
+constexpr std::string_view hosted_target_prefix = "/machines/";
+
+/// \brief Parses the target of a request addressed to a hosted machine
+/// \param target Request target (e.g. "/machines/3" or "/machines/3/binary")
+/// \param handle Receives the handle of the hosted machine
+/// \param binary Receives whether the request uses the binary transport
+/// \returns True if target addresses a hosted machine, false otherwise
+static bool parse_hosted_target(std::string_view target, uint64_t &handle, bool &binary) {
+    if (!target.starts_with(hosted_target_prefix)) {
+        return false;
+    }
+    target.remove_prefix(hosted_target_prefix.size());
+    const auto *end = target.data() + target.size();
+    const auto [ptr, ec] = std::from_chars(target.data(), end, handle);
+    if (ec != std::errc{} || ptr == target.data() || handle == 0) {
+        return false;
+    }
+    const std::string_view rest{ptr, static_cast<size_t>(end - ptr)};
+    binary = rest == cartesi::JSONRPC_BINARY_TARGET;
+    return binary || rest.empty();
+}
+
+/// \brief Machine served by the server, along with its queue of pending jobs
+struct machine_slot {
+    using job_type = std::function<std::function<void()>()>;
+
+    uint64_t handle{0};                        ///< Handle of hosted machine, or 0 for the machine served at "/"
+    std::string address;                       ///< Address the hosted machine is served at, for logging
+    std::unique_ptr<cartesi::machine> machine; ///< Cartesi Machine, if any
+    std::deque<job_type> jobs;                 ///< Jobs waiting for a worker (protected by the worker pool mutex)
+    bool scheduled{false};                     ///< Whether slot is in the worker pool ready queue
+};
+
+/// \class worker_pool
+/// \brief Runs jobs for hosted machines on a shared pool of threads
+/// \details Each hosted machine has its own queue of jobs, so its jobs run one at a time and in order, while jobs for
+/// different machines run in parallel. A job returns a completion that is then invoked on the IO thread. ASIO is built
+/// without thread support, so completions are handed back to the IO thread through a pipe.
+class worker_pool {
+public:
+    /// \brief Constructor
+    /// \param ioc IO context completions are invoked from
+    /// \param thread_count Number of worker threads
+    worker_pool(asio::io_context &ioc, uint64_t thread_count) : m_notifier(ioc) {
+        std::array<int, 2> fds{-1, -1};
+        if (pipe(fds.data()) < 0) {
+            throw std::system_error{errno, std::generic_category(), "pipe failed"};
+        }
+        m_notifier.assign(fds[0]);
+        m_notify_fd = fds[1];
+        std::ignore = fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+        std::ignore = fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+        std::ignore = fcntl(fds[1], F_SETFL, O_NONBLOCK);
+        thread_count = std::max<uint64_t>(thread_count, 1);
+        for (uint64_t i = 0; i < thread_count; ++i) {
+            m_threads.emplace_back([this] { work_loop(); });
+        }
+    }
+
+    worker_pool(const worker_pool &other) = delete;
+    worker_pool(worker_pool &&other) = delete;
+    worker_pool &operator=(const worker_pool &other) = delete;
+    worker_pool &operator=(worker_pool &&other) = delete;
+
+    /// \brief Destructor
+    /// \details Runs all queued jobs, discarding their completions, and joins the worker threads
+    ~worker_pool() {
+        {
+            const std::scoped_lock lock(m_mutex);
+            m_stopping = true;
+        }
+        m_ready_cv.notify_all();
+        for (auto &thread : m_threads) {
+            thread.join();
+        }
+        close(m_notify_fd);
+    }
+
+    /// \brief Queues a job for a machine
+    /// \param slot Machine the job is for
+    /// \param job Job to run on a worker thread
+    /// \details Must be called from the IO thread. The IO context keeps running until the job completes.
+    void submit(const std::shared_ptr<machine_slot> &slot, machine_slot::job_type job) {
+        {
+            const std::scoped_lock lock(m_mutex);
+            slot->jobs.push_back(std::move(job));
+            if (!slot->scheduled) {
+                slot->scheduled = true;
+                m_ready.push_back(slot);
+            }
+        }
+        m_ready_cv.notify_one();
+        ++m_pending;
+        if (!m_waiting) {
+            wait_completions();
+        }
+    }
+
+private:
+    void work_loop() {
+        std::unique_lock lock(m_mutex);
+        for (;;) {
+            m_ready_cv.wait(lock, [this] { return m_stopping || !m_ready.empty(); });
+            if (m_ready.empty()) {
+                return;
+            }
+            auto slot = std::move(m_ready.front());
+            m_ready.pop_front();
+            auto job = std::move(slot->jobs.front());
+            slot->jobs.pop_front();
+            lock.unlock();
+            std::function<void()> completion;
+            try {
+                completion = job();
+            } catch (...) { // NOLINT(bugprone-empty-catch)
+                // Jobs report their own errors, there is nobody left to tell
+            }
+            lock.lock();
+            // Other machines waiting for a worker go first
+            if (slot->jobs.empty()) {
+                slot->scheduled = false;
+            } else {
+                m_ready.push_back(std::move(slot));
+            }
+            m_completions.push_back(std::move(completion));
+            // A full pipe already has a wakeup pending, so errors can be ignored
+            const char wakeup = 0;
+            std::ignore = write(m_notify_fd, &wakeup, 1);
+        }
+    }
+
+    void wait_completions() {
+        m_waiting = true;
+        m_notifier.async_read_some(asio::buffer(m_wakeups),
+            [this](const beast::error_code &ec, std::size_t /*bytes_transferred*/) {
+                m_waiting = false;
+                if (ec == asio::error::operation_aborted) {
+                    return;
+                }
+                std::deque<std::function<void()>> completions;
+                {
+                    const std::scoped_lock lock(m_mutex);
+                    std::swap(completions, m_completions);
+                }
+                m_pending -= completions.size();
+                for (auto &completion : completions) {
+                    if (completion) {
+                        completion();
+                    }
+                }
+                if (m_pending > 0 && !m_waiting) {
+                    wait_completions();
+                }
+            });
+    }
+
+    asio::posix::stream_descriptor m_notifier;         ///< Read end of pipe, signaled when jobs complete
+    int m_notify_fd{-1};                               ///< Write end of pipe
+    std::array<char, 64> m_wakeups{};                  ///< Buffer for draining the pipe
+    uint64_t m_pending{0};                             ///< Jobs whose completion has not been invoked yet
+    bool m_waiting{false};                             ///< Whether a read from the pipe is pending
+    std::mutex m_mutex;                                ///< Protects ready queue, slot jobs, and completions
+    std::condition_variable m_ready_cv;                ///< Signaled when a slot becomes ready or on stop
+    std::deque<std::shared_ptr<machine_slot>> m_ready; ///< Slots with jobs and no worker
+    std::deque<std::function<void()>> m_completions;   ///< Completions waiting for the IO thread
+    bool m_stopping{false};                            ///< Tells workers to exit once the ready queue is empty
+    std::vector<std::thread> m_threads;                ///< Worker threads
+};
+
+//------------------------------------------------------------------------------
+
 struct http_handler;
 struct http_session;
 template <typename HTTP_REQ>
 static http::message_generator handle_request(HTTP_REQ &&rreq, const std::shared_ptr<http_session> &session);
+static http::message_generator handle_jsonrpc_request(const http::request<http::string_body> &req,
+    const std::shared_ptr<http_session> &session);
+static http::message_generator handle_binary_request(const http::request<http::string_body> &req,
+    const std::shared_ptr<http_session> &session);
 
 // Handles a HTTP session
 struct http_session : std::enable_shared_from_this<http_session> {
-    beast::tcp_stream stream;
+    beast::basic_stream<generic_stream> stream;
     beast::flat_buffer buffer;
     std::unique_ptr<http::request_parser<http::string_body>> req_parser;
     std::shared_ptr<http_handler> handler;
+    std::shared_ptr<machine_slot> slot; // Machine the request being served is addressed to
 
     // Take ownership of the stream
-    http_session(tcp::socket &&socket, std::shared_ptr<http_handler> handler) :
+    http_session(generic_stream::socket &&socket, std::shared_ptr<http_handler> handler) :
         stream(std::move(socket)),
         handler(std::move(handler)) {}
 
@@ -196,6 +477,11 @@ struct http_session : std::enable_shared_from_this<http_session> {
         // Retrieve the request
         auto req = parser->release();
 
+        // Requests to hosted machines are served by the worker pool, which sends the response when done
+        if (serve_hosted_request(req)) {
+            return;
+        }
+
         // Process the request
         auto res = handle_request(std::move(req), shared_from_this());
 
@@ -208,6 +494,12 @@ struct http_session : std::enable_shared_from_this<http_session> {
         send_response(std::move(res));
     }
 
+    // Queues a request addressed to a hosted machine, if it is one
+    bool serve_hosted_request(http::request<http::string_body> &req);
+
+    // Returns the address the machine being served is at, for logging
+    const std::string &address() const;
+
     // Sends a HTTP response
     void send_response(http::message_generator &&msg) {
         const bool keep_alive = msg.keep_alive();
@@ -241,9 +533,9 @@ struct http_session : std::enable_shared_from_this<http_session> {
 
     // Called we are done with this HTTP session
     void shutdown() {
-        // Send a TCP send shutdown.
+        // Send a socket send shutdown.
         beast::error_code ec;
-        std::ignore = stream.socket().shutdown(tcp::socket::shutdown_both, ec);
+        std::ignore = stream.socket().shutdown(generic_stream::socket::shutdown_both, ec);
 
         // At this point the connection is closed gracefully
     }
@@ -260,21 +552,111 @@ struct http_session : std::enable_shared_from_this<http_session> {
 
 // Accepts incoming connections and launches HTTP sessions
 struct http_handler : std::enable_shared_from_this<http_handler> {
+    using slot_map = std::unordered_map<uint64_t, std::shared_ptr<machine_slot>>;
+    using template_map = std::unordered_map<uint64_t, std::shared_ptr<const cartesi::machine_template>>;
+
     // NOLINTNEXTLINE(cppcoreguidelines-avoid-const-or-ref-data-members)
     asio::io_context &ioc;                             ///< IO context
     asio::signal_set signals;                          ///< Signal set used for process termination notifications
-    tcp::endpoint local_endpoint;                      ///< Address server receives requests at
-    tcp::acceptor acceptor;                            ///< TCP connection acceptor
+    generic_stream::endpoint local_endpoint;           ///< Endpoint server receives requests at
+    std::string local_address;                         ///< Address server receives requests at, for logging
+    generic_acceptor acceptor;                         ///< TCP or Unix domain socket connection acceptor
+    std::string unix_path;                             ///< Unix domain socket path bound by this process, if any
     uint64_t delay{0};                                 ///< How much to delay next request in ms
-    std::unique_ptr<cartesi::machine> machine;         ///< Cartesi Machine, if any
+    std::shared_ptr<machine_slot> default_slot;        ///< Machine served at "/"
     std::vector<std::weak_ptr<http_session>> sessions; ///< HTTP sessions
-
-    http_handler(asio::io_context &ioc, tcp::acceptor &&acceptor) :
+    uint64_t worker_count;                             ///< Number of worker threads serving hosted machines
+    std::unique_ptr<worker_pool> workers;              ///< Worker threads, started with the first hosted machine
+    slot_map hosted_machines;                          ///< Hosted machines by handle
+    uint64_t next_machine_handle{1};                   ///< Handle of next hosted machine
+    std::mutex templates_mutex;                        ///< Protects hosted templates, also created by worker threads
+    template_map templates;                            ///< Hosted templates by handle
+    uint64_t next_template_handle{1};                  ///< Handle of next hosted template
+    bool binary_transport;                             ///< Whether requests are also served at JSONRPC_BINARY_TARGET
+
+    http_handler(asio::io_context &ioc, generic_acceptor &&acceptor, uint64_t worker_count, bool binary_transport) :
         ioc(ioc),
         signals(ioc),
         local_endpoint(acceptor.local_endpoint()),
-        acceptor(std::move(acceptor)) {
-        SLOG(info) << "remote machine server bound to " << local_endpoint;
+        local_address(endpoint_to_string(local_endpoint)),
+        acceptor(std::move(acceptor)),
+        default_slot(std::make_shared<machine_slot>()),
+        worker_count(worker_count),
+        binary_transport(binary_transport) {
+        own_unix_path();
+        SLOG(info) << "remote machine server bound to " << local_address;
+    }
+
+    // Creates an empty hosted machine, starting the worker threads if needed
+    std::shared_ptr<machine_slot> new_hosted_machine() {
+        if (!workers) {
+            workers = std::make_unique<worker_pool>(ioc, worker_count);
+        }
+        auto slot = std::make_shared<machine_slot>();
+        slot->handle = next_machine_handle++;
+        slot->address = local_address + std::string{hosted_target_prefix} + std::to_string(slot->handle);
+        hosted_machines.emplace(slot->handle, slot);
+        return slot;
+    }
+
+    // Returns the hosted machine with a given handle, if any
+    std::shared_ptr<machine_slot> find_hosted_machine(uint64_t handle) const {
+        auto found = hosted_machines.find(handle);
+        if (found == hosted_machines.end()) {
+            return {};
+        }
+        return found->second;
+    }
+
+    // Deletes a hosted machine once its pending jobs complete
+    bool delete_hosted_machine(uint64_t handle) {
+        auto found = hosted_machines.find(handle);
+        if (found == hosted_machines.end()) {
+            return false;
+        }
+        auto slot = std::move(found->second);
+        hosted_machines.erase(found);
+        workers->submit(slot, [slot] {
+            slot->machine.reset();
+            return std::function<void()>{};
+        });
+        return true;
+    }
+
+    // Deletes all hosted machines once their pending jobs complete
+    void delete_hosted_machines() {
+        while (!hosted_machines.empty()) {
+            delete_hosted_machine(hosted_machines.begin()->first);
+        }
+    }
+
+    // Stops the worker threads, after all their jobs complete
+    void stop_workers() {
+        workers.reset();
+    }
+
+    // Keeps a hosted template and returns its handle
+    uint64_t add_template(std::shared_ptr<const cartesi::machine_template> t) {
+        const std::scoped_lock lock(templates_mutex);
+        const uint64_t handle = next_template_handle++;
+        templates.emplace(handle, std::move(t));
+        return handle;
+    }
+
+    // Returns the hosted template with a given handle, if any
+    std::shared_ptr<const cartesi::machine_template> find_template(uint64_t handle) {
+        const std::scoped_lock lock(templates_mutex);
+        auto found = templates.find(handle);
+        if (found == templates.end()) {
+            return {};
+        }
+        return found->second;
+    }
+
+    // Deletes a hosted template, machines instantiated from it remain valid
+    bool delete_template(uint64_t handle) {
+        const std::scoped_lock lock(templates_mutex);
+        return templates.erase(handle) != 0;
     }
 
     // Installs all handlers that should stop the HTTP server
@@ -297,15 +679,15 @@ struct http_handler : std::enable_shared_from_this<http_handler> {
         acceptor.async_accept(ioc, beast::bind_front_handler(&http_handler::on_accept, shared_from_this()));
     }
 
-    // Bind the HTTP server to a new TCP port
-    void rebind(tcp::acceptor &&new_acceptor) {
+    // Bind the HTTP server to a new TCP port or Unix domain socket path
+    void rebind(generic_acceptor &&new_acceptor) {
         // Stop asynchronous accept and close the acceptor
-        beast::error_code ec;
-        std::ignore = acceptor.cancel(ec);
-        std::ignore = acceptor.close(ec);
+        close_acceptor();
         // Replace current acceptor with the new one
         acceptor = std::move(new_acceptor);
         local_endpoint = acceptor.local_endpoint();
+        local_address = endpoint_to_string(local_endpoint);
+        own_unix_path();
         next_accept();
     }
 
@@ -314,6 +696,16 @@ struct http_handler : std::enable_shared_from_this<http_handler> {
         beast::error_code ec;
         std::ignore = acceptor.cancel(ec);
         std::ignore = acceptor.close(ec);
+        // Nobody can connect to the Unix domain socket path anymore, so remove it
+        if (!unix_path.empty()) {
+            std::ignore = unlink(unix_path.c_str());
+            unix_path.clear();
+        }
+    }
+
+    // Forget the Unix domain socket path, if any, without removing it (e.g. after fork, it belongs to the parent)
+    void disown_unix_path() {
+        unix_path.clear();
     }
 
     // Close open sessions
@@ -327,26 +719,33 @@ struct http_handler : std::enable_shared_from_this<http_handler> {
     }
 
 private:
+    // Take ownership of the Unix domain socket path the acceptor is bound to, if any
+    void own_unix_path() {
+        if (is_unix_endpoint(local_endpoint)) {
+            unix_path = endpoint_cast<unix_stream::endpoint>(local_endpoint).path();
+        }
+    }
+
     // Receives a termination signal
     void on_signal(const beast::error_code &ec, int signum) {
         // Operation may be aborted (e.g uninstall_termination_signal_handlers() was called)
         if (ec == asio::error::operation_aborted) {
             return;
         }
-        SLOG(info) << local_endpoint << " http handler terminated due to signal " << signum;
+        SLOG(info) << local_address << " http handler terminated due to signal " << signum;
         uninstall_termination_signal_handlers();
         close_acceptor();
         close_sessions();
     }
 
     // Receives an incoming TCP connection
-    void on_accept(const beast::error_code ec, tcp::socket socket) {
+    void on_accept(const beast::error_code ec, generic_stream::socket socket) {
         // Operation may be aborted (e.g rebind() or close_acceptor() was called)
         if (ec == asio::error::operation_aborted || !acceptor.is_open()) {
             return;
         }
         if (ec) {
-            SLOG(error) << local_endpoint << " accept error: " << ec.what();
+            SLOG(error) << local_address << " accept error: " << ec.what();
             // If we can't accept, the listening socket is probably in a broken state,
             // close the acceptor so the client abort new connection attempts.
             // This may happen when amount of open files is reached.
@@ -355,8 +754,10 @@ private:
         }
 
         // Disable Nagle's algorithm to minimize TCP connection latency
-        const boost::asio::ip::tcp::no_delay no_delay_option(true);
-        socket.set_option(no_delay_option);
+        if (!is_unix_endpoint(local_endpoint)) {
+            const boost::asio::ip::tcp::no_delay no_delay_option(true);
+            socket.set_option(no_delay_option);
+        }
 
         // Create the session
         auto session = std::make_shared<http_session>(std::move(socket), shared_from_this());
@@ -377,6 +778,42 @@ private:
     }
 };
 
+bool http_session::serve_hosted_request(http::request<http::string_body> &req) {
+    uint64_t handle = 0;
+    bool binary = false;
+    const auto target = req.target();
+    if (req.method() != http::verb::post ||
+        !parse_hosted_target(std::string_view{target.data(), target.size()}, handle, binary) ||
+        (binary && !handler->binary_transport)) {
+        return false;
+    }
+    auto hosted = handler->find_hosted_machine(handle);
+    if (!hosted) {
+        return false;
+    }
+    SLOG(trace) << hosted->address << " queuing request";
+    slot = hosted;
+    auto shared_req = std::make_shared<http::request<http::string_body>>(std::move(req));
+    handler->workers->submit(hosted, [self = shared_from_this(), shared_req, binary]() -> std::function<void()> {
+        auto res = std::make_shared<http::message_generator>(
+            binary ? handle_binary_request(*shared_req, self) : handle_jsonrpc_request(*shared_req, self));
+        return [self, res] {
+            // The session may have been closed in the meantime, in that case we have nothing to reply
+            if (self->stream.socket().is_open()) {
+                self->send_response(std::move(*res));
+            }
+        };
+    });
+    return true;
+}
+
+const std::string &http_session::address() const {
+    if (slot && slot->handle != 0) {
+        return slot->address;
+    }
+    return handler->local_address;
+}
+
 //------------------------------------------------------------------------------
 
 /// \brief Names for JSONRPC error codes
@@ -627,7 +1064,8 @@ static size_t count_args(const std::tuple<ARGS...> &tup) {
 template <typename... ARGS, size_t... I>
 static std::tuple<ARGS...> parse_array_args(const json &j, std::index_sequence<I...> /*unused*/) {
     std::tuple<ARGS...> tp;
-    (cartesi::ju_get_field(j, static_cast<uint64_t>(I), std::get<I>(tp)), ...);
+    // Trailing entries left out of the array can only be optional parameters, which then remain empty
+    ((I < j.size() ? cartesi::ju_get_field(j, static_cast<uint64_t>(I), std::get<I>(tp)) : void()), ...);
     return tp;
 }
 
@@ -707,7 +1145,9 @@ static json jsonrpc_shutdown_handler(const json &j, const std::shared_ptr<http_s
     // Ensure the machine is unmapped before shutting down.
     // This step releases memory and flushes any pending changes to disk,
     // allowing files from the destroyed machine to be safely reused afterward.
-    session->handler->machine.reset();
+    // Hosted machines are destroyed by the worker threads once their pending requests complete.
+    session->handler->default_slot->machine.reset();
+    session->handler->delete_hosted_machines();
     // Close acceptor right-away so the port can be immediately reused after request response.
     // This will also stop the IO main loop when all connections are closed,
     // because the IO context will run out of pending events to execute.
@@ -715,7 +1155,7 @@ static json jsonrpc_shutdown_handler(const json &j, const std::shared_ptr<http_s
     // Cancel other asynchronous pending events so IO context run out of pending events
     session->handler->close_sessions(session);
     session->handler->uninstall_termination_signal_handlers();
-    SLOG(trace) << session->handler->local_endpoint << " shutting down";
+    SLOG(trace) << session->handler->local_address << " shutting down";
     return jsonrpc_response_ok(j);
 }
 
@@ -745,27 +1185,16 @@ static json jsonrpc_get_version_handler(const json &j, const std::shared_ptr<htt
         });
 }
 
-/// \brief Parse a address from a string to an endpoint.
-/// \param address Address string (e.g "127.0.0.1:8000")
-/// \returns Endpoint address
-static tcp::endpoint address_to_endpoint(const std::string &address) {
-    try {
-        const auto pos = address.find_last_of(':');
-        const std::string ip = address.substr(0, pos);
-        const int port = std::stoi(address.substr(pos + 1));
-        if (port < 0 || port > 65535) {
-            throw std::runtime_error{"invalid port"};
-        }
-        return {asio::ip::make_address(ip), static_cast<uint16_t>(port)};
-    } catch (std::exception &e) {
-        throw std::runtime_error{"invalid endpoint address \"" + address + "\""};
+/// \brief Returns an endpoint for a forked server to listen on
+/// \param endpoint Endpoint the current server listens on
+/// \returns Same IP address with an ephemeral port, or a new Unix domain socket path next to the current one
+static generic_stream::endpoint fork_endpoint(const generic_stream::endpoint &endpoint) {
+    if (is_unix_endpoint(endpoint)) {
+        static uint64_t fork_count = 0;
+        return unix_stream::endpoint{endpoint_cast<unix_stream::endpoint>(endpoint).path() + "." +
+            std::to_string(getpid()) + "." + std::to_string(fork_count++)};
     }
-}
-
-static std::string endpoint_to_string(const tcp::endpoint &endpoint) {
-    std::ostringstream ss;
-    ss << endpoint;
-    return ss.str();
+    return tcp::endpoint{endpoint_cast<tcp::endpoint>(endpoint).address(), 0};
 }
 
 /// \brief JSONRPC handler for the fork method
@@ -779,9 +1208,13 @@ static std::string endpoint_to_string(const tcp::endpoint &endpoint) {
 /// server.
 static json jsonrpc_fork_handler(const json &j, const std::shared_ptr<http_session> &session) {
     jsonrpc_check_no_params(j);
+    // Only the forking thread would survive in the child
+    if (session->handler->workers) {
+        return jsonrpc_response_server_error(j, "fork is unavailable once machines are hosted");
+    }
     // Listen in desired port before fork so failures happen still in parent,
     // who can directly report them to client
-    tcp::acceptor acceptor{session->handler->ioc, tcp::endpoint{session->handler->local_endpoint.address(), 0}};
+    generic_acceptor acceptor = make_acceptor(session->handler->ioc, fork_endpoint(session->handler->local_endpoint));
     const std::string new_server_address = endpoint_to_string(acceptor.local_endpoint());
     // Notify ASIO that we are about to fork
     session->handler->ioc.notify_fork(asio::io_context::fork_prepare);
@@ -792,9 +1225,11 @@ static json jsonrpc_fork_handler(const json &j, const std::shared_ptr<http_sessi
         session->handler->ioc.notify_fork(asio::io_context::fork_child);
         // Close all sessions that were initiated by the parent
         session->handler->close_sessions();
+        // The parent is still serving from its Unix domain socket path, if any, so leave it alone
+        session->handler->disown_unix_path();
         // Swap current handler acceptor with the new one
         session->handler->rebind(std::move(acceptor));
-        SLOG(trace) << session->handler->local_endpoint << " fork child";
+        SLOG(trace) << session->handler->local_address << " fork child";
     } else { // Parent process, fork() may have succeeded or failed
         // Notify to ASIO that we are the parent
         session->handler->ioc.notify_fork(asio::io_context::fork_parent);
@@ -803,10 +1238,10 @@ static json jsonrpc_fork_handler(const json &j, const std::shared_ptr<http_sessi
         beast::error_code ec;
         std::ignore = acceptor.close(ec);
         if (pid < 0) { // Fork failed
-            SLOG(error) << session->handler->local_endpoint << " fork failed (" << strerror(errno) << ")";
+            SLOG(error) << session->handler->local_address << " fork failed (" << strerror(errno) << ")";
             return jsonrpc_response_server_error(j, "fork failed ("s + strerror(errno) + ")"s);
         }
-        SLOG(trace) << session->handler->local_endpoint << " fork parent";
+        SLOG(trace) << session->handler->local_address << " fork parent";
     }
     const cartesi::fork_result result{
         .address = new_server_address,
@@ -825,34 +1260,105 @@ static json jsonrpc_rebind_handler(const json &j, const std::shared_ptr<http_ses
     static const char *param_name[] = {"address"};
     auto args = parse_args<std::string>(j, param_name);
     const std::string new_server_address = std::get<0>(args);
-    const tcp::endpoint new_local_endpoint = address_to_endpoint(new_server_address);
+    const generic_stream::endpoint new_local_endpoint = address_to_endpoint(new_server_address);
     if (new_local_endpoint != session->handler->local_endpoint) {
-        SLOG(trace) << session->handler->local_endpoint << " rebinding to " << new_local_endpoint;
-        session->handler->rebind(tcp::acceptor{session->handler->ioc, new_local_endpoint});
-        SLOG(trace) << session->handler->local_endpoint << " rebound to " << session->handler->local_endpoint;
+        SLOG(trace) << session->handler->local_address << " rebinding to " << new_server_address;
+        session->handler->rebind(make_acceptor(session->handler->ioc, new_local_endpoint));
+        SLOG(trace) << session->handler->local_address << " rebound to " << session->handler->local_address;
     } else {
-        SLOG(trace) << session->handler->local_endpoint << " rebind unnecessary";
+        SLOG(trace) << session->handler->local_address << " rebind unnecessary";
     }
-    const std::string result = endpoint_to_string(session->handler->local_endpoint);
+    const std::string result = session->handler->local_address;
     return jsonrpc_response_ok(j, result);
 }
 
+/// \brief JSONRPC handler for the host.new_machine method
+/// \param j JSON request object
+/// \param session HTTP session
+/// \returns JSON response object
+/// \details Machines instantiated from the same template share its memory pages until they write to them.
+/// Instantiation is the first job of the new machine, so it runs on a worker thread and requests to the machine wait
+/// for it. If it fails, the machine is removed and requests to it are rejected.
+static json jsonrpc_host_new_machine_handler(const json &j, const std::shared_ptr<http_session> &session) {
+    static const char *param_name[] = {"template", "runtime_config"};
+    auto args = parse_args<cartesi::optional_param<uint64_t>,
+        cartesi::optional_param<cartesi::machine_runtime_config>>(j, param_name);
+    const uint64_t template_handle = std::get<0>(args).value_or(0);
+    std::shared_ptr<const cartesi::machine_template> t;
+    if (template_handle != 0) {
+        t = session->handler->find_template(template_handle);
+        if (!t) {
+            return jsonrpc_response_invalid_params(j, "template not found");
+        }
+    } else if (has_arg(std::get<1>(args))) {
+        return jsonrpc_response_invalid_params(j, "runtime config given without template");
+    }
+    auto slot = session->handler->new_hosted_machine();
+    if (t) {
+        auto runtime = std::get<1>(args).value_or(cartesi::machine_runtime_config{});
+        session->handler->workers->submit(slot,
+            [slot, t = std::move(t), runtime = std::move(runtime),
+                handler = session->handler]() -> std::function<void()> {
+                try {
+                    slot->machine = std::make_unique<cartesi::machine>(*t, runtime);
+                    return {};
+                } catch (std::exception &e) {
+                    SLOG(error) << slot->address << " instantiation failed (" << e.what() << ")";
+                }
+                return [slot, handler] {
+                    // The machine may have been deleted in the meantime
+                    if (handler->find_hosted_machine(slot->handle) == slot) {
+                        handler->delete_hosted_machine(slot->handle);
+                    }
+                };
+            });
+    }
+    SLOG(trace) << slot->address << " hosted";
+    return jsonrpc_response_ok(j, slot->handle);
+}
+
+/// \brief JSONRPC handler for the host.delete_machine method
+/// \param j JSON request object
+/// \param session HTTP session
+/// \returns JSON response object
+static json jsonrpc_host_delete_machine_handler(const json &j, const std::shared_ptr<http_session> &session) {
+    static const char *param_name[] = {"handle"};
+    auto args = parse_args<uint64_t>(j, param_name);
+    if (!session->handler->delete_hosted_machine(std::get<0>(args))) {
+        return jsonrpc_response_invalid_params(j, "hosted machine not found");
+    }
+    return jsonrpc_response_ok(j);
+}
+
+/// \brief JSONRPC handler for the host.delete_template method
+/// \param j JSON request object
+/// \param session HTTP session
+/// \returns JSON response object
+static json jsonrpc_host_delete_template_handler(const json &j, const std::shared_ptr<http_session> &session) {
+    static const char *param_name[] = {"handle"};
+    auto args = parse_args<uint64_t>(j, param_name);
+    if (!session->handler->delete_template(std::get<0>(args))) {
+        return jsonrpc_response_invalid_params(j, "template not found");
+    }
+    return jsonrpc_response_ok(j);
+}
+
 /// \brief JSONRPC handler for the machine.load method
 /// \param j JSON request object
 /// \param session HTTP session
 /// \returns JSON response object
 static json jsonrpc_machine_load_handler(const json &j, const std::shared_ptr<http_session> &session) {
-    if (session->handler->machine) {
+    if (session->slot->machine) {
         return jsonrpc_response_invalid_request(j, "machine exists");
     }
     static const char *param_name[] = {"directory", "runtime_config"};
     auto args = parse_args<std::string, cartesi::optional_param<cartesi::machine_runtime_config>>(j, param_name);
     switch (count_args(args)) {
         case 1:
-            session->handler->machine = std::make_unique<cartesi::machine>(std::get<0>(args));
+            session->slot->machine = std::make_unique<cartesi::machine>(std::get<0>(args));
             break;
         case 2:
-            session->handler->machine = std::make_unique<cartesi::machine>(std::get<0>(args),
+            session->slot->machine = std::make_unique<cartesi::machine>(std::get<0>(args),
                 std::get<1>(args).value()); // NOLINT(bugprone-unchecked-optional-access)
             break;
         default:
@@ -866,7 +1372,7 @@ static json jsonrpc_machine_load_handler(const json &j, const std::shared_ptr<ht
 /// \param session HTTP session
 /// \returns JSON response object
 static json jsonrpc_machine_create_handler(const json &j, const std::shared_ptr<http_session> &session) {
-    if (session->handler->machine) {
+    if (session->slot->machine) {
         return jsonrpc_response_invalid_request(j, "machine exists");
     }
     static const char *param_name[] = {"config", "runtime_config"};
@@ -874,10 +1380,10 @@ static json jsonrpc_machine_create_handler(const json &j, const std::shared_ptr<
         parse_args<cartesi::machine_config, cartesi::optional_param<cartesi::machine_runtime_config>>(j, param_name);
     switch (count_args(args)) {
         case 1:
-            session->handler->machine = std::make_unique<cartesi::machine>(std::get<0>(args));
+            session->slot->machine = std::make_unique<cartesi::machine>(std::get<0>(args));
             break;
         case 2:
-            session->handler->machine = std::make_unique<cartesi::machine>(std::get<0>(args),
+            session->slot->machine = std::make_unique<cartesi::machine>(std::get<0>(args),
                 std::get<1>(args).value()); // // NOLINT(bugprone-unchecked-optional-access)
             break;
         default:
@@ -892,7 +1398,7 @@ static json jsonrpc_machine_create_handler(const json &j, const std::shared_ptr<
 /// \returns JSON response object
 static json jsonrpc_machine_destroy_handler(const json &j, const std::shared_ptr<http_session> &session) {
     jsonrpc_check_no_params(j);
-    session->handler->machine.reset();
+    session->slot->machine.reset();
     return jsonrpc_response_ok(j);
 }
 
@@ -914,7 +1420,7 @@ static json jsonrpc_delay_next_request_handler(const json &j, const std::shared_
 /// \returns JSON response object
 static json jsonrpc_machine_is_empty_handler(const json &j, const std::shared_ptr<http_session> &session) {
     jsonrpc_check_no_params(j);
-    return jsonrpc_response_ok(j, session->handler->machine == nullptr);
+    return jsonrpc_response_ok(j, session->slot->machine == nullptr);
 }
 
 /// \brief JSONRPC handler for the emancipate method
@@ -932,15 +1438,28 @@ static json jsonrpc_emancipate_handler(const json &j, const std::shared_ptr<http
 /// \param session HTTP session
 /// \returns JSON response object
 static json jsonrpc_machine_store_handler(const json &j, const std::shared_ptr<http_session> &session) {
-    if (!session->handler->machine) {
+    if (!session->slot->machine) {
         return jsonrpc_response_invalid_request(j, "no machine");
     }
     static const char *param_name[] = {"directory"};
     auto args = parse_args<std::string>(j, param_name);
-    session->handler->machine->store(std::get<0>(args));
+    session->slot->machine->store(std::get<0>(args));
     return jsonrpc_response_ok(j);
 }
 
+/// \brief JSONRPC handler for the machine.new_template method
+/// \param j JSON request object
+/// \param session HTTP session
+/// \returns JSON response object
+static json jsonrpc_machine_new_template_handler(const json &j, const std::shared_ptr<http_session> &session) {
+    if (!session->slot->machine) {
+        return jsonrpc_response_invalid_request(j, "no machine");
+    }
+    jsonrpc_check_no_params(j);
+    auto t = std::make_shared<const cartesi::machine_template>(*session->slot->machine);
+    return jsonrpc_response_ok(j, session->handler->add_template(std::move(t)));
+}
+
 /// \brief Translate an interpret_break_reason value to string
 /// \param reason interpret_break_reason value to translate
 /// \returns String representation of value
@@ -968,12 +1487,12 @@ static std::string interpreter_break_reason_name(cartesi::interpreter_break_reas
 /// \param session HTTP session
 /// \returns JSON response object
 static json jsonrpc_machine_run_handler(const json &j, const std::shared_ptr<http_session> &session) {
-    if (!session->handler->machine) {
+    if (!session->slot->machine) {
         return jsonrpc_response_invalid_request(j, "no machine");
     }
     static const char *param_name[] = {"mcycle_end"};
     auto args = parse_args<uint64_t>(j, param_name);
-    auto reason = session->handler->machine->run(std::get<0>(args));
+    auto reason = session->slot->machine->run(std::get<0>(args));
     return jsonrpc_response_ok(j, interpreter_break_reason_name(reason));
 }
 
@@ -982,12 +1501,12 @@ static json jsonrpc_machine_run_handler(const json &j, const std::shared_ptr<htt
 /// \param session HTTP session
 /// \returns JSON response object
 static json jsonrpc_machine_log_step_handler(const json &j, const std::shared_ptr<http_session> &session) {
-    if (!session->handler->machine) {
+    if (!session->slot->machine) {
         return jsonrpc_response_invalid_request(j, "no machine");
     }
     static const char *param_name[] = {"mcycle_count", "filename"};
     auto args = parse_args<uint64_t, std::string>(j, param_name);
-    auto reason = session->handler->machine->log_step(std::get<0>(args), std::get<1>(args));
+    auto reason = session->slot->machine->log_step(std::get<0>(args), std::get<1>(args));
     return jsonrpc_response_ok(j, interpreter_break_reason_name(reason));
 }
 
@@ -1010,12 +1529,12 @@ static std::string uarch_interpreter_break_reason_name(cartesi::uarch_interprete
 /// \param session HTTP session
 /// \returns JSON response object
 static json jsonrpc_machine_run_uarch_handler(const json &j, const std::shared_ptr<http_session> &session) {
-    if (!session->handler->machine) {
+    if (!session->slot->machine) {
         return jsonrpc_response_invalid_request(j, "no machine");
     }
     static const char *param_name[] = {"uarch_cycle_end"};
     auto args = parse_args<uint64_t>(j, param_name);
-    auto reason = session->handler->machine->run_uarch(std::get<0>(args));
+    auto reason = session->slot->machine->run_uarch(std::get<0>(args));
     return jsonrpc_response_ok(j, uarch_interpreter_break_reason_name(reason));
 }
 
@@ -1024,13 +1543,13 @@ static json jsonrpc_machine_run_uarch_handler(const json &j, const std::shared_p
 /// \param session HTTP session
 /// \returns JSON response object
 static json jsonrpc_machine_log_step_uarch_handler(const json &j, const std::shared_ptr<http_session> &session) {
-    if (!session->handler->machine) {
+    if (!session->slot->machine) {
         return jsonrpc_response_invalid_request(j, "no machine");
     }
     static const char *param_name[] = {"log_type"};
     auto args = parse_args<cartesi::not_default_constructible<cartesi::access_log::type>>(j, param_name);
     // NOLINTNEXTLINE(bugprone-unchecked-optional-access)
-    return jsonrpc_response_ok(j, session->handler->machine->log_step_uarch(std::get<0>(args).value()));
+    return jsonrpc_response_ok(j, session->slot->machine->log_step_uarch(std::get<0>(args).value()));
 }
 
 /// \brief JSONRPC handler for the machine.log_step_uarch method
@@ -1038,13 +1557,13 @@ static json jsonrpc_machine_log_step_uarch_handler(const json &j, const std::sha
 /// \param session HTTP session
 /// \returns JSON response object
 static json jsonrpc_machine_log_reset_uarch_handler(const json &j, const std::shared_ptr<http_session> &session) {
-    if (!session->handler->machine) {
+    if (!session->slot->machine) {
         return jsonrpc_response_invalid_request(j, "no machine");
     }
     static const char *param_name[] = {"log_type"};
     auto args = parse_args<cartesi::not_default_constructible<cartesi::access_log::type>>(j, param_name);
     // NOLINTNEXTLINE(bugprone-unchecked-optional-access)
-    return jsonrpc_response_ok(j, session->handler->machine->log_reset_uarch(std::get<0>(args).value()));
+    return jsonrpc_response_ok(j, session->slot->machine->log_reset_uarch(std::get<0>(args).value()));
 }
 
 /// \brief JSONRPC handler for the machine.verify_send_cmio_response method
@@ -1097,7 +1616,7 @@ static json jsonrpc_machine_verify_reset_uarch_handler(const json &j,
 /// \param session HTTP session
 /// \returns JSON response object
 static json jsonrpc_machine_get_proof_handler(const json &j, const std::shared_ptr<http_session> &session) {
-    if (!session->handler->machine) {
+    if (!session->slot->machine) {
         return jsonrpc_response_invalid_request(j, "no machine");
     }
     static const char *param_name[] = {"address", "log2_size"};
@@ -1106,7 +1625,7 @@ static json jsonrpc_machine_get_proof_handler(const json &j, const std::shared_p
         throw std::domain_error("log2_size is out of range");
     }
     return jsonrpc_response_ok(j,
-        session->handler->machine->get_proof(std::get<0>(args), static_cast<int>(std::get<1>(args))));
+        session->slot->machine->get_proof(std::get<0>(args), static_cast<int>(std::get<1>(args))));
 }
 
 /// \brief JSONRPC handler for the machine.verify_merkle_tree method
@@ -1114,11 +1633,11 @@ static json jsonrpc_machine_get_proof_handler(const json &j, const std::shared_p
 /// \param session HTTP session
 /// \returns JSON response object
 static json jsonrpc_machine_verify_merkle_tree_handler(const json &j, const std::shared_ptr<http_session> &session) {
-    if (!session->handler->machine) {
+    if (!session->slot->machine) {
         return jsonrpc_response_invalid_request(j, "no machine");
     }
     jsonrpc_check_no_params(j);
-    return jsonrpc_response_ok(j, session->handler->machine->verify_merkle_tree());
+    return jsonrpc_response_ok(j, session->slot->machine->verify_merkle_tree());
 }
 
 /// \brief JSONRPC handler for the machine.get_root_hash method
@@ -1126,12 +1645,12 @@ static json jsonrpc_machine_verify_merkle_tree_handler(const json &j, const std:
 /// \param session HTTP session
 /// \returns JSON response object
 static json jsonrpc_machine_get_root_hash_handler(const json &j, const std::shared_ptr<http_session> &session) {
-    if (!session->handler->machine) {
+    if (!session->slot->machine) {
         return jsonrpc_response_invalid_request(j, "no machine");
     }
     jsonrpc_check_no_params(j);
     cartesi::machine_merkle_tree::hash_type hash;
-    session->handler->machine->get_root_hash(hash);
+    session->slot->machine->get_root_hash(hash);
     return jsonrpc_response_ok(j, cartesi::encode_base64(hash));
 }
 
@@ -1140,13 +1659,13 @@ static json jsonrpc_machine_get_root_hash_handler(const json &j, const std::shar
 /// \param session HTTP session
 /// \returns JSON response object
 static json jsonrpc_machine_read_word_handler(const json &j, const std::shared_ptr<http_session> &session) {
-    if (!session->handler->machine) {
+    if (!session->slot->machine) {
         return jsonrpc_response_invalid_request(j, "no machine");
     }
     static const char *param_name[] = {"address"};
     auto args = parse_args<uint64_t>(j, param_name);
     auto address = std::get<0>(args);
-    return jsonrpc_response_ok(j, session->handler->machine->read_word(address));
+    return jsonrpc_response_ok(j, session->slot->machine->read_word(address));
 }
 
 /// \brief JSONRPC handler for the machine.read_memory method
@@ -1154,7 +1673,7 @@ static json jsonrpc_machine_read_word_handler(const json &j, const std::shared_p
 /// \param session HTTP session
 /// \returns JSON response object
 static json jsonrpc_machine_read_memory_handler(const json &j, const std::shared_ptr<http_session> &session) {
-    if (!session->handler->machine) {
+    if (!session->slot->machine) {
         return jsonrpc_response_invalid_request(j, "no machine");
     }
     static const char *param_name[] = {"address", "length"};
@@ -1162,7 +1681,7 @@ static json jsonrpc_machine_read_memory_handler(const json &j, const std::shared
     auto address = std::get<0>(args);
     auto length = std::get<1>(args);
     auto data = cartesi::unique_calloc<unsigned char>(length);
-    session->handler->machine->read_memory(address, data.get(), length);
+    session->slot->machine->read_memory(address, data.get(), length);
     return jsonrpc_response_ok(j, cartesi::encode_base64(data.get(), length));
 }
 
@@ -1171,7 +1690,7 @@ static json jsonrpc_machine_read_memory_handler(const json &j, const std::shared
 /// \param session HTTP session
 /// \returns JSON response object
 static json jsonrpc_machine_write_memory_handler(const json &j, const std::shared_ptr<http_session> &session) {
-    if (!session->handler->machine) {
+    if (!session->slot->machine) {
         return jsonrpc_response_invalid_request(j, "no machine");
     }
     static const char *param_name[] = {"address", "data"};
@@ -1179,7 +1698,7 @@ static json jsonrpc_machine_write_memory_handler(const json &j, const std::share
     auto address = std::get<0>(args);
     auto bin = cartesi::decode_base64(std::get<1>(args));
     // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
-    session->handler->machine->write_memory(address, reinterpret_cast<unsigned char *>(bin.data()), bin.size());
+    session->slot->machine->write_memory(address, reinterpret_cast<unsigned char *>(bin.data()), bin.size());
     return jsonrpc_response_ok(j);
 }
 
@@ -1188,7 +1707,7 @@ static json jsonrpc_machine_write_memory_handler(const json &j, const std::share
 /// \param session HTTP session
 /// \returns JSON response object
 static json jsonrpc_machine_read_virtual_memory_handler(const json &j, const std::shared_ptr<http_session> &session) {
-    if (!session->handler->machine) {
+    if (!session->slot->machine) {
         return jsonrpc_response_invalid_request(j, "no machine");
     }
     static const char *param_name[] = {"address", "length"};
@@ -1196,7 +1715,7 @@ static json jsonrpc_machine_read_virtual_memory_handler(const json &j, const std
     auto address = std::get<0>(args);
     auto length = std::get<1>(args);
     auto data = cartesi::unique_calloc<unsigned char>(length);
-    session->handler->machine->read_virtual_memory(address, data.get(), length);
+    session->slot->machine->read_virtual_memory(address, data.get(), length);
     return jsonrpc_response_ok(j, cartesi::encode_base64(data.get(), length));
 }
 
@@ -1205,7 +1724,7 @@ static json jsonrpc_machine_read_virtual_memory_handler(const json &j, const std
 /// \param session HTTP session
 /// \returns JSON response object
 static json jsonrpc_machine_write_virtual_memory_handler(const json &j, const std::shared_ptr<http_session> &session) {
-    if (!session->handler->machine) {
+    if (!session->slot->machine) {
         return jsonrpc_response_invalid_request(j, "no machine");
     }
     static const char *param_name[] = {"address", "data"};
@@ -1213,7 +1732,7 @@ static json jsonrpc_machine_write_virtual_memory_handler(const json &j, const st
     auto address = std::get<0>(args);
     auto bin = cartesi::decode_base64(std::get<1>(args));
     // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
-    session->handler->machine->write_virtual_memory(address, reinterpret_cast<unsigned char *>(bin.data()), bin.size());
+    session->slot->machine->write_virtual_memory(address, reinterpret_cast<unsigned char *>(bin.data()), bin.size());
     return jsonrpc_response_ok(j);
 }
 
@@ -1223,13 +1742,13 @@ static json jsonrpc_machine_write_virtual_memory_handler(const json &j, const st
 /// \returns JSON response object
 static json jsonrpc_machine_translate_virtual_address_handler(const json &j,
     const std::shared_ptr<http_session> &session) {
-    if (!session->handler->machine) {
+    if (!session->slot->machine) {
         return jsonrpc_response_invalid_request(j, "no machine");
     }
     static const char *param_name[] = {"vaddr"};
     auto args = parse_args<uint64_t>(j, param_name);
     auto vaddr = std::get<0>(args);
-    return jsonrpc_response_ok(j, session->handler->machine->translate_virtual_address(vaddr));
+    return jsonrpc_response_ok(j, session->slot->machine->translate_virtual_address(vaddr));
 }
 
 /// \brief JSONRPC handler for the machine.replace_memory_range method
@@ -1237,12 +1756,12 @@ static json jsonrpc_machine_translate_virtual_address_handler(const json &j,
 /// \param session HTTP session
 /// \returns JSON response object
 static json jsonrpc_machine_replace_memory_range_handler(const json &j, const std::shared_ptr<http_session> &session) {
-    if (!session->handler->machine) {
+    if (!session->slot->machine) {
         return jsonrpc_response_invalid_request(j, "no machine");
     }
     static const char *param_name[] = {"range"};
     auto args = parse_args<cartesi::memory_range_config>(j, param_name);
-    session->handler->machine->replace_memory_range(std::get<0>(args));
+    session->slot->machine->replace_memory_range(std::get<0>(args));
     return jsonrpc_response_ok(j);
 }
 
@@ -1251,12 +1770,12 @@ static json jsonrpc_machine_replace_memory_range_handler(const json &j, const st
 /// \param session HTTP session
 /// \returns JSON response object
 static json jsonrpc_machine_read_reg_handler(const json &j, const std::shared_ptr<http_session> &session) {
-    if (!session->handler->machine) {
+    if (!session->slot->machine) {
         return jsonrpc_response_invalid_request(j, "no machine");
     }
     static const char *param_name[] = {"reg"};
     auto args = parse_args<cartesi::machine::reg>(j, param_name);
-    return jsonrpc_response_ok(j, session->handler->machine->read_reg(std::get<0>(args)));
+    return jsonrpc_response_ok(j, session->slot->machine->read_reg(std::get<0>(args)));
 }
 
 /// \brief JSONRPC handler for the machine.write_reg method
@@ -1264,12 +1783,12 @@ static json jsonrpc_machine_read_reg_handler(const json &j, const std::shared_pt
 /// \param session HTTP session
 /// \returns JSON response object
 static json jsonrpc_machine_write_reg_handler(const json &j, const std::shared_ptr<http_session> &session) {
-    if (!session->handler->machine) {
+    if (!session->slot->machine) {
         return jsonrpc_response_invalid_request(j, "no machine");
     }
     static const char *param_name[] = {"reg", "value"};
     auto args = parse_args<cartesi::machine::reg, uint64_t>(j, param_name);
-    session->handler->machine->write_reg(std::get<0>(args), std::get<1>(args));
+    session->slot->machine->write_reg(std::get<0>(args), std::get<1>(args));
     return jsonrpc_response_ok(j);
 }
 
@@ -1288,11 +1807,11 @@ static json jsonrpc_machine_get_reg_address_handler(const json &j, const std::sh
 /// \param session HTTP session
 /// \returns JSON response object
 static json jsonrpc_machine_reset_uarch_handler(const json &j, const std::shared_ptr<http_session> &session) {
-    if (!session->handler->machine) {
+    if (!session->slot->machine) {
         return jsonrpc_response_invalid_request(j, "no machine");
     }
     jsonrpc_check_no_params(j);
-    session->handler->machine->reset_uarch();
+    session->slot->machine->reset_uarch();
     return jsonrpc_response_ok(j);
 }
 
@@ -1301,11 +1820,11 @@ static json jsonrpc_machine_reset_uarch_handler(const json &j, const std::shared
 /// \param session HTTP session
 /// \returns JSON response object
 static json jsonrpc_machine_get_initial_config_handler(const json &j, const std::shared_ptr<http_session> &session) {
-    if (!session->handler->machine) {
+    if (!session->slot->machine) {
         return jsonrpc_response_invalid_request(j, "no machine");
     }
     jsonrpc_check_no_params(j);
-    return jsonrpc_response_ok(j, session->handler->machine->get_initial_config());
+    return jsonrpc_response_ok(j, session->slot->machine->get_initial_config());
 }
 
 /// \brief JSONRPC handler for the machine.get_runtime_config method
@@ -1313,11 +1832,11 @@ static json jsonrpc_machine_get_initial_config_handler(const json &j, const std:
 /// \param session HTTP session
 /// \returns JSON response object
 static json jsonrpc_machine_get_runtime_config_handler(const json &j, const std::shared_ptr<http_session> &session) {
-    if (!session->handler->machine) {
+    if (!session->slot->machine) {
         return jsonrpc_response_invalid_request(j, "no machine");
     }
     jsonrpc_check_no_params(j);
-    return jsonrpc_response_ok(j, session->handler->machine->get_runtime_config());
+    return jsonrpc_response_ok(j, session->slot->machine->get_runtime_config());
 }
 
 /// \brief JSONRPC handler for the machine.set_runtime_config method
@@ -1325,12 +1844,12 @@ static json jsonrpc_machine_get_runtime_config_handler(const json &j, const std:
 /// \param session HTTP session
 /// \returns JSON response object
 static json jsonrpc_machine_set_runtime_config_handler(const json &j, const std::shared_ptr<http_session> &session) {
-    if (!session->handler->machine) {
+    if (!session->slot->machine) {
         return jsonrpc_response_invalid_request(j, "no machine");
     }
     static const char *param_name[] = {"runtime_config"};
     auto args = parse_args<cartesi::machine_runtime_config>(j, param_name);
-    session->handler->machine->set_runtime_config(std::get<0>(args));
+    session->slot->machine->set_runtime_config(std::get<0>(args));
     return jsonrpc_response_ok(j);
 }
 
@@ -1350,11 +1869,11 @@ static json jsonrpc_machine_get_default_config_handler(const json &j,
 /// \returns JSON response object
 static json jsonrpc_machine_verify_dirty_page_maps_handler(const json &j,
     const std::shared_ptr<http_session> &session) {
-    if (!session->handler->machine) {
+    if (!session->slot->machine) {
         return jsonrpc_response_invalid_request(j, "no machine");
     }
     jsonrpc_check_no_params(j);
-    return jsonrpc_response_ok(j, session->handler->machine->verify_dirty_page_maps());
+    return jsonrpc_response_ok(j, session->slot->machine->verify_dirty_page_maps());
 }
 
 /// \brief JSONRPC handler for the machine.get_memory_ranges method
@@ -1362,11 +1881,11 @@ static json jsonrpc_machine_verify_dirty_page_maps_handler(const json &j,
 /// \param session HTTP session
 /// \returns JSON response object
 static json jsonrpc_machine_get_memory_ranges_handler(const json &j, const std::shared_ptr<http_session> &session) {
-    if (!session->handler->machine) {
+    if (!session->slot->machine) {
         return jsonrpc_response_invalid_request(j, "no machine");
     }
     jsonrpc_check_no_params(j);
-    return jsonrpc_response_ok(j, session->handler->machine->get_memory_ranges());
+    return jsonrpc_response_ok(j, session->slot->machine->get_memory_ranges());
 }
 
 /// \brief JSONRPC handler for the machine.send_cmio_response method
@@ -1374,21 +1893,21 @@ static json jsonrpc_machine_get_memory_ranges_handler(const json &j, const std::
 /// \param session HTTP session
 /// \returns JSON response object
 static json jsonrpc_machine_send_cmio_response_handler(const json &j, const std::shared_ptr<http_session> &session) {
-    if (!session->handler->machine) {
+    if (!session->slot->machine) {
         return jsonrpc_response_invalid_request(j, "no machine");
     }
     static const char *param_name[] = {"reason", "data"};
     auto args = parse_args<uint16_t, std::string>(j, param_name);
     auto bin = cartesi::decode_base64(std::get<1>(args));
     // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
-    session->handler->machine->send_cmio_response(std::get<0>(args), reinterpret_cast<unsigned char *>(bin.data()),
+    session->slot->machine->send_cmio_response(std::get<0>(args), reinterpret_cast<unsigned char *>(bin.data()),
         bin.size());
     return jsonrpc_response_ok(j);
 }
 
 static json jsonrpc_machine_log_send_cmio_response_handler(const json &j,
     const std::shared_ptr<http_session> &session) {
-    if (!session->handler->machine) {
+    if (!session->slot->machine) {
         return jsonrpc_response_invalid_request(j, "no machine");
     }
     static const char *param_name[] = {"reason", "data", "log_type"};
@@ -1398,7 +1917,7 @@ static json jsonrpc_machine_log_send_cmio_response_handler(const json &j,
     // NOLINTBEGIN(bugprone-unchecked-optional-access)
     // NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
     return jsonrpc_response_ok(j,
-        session->handler->machine->log_send_cmio_response(std::get<0>(args),
+        session->slot->machine->log_send_cmio_response(std::get<0>(args),
             reinterpret_cast<unsigned char *>(bin.data()), bin.size(), std::get<2>(args).value()));
     // NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
     // NOLINTEND(bugprone-unchecked-optional-access)
@@ -1433,7 +1952,7 @@ static json jsonrpc_machine_verify_send_cmio_response_handler(const json &j,
 static http::message_generator jsonrpc_http_reply(const http::request<http::string_body> &req, const json &j,
     const std::shared_ptr<http_session> &session) {
     std::string body = j.dump();
-    SLOG(trace) << session->handler->local_endpoint << " response is " << body;
+    SLOG(trace) << session->address() << " response is " << body;
     http::response<http::string_body> res{http::status::ok, req.version()};
     res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
     res.set(http::field::access_control_allow_origin, "*");
@@ -1450,7 +1969,7 @@ static http::message_generator jsonrpc_http_reply(const http::request<http::stri
 /// \returns HTTP response message
 static http::message_generator jsonrpc_http_empty_reply(const http::request<http::string_body> &req,
     const std::shared_ptr<http_session> &session) {
-    SLOG(trace) << session->handler->local_endpoint << " response is empty";
+    SLOG(trace) << session->address() << " response is empty";
     http::response<http::empty_body> res{http::status::ok, req.version()};
     res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
     res.set(http::field::access_control_allow_origin, "*");
@@ -1462,6 +1981,13 @@ static http::message_generator jsonrpc_http_empty_reply(const http::request<http
 /// \brief jsonrpc handler is a function pointer
 using jsonrpc_handler = json (*)(const json &ji, const std::shared_ptr<http_session> &session);
 
+/// \brief Tells whether a method only concerns the machine the request is addressed to
+/// \param method Method name
+/// \returns True if method can be served by hosted machines
+static bool is_machine_method(std::string_view method) {
+    return method.starts_with("machine.") || method == "get_version" || method == "rpc.discover";
+}
+
 /// \brief Dispatch request to appropriate JSONRPC handler
 /// \param j JSON request object
 /// \param session HTTP session
@@ -1471,6 +1997,9 @@ static json jsonrpc_dispatch_method(const json &j, const std::shared_ptr<http_se
         {"fork", jsonrpc_fork_handler},
         {"rebind", jsonrpc_rebind_handler},
         {"shutdown", jsonrpc_shutdown_handler},
+        {"host.new_machine", jsonrpc_host_new_machine_handler},
+        {"host.delete_machine", jsonrpc_host_delete_machine_handler},
+        {"host.delete_template", jsonrpc_host_delete_template_handler},
         {"emancipate", jsonrpc_emancipate_handler},
         {"get_version", jsonrpc_get_version_handler},
         {"delay_next_request", jsonrpc_delay_next_request_handler},
@@ -1480,6 +2009,7 @@ static json jsonrpc_dispatch_method(const json &j, const std::shared_ptr<http_se
         {"machine.load", jsonrpc_machine_load_handler},
         {"machine.destroy", jsonrpc_machine_destroy_handler},
         {"machine.store", jsonrpc_machine_store_handler},
+        {"machine.new_template", jsonrpc_machine_new_template_handler},
         {"machine.run", jsonrpc_machine_run_handler},
         {"machine.log_step", jsonrpc_machine_log_step_handler},
         {"machine.run_uarch", jsonrpc_machine_run_uarch_handler},
@@ -1513,7 +2043,11 @@ static json jsonrpc_dispatch_method(const json &j, const std::shared_ptr<http_se
         {"machine.verify_step", jsonrpc_machine_verify_step_handler},
     };
     auto method = j["method"].get<std::string>();
-    SLOG(debug) << session->handler->local_endpoint << " handling \"" << method << "\" method";
+    SLOG(debug) << session->address() << " handling \"" << method << "\" method";
+    // Hosted machines run on worker threads, so they only serve methods that concern the machine itself
+    if (session->slot->handle != 0 && !is_machine_method(method)) {
+        return jsonrpc_response_invalid_request(j, "method unavailable for hosted machines");
+    }
     auto found = dispatch.find(method);
     if (found != dispatch.end()) {
         return found->second(j, session);
@@ -1525,6 +2059,328 @@ static json jsonrpc_dispatch_method(const json &j, const std::shared_ptr<http_se
     return jsonrpc_response_internal_error(j, x.what());
 }
 
+/// \brief Binary JSONRPC handler is a function pointer
+using jsonrpc_binary_handler = json (*)(const json &ji, std::string_view payload, std::string &reply_payload,
+    const std::shared_ptr<http_session> &session);
+
+/// \brief Binary JSONRPC handler for the machine.read_memory method
+/// \param j JSON request object
+/// \param payload Request payload (unused)
+/// \param reply_payload Receives the memory contents
+/// \param session HTTP session
+/// \returns JSON response object
+static json jsonrpc_machine_read_memory_binary_handler(const json &j, std::string_view /*payload*/,
+    std::string &reply_payload, const std::shared_ptr<http_session> &session) {
+    if (!session->slot->machine) {
+        return jsonrpc_response_invalid_request(j, "no machine");
+    }
+    static const char *param_name[] = {"address", "length"};
+    auto args = parse_args<uint64_t, uint64_t>(j, param_name);
+    reply_payload.resize(std::get<1>(args));
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    session->slot->machine->read_memory(std::get<0>(args), reinterpret_cast<unsigned char *>(reply_payload.data()),
+        reply_payload.size());
+    return jsonrpc_response_ok(j);
+}
+
+/// \brief Binary JSONRPC handler for the machine.write_memory method
+/// \param j JSON request object
+/// \param payload Data to write
+/// \param reply_payload Response payload (unused)
+/// \param session HTTP session
+/// \returns JSON response object
+static json jsonrpc_machine_write_memory_binary_handler(const json &j, std::string_view payload,
+    std::string & /*reply_payload*/, const std::shared_ptr<http_session> &session) {
+    if (!session->slot->machine) {
+        return jsonrpc_response_invalid_request(j, "no machine");
+    }
+    static const char *param_name[] = {"address"};
+    auto args = parse_args<uint64_t>(j, param_name);
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    session->slot->machine->write_memory(std::get<0>(args), reinterpret_cast<const unsigned char *>(payload.data()),
+        payload.size());
+    return jsonrpc_response_ok(j);
+}
+
+/// \brief Binary JSONRPC handler for the machine.read_virtual_memory method
+/// \param j JSON request object
+/// \param payload Request payload (unused)
+/// \param reply_payload Receives the memory contents
+/// \param session HTTP session
+/// \returns JSON response object
+static json jsonrpc_machine_read_virtual_memory_binary_handler(const json &j, std::string_view /*payload*/,
+    std::string &reply_payload, const std::shared_ptr<http_session> &session) {
+    if (!session->slot->machine) {
+        return jsonrpc_response_invalid_request(j, "no machine");
+    }
+    static const char *param_name[] = {"address", "length"};
+    auto args = parse_args<uint64_t, uint64_t>(j, param_name);
+    reply_payload.resize(std::get<1>(args));
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    session->slot->machine->read_virtual_memory(std::get<0>(args),
+        reinterpret_cast<unsigned char *>(reply_payload.data()), reply_payload.size());
+    return jsonrpc_response_ok(j);
+}
+
+/// \brief Binary JSONRPC handler for the machine.write_virtual_memory method
+/// \param j JSON request object
+/// \param payload Data to write
+/// \param reply_payload Response payload (unused)
+/// \param session HTTP session
+/// \returns JSON response object
+static json jsonrpc_machine_write_virtual_memory_binary_handler(const json &j, std::string_view payload,
+    std::string & /*reply_payload*/, const std::shared_ptr<http_session> &session) {
+    if (!session->slot->machine) {
+        return jsonrpc_response_invalid_request(j, "no machine");
+    }
+    static const char *param_name[] = {"address"};
+    auto args = parse_args<uint64_t>(j, param_name);
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    session->slot->machine->write_virtual_memory(std::get<0>(args),
+        reinterpret_cast<const unsigned char *>(payload.data()), payload.size());
+    return jsonrpc_response_ok(j);
+}
+
+/// \brief Binary JSONRPC handler for the machine.get_proof method
+/// \param j JSON request object
+/// \param payload Request payload (unused)
+/// \param reply_payload Receives the target hash, the root hash, and the sibling hashes from the target up
+/// \param session HTTP session
+/// \returns JSON response object with the proof sizes and target address
+static json jsonrpc_machine_get_proof_binary_handler(const json &j, std::string_view /*payload*/,
+    std::string &reply_payload, const std::shared_ptr<http_session> &session) {
+    if (!session->slot->machine) {
+        return jsonrpc_response_invalid_request(j, "no machine");
+    }
+    static const char *param_name[] = {"address", "log2_size"};
+    auto args = parse_args<uint64_t, uint64_t>(j, param_name);
+    if (std::get<1>(args) > INT_MAX) {
+        throw std::domain_error("log2_size is out of range");
+    }
+    auto proof = session->slot->machine->get_proof(std::get<0>(args), static_cast<int>(std::get<1>(args)));
+    const auto append_hash = [&reply_payload](const cartesi::machine_merkle_tree::hash_type &hash) {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        reply_payload.append(reinterpret_cast<const char *>(hash.data()), hash.size());
+    };
+    append_hash(proof.get_target_hash());
+    append_hash(proof.get_root_hash());
+    for (int log2_size = proof.get_log2_target_size(); log2_size < proof.get_log2_root_size(); ++log2_size) {
+        append_hash(proof.get_sibling_hash(log2_size));
+    }
+    return jsonrpc_response_ok(j,
+        json{{"target_address", proof.get_target_address()}, {"log2_target_size", proof.get_log2_target_size()},
+            {"log2_root_size", proof.get_log2_root_size()}});
+}
+
+/// \brief Binary JSONRPC handler for the machine.log_step_uarch method
+/// \param j JSON request object
+/// \param payload Request payload (unused)
+/// \param reply_payload Receives the access log in the compact binary format
+/// \param session HTTP session
+/// \returns JSON response object
+static json jsonrpc_machine_log_step_uarch_binary_handler(const json &j, std::string_view /*payload*/,
+    std::string &reply_payload, const std::shared_ptr<http_session> &session) {
+    if (!session->slot->machine) {
+        return jsonrpc_response_invalid_request(j, "no machine");
+    }
+    static const char *param_name[] = {"log_type"};
+    auto args = parse_args<cartesi::not_default_constructible<cartesi::access_log::type>>(j, param_name);
+    reply_payload =
+        // NOLINTNEXTLINE(bugprone-unchecked-optional-access)
+        cartesi::encode_access_log_binary(session->slot->machine->log_step_uarch(std::get<0>(args).value()));
+    return jsonrpc_response_ok(j);
+}
+
+/// \brief Binary JSONRPC handler for the machine.log_reset_uarch method
+/// \param j JSON request object
+/// \param payload Request payload (unused)
+/// \param reply_payload Receives the access log in the compact binary format
+/// \param session HTTP session
+/// \returns JSON response object
+static json jsonrpc_machine_log_reset_uarch_binary_handler(const json &j, std::string_view /*payload*/,
+    std::string &reply_payload, const std::shared_ptr<http_session> &session) {
+    if (!session->slot->machine) {
+        return jsonrpc_response_invalid_request(j, "no machine");
+    }
+    static const char *param_name[] = {"log_type"};
+    auto args = parse_args<cartesi::not_default_constructible<cartesi::access_log::type>>(j, param_name);
+    reply_payload =
+        // NOLINTNEXTLINE(bugprone-unchecked-optional-access)
+        cartesi::encode_access_log_binary(session->slot->machine->log_reset_uarch(std::get<0>(args).value()));
+    return jsonrpc_response_ok(j);
+}
+
+/// \brief Binary JSONRPC handler for the machine.log_send_cmio_response method
+/// \param j JSON request object
+/// \param payload Response data to send
+/// \param reply_payload Receives the access log in the compact binary format
+/// \param session HTTP session
+/// \returns JSON response object
+static json jsonrpc_machine_log_send_cmio_response_binary_handler(const json &j, std::string_view payload,
+    std::string &reply_payload, const std::shared_ptr<http_session> &session) {
+    if (!session->slot->machine) {
+        return jsonrpc_response_invalid_request(j, "no machine");
+    }
+    static const char *param_name[] = {"reason", "log_type"};
+    auto args = parse_args<uint16_t, cartesi::not_default_constructible<cartesi::access_log::type>>(j, param_name);
+    // NOLINTBEGIN(bugprone-unchecked-optional-access)
+    // NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+    reply_payload = cartesi::encode_access_log_binary(session->slot->machine->log_send_cmio_response(
+        std::get<0>(args), reinterpret_cast<const unsigned char *>(payload.data()), payload.size(),
+        std::get<1>(args).value()));
+    // NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+    // NOLINTEND(bugprone-unchecked-optional-access)
+    return jsonrpc_response_ok(j);
+}
+
+/// \brief Splits the payload of a binary verify request into its root hashes and its access log
+/// \param payload Root hash before, root hash after, and access log in the compact binary format
+/// \param root_hash_before Receives the root hash before
+/// \param root_hash_after Receives the root hash after
+/// \returns Access log
+static cartesi::access_log split_verify_payload(std::string_view payload,
+    cartesi::machine_merkle_tree::hash_type &root_hash_before,
+    cartesi::machine_merkle_tree::hash_type &root_hash_after) {
+    if (payload.size() < root_hash_before.size() + root_hash_after.size()) {
+        throw std::invalid_argument("payload is too short to hold root hashes");
+    }
+    std::memcpy(root_hash_before.data(), payload.data(), root_hash_before.size());
+    payload.remove_prefix(root_hash_before.size());
+    std::memcpy(root_hash_after.data(), payload.data(), root_hash_after.size());
+    payload.remove_prefix(root_hash_after.size());
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    return cartesi::decode_access_log_binary(reinterpret_cast<const unsigned char *>(payload.data()), payload.size());
+}
+
+/// \brief Binary JSONRPC handler for the machine.verify_step_uarch method
+/// \param j JSON request object
+/// \param payload Root hash before, root hash after, and access log in the compact binary format
+/// \param reply_payload Response payload (unused)
+/// \param session HTTP session
+/// \returns JSON response object
+static json jsonrpc_machine_verify_step_uarch_binary_handler(const json &j, std::string_view payload,
+    std::string & /*reply_payload*/, const std::shared_ptr<http_session> & /*session*/) {
+    jsonrpc_check_no_params(j);
+    cartesi::machine_merkle_tree::hash_type root_hash_before;
+    cartesi::machine_merkle_tree::hash_type root_hash_after;
+    auto log = split_verify_payload(payload, root_hash_before, root_hash_after);
+    cartesi::machine::verify_step_uarch(root_hash_before, log, root_hash_after);
+    return jsonrpc_response_ok(j);
+}
+
+/// \brief Binary JSONRPC handler for the machine.verify_reset_uarch method
+/// \param j JSON request object
+/// \param payload Root hash before, root hash after, and access log in the compact binary format
+/// \param reply_payload Response payload (unused)
+/// \param session HTTP session
+/// \returns JSON response object
+static json jsonrpc_machine_verify_reset_uarch_binary_handler(const json &j, std::string_view payload,
+    std::string & /*reply_payload*/, const std::shared_ptr<http_session> & /*session*/) {
+    jsonrpc_check_no_params(j);
+    cartesi::machine_merkle_tree::hash_type root_hash_before;
+    cartesi::machine_merkle_tree::hash_type root_hash_after;
+    auto log = split_verify_payload(payload, root_hash_before, root_hash_after);
+    cartesi::machine::verify_reset_uarch(root_hash_before, log, root_hash_after);
+    return jsonrpc_response_ok(j);
+}
+
+/// \brief Dispatch binary request to appropriate binary JSONRPC handler
+/// \param j JSON request object
+/// \param payload Request payload
+/// \param reply_payload Receives the response payload
+/// \param session HTTP session
+/// \returns JSON with response
+/// \details Methods without a binary handler are served by the regular JSONRPC handler, with an empty payload
+static json jsonrpc_binary_dispatch_method(const json &j, std::string_view payload, std::string &reply_payload,
+    const std::shared_ptr<http_session> &session) try {
+    static const std::unordered_map<std::string, jsonrpc_binary_handler> dispatch = {
+        {"machine.read_memory", jsonrpc_machine_read_memory_binary_handler},
+        {"machine.write_memory", jsonrpc_machine_write_memory_binary_handler},
+        {"machine.read_virtual_memory", jsonrpc_machine_read_virtual_memory_binary_handler},
+        {"machine.write_virtual_memory", jsonrpc_machine_write_virtual_memory_binary_handler},
+        {"machine.get_proof", jsonrpc_machine_get_proof_binary_handler},
+        {"machine.log_step_uarch", jsonrpc_machine_log_step_uarch_binary_handler},
+        {"machine.log_reset_uarch", jsonrpc_machine_log_reset_uarch_binary_handler},
+        {"machine.log_send_cmio_response", jsonrpc_machine_log_send_cmio_response_binary_handler},
+        {"machine.verify_step_uarch", jsonrpc_machine_verify_step_uarch_binary_handler},
+        {"machine.verify_reset_uarch", jsonrpc_machine_verify_reset_uarch_binary_handler},
+    };
+    auto method = j["method"].get<std::string>();
+    auto found = dispatch.find(method);
+    if (found != dispatch.end()) {
+        SLOG(debug) << session->address() << " handling binary \"" << method << "\" method";
+        return found->second(j, payload, reply_payload, session);
+    }
+    return jsonrpc_dispatch_method(j, session);
+} catch (std::invalid_argument &x) {
+    reply_payload.clear();
+    return jsonrpc_response_invalid_params(j, x.what());
+} catch (std::exception &x) {
+    reply_payload.clear();
+    return jsonrpc_response_internal_error(j, x.what());
+}
+
+/// \brief Prepares a binary JSONRPC response
+/// \param req HTTP request object
+/// \param j JSON response object
+/// \param payload Response payload
+/// \param session HTTP session
+/// \returns HTTP response message
+static http::message_generator jsonrpc_http_binary_reply(const http::request<http::string_body> &req, const json &j,
+    std::string_view payload, const std::shared_ptr<http_session> &session) {
+    std::string body = j.dump();
+    SLOG(trace) << session->address() << " response is " << body << " with " << payload.size()
+                << " payload bytes";
+    http::response<http::string_body> res{http::status::ok, req.version()};
+    res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
+    res.set(http::field::access_control_allow_origin, "*");
+    res.set(http::field::content_type, cartesi::JSONRPC_BINARY_CONTENT_TYPE);
+    res.body() = cartesi::jsonrpc_binary_frame_encode(body, payload);
+    res.prepare_payload();
+    res.keep_alive(req.keep_alive());
+    return res;
+}
+
+/// \brief Handler for binary JSONRPC requests
+/// \param req HTTP request
+/// \param session HTTP session
+/// \returns HTTP response message
+/// \details Binary requests carry a single JSONRPC request object each, batches are not supported
+static http::message_generator handle_binary_request(const http::request<http::string_body> &req,
+    const std::shared_ptr<http_session> &session) {
+    json j;
+    std::string_view payload;
+    try {
+        std::string_view js;
+        std::tie(js, payload) = cartesi::jsonrpc_binary_frame_decode(req.body());
+        j = json::parse(js);
+    } catch (std::exception &x) {
+        return jsonrpc_http_binary_reply(req, jsonrpc_response_parse_error(x.what()), {}, session);
+    }
+    SLOG(trace) << session->address() << " binary request is " << j.dump() << " with "
+                << payload.size() << " payload bytes";
+    if (!j.is_object()) {
+        return jsonrpc_http_binary_reply(req, jsonrpc_response_invalid_request(j, "request not an object"), {},
+            session);
+    }
+    if (!j.contains("jsonrpc") || !j["jsonrpc"].is_string() || j["jsonrpc"] != "2.0") {
+        return jsonrpc_http_binary_reply(req,
+            jsonrpc_response_invalid_request(j, R"(invalid field "jsonrpc" (expected "2.0"))"), {}, session);
+    }
+    if (!j.contains("method") || !j["method"].is_string() || j["method"].get<std::string>().empty()) {
+        return jsonrpc_http_binary_reply(req,
+            jsonrpc_response_invalid_request(j, "invalid field \"method\" (expected non-empty string)"), {}, session);
+    }
+    if (session->slot->handle == 0 && session->handler->delay != 0) {
+        SLOG(trace) << session->handler->local_address << " sleeping for " << session->handler->delay << "ms";
+        std::this_thread::sleep_for(std::chrono::milliseconds(session->handler->delay));
+        session->handler->delay = 0;
+    }
+    std::string reply_payload;
+    json jr = jsonrpc_binary_dispatch_method(j, payload, reply_payload, session);
+    return jsonrpc_http_binary_reply(req, jr, reply_payload, session);
+}
+
 //------------------------------------------------------------------------------
 
 /// \brief Handler for HTTP requests
@@ -1538,7 +2394,7 @@ http::message_generator handle_request(HTTP_REQ &&rreq, const std::shared_ptr<ht
     HTTP_REQ req = std::forward<HTTP_REQ>(rreq);
     // Answer OPTIONS request to support cross origin resource sharing (CORS) preflighted browser requests
     if (req.method() == http::verb::options) {
-        SLOG(trace) << session->handler->local_endpoint << " serving \"" << req.method_string() << "\" request";
+        SLOG(trace) << session->handler->local_address << " serving \"" << req.method_string() << "\" request";
         http::response<http::empty_body> res{http::status::no_content, req.version()};
         res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
         res.set(http::field::access_control_allow_origin, "*");
@@ -1550,7 +2406,7 @@ http::message_generator handle_request(HTTP_REQ &&rreq, const std::shared_ptr<ht
     }
     // Only accept POST requests
     if (req.method() != http::verb::post) {
-        SLOG(trace) << session->handler->local_endpoint << " rejected unexpected \"" << req.method_string()
+        SLOG(trace) << session->handler->local_address << " rejected unexpected \"" << req.method_string()
                     << "\" request";
         http::response<http::empty_body> res{http::status::method_not_allowed, req.version()};
         res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
@@ -1558,17 +2414,34 @@ http::message_generator handle_request(HTTP_REQ &&rreq, const std::shared_ptr<ht
         res.keep_alive(req.keep_alive());
         return res;
     }
-    // Only accept / URI
-    SLOG(trace) << session->handler->local_endpoint << " request target uri is " << req.target();
+    // Only accept / URI, or the binary transport URI
+    // Requests to hosted machines never get here, unless the machine does not exist or the transport is disabled
+    SLOG(trace) << session->handler->local_address << " request target uri is " << req.target();
+    if (session->handler->binary_transport && req.target() == cartesi::JSONRPC_BINARY_TARGET) {
+        session->slot = session->handler->default_slot;
+        return handle_binary_request(req, session);
+    }
     if (req.target() != "/") {
-        SLOG(trace) << session->handler->local_endpoint << " request uri rejected";
+        SLOG(trace) << session->handler->local_address << " request uri rejected";
         http::response<http::empty_body> res{http::status::not_found, req.version()};
         res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
         res.set(http::field::access_control_allow_origin, "*");
         res.keep_alive(req.keep_alive());
+        // Clients that fall back to "/" keep the connection, so they need to know the response has no body
+        res.prepare_payload();
         return res;
     }
-    SLOG(trace) << session->handler->local_endpoint << " request body is " << req.body().data();
+    session->slot = session->handler->default_slot;
+    return handle_jsonrpc_request(req, session);
+}
+
+/// \brief Handler for JSONRPC requests
+/// \param req HTTP request
+/// \param session HTTP session
+/// \returns HTTP response message
+static http::message_generator handle_jsonrpc_request(const http::request<http::string_body> &req,
+    const std::shared_ptr<http_session> &session) {
+    SLOG(trace) << session->address() << " request body is " << req.body().data();
     // Parse request body into a JSON object
     json j;
     try {
@@ -1616,8 +2489,8 @@ http::message_generator handle_request(HTTP_REQ &&rreq, const std::shared_ptr<ht
                     jsonrpc_response_invalid_request(ji, "invalid field \"id\" (expected string, number, or null)"));
             }
         }
-        if (session->handler->delay != 0) {
-            SLOG(trace) << session->handler->local_endpoint << " sleeping for " << session->handler->delay << "ms";
+        if (session->slot->handle == 0 && session->handler->delay != 0) {
+            SLOG(trace) << session->handler->local_address << " sleeping for " << session->handler->delay << "ms";
             std::this_thread::sleep_for(std::chrono::milliseconds(session->handler->delay));
             session->handler->delay = 0;
         }
@@ -1653,13 +2526,25 @@ where options are
       <server-address> can be
         <ipv4-address>:<port>
         <ipv6-address>:<port>
+        unix:<path>
       when <port> is 0, an ephemeral port will be automatically selected
+      unix:<path> listens on a Unix domain socket, which is removed when the server stops listening
+      (a socket left behind by a server that is gone is replaced)
       default is "127.0.0.1:0"
 
     --server-fd=<socket-fd>
-      use a listening TCP/IP socket file descriptor inherited from parent process
+      use a listening TCP/IP or Unix domain socket file descriptor inherited from parent process
       default is "-1", so a new socket is created based on --server-address
 
+    --workers=<n>
+      number of threads serving hosted machines
+      hosted machines are created with the host.new_machine method and served at /machines/<handle>
+      default is the number of hardware threads
+
+    --no-binary-transport
+      serves JSON requests only, answering requests to the binary transport with "404 Not Found"
+      clients then fall back to JSON, as they do with servers that predate the binary transport
+
     --log-level=<level>
       sets the log level
       <level> can be
@@ -1708,6 +2593,8 @@ static void init_logger(const char *strlevel) {
 int main(int argc, char *argv[]) try {
     const char *server_address = nullptr;
     int server_fd = -1;
+    uint64_t worker_count = std::thread::hardware_concurrency();
+    bool binary_transport = true;
     const char *log_level = nullptr;
     const char *program_name = PROGRAM_NAME;
 
@@ -1719,8 +2606,13 @@ int main(int argc, char *argv[]) try {
         if (int end = 0; stringval("--server-address=", argv[i], &server_address) ||
             stringval("--log-level=", argv[i], &log_level) ||
             // NOLINTNEXTLINE(cert-err34-c)
-            (sscanf(argv[i], "--server-fd=%d%n", &server_fd, &end) == 1 && argv[i][end] == 0)) {
+            (sscanf(argv[i], "--server-fd=%d%n", &server_fd, &end) == 1 && argv[i][end] == 0) ||
+            // NOLINTNEXTLINE(cert-err34-c)
+            (sscanf(argv[i], "--workers=%" SCNu64 "%n", &worker_count, &end) == 1 && argv[i][end] == 0 &&
+                worker_count > 0)) {
             ;
+        } else if (strcmp(argv[i], "--no-binary-transport") == 0) {
+            binary_transport = false;
         } else if (strcmp(argv[i], "--help") == 0) {
             help(program_name);
             exit(0);
@@ -1740,7 +2632,7 @@ int main(int argc, char *argv[]) try {
     // IO context that will process async events
     asio::io_context ioc{1};
 
-    tcp::acceptor acceptor(ioc);
+    generic_acceptor acceptor(ioc);
     if (server_fd >= 0) {
         if (server_address != nullptr) {
             SLOG(fatal) << "server-address and server-fd options are mutually exclusive";
@@ -1748,7 +2640,7 @@ int main(int argc, char *argv[]) try {
         }
         SLOG(info) << "attempting to inherit fd " << server_fd << " from parent";
         // check socket is listening and is of right domain and type
-        struct sockaddr_in fd_addr{};
+        struct sockaddr_storage fd_addr{};
         socklen_t len = sizeof(fd_addr);
         memset(&fd_addr, 0, len);
         // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
@@ -1756,8 +2648,8 @@ int main(int argc, char *argv[]) try {
             SLOG(fatal) << "getsockname failed on inherited fd: " << strerror(errno);
             exit(1);
         }
-        if (fd_addr.sin_family != PF_INET && fd_addr.sin_family != PF_INET6) {
-            SLOG(fatal) << "inherited fd is not an inet/inet6 domain socket";
+        if (fd_addr.ss_family != PF_INET && fd_addr.ss_family != PF_INET6 && fd_addr.ss_family != PF_UNIX) {
+            SLOG(fatal) << "inherited fd is not an inet/inet6/unix domain socket";
             exit(1);
         }
         int listen = 0;
@@ -1785,22 +2677,18 @@ int main(int argc, char *argv[]) try {
             SLOG(fatal) << "inherited fd is not a stream type socket";
             exit(1);
         }
-        if (fd_addr.sin_family == PF_INET) {
-            acceptor.assign(boost::asio::ip::tcp::v4(), server_fd);
-        } else {
-            acceptor.assign(boost::asio::ip::tcp::v6(), server_fd);
-        }
+        acceptor.assign(generic_stream{fd_addr.ss_family, fd_addr.ss_family == PF_UNIX ? 0 : IPPROTO_TCP}, server_fd);
     } else {
         if (server_address == nullptr) {
             server_address = "127.0.0.1:0";
         }
-        acceptor = tcp::acceptor{ioc, address_to_endpoint(server_address)};
+        acceptor = make_acceptor(ioc, address_to_endpoint(server_address));
     }
 
-    SLOG(info) << "initial server address is '" << acceptor.local_endpoint() << "'";
+    SLOG(info) << "initial server address is '" << endpoint_to_string(acceptor.local_endpoint()) << "'";
 
     // Create and launch a listener
-    auto handler = std::make_shared<http_handler>(ioc, std::move(acceptor));
+    auto handler = std::make_shared<http_handler>(ioc, std::move(acceptor), worker_count, binary_transport);
     // Begin asynchronous operation that will be fired on next process termination signal
     handler->install_termination_signal_handlers();
     // Begin asynchronous operation that will be fired on next accept
@@ -1810,6 +2698,9 @@ int main(int argc, char *argv[]) try {
     // e.g, there is no more clients connected and the handler is not accepting new connections.
     ioc.run();
 
+    // Destroy hosted machines still queued for destruction
+    handler->stop_workers();
+
     SLOG(trace) << "remote machine server exiting";
     return 0;
 } catch (std::exception &e) {
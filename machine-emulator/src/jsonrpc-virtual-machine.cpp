@@ -18,6 +18,7 @@
 
 #include <cerrno>
 #include <chrono>
+#include <climits>
 #include <csignal>
 #include <cstddef>
 #include <cstdint>
@@ -27,9 +28,12 @@
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <system_error>
 #include <tuple>
+#include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "os-features.h"
 
@@ -49,18 +53,22 @@
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wdeprecated-declarations"
 #include <boost/asio/connect.hpp>
+#include <boost/asio/generic/stream_protocol.hpp>
 #include <boost/asio/ip/address.hpp>
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
 #include <boost/beast/version.hpp>
 #pragma GCC diagnostic pop
 
+#include "access-log-binary.h"
 #include "access-log.h"
 #include "base64.h"
 #include "interpret.h"
 #include "json-util.h"
 #include "json.hpp"
+#include "jsonrpc-binary-frame.h"
 #include "jsonrpc-version.h"
 #include "machine-config.h"
 #include "machine-memory-range-descr.h"
@@ -75,23 +83,37 @@ using namespace std::string_literals;
 using json = nlohmann::json;
 using hash_type = cartesi::machine_merkle_tree::hash_type;
 
-namespace beast = boost::beast; // from <boost/beast.hpp>
-namespace http = beast::http;   // from <boost/beast/http.hpp>
-namespace asio = boost::asio;   // from <boost/asio.hpp>
-using tcp = asio::ip::tcp;      // from <boost/asio/ip/tcp.hpp>
+namespace beast = boost::beast;                        // from <boost/beast.hpp>
+namespace http = beast::http;                          // from <boost/beast/http.hpp>
+namespace asio = boost::asio;                          // from <boost/asio.hpp>
+using tcp = asio::ip::tcp;                             // from <boost/asio/ip/tcp.hpp>
+using unix_stream = asio::local::stream_protocol;      // from <boost/asio/local/stream_protocol.hpp>
+using generic_stream = asio::generic::stream_protocol; // from <boost/asio/generic/stream_protocol.hpp>
+using generic_acceptor = asio::basic_socket_acceptor<generic_stream>;
+using stream_type = beast::basic_stream<generic_stream>;
+
+/// \brief Prefix that selects Unix domain socket addresses
+constexpr std::string_view unix_address_prefix = "unix:";
+
+/// \brief Prefix of request targets addressed to hosted machines
+constexpr std::string_view hosted_target_prefix = "/machines/";
 
 template <typename... Ts, size_t... Is>
-static std::string jsonrpc_post_data(const std::string &method, const std::tuple<Ts...> &params,
+static json jsonrpc_request_object(const std::string &method, const std::tuple<Ts...> &params, uint64_t id,
     std::index_sequence<Is...> /*unused*/) {
     json array = json::array();
     ((array.push_back(json(std::get<Is>(params)))), ...);
-    const json j = {{"jsonrpc", "2.0"}, {"method", method}, {"id", 0}, {"params", std::move(array)}};
-    return j.dump();
+    return {{"jsonrpc", "2.0"}, {"method", method}, {"id", id}, {"params", std::move(array)}};
+}
+
+template <typename... Ts>
+static json jsonrpc_request_object(const std::string &method, const std::tuple<Ts...> &params, uint64_t id) {
+    return jsonrpc_request_object(method, params, id, std::make_index_sequence<sizeof...(Ts)>{});
 }
 
 template <typename... Ts>
 static std::string jsonrpc_post_data(const std::string &method, const std::tuple<Ts...> &params) {
-    return jsonrpc_post_data(method, params, std::make_index_sequence<sizeof...(Ts)>{});
+    return jsonrpc_request_object(method, params, 0).dump();
 }
 
 // Close a socket of a connection we are done processing.
@@ -102,13 +124,20 @@ static void shutdown_and_close_socket(auto &socket) {
     // during close(). This behavior occurs because we've set SO_LINGER to 0 on the TCP socket, which causes it to send
     // RST packets when closed. By sending RST instead of FIN, we avoid leaving the connection in TIME_WAIT state, which
     // helps prevent TCP port exhaustion.
-    std::ignore = socket.shutdown(tcp::socket::shutdown_receive, ec);
+    std::ignore = socket.shutdown(asio::socket_base::shutdown_receive, ec);
     std::ignore = socket.close(ec);
 }
 
-// Parses an endpoint from an address string in the format "<ip>:<port>"
-static asio::ip::tcp::endpoint parse_endpoint(const std::string &address) {
+// Parses an endpoint from an address string in the format "<ip>:<port>" or "unix:<path>"
+static generic_stream::endpoint parse_endpoint(const std::string &address) {
     try {
+        if (address.starts_with(unix_address_prefix)) {
+            const std::string path = address.substr(unix_address_prefix.size());
+            if (path.empty()) {
+                throw std::runtime_error("missing socket path"s);
+            }
+            return unix_stream::endpoint{path};
+        }
         const auto colon_pos = address.find_first_of(':');
         if (colon_pos == std::string::npos) {
             throw std::runtime_error("missing port number"s);
@@ -118,18 +147,35 @@ static asio::ip::tcp::endpoint parse_endpoint(const std::string &address) {
         if (port <= 0 || port >= 65536) {
             throw std::runtime_error("invalid port number"s);
         }
-        return {asio::ip::make_address(host), static_cast<uint16_t>(port)};
+        return tcp::endpoint{asio::ip::make_address(host), static_cast<uint16_t>(port)};
     } catch (std::exception &e) {
         throw std::runtime_error("failed to parse endpoint from address \""s + address + "\": "s + e.what());
     }
 }
 
+/// \brief Returns whether an endpoint is a Unix domain socket endpoint
+static bool is_unix_endpoint(const generic_stream::endpoint &endpoint) {
+    return endpoint.protocol().family() == AF_UNIX;
+}
+
+/// \brief Converts a generic endpoint to a specific protocol endpoint
+template <typename ENDPOINT>
+static ENDPOINT endpoint_cast(const generic_stream::endpoint &endpoint) {
+    ENDPOINT specific;
+    if (endpoint.size() > specific.capacity()) {
+        throw std::runtime_error{"endpoint is too large"s};
+    }
+    std::memcpy(specific.data(), endpoint.data(), endpoint.size());
+    specific.resize(endpoint.size());
+    return specific;
+}
+
 class expiration {
     // NOLINTNEXTLINE(cppcoreguidelines-avoid-const-or-ref-data-members)
-    beast::tcp_stream &m_stream;
+    stream_type &m_stream;
 
 public:
-    expiration(beast::tcp_stream &stream, std::chrono::time_point<std::chrono::steady_clock> timeout_at) :
+    expiration(stream_type &stream, std::chrono::time_point<std::chrono::steady_clock> timeout_at) :
         m_stream(stream) {
         if (timeout_at != std::chrono::time_point<std::chrono::steady_clock>::max()) {
             beast::get_lowest_layer(m_stream).expires_at(timeout_at);
@@ -147,10 +193,27 @@ public:
     }
 };
 
-static std::string json_post(boost::asio::io_context &ioc, beast::tcp_stream &stream, const std::string &remote_address,
-    const std::string &post_data, std::chrono::time_point<std::chrono::steady_clock> timeout_at, bool keep_alive) {
+/// \brief Error raised when the server answers with an HTTP status other than OK
+class http_status_error : public std::runtime_error {
+    http::status m_status;
+
+public:
+    explicit http_status_error(const http::response<http::string_body> &res) :
+        std::runtime_error("http error: reason "s + std::string(res.reason()) + " (code "s +
+            std::to_string(res.result_int()) + ")"s),
+        m_status(res.result()) {}
+
+    http::status status() const noexcept {
+        return m_status;
+    }
+};
+
+static std::string http_post(boost::asio::io_context &ioc, stream_type &stream, const std::string &remote_address,
+    const std::string &target, const char *content_type, const std::string &post_data,
+    std::chrono::time_point<std::chrono::steady_clock> timeout_at, bool keep_alive) {
     // Determine remote endpoint from remote address
-    const asio::ip::tcp::endpoint remote_endpoint = parse_endpoint(remote_address);
+    const generic_stream::endpoint remote_endpoint = parse_endpoint(remote_address);
+    const bool is_unix = is_unix_endpoint(remote_endpoint);
 
     // Set expiration to ms milliseconds into the future, automatically clear it when function exits
     const expiration exp(stream, timeout_at);
@@ -179,22 +242,25 @@ static std::string json_post(boost::asio::io_context &ioc, beast::tcp_stream &st
         ioc.restart();
         ioc.run();
 
-        // Disable Nagle's algorithm to minimize TCP connection latency
-        const boost::asio::ip::tcp::no_delay no_delay_option(true);
-        stream.socket().set_option(no_delay_option);
-
-        // Minimize socket close time by setting the linger time to 0.
-        // It avoids accumulating socket in TIME_WAIT state after rapid successive requests,
-        // which can consume all available ports.
-        // It's safe to do this because it is the client who decides to close the connection,
-        // after all data is received.
-        const boost::asio::socket_base::linger linger_option(true, 0);
-        stream.socket().set_option(linger_option);
-
-        // Enable keep alive TCP option for keep alive HTTP connection
-        if (keep_alive) {
-            const boost::asio::socket_base::keep_alive keep_alive_option(true);
-            stream.socket().set_option(keep_alive_option);
+        // Unix domain sockets have no Nagle's algorithm, TIME_WAIT state, or TCP keep alive to tune
+        if (!is_unix) {
+            // Disable Nagle's algorithm to minimize TCP connection latency
+            const boost::asio::ip::tcp::no_delay no_delay_option(true);
+            stream.socket().set_option(no_delay_option);
+
+            // Minimize socket close time by setting the linger time to 0.
+            // It avoids accumulating socket in TIME_WAIT state after rapid successive requests,
+            // which can consume all available ports.
+            // It's safe to do this because it is the client who decides to close the connection,
+            // after all data is received.
+            const boost::asio::socket_base::linger linger_option(true, 0);
+            stream.socket().set_option(linger_option);
+
+            // Enable keep alive TCP option for keep alive HTTP connection
+            if (keep_alive) {
+                const boost::asio::socket_base::keep_alive keep_alive_option(true);
+                stream.socket().set_option(keep_alive_option);
+            }
         }
     }
 
@@ -203,10 +269,11 @@ static std::string json_post(boost::asio::io_context &ioc, beast::tcp_stream &st
         http::request<http::string_body> req;
         req.method(http::verb::post); // POST
         req.version(11);              // Only HTTP 1.1 support keep alive connections
-        req.target("/");
+        req.target(target);
         req.keep_alive(keep_alive);
-        req.set(http::field::host, remote_endpoint.address().to_string());
-        req.set(http::field::content_type, "application/json");
+        req.set(http::field::host,
+            is_unix ? "localhost"s : endpoint_cast<tcp::endpoint>(remote_endpoint).address().to_string());
+        req.set(http::field::content_type, content_type);
         req.set(http::field::user_agent, BOOST_BEAST_VERSION_STRING);
         req.body() = post_data;
         req.prepare_payload();
@@ -245,8 +312,7 @@ static std::string json_post(boost::asio::io_context &ioc, beast::tcp_stream &st
 
         http::response<http::string_body> res = res_parser.release();
         if (res.result() != http::status::ok) {
-            throw std::runtime_error("http error: reason "s + std::string(res.reason()) + " (code "s +
-                std::to_string(res.result_int()) + ")"s);
+            throw http_status_error(res);
         }
 
         // Gracefully close the socket
@@ -263,25 +329,10 @@ static std::string json_post(boost::asio::io_context &ioc, beast::tcp_stream &st
     }
 }
 
-template <typename R, typename... Ts>
-static void jsonrpc_request(std::unique_ptr<boost::asio::io_context> &ioc, std::unique_ptr<beast::tcp_stream> &stream,
-    const std::string &remote_address, const std::string &method, const std::tuple<Ts...> &tp, R &result,
-    std::chrono::time_point<std::chrono::steady_clock> timeout_at, bool keep_alive = true) {
-    if (!stream || !ioc) {
-        throw std::runtime_error{"remote server was shutdown"s};
-    }
-    auto request = jsonrpc_post_data(method, tp);
-    std::string response_s;
-    try {
-        response_s = json_post(*ioc, *stream, remote_address, request, timeout_at, keep_alive);
-    } catch (std::exception &x) {
-        throw std::runtime_error("jsonrpc error: post error contacting "s + remote_address + " ("s + x.what() + ")"s);
-    }
-    json response;
-    try {
-        response = json::parse(response_s);
-    } catch (std::exception &x) {
-        throw std::runtime_error("jsonrpc server error: invalid response ("s + x.what() + ")"s);
+template <typename R>
+static void jsonrpc_check_response(const json &response, uint64_t id, R &result) {
+    if (!response.is_object()) {
+        throw std::runtime_error("jsonrpc server error: response not an object"s);
     }
     if (!response.contains("jsonrpc")) {
         throw std::runtime_error(R"(jsonrpc server error: missing field "jsonrpc")"s);
@@ -292,8 +343,8 @@ static void jsonrpc_request(std::unique_ptr<boost::asio::io_context> &ioc, std::
     if (!response.contains("id")) {
         throw std::runtime_error(R"(jsonrpc server error: missing field "id")"s);
     }
-    if (!response["id"].is_number() || response["id"] != 0) {
-        throw std::runtime_error(R"(jsonrpc server error: invalid field "id" (expected 0))"s);
+    if (!response["id"].is_number() || response["id"] != id) {
+        throw std::runtime_error(R"(jsonrpc server error: invalid field "id" (expected )"s + std::to_string(id) + ")"s);
     }
     if (response.contains("error") && response.contains("result")) {
         throw std::runtime_error(R"(jsonrpc server error: response contains both "error" and "result" fields)"s);
@@ -317,12 +368,213 @@ static void jsonrpc_request(std::unique_ptr<boost::asio::io_context> &ioc, std::
         throw std::runtime_error("jsonrpc error: "s + message + " (code "s + std::to_string(code) + ")"s);
     }
     try {
-        cartesi::ju_get_field(response, "result"s, result, ""s);
+        if constexpr (std::is_same_v<R, json>) {
+            result = response["result"];
+        } else {
+            cartesi::ju_get_field(response, "result"s, result, ""s);
+        }
     } catch (std::exception &x) {
         throw std::runtime_error("jsonrpc server error: "s + x.what());
     }
 }
 
+template <typename R>
+static void jsonrpc_parse_response(std::string_view response_s, R &result) {
+    json response;
+    try {
+        response = json::parse(response_s);
+    } catch (std::exception &x) {
+        throw std::runtime_error("jsonrpc server error: invalid response ("s + x.what() + ")"s);
+    }
+    jsonrpc_check_response(response, 0, result);
+}
+
+template <typename R, typename... Ts>
+static void jsonrpc_request(std::unique_ptr<boost::asio::io_context> &ioc, std::unique_ptr<stream_type> &stream,
+    const std::string &remote_address, const std::string &target, const std::string &method,
+    const std::tuple<Ts...> &tp, R &result, std::chrono::time_point<std::chrono::steady_clock> timeout_at,
+    bool keep_alive = true) {
+    if (!stream || !ioc) {
+        throw std::runtime_error{"remote server was shutdown"s};
+    }
+    auto request = jsonrpc_post_data(method, tp);
+    std::string response_s;
+    try {
+        response_s =
+            http_post(*ioc, *stream, remote_address, target, "application/json", request, timeout_at, keep_alive);
+    } catch (std::exception &x) {
+        throw std::runtime_error("jsonrpc error: post error contacting "s + remote_address + " ("s + x.what() + ")"s);
+    }
+    jsonrpc_parse_response(response_s, result);
+}
+
+/// \brief Performs several calls to the same method as a single JSONRPC batch request
+/// \details The whole batch travels in one round-trip, and results are returned in the order of the calls
+template <typename R, typename... Ts>
+static void jsonrpc_batch_request(std::unique_ptr<boost::asio::io_context> &ioc, std::unique_ptr<stream_type> &stream,
+    const std::string &remote_address, const std::string &target, const std::string &method,
+    const std::vector<std::tuple<Ts...>> &tps, std::vector<R> &results,
+    std::chrono::time_point<std::chrono::steady_clock> timeout_at) {
+    if (!stream || !ioc) {
+        throw std::runtime_error{"remote server was shutdown"s};
+    }
+    results.resize(tps.size());
+    if (tps.empty()) {
+        return;
+    }
+    json batch = json::array();
+    for (uint64_t id = 0; id < tps.size(); ++id) {
+        batch.push_back(jsonrpc_request_object(method, tps[id], id));
+    }
+    std::string response_s;
+    try {
+        response_s =
+            http_post(*ioc, *stream, remote_address, target, "application/json", batch.dump(), timeout_at, true);
+    } catch (std::exception &x) {
+        throw std::runtime_error("jsonrpc error: post error contacting "s + remote_address + " ("s + x.what() + ")"s);
+    }
+    json responses;
+    try {
+        responses = json::parse(response_s);
+    } catch (std::exception &x) {
+        throw std::runtime_error("jsonrpc server error: invalid response ("s + x.what() + ")"s);
+    }
+    if (!responses.is_array() || responses.size() != tps.size()) {
+        throw std::runtime_error("jsonrpc server error: invalid batch response (expected array with "s +
+            std::to_string(tps.size()) + " entries)"s);
+    }
+    // The server answers in order, but responses are matched by id as the specification allows any order
+    std::vector<bool> answered(tps.size(), false);
+    for (const auto &response : responses) {
+        const auto *jid = response.is_object() && response.contains("id") ? &response["id"] : nullptr;
+        if (jid == nullptr || !jid->is_number_unsigned() || jid->get<uint64_t>() >= tps.size() ||
+            answered[jid->get<uint64_t>()]) {
+            throw std::runtime_error(R"(jsonrpc server error: invalid field "id" in batch response)"s);
+        }
+        const auto id = jid->get<uint64_t>();
+        answered[id] = true;
+        jsonrpc_check_response(response, id, results[id]);
+    }
+}
+
+/// \brief Performs a request through the binary transport
+/// \returns False if the server does not serve the binary transport, true otherwise
+/// \details The payload is sent raw after the request, and the raw payload that follows the response is returned in
+/// reply_payload
+template <typename R, typename... Ts>
+static bool jsonrpc_binary_request(std::unique_ptr<boost::asio::io_context> &ioc,
+    std::unique_ptr<stream_type> &stream, const std::string &remote_address, const std::string &target,
+    const std::string &method, const std::tuple<Ts...> &tp, std::string_view payload, R &result,
+    std::string &reply_payload, std::chrono::time_point<std::chrono::steady_clock> timeout_at) {
+    if (!stream || !ioc) {
+        throw std::runtime_error{"remote server was shutdown"s};
+    }
+    auto request = cartesi::jsonrpc_binary_frame_encode(jsonrpc_post_data(method, tp), payload);
+    std::string response_s;
+    try {
+        // Hosted machines serve the binary transport below their own target
+        const auto binary_target =
+            target == "/" ? std::string{cartesi::JSONRPC_BINARY_TARGET} : target + cartesi::JSONRPC_BINARY_TARGET;
+        response_s = http_post(*ioc, *stream, remote_address, binary_target, cartesi::JSONRPC_BINARY_CONTENT_TYPE,
+            request, timeout_at, true);
+    } catch (http_status_error &x) {
+        if (x.status() == http::status::not_found) {
+            return false;
+        }
+        throw std::runtime_error("jsonrpc error: post error contacting "s + remote_address + " ("s + x.what() + ")"s);
+    } catch (std::exception &x) {
+        throw std::runtime_error("jsonrpc error: post error contacting "s + remote_address + " ("s + x.what() + ")"s);
+    }
+    std::string_view response_json;
+    std::string_view response_payload;
+    try {
+        std::tie(response_json, response_payload) = cartesi::jsonrpc_binary_frame_decode(response_s);
+    } catch (std::exception &x) {
+        throw std::runtime_error("jsonrpc server error: invalid response ("s + x.what() + ")"s);
+    }
+    jsonrpc_parse_response(response_json, result);
+    // Move the payload to the front of the response body rather than copying it out
+    response_s.erase(0, response_s.size() - response_payload.size());
+    reply_payload = std::move(response_s);
+    return true;
+}
+
+/// \brief Views a block of memory as a binary payload
+static std::string_view as_string_view(const unsigned char *data, uint64_t length) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    return {reinterpret_cast<const char *>(data), length};
+}
+
+/// \brief Copies a binary reply payload holding memory contents to its destination
+static void copy_reply_payload(const std::string &bin, unsigned char *data, uint64_t length) {
+    if (bin.size() != length) {
+        throw std::runtime_error("jsonrpc server error: invalid binary data length");
+    }
+    std::memcpy(data, bin.data(), length);
+}
+
+/// \brief Decodes a binary reply payload holding an access log, restoring the log type that was requested
+static cartesi::access_log decode_reply_log(const std::string &bin, const cartesi::access_log::type &log_type) {
+    try {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        auto log = cartesi::decode_access_log_binary(reinterpret_cast<const unsigned char *>(bin.data()), bin.size());
+        if (log_type.is_binary()) {
+            return log;
+        }
+        return {log.get_accesses(), log.get_brackets(), log.get_notes(), log_type};
+    } catch (std::exception &x) {
+        throw std::runtime_error("jsonrpc server error: "s + x.what());
+    }
+}
+
+/// \brief Builds the payload of a binary verify request, with the raw root hashes followed by the access log
+static std::string make_verify_payload(const cartesi::machine_merkle_tree::hash_type &root_hash_before,
+    const cartesi::access_log &log, const cartesi::machine_merkle_tree::hash_type &root_hash_after) {
+    std::string payload;
+    // NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+    payload.append(reinterpret_cast<const char *>(root_hash_before.data()), root_hash_before.size());
+    payload.append(reinterpret_cast<const char *>(root_hash_after.data()), root_hash_after.size());
+    // NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+    payload.append(cartesi::encode_access_log_binary(log));
+    return payload;
+}
+
+/// \brief Rebuilds a proof from the sizes in a binary reply and the hashes in its payload
+static cartesi::machine_merkle_tree::proof_type decode_reply_proof(const json &sizes, const std::string &bin) {
+    using proof_type = cartesi::machine_merkle_tree::proof_type;
+    proof_type::address_type target_address = 0;
+    uint64_t log2_target_size = 0;
+    uint64_t log2_root_size = 0;
+    try {
+        cartesi::ju_get_field(sizes, "target_address"s, target_address, "result/"s);
+        cartesi::ju_get_field(sizes, "log2_target_size"s, log2_target_size, "result/"s);
+        cartesi::ju_get_field(sizes, "log2_root_size"s, log2_root_size, "result/"s);
+    } catch (std::exception &x) {
+        throw std::runtime_error("jsonrpc server error: "s + x.what());
+    }
+    if (log2_root_size > INT_MAX || log2_target_size > log2_root_size) {
+        throw std::runtime_error("jsonrpc server error: invalid binary proof sizes");
+    }
+    proof_type proof(static_cast<int>(log2_root_size), static_cast<int>(log2_target_size));
+    proof_type::hash_type hash;
+    if (bin.size() != hash.size() * (2 + log2_root_size - log2_target_size)) {
+        throw std::runtime_error("jsonrpc server error: invalid binary proof length");
+    }
+    const char *next = bin.data();
+    const auto get_hash = [&next, &hash]() -> const proof_type::hash_type & {
+        std::memcpy(hash.data(), next, hash.size());
+        next += hash.size();
+        return hash;
+    };
+    proof.set_target_address(target_address);
+    proof.set_target_hash(get_hash());
+    proof.set_root_hash(get_hash());
+    for (int log2_size = proof.get_log2_target_size(); log2_size < proof.get_log2_root_size(); ++log2_size) {
+        proof.set_sibling_hash(get_hash(), log2_size);
+    }
+    return proof;
+}
+
 namespace cartesi {
 
 template <typename R, typename... Ts>
@@ -332,18 +584,52 @@ void jsonrpc_virtual_machine::request(const std::string &method, const std::tupl
     const auto timeout_at = m_timeout >= 0 ? (std::chrono::steady_clock::now() + std::chrono::milliseconds(m_timeout)) :
                                              std::chrono::time_point<std::chrono::steady_clock>::max();
     // Performs the request
-    jsonrpc_request(m_ioc, m_stream, m_address, method, tp, result, timeout_at, keep_alive);
+    jsonrpc_request(m_ioc, m_stream, m_address, m_target, method, tp, result, timeout_at, keep_alive);
 }
 
 template <typename R, typename... Ts>
-void jsonrpc_virtual_machine::request(const std::string &method, const std::tuple<Ts...> &tp, R &result,
+void jsonrpc_virtual_machine::server_request(const std::string &method, const std::tuple<Ts...> &tp, R &result,
+    bool keep_alive) const {
+    const auto timeout_at = m_timeout >= 0 ? (std::chrono::steady_clock::now() + std::chrono::milliseconds(m_timeout)) :
+                                             std::chrono::time_point<std::chrono::steady_clock>::max();
+    server_request(method, tp, result, timeout_at, keep_alive);
+}
+
+template <typename R, typename... Ts>
+void jsonrpc_virtual_machine::server_request(const std::string &method, const std::tuple<Ts...> &tp, R &result,
     std::chrono::time_point<std::chrono::steady_clock> timeout_at, bool keep_alive) const {
-    jsonrpc_request(m_ioc, m_stream, m_address, method, tp, result, timeout_at, keep_alive);
+    // Server methods are always posted to the root target, even when talking to a hosted machine
+    jsonrpc_request(m_ioc, m_stream, m_address, "/"s, method, tp, result, timeout_at, keep_alive);
+}
+
+template <typename R, typename... Ts>
+bool jsonrpc_virtual_machine::binary_request(const std::string &method, const std::tuple<Ts...> &tp,
+    std::string_view payload, R &result, std::string &reply_payload) const {
+    if (!m_binary_transport) {
+        return false;
+    }
+    const auto timeout_at = m_timeout >= 0 ? (std::chrono::steady_clock::now() + std::chrono::milliseconds(m_timeout)) :
+                                             std::chrono::time_point<std::chrono::steady_clock>::max();
+    if (!jsonrpc_binary_request(m_ioc, m_stream, m_address, m_target, method, tp, payload, result, reply_payload,
+            timeout_at)) {
+        // Older servers do not know the binary transport, so stick to JSON from now on
+        m_binary_transport = false;
+        return false;
+    }
+    return true;
+}
+
+template <typename R, typename... Ts>
+void jsonrpc_virtual_machine::batch_request(const std::string &method, const std::vector<std::tuple<Ts...>> &tps,
+    std::vector<R> &results) const {
+    const auto timeout_at = m_timeout >= 0 ? (std::chrono::steady_clock::now() + std::chrono::milliseconds(m_timeout)) :
+                                             std::chrono::time_point<std::chrono::steady_clock>::max();
+    jsonrpc_batch_request(m_ioc, m_stream, m_address, m_target, method, tps, results, timeout_at);
 }
 
 void jsonrpc_virtual_machine::shutdown_server() {
     bool result = false;
-    request("shutdown", std::tie(), result, false);
+    server_request("shutdown", std::tie(), result, false);
     // Destroy ASIO context early to release its socket before the destructor,
     // otherwise we may end up with too many open sockets in garbage collected environments.
     // This will also invalidate any further jsonrpc request.
@@ -353,7 +639,7 @@ void jsonrpc_virtual_machine::shutdown_server() {
 
 void jsonrpc_virtual_machine::delay_next_request(uint64_t ms) const {
     bool result = false;
-    request("delay_next_request", std::tie(ms), result);
+    server_request("delay_next_request", std::tie(ms), result);
 }
 
 void jsonrpc_virtual_machine::set_timeout(int64_t ms) {
@@ -376,6 +662,41 @@ const std::string &jsonrpc_virtual_machine::get_server_address() const {
     return m_address;
 }
 
+jsonrpc_virtual_machine *jsonrpc_virtual_machine::new_hosted_machine(uint64_t template_handle,
+    const std::optional<machine_runtime_config> &runtime) const {
+    uint64_t handle = 0;
+    if (template_handle == 0) {
+        if (runtime.has_value()) {
+            throw std::invalid_argument{"runtime config given without template"s};
+        }
+        server_request("host.new_machine", std::tie(), handle);
+    } else if (runtime.has_value()) {
+        server_request("host.new_machine", std::tie(template_handle, runtime.value()), handle);
+    } else {
+        server_request("host.new_machine", std::tie(template_handle), handle);
+    }
+    auto hosted = std::unique_ptr<jsonrpc_virtual_machine>(new jsonrpc_virtual_machine(m_address, handle));
+    hosted->set_timeout(m_timeout);
+    // The server keeps the machine until it is deleted, so delete it when the new object goes away
+    hosted->set_cleanup_call(cleanup_call::destroy);
+    return hosted.release();
+}
+
+uint64_t jsonrpc_virtual_machine::new_hosted_template() const {
+    uint64_t result = 0;
+    request("machine.new_template", std::tie(), result);
+    return result;
+}
+
+void jsonrpc_virtual_machine::delete_hosted_template(uint64_t template_handle) const {
+    bool result = false;
+    server_request("host.delete_template", std::tie(template_handle), result);
+}
+
+uint64_t jsonrpc_virtual_machine::get_hosted_handle() const {
+    return m_hosted_handle;
+}
+
 static inline std::string semver_to_string(uint32_t major, uint32_t minor) {
     return std::to_string(major) + "." + std::to_string(minor);
 }
@@ -383,7 +704,7 @@ static inline std::string semver_to_string(uint32_t major, uint32_t minor) {
 void jsonrpc_virtual_machine::check_server_version(
     std::chrono::time_point<std::chrono::steady_clock> timeout_at) const {
     semantic_version server_version;
-    request("get_version", std::tie(), server_version, timeout_at, false);
+    server_request("get_version", std::tie(), server_version, timeout_at, false);
     if (server_version.major != JSONRPC_VERSION_MAJOR || server_version.minor != JSONRPC_VERSION_MINOR) {
         throw std::runtime_error{"expected server version "s +
             semver_to_string(JSONRPC_VERSION_MAJOR, JSONRPC_VERSION_MINOR) + " (got "s +
@@ -393,7 +714,7 @@ void jsonrpc_virtual_machine::check_server_version(
 
 jsonrpc_virtual_machine::jsonrpc_virtual_machine(std::string address, int64_t connect_timeout_ms) :
     m_ioc(new boost::asio::io_context{1}),
-    m_stream(new boost::beast::tcp_stream(*m_ioc)),
+    m_stream(new stream_type(*m_ioc)),
     m_address(std::move(address)) {
     // Install handler to ignore SIGPIPE lest we crash when a server closes a connection
     os_disable_sigpipe();
@@ -409,38 +730,54 @@ jsonrpc_virtual_machine::jsonrpc_virtual_machine(std::string address, int64_t co
 
 jsonrpc_virtual_machine::jsonrpc_virtual_machine(std::string address) :
     m_ioc(new boost::asio::io_context{1}),
-    m_stream(new boost::beast::tcp_stream(*m_ioc)),
+    m_stream(new stream_type(*m_ioc)),
     m_address(std::move(address)) {
     // Install handler to ignore SIGPIPE lest we crash when a server closes a connection
     os_disable_sigpipe();
 }
 
+jsonrpc_virtual_machine::jsonrpc_virtual_machine(std::string address, uint64_t hosted_handle) :
+    m_ioc(new boost::asio::io_context{1}),
+    m_stream(new stream_type(*m_ioc)),
+    m_address(std::move(address)),
+    m_target(std::string{hosted_target_prefix} + std::to_string(hosted_handle)),
+    m_hosted_handle(hosted_handle) {
+    // Install handler to ignore SIGPIPE lest we crash when a server closes a connection
+    os_disable_sigpipe();
+}
+
 #ifdef HAVE_FORK
 
-static boost::asio::ip::tcp::endpoint address_to_endpoint(const std::string &address) {
+static generic_stream::endpoint address_to_endpoint(const std::string &address) {
     try {
+        if (address.starts_with(unix_address_prefix)) {
+            return unix_stream::endpoint{address.substr(unix_address_prefix.size())};
+        }
         const auto pos = address.find_last_of(':');
         const std::string ip = address.substr(0, pos);
         const int port = std::stoi(address.substr(pos + 1));
         if (port < 0 || port > 65535) {
             throw std::runtime_error{"invalid port"};
         }
-        return {boost::asio::ip::make_address(ip), static_cast<uint16_t>(port)};
+        return tcp::endpoint{boost::asio::ip::make_address(ip), static_cast<uint16_t>(port)};
     } catch (std::exception &e) {
         throw std::runtime_error{"invalid endpoint address \"" + address + "\""};
     }
 }
 
-static std::string endpoint_to_string(const boost::asio::ip::tcp::endpoint &endpoint) {
+static std::string endpoint_to_string(const generic_stream::endpoint &endpoint) {
+    if (is_unix_endpoint(endpoint)) {
+        return std::string{unix_address_prefix} + endpoint_cast<unix_stream::endpoint>(endpoint).path();
+    }
     std::ostringstream ss;
-    ss << endpoint;
+    ss << endpoint_cast<tcp::endpoint>(endpoint);
     return ss.str();
 }
 
 jsonrpc_virtual_machine::jsonrpc_virtual_machine(const std::string &address, int64_t spawn_timeout_ms,
     fork_result &spawned) :
     m_ioc(new boost::asio::io_context{1}),
-    m_stream(new boost::beast::tcp_stream(*m_ioc)),
+    m_stream(new stream_type(*m_ioc)),
     m_call(cleanup_call::shutdown) {
 
     // Determine spawn timeout time
@@ -448,10 +785,10 @@ jsonrpc_virtual_machine::jsonrpc_virtual_machine(const std::string &address, int
         (std::chrono::steady_clock::now() + std::chrono::milliseconds(spawn_timeout_ms)) :
         std::chrono::time_point<std::chrono::steady_clock>::max();
 
-    // Create a TCP acceptor and bind it to the specified address
+    // Create a TCP or Unix domain socket acceptor and bind it to the specified address
     // The acceptor automatically performs open, bind and listen operations
-    boost::asio::ip::tcp::acceptor a(*m_ioc,
-        address_to_endpoint(address)); // NOLINT(clang-analyzer-optin.cplusplus.VirtualCall)
+    const auto endpoint = address_to_endpoint(address);
+    generic_acceptor a(*m_ioc, endpoint); // NOLINT(clang-analyzer-optin.cplusplus.VirtualCall)
 
     // Determine which remote machine binary to use
     const char *bin = getenv("CARTESI_JSONRPC_MACHINE");
@@ -522,7 +859,7 @@ jsonrpc_virtual_machine::jsonrpc_virtual_machine(const std::string &address, int
     // This allows us to use waitpid() on the original child process while the
     // actual server (grand-child) continues running independently
     fork_result forked_grand_child{};
-    request("fork", std::tie(), forked_grand_child, timeout_at, true);
+    server_request("fork", std::tie(), forked_grand_child, timeout_at, true);
 
     // Ensures the grand-child process is killed if any exceptions occur during the subsequent initialization steps
     auto grand_child_killer = make_scope_fail([&] {
@@ -532,12 +869,14 @@ jsonrpc_virtual_machine::jsonrpc_virtual_machine(const std::string &address, int
 
     // Shutdown the original child server process now that we have a forked grand-child
     bool shutdown_result = false;
-    request("shutdown", std::tie(), shutdown_result, timeout_at, false);
+    server_request("shutdown", std::tie(), shutdown_result, timeout_at, false);
     m_address = forked_grand_child.address;
 
     // Rebind the forked server to listen on the originally requested address
+    // A Unix domain socket path was released when the child shut down, so the grand-child can take it over
+    const std::string &rebind_address = is_unix_endpoint(endpoint) ? address : forked_grand_child.address;
     std::string rebind_result;
-    request("rebind", std::tie(forked_grand_child.address), rebind_result, timeout_at, false);
+    server_request("rebind", std::tie(rebind_address), rebind_result, timeout_at, false);
     m_address = rebind_result;
 
     // At this point, we've confirmed the remote server is properly initialized and running
@@ -565,6 +904,10 @@ bool jsonrpc_virtual_machine::do_is_empty() const {
 }
 
 i_virtual_machine *jsonrpc_virtual_machine::do_clone_empty() const {
+    // Hosted machines are cloned into another machine hosted by the same server, as forking is unavailable
+    if (m_hosted_handle != 0) {
+        return new_hosted_machine(0, std::nullopt);
+    }
     auto fork_result = fork_server();
     auto *clone = new jsonrpc_virtual_machine(fork_result.address);
     try {
@@ -588,9 +931,28 @@ void jsonrpc_virtual_machine::do_create(const machine_config &config, const mach
     request("machine.create", std::tie(config, runtime), result);
 }
 
+void jsonrpc_virtual_machine::do_create_from_template(const machine_template & /*t*/,
+    const machine_runtime_config & /*runtime*/) {
+    throw std::runtime_error{"machine templates are unsupported by remote machines"s};
+}
+
+machine_template *jsonrpc_virtual_machine::do_create_template() const {
+    throw std::runtime_error{"machine templates are unsupported by remote machines"s};
+}
+
 jsonrpc_virtual_machine::~jsonrpc_virtual_machine() {
+    // Hosted machines are deleted from the server instead, which must keep serving other machines
+    if (m_stream && m_hosted_handle != 0 && m_call != cleanup_call::nothing) {
+        try {
+            bool result = false;
+            server_request("host.delete_machine", std::tie(m_hosted_handle), result);
+        } catch (...) { // NOLINT(bugprone-empty-catch)
+            // We guard against exceptions here, which would only mean we failed to cleanup.
+            // We do not guarantee that we will cleanup. It's a best-effort thing.
+        }
+    }
     // If configured to destroy machine, do it
-    if (m_stream && m_call == cleanup_call::destroy) {
+    if (m_stream && m_hosted_handle == 0 && m_call == cleanup_call::destroy) {
         try {
             destroy();
         } catch (...) { // NOLINT(bugprone-empty-catch)
@@ -599,7 +961,7 @@ jsonrpc_virtual_machine::~jsonrpc_virtual_machine() {
         }
     }
     // If configured to shutdown server, do it
-    if (m_stream && m_call == cleanup_call::shutdown) {
+    if (m_stream && m_hosted_handle == 0 && m_call == cleanup_call::shutdown) {
         try {
             shutdown_server();
         } catch (...) { // NOLINT(bugprone-empty-catch)
@@ -632,7 +994,7 @@ void jsonrpc_virtual_machine::do_set_runtime_config(const machine_runtime_config
 
 semantic_version jsonrpc_virtual_machine::get_server_version() const {
     semantic_version result;
-    request("get_version", std::tie(), result);
+    server_request("get_version", std::tie(), result);
     return result;
 }
 
@@ -659,6 +1021,17 @@ uint64_t jsonrpc_virtual_machine::do_read_reg(reg r) const {
     return result;
 }
 
+std::vector<uint64_t> jsonrpc_virtual_machine::do_read_regs(const std::vector<reg> &regs) const {
+    std::vector<std::tuple<reg>> tps;
+    tps.reserve(regs.size());
+    for (const auto r : regs) {
+        tps.emplace_back(r);
+    }
+    std::vector<uint64_t> results;
+    batch_request("machine.read_reg", tps, results);
+    return results;
+}
+
 void jsonrpc_virtual_machine::do_write_reg(reg w, uint64_t val) {
     bool result = false;
     request("machine.write_reg", std::tie(w, val), result);
@@ -666,23 +1039,29 @@ void jsonrpc_virtual_machine::do_write_reg(reg w, uint64_t val) {
 
 auto jsonrpc_virtual_machine::fork_server() const -> fork_result {
     fork_result result{};
-    request("fork", std::tie(), result, false);
+    server_request("fork", std::tie(), result, false);
     return result;
 }
 
 std::string jsonrpc_virtual_machine::rebind_server(const std::string &address) {
     std::string result;
-    request("rebind", std::tie(address), result, false);
+    server_request("rebind", std::tie(address), result, false);
     m_address = result;
     return result;
 }
 
 void jsonrpc_virtual_machine::emancipate_server() const {
     bool result = false;
-    request("emancipate", std::tie(), result);
+    server_request("emancipate", std::tie(), result);
 }
 
 void jsonrpc_virtual_machine::do_read_memory(uint64_t address, unsigned char *data, uint64_t length) const {
+    bool ok = false;
+    std::string payload;
+    if (binary_request("machine.read_memory", std::tie(address, length), {}, ok, payload)) {
+        copy_reply_payload(payload, data, length);
+        return;
+    }
     std::string result;
     request("machine.read_memory", std::tie(address, length), result);
     std::string bin = cartesi::decode_base64(result);
@@ -694,11 +1073,29 @@ void jsonrpc_virtual_machine::do_read_memory(uint64_t address, unsigned char *da
 
 void jsonrpc_virtual_machine::do_write_memory(uint64_t address, const unsigned char *data, uint64_t length) {
     bool result = false;
+    std::string none;
+    if (binary_request("machine.write_memory", std::tie(address), as_string_view(data, length), result, none)) {
+        return;
+    }
     std::string b64 = cartesi::encode_base64(data, length);
     request("machine.write_memory", std::tie(address, b64), result);
 }
 
+unsigned char *jsonrpc_virtual_machine::do_get_host_memory(uint64_t /*address*/, uint64_t /*length*/) {
+    throw std::runtime_error{"host memory pointers are unsupported by remote machines"s};
+}
+
+void jsonrpc_virtual_machine::do_mark_dirty_memory(uint64_t /*address*/, uint64_t /*length*/) {
+    throw std::runtime_error{"host memory pointers are unsupported by remote machines"s};
+}
+
 void jsonrpc_virtual_machine::do_read_virtual_memory(uint64_t address, unsigned char *data, uint64_t length) {
+    bool ok = false;
+    std::string payload;
+    if (binary_request("machine.read_virtual_memory", std::tie(address, length), {}, ok, payload)) {
+        copy_reply_payload(payload, data, length);
+        return;
+    }
     std::string result;
     request("machine.read_virtual_memory", std::tie(address, length), result);
     std::string bin = cartesi::decode_base64(result);
@@ -710,6 +1107,11 @@ void jsonrpc_virtual_machine::do_read_virtual_memory(uint64_t address, unsigned
 
 void jsonrpc_virtual_machine::do_write_virtual_memory(uint64_t address, const unsigned char *data, uint64_t length) {
     bool result = false;
+    std::string none;
+    if (binary_request("machine.write_virtual_memory", std::tie(address), as_string_view(data, length), result,
+            none)) {
+        return;
+    }
     std::string b64 = cartesi::encode_base64(data, length);
     request("machine.write_virtual_memory", std::tie(address, b64), result);
 }
@@ -726,6 +1128,11 @@ void jsonrpc_virtual_machine::do_reset_uarch() {
 }
 
 access_log jsonrpc_virtual_machine::do_log_reset_uarch(const access_log::type &log_type) {
+    bool ok = false;
+    std::string bin;
+    if (binary_request("machine.log_reset_uarch", std::tie(log_type), {}, ok, bin)) {
+        return decode_reply_log(bin, log_type);
+    }
     not_default_constructible<access_log> result;
     request("machine.log_reset_uarch", std::tie(log_type), result);
     if (!result.has_value()) {
@@ -739,6 +1146,11 @@ void jsonrpc_virtual_machine::do_get_root_hash(hash_type &hash) const {
 }
 
 machine_merkle_tree::proof_type jsonrpc_virtual_machine::do_get_proof(uint64_t address, int log2_size) const {
+    json sizes;
+    std::string bin;
+    if (binary_request("machine.get_proof", std::tie(address, log2_size), {}, sizes, bin)) {
+        return decode_reply_proof(sizes, bin);
+    }
     not_default_constructible<machine_merkle_tree::proof_type> result;
     request("machine.get_proof", std::tie(address, log2_size), result);
     if (!result.has_value()) {
@@ -753,6 +1165,11 @@ void jsonrpc_virtual_machine::do_replace_memory_range(const memory_range_config
 }
 
 access_log jsonrpc_virtual_machine::do_log_step_uarch(const access_log::type &log_type) {
+    bool ok = false;
+    std::string bin;
+    if (binary_request("machine.log_step_uarch", std::tie(log_type), {}, ok, bin)) {
+        return decode_reply_log(bin, log_type);
+    }
     not_default_constructible<access_log> result;
     request("machine.log_step_uarch", std::tie(log_type), result);
     if (!result.has_value()) {
@@ -804,6 +1221,12 @@ void jsonrpc_virtual_machine::do_send_cmio_response(uint16_t reason, const unsig
 
 access_log jsonrpc_virtual_machine::do_log_send_cmio_response(uint16_t reason, const unsigned char *data,
     uint64_t length, const access_log::type &log_type) {
+    bool ok = false;
+    std::string bin;
+    if (binary_request("machine.log_send_cmio_response", std::tie(reason, log_type), as_string_view(data, length), ok,
+            bin)) {
+        return decode_reply_log(bin, log_type);
+    }
     not_default_constructible<access_log> result;
     std::string b64 = cartesi::encode_base64(data, length);
     request("machine.log_send_cmio_response", std::tie(reason, b64, log_type), result);
@@ -835,9 +1258,30 @@ interpreter_break_reason jsonrpc_virtual_machine::do_verify_step(const hash_type
     return result;
 }
 
+std::vector<interpreter_break_reason> jsonrpc_virtual_machine::do_verify_steps(
+    const std::vector<machine::step_log_entry> &entries, bool chained, uint64_t /*concurrency*/) const {
+    // The server verifies one log per request, so logs are simply checked in order
+    std::vector<interpreter_break_reason> break_reasons;
+    break_reasons.reserve(entries.size());
+    for (uint64_t i = 0; i < entries.size(); ++i) {
+        const auto &e = entries[i];
+        if (chained && i > 0 && e.root_hash_before != entries[i - 1].root_hash_after) {
+            throw std::invalid_argument{"step log "s + std::to_string(i) + " does not start where step log "s +
+                std::to_string(i - 1) + " ends"s};
+        }
+        break_reasons.push_back(do_verify_step(e.root_hash_before, e.log_filename, e.mcycle_count, e.root_hash_after));
+    }
+    return break_reasons;
+}
+
 void jsonrpc_virtual_machine::do_verify_step_uarch(const hash_type &root_hash_before, const access_log &log,
     const hash_type &root_hash_after) const {
     bool result = false;
+    std::string none;
+    const auto payload = make_verify_payload(root_hash_before, log, root_hash_after);
+    if (binary_request("machine.verify_step_uarch", std::tie(), payload, result, none)) {
+        return;
+    }
     auto b64_root_hash_before = encode_base64(root_hash_before);
     auto b64_root_hash_after = encode_base64(root_hash_after);
     request("machine.verify_step_uarch", std::tie(b64_root_hash_before, log, b64_root_hash_after), result);
@@ -846,6 +1290,11 @@ void jsonrpc_virtual_machine::do_verify_step_uarch(const hash_type &root_hash_be
 void jsonrpc_virtual_machine::do_verify_reset_uarch(const hash_type &root_hash_before, const access_log &log,
     const hash_type &root_hash_after) const {
     bool result = false;
+    std::string none;
+    const auto payload = make_verify_payload(root_hash_before, log, root_hash_after);
+    if (binary_request("machine.verify_reset_uarch", std::tie(), payload, result, none)) {
+        return;
+    }
     auto b64_root_hash_before = encode_base64(root_hash_before);
     auto b64_root_hash_after = encode_base64(root_hash_after);
     request("machine.verify_reset_uarch", std::tie(b64_root_hash_before, log, b64_root_hash_after), result);
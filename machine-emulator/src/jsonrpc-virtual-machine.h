@@ -19,7 +19,10 @@
 
 #include <cstdint>
 #include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <vector>
 
 #include "access-log.h"
 #include "i-virtual-machine.h"
@@ -29,13 +32,15 @@
 #include "machine-memory-range-descr.h"
 #include "machine-merkle-tree.h"
 #include "machine-runtime-config.h"
+#include "machine-template.h"
 #include "semantic-version.h"
 #include "uarch-interpret.h"
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#include <boost/asio/generic/stream_protocol.hpp>
 #include <boost/asio/io_context.hpp>
-#include <boost/beast/core/tcp_stream.hpp>
+#include <boost/beast/core/basic_stream.hpp>
 #include <boost/container/static_vector.hpp>
 #pragma GCC diagnostic pop
 
@@ -102,19 +107,42 @@ public:
     /// \brief Returns address of remote remote server
     const std::string &get_server_address() const;
 
+    /// \brief Asks remote server to host a new machine alongside the one it already serves
+    /// \param template_handle Handle of a template hosted by the server to instantiate, or 0 for an empty machine
+    /// \param runtime Runtime configuration for the machine instantiated from the template
+    /// \returns New object talking to the hosted machine over a connection of its own
+    /// \details Requests to different hosted machines are served concurrently by the server worker threads.
+    jsonrpc_virtual_machine *new_hosted_machine(uint64_t template_handle,
+        const std::optional<machine_runtime_config> &runtime) const;
+
+    /// \brief Asks remote server to keep a template of the machine, to be instantiated by new_hosted_machine
+    /// \returns Handle of the new template
+    uint64_t new_hosted_template() const;
+
+    /// \brief Asks remote server to delete a template it keeps
+    void delete_hosted_template(uint64_t template_handle) const;
+
+    /// \brief Returns the handle of the hosted machine, or 0 if talking to the machine served by default
+    uint64_t get_hosted_handle() const;
+
 private:
     machine_config do_get_initial_config() const override;
     i_virtual_machine *do_clone_empty() const override;
     bool do_is_empty() const override;
     void do_create(const machine_config &config, const machine_runtime_config &runtime) override;
     void do_load(const std::string &directory, const machine_runtime_config &runtime) override;
+    void do_create_from_template(const machine_template &t, const machine_runtime_config &runtime) override;
+    machine_template *do_create_template() const override;
     interpreter_break_reason do_run(uint64_t mcycle_end) override;
     interpreter_break_reason do_log_step(uint64_t mcycle_count, const std::string &filename) override;
     void do_store(const std::string &dir) const override;
     uint64_t do_read_reg(reg r) const override;
+    std::vector<uint64_t> do_read_regs(const std::vector<reg> &regs) const override;
     void do_write_reg(reg w, uint64_t val) override;
     void do_read_memory(uint64_t address, unsigned char *data, uint64_t length) const override;
     void do_write_memory(uint64_t address, const unsigned char *data, uint64_t length) override;
+    unsigned char *do_get_host_memory(uint64_t address, uint64_t length) override;
+    void do_mark_dirty_memory(uint64_t address, uint64_t length) override;
     void do_read_virtual_memory(uint64_t address, unsigned char *data, uint64_t length) override;
     void do_write_virtual_memory(uint64_t address, const unsigned char *data, uint64_t length) override;
     uint64_t do_translate_virtual_address(uint64_t vaddr) override;
@@ -139,6 +167,8 @@ private:
     machine_config do_get_default_config() const override;
     interpreter_break_reason do_verify_step(const hash_type &root_hash_before, const std::string &log_filename,
         uint64_t mcycle_count, const hash_type &root_hash_after) const override;
+    std::vector<interpreter_break_reason> do_verify_steps(const std::vector<machine::step_log_entry> &entries,
+        bool chained, uint64_t concurrency) const override;
     void do_verify_step_uarch(const hash_type &root_hash_before, const access_log &log,
         const hash_type &root_hash_after) const override;
     void do_verify_reset_uarch(const hash_type &root_hash_before, const access_log &log,
@@ -147,18 +177,37 @@ private:
         const hash_type &root_hash_before, const access_log &log, const hash_type &root_hash_after) const override;
     bool do_is_jsonrpc_virtual_machine() const override;
 
+    /// \brief Constructor that talks to a machine hosted by an existing JSONRPC server
+    jsonrpc_virtual_machine(std::string address, uint64_t hosted_handle);
+
     void check_server_version(std::chrono::time_point<std::chrono::steady_clock> timeout_at) const;
     template <typename R, typename... Ts>
     void request(const std::string &method, const std::tuple<Ts...> &tp, R &result, bool keep_alive = true) const;
     template <typename R, typename... Ts>
     void request(const std::string &method, const std::tuple<Ts...> &tp, R &result,
         std::chrono::time_point<std::chrono::steady_clock> timeout_at, bool keep_alive) const;
+    template <typename R, typename... Ts>
+    void server_request(const std::string &method, const std::tuple<Ts...> &tp, R &result,
+        bool keep_alive = true) const;
+    template <typename R, typename... Ts>
+    void server_request(const std::string &method, const std::tuple<Ts...> &tp, R &result,
+        std::chrono::time_point<std::chrono::steady_clock> timeout_at, bool keep_alive) const;
+    template <typename R, typename... Ts>
+    void batch_request(const std::string &method, const std::vector<std::tuple<Ts...>> &tps,
+        std::vector<R> &results) const;
+    template <typename R, typename... Ts>
+    bool binary_request(const std::string &method, const std::tuple<Ts...> &tp, std::string_view payload, R &result,
+        std::string &reply_payload) const;
 
-    mutable std::unique_ptr<boost::asio::io_context> m_ioc;     // The io_context is required for all I/O
-    mutable std::unique_ptr<boost::beast::tcp_stream> m_stream; // TCP stream for keep alive connections
+    mutable std::unique_ptr<boost::asio::io_context> m_ioc; // The io_context is required for all I/O
+    // TCP or Unix domain socket stream for keep alive connections
+    mutable std::unique_ptr<boost::beast::basic_stream<boost::asio::generic::stream_protocol>> m_stream;
     cleanup_call m_call{cleanup_call::nothing};
     std::string m_address;
+    std::string m_target{"/"}; // Target machine requests are posted to
+    uint64_t m_hosted_handle{0}; // Handle of the hosted machine, or 0 for the machine served by default
     int64_t m_timeout{-1};
+    mutable bool m_binary_transport{true}; // Cleared once the server is found not to serve the binary transport
 };
 
 } // namespace cartesi
@@ -16,6 +16,7 @@
 
 #include "machine-c-api.h"
 
+#include <algorithm>
 #include <any>
 #include <cstdint>
 #include <cstring>
@@ -30,8 +31,10 @@
 #include <system_error>
 #include <typeinfo>
 #include <variant>
+#include <vector>
 
 #include "access-log.h"
+#include "async-run.h"
 #include "htif.h"
 #include "i-virtual-machine.h"
 #include "json-util.h"
@@ -456,6 +459,40 @@ static cm_machine *convert_to_c(cartesi::i_virtual_machine *cpp_m) {
     return reinterpret_cast<cm_machine *>(cpp_m);
 }
 
+static const cartesi::machine_template *convert_from_c(const cm_machine_template *t) {
+    if (t == nullptr) {
+        throw std::invalid_argument("invalid machine template");
+    }
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    return reinterpret_cast<const cartesi::machine_template *>(t);
+}
+
+static cm_machine_template *convert_to_c(cartesi::machine_template *cpp_t) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    return reinterpret_cast<cm_machine_template *>(cpp_t);
+}
+
+static cartesi::async_run *convert_from_c(cm_async_run *run) {
+    if (run == nullptr) {
+        throw std::invalid_argument("invalid async run");
+    }
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    return reinterpret_cast<cartesi::async_run *>(run);
+}
+
+static const cartesi::async_run *convert_from_c(const cm_async_run *run) {
+    if (run == nullptr) {
+        throw std::invalid_argument("invalid async run");
+    }
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    return reinterpret_cast<const cartesi::async_run *>(run);
+}
+
+static cm_async_run *convert_to_c(cartesi::async_run *cpp_run) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    return reinterpret_cast<cm_async_run *>(cpp_run);
+}
+
 static cartesi::machine_merkle_tree::hash_type convert_from_c(const cm_hash *c_hash) {
     if (c_hash == nullptr) {
         throw std::invalid_argument("invalid hash");
@@ -564,6 +601,74 @@ cm_error cm_create_new(const char *config, const char *runtime_config, cm_machin
     return err;
 }
 
+cm_error cm_new_template(const cm_machine *m, cm_machine_template **new_t) try {
+    if (new_t == nullptr) {
+        throw std::invalid_argument("invalid new machine template output");
+    }
+    const auto *cpp_m = convert_from_c(m);
+    *new_t = convert_to_c(cpp_m->create_template());
+    return cm_result_success();
+} catch (...) {
+    if (new_t != nullptr) {
+        *new_t = nullptr;
+    }
+    return cm_result_failure();
+}
+
+void cm_delete_template(cm_machine_template *t) {
+    if (t != nullptr) {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        delete reinterpret_cast<cartesi::machine_template *>(t);
+    }
+}
+
+cm_error cm_create_from_template(cm_machine *m, const cm_machine_template *t, const char *runtime_config) try {
+    auto *cpp_m = convert_from_c(m);
+    const auto *cpp_t = convert_from_c(t);
+    cartesi::machine_runtime_config r;
+    if (runtime_config != nullptr) {
+        r = cartesi::from_json<cartesi::machine_runtime_config>(runtime_config);
+    }
+    cpp_m->create_from_template(*cpp_t, r);
+    return cm_result_success();
+} catch (...) {
+    return cm_result_failure();
+}
+
+cm_error cm_create_new_from_template(const cm_machine_template *t, const char *runtime_config, cm_machine **new_m) {
+    auto err = cm_new(new_m);
+    if (err != 0) {
+        return err;
+    }
+    err = cm_create_from_template(*new_m, t, runtime_config);
+    if (err != 0) {
+        cm_delete(*new_m);
+        *new_m = nullptr;
+    }
+    return err;
+}
+
+cm_error cm_find_divergence(const cm_machine_template *a, const cm_machine_template *b, uint64_t mcycle_begin,
+    uint64_t mcycle_end, const char *runtime_config, uint64_t max_pages, const char **divergence) try {
+    if (divergence == nullptr) {
+        throw std::invalid_argument("invalid divergence output");
+    }
+    const auto *cpp_a = convert_from_c(a);
+    const auto *cpp_b = convert_from_c(b);
+    cartesi::machine_runtime_config r;
+    if (runtime_config != nullptr) {
+        r = cartesi::from_json<cartesi::machine_runtime_config>(runtime_config);
+    }
+    const auto d = cartesi::machine::find_divergence(*cpp_a, *cpp_b, mcycle_begin, mcycle_end, r, max_pages);
+    *divergence = cm_set_temp_string(cartesi::to_json(d).dump());
+    return cm_result_success();
+} catch (...) {
+    if (divergence != nullptr) {
+        *divergence = nullptr;
+    }
+    return cm_result_failure();
+}
+
 cm_error cm_store(const cm_machine *m, const char *dir) try {
     if (dir == nullptr) {
         throw std::invalid_argument("invalid dir");
@@ -589,6 +694,91 @@ cm_error cm_run(cm_machine *m, uint64_t mcycle_end, cm_break_reason *break_reaso
     return cm_result_failure();
 }
 
+cm_error cm_run_async(cm_machine *m, uint64_t mcycle_end, cm_run_async_callback callback, void *context,
+    cm_async_run **new_run) try {
+    if (new_run == nullptr) {
+        throw std::invalid_argument("invalid new async run output");
+    }
+    auto *cpp_m = convert_from_c(m);
+    cartesi::async_run::completion_callback on_completion;
+    if (callback != nullptr) {
+        on_completion = [callback, context](std::exception_ptr error, cartesi::interpreter_break_reason reason,
+                            bool paused) {
+            cm_error err = CM_ERROR_OK;
+            if (error) {
+                try {
+                    std::rethrow_exception(error);
+                } catch (...) {
+                    err = cm_result_failure();
+                }
+            } else {
+                err = cm_result_success();
+            }
+            const auto break_reason = paused ? CM_BREAK_REASON_PAUSED : static_cast<cm_break_reason>(reason);
+            callback(context, err, break_reason);
+        };
+    }
+    *new_run = convert_to_c(new cartesi::async_run(*cpp_m, mcycle_end, std::move(on_completion)));
+    return cm_result_success();
+} catch (...) {
+    if (new_run != nullptr) {
+        *new_run = nullptr;
+    }
+    return cm_result_failure();
+}
+
+cm_error cm_async_run_pause(cm_async_run *run) try {
+    convert_from_c(run)->pause();
+    return cm_result_success();
+} catch (...) {
+    return cm_result_failure();
+}
+
+cm_error cm_async_run_inspect(cm_async_run *run, cm_inspect_callback callback, void *context) try {
+    auto *cpp_run = convert_from_c(run);
+    if (callback == nullptr) {
+        throw std::invalid_argument("invalid inspect callback");
+    }
+    cpp_run->inspect([callback, context](cartesi::i_virtual_machine &m) { callback(context, convert_to_c(&m)); });
+    return cm_result_success();
+} catch (...) {
+    return cm_result_failure();
+}
+
+cm_error cm_async_run_is_done(const cm_async_run *run, bool *done) try {
+    if (done == nullptr) {
+        throw std::invalid_argument("invalid done output");
+    }
+    *done = convert_from_c(run)->is_done();
+    return cm_result_success();
+} catch (...) {
+    if (done != nullptr) {
+        *done = false;
+    }
+    return cm_result_failure();
+}
+
+cm_error cm_async_run_wait(const cm_async_run *run, cm_break_reason *break_reason) try {
+    const auto *cpp_run = convert_from_c(run);
+    const auto status = cpp_run->wait();
+    if (break_reason != nullptr) {
+        *break_reason = cpp_run->was_paused() ? CM_BREAK_REASON_PAUSED : static_cast<cm_break_reason>(status);
+    }
+    return cm_result_success();
+} catch (...) {
+    if (break_reason != nullptr) {
+        *break_reason = CM_BREAK_REASON_FAILED;
+    }
+    return cm_result_failure();
+}
+
+void cm_delete_async_run(cm_async_run *run) {
+    if (run != nullptr) {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        delete reinterpret_cast<cartesi::async_run *>(run);
+    }
+}
+
 cm_error cm_reset_uarch(cm_machine *m) try {
     auto *cpp_m = convert_from_c(m);
     cpp_m->reset_uarch();
@@ -686,6 +876,46 @@ cm_error cm_verify_step(const cm_machine *m, const cm_hash *root_hash_before, co
     return cm_result_failure();
 }
 
+cm_error cm_verify_steps(const cm_machine *m, uint64_t count, const cm_hash *root_hashes_before,
+    const char *const *log_filenames, const uint64_t *mcycle_counts, const cm_hash *root_hashes_after, bool chained,
+    uint64_t concurrency, cm_break_reason *break_reasons) try {
+    if (count > 0 &&
+        (root_hashes_before == nullptr || log_filenames == nullptr || mcycle_counts == nullptr ||
+            root_hashes_after == nullptr)) {
+        throw std::invalid_argument("invalid step log arrays");
+    }
+    std::vector<cartesi::machine::step_log_entry> entries(count);
+    for (uint64_t i = 0; i < count; ++i) {
+        if (log_filenames[i] == nullptr) {
+            throw std::invalid_argument("invalid log_filename");
+        }
+        entries[i].root_hash_before = convert_from_c(&root_hashes_before[i]);
+        entries[i].log_filename = log_filenames[i];
+        entries[i].mcycle_count = mcycle_counts[i];
+        entries[i].root_hash_after = convert_from_c(&root_hashes_after[i]);
+    }
+    std::vector<cartesi::interpreter_break_reason> statuses;
+    if (m != nullptr) {
+        const auto *cpp_m = convert_from_c(m);
+        statuses = cpp_m->verify_steps(entries, chained, concurrency);
+    } else {
+        statuses = cartesi::machine::verify_steps(entries, chained, concurrency);
+    }
+    if (break_reasons != nullptr) {
+        for (uint64_t i = 0; i < count; ++i) {
+            break_reasons[i] = static_cast<cm_break_reason>(statuses[i]);
+        }
+    }
+    return cm_result_success();
+} catch (...) {
+    if (break_reasons != nullptr) {
+        for (uint64_t i = 0; i < count; ++i) {
+            break_reasons[i] = CM_BREAK_REASON_FAILED;
+        }
+    }
+    return cm_result_failure();
+}
+
 cm_error cm_verify_step_uarch(const cm_machine *m, const cm_hash *root_hash_before, const char *log,
     const cm_hash *root_hash_after) try {
     if (log == nullptr) {
@@ -783,6 +1013,29 @@ cm_error cm_read_reg(const cm_machine *m, cm_reg reg, uint64_t *val) try {
     return cm_result_failure();
 }
 
+cm_error cm_read_regs(const cm_machine *m, const cm_reg *regs, uint64_t count, uint64_t *vals) try {
+    if (count > 0 && regs == nullptr) {
+        throw std::invalid_argument("invalid regs");
+    }
+    if (count > 0 && vals == nullptr) {
+        throw std::invalid_argument("invalid vals output");
+    }
+    const auto *cpp_m = convert_from_c(m);
+    std::vector<cartesi::machine_reg> cpp_regs;
+    cpp_regs.reserve(count);
+    for (uint64_t i = 0; i < count; ++i) {
+        cpp_regs.push_back(convert_from_c(regs[i]));
+    }
+    const auto cpp_vals = cpp_m->read_regs(cpp_regs);
+    std::copy(cpp_vals.begin(), cpp_vals.end(), vals);
+    return cm_result_success();
+} catch (...) {
+    if (vals != nullptr) {
+        std::fill_n(vals, count, 0);
+    }
+    return cm_result_failure();
+}
+
 cm_error cm_write_reg(cm_machine *m, cm_reg reg, uint64_t val) try {
     auto *cpp_m = convert_from_c(m);
     auto cpp_reg = convert_from_c(reg);
@@ -841,6 +1094,28 @@ cm_error cm_write_memory(cm_machine *m, uint64_t address, const uint8_t *data, u
     return cm_result_failure();
 }
 
+cm_error cm_get_host_memory(cm_machine *m, uint64_t address, uint64_t length, uint8_t **data) try {
+    if (data == nullptr) {
+        throw std::invalid_argument("invalid data output");
+    }
+    auto *cpp_m = convert_from_c(m);
+    *data = cpp_m->get_host_memory(address, length);
+    return cm_result_success();
+} catch (...) {
+    if (data != nullptr) {
+        *data = nullptr;
+    }
+    return cm_result_failure();
+}
+
+cm_error cm_mark_dirty_memory(cm_machine *m, uint64_t address, uint64_t length) try {
+    auto *cpp_m = convert_from_c(m);
+    cpp_m->mark_dirty_memory(address, length);
+    return cm_result_success();
+} catch (...) {
+    return cm_result_failure();
+}
+
 cm_error cm_read_virtual_memory(cm_machine *m, uint64_t address, uint8_t *data, uint64_t length) try {
     auto *cpp_m = convert_from_c(m);
     cpp_m->read_virtual_memory(address, data, length);
@@ -95,6 +95,7 @@ typedef enum cm_break_reason {
     CM_BREAK_REASON_YIELDED_AUTOMATICALLY,
     CM_BREAK_REASON_YIELDED_SOFTLY,
     CM_BREAK_REASON_REACHED_TARGET_MCYCLE,
+    CM_BREAK_REASON_PAUSED, ///< Only reported by asynchronous runs
 } cm_break_reason;
 
 /// \brief Reasons for the machine to break from call to cm_run_uarch.
@@ -108,6 +109,7 @@ typedef enum cm_uarch_break_reason {
 typedef enum cm_access_log_type {
     CM_ACCESS_LOG_TYPE_ANNOTATIONS = 1, ///< Includes annotations
     CM_ACCESS_LOG_TYPE_LARGE_DATA = 2,  ///< Includes data larger than 8 bytes
+    CM_ACCESS_LOG_TYPE_BINARY = 4,      ///< Serialized as a JSON string with the compact binary format in base64
 } cm_access_log_type;
 
 /// \brief Yield device commands.
@@ -298,6 +300,30 @@ typedef uint8_t cm_hash[CM_HASH_SIZE];
 /// \details It's used only as an opaque handle to pass machine objects through the C API.
 typedef struct cm_machine cm_machine;
 
+/// \brief Machine template object handle.
+/// \details It's used only as an opaque handle to pass machine templates through the C API.
+typedef struct cm_machine_template cm_machine_template;
+
+/// \brief Asynchronous run object handle.
+/// \details It's used only as an opaque handle to pass asynchronous runs through the C API.
+typedef struct cm_async_run cm_async_run;
+
+/// \brief Callback invoked when an asynchronous run completes.
+/// \param context Context pointer given to cm_run_async().
+/// \param error 0 if the run succeeded, non zero code for error.
+/// \param break_reason Reason for the run to complete.
+/// \details It is invoked on the worker thread of the run, where cm_get_last_error_message() returns the error message.
+/// The machine is idle by then, so the callback may access it, or start a new run on it.
+/// It may also delete the run object it reports on, unless that object is already being deleted, or the build has no
+/// thread support.
+typedef void (*cm_run_async_callback)(void *context, cm_error error, cm_break_reason break_reason);
+
+/// \brief Callback invoked with exclusive access to a machine at a safe point of an asynchronous run.
+/// \param context Context pointer given to cm_async_run_inspect().
+/// \param m Pointer to the machine object being run.
+/// \details It must not delete the run object, which the run still uses once the callback returns.
+typedef void (*cm_inspect_callback)(void *context, cm_machine *m);
+
 // -----------------------------------------------------------------------------
 // API functions
 // -----------------------------------------------------------------------------
@@ -420,6 +446,70 @@ CM_API cm_error cm_load(cm_machine *m, const char *dir, const char *runtime_conf
 /// \details See cm_new() and cm_load() for more details.
 CM_API cm_error cm_load_new(const char *dir, const char *runtime_config, cm_machine **new_m);
 
+/// \brief Creates a template holding a snapshot of a machine instance.
+/// \param m Pointer to a non-empty local machine object (holds a machine instance).
+/// \param new_t Receives the pointer to the new template object. Set to NULL on failure.
+/// \returns 0 for success, non zero code for error.
+/// \details The snapshot includes the contents of all memory ranges and the Merkle tree,
+/// so later changes to \p m do not affect the template.
+/// Machines with shared flash drives or cmio buffers cannot be used as templates.
+/// Machines with VirtIO devices can only be used as templates before they run.
+/// Use cm_create_from_template() to instantiate machines from the template.
+/// Use cm_delete_template() to delete the template.
+CM_API cm_error cm_new_template(const cm_machine *m, cm_machine_template **new_t);
+
+/// \brief Deletes a machine template object.
+/// \param t Pointer to the existing template object (can be NULL).
+/// \details Machines previously instantiated from the template remain valid.
+CM_API void cm_delete_template(cm_machine_template *t);
+
+/// \brief Creates a new machine instance from a template.
+/// \param m Pointer to an empty local machine object (does not hold a machine instance).
+/// \param t Pointer to the template object.
+/// \param runtime_config Machine runtime configuration as a JSON object in a string (can be NULL).
+/// \returns 0 for success, non zero code for error.
+/// \details The new instance starts in the exact state of the snapshot held by the template.
+/// All instances share the template memory pages until they write to them (copy-on-write),
+/// and reuse the template Merkle tree instead of rehashing memory.
+/// Use cm_destroy() to destroy the machine instance and remove it from the object.
+CM_API cm_error cm_create_from_template(cm_machine *m, const cm_machine_template *t, const char *runtime_config);
+
+/// \brief Combines cm_new() and cm_create_from_template() for convenience.
+/// \param t Pointer to the template object.
+/// \param runtime_config Machine runtime configuration as a JSON object in a string (can be NULL).
+/// \param new_m Receives the pointer to the new machine object with a machine instance. Set to NULL on failure.
+/// \returns 0 for success, non zero code for error.
+/// \details Use cm_delete() to delete the object.
+/// \details See cm_new() and cm_create_from_template() for more details.
+CM_API cm_error cm_create_new_from_template(const cm_machine_template *t, const char *runtime_config,
+    cm_machine **new_m);
+
+/// \brief Finds the first mcycle at which two machines diverge.
+/// \param a Pointer to the template holding the state of the first machine.
+/// \param b Pointer to the template holding the state of the second machine, at the same mcycle.
+/// \param mcycle_begin First mcycle of the range to search.
+/// \param mcycle_end Last mcycle of the range to search.
+/// \param runtime_config Runtime configuration for the machines run during the search,
+/// as a JSON object in a string (can be NULL).
+/// \param max_pages Maximum number of divergent pages to report.
+/// \param divergence Receives the result as a JSON object in a string, guaranteed to remain valid only until
+/// the next CM_API function is called from the same thread. Set to NULL on failure.
+/// \returns 0 for success, non zero code for error.
+/// \details The result holds "diverged", telling whether the root hashes of both machines differ by mcycle_end,
+/// "mcycle", the first mcycle in the range at which they differ (or where the search ended), "mcycle_a" and
+/// "mcycle_b", the mcycle each machine actually reached when compared, "break_reason_a" and "break_reason_b",
+/// why each machine stopped, "root_hash_a" and "root_hash_b", the root hashes of the compared states, and
+/// "page_addresses", the start of the pages that differ in them.
+/// \details The search bisects the mcycle range, assuming machines that diverged stay diverged.
+/// Machines are resumed after automatic and soft yields. A machine that halts or yields manually before a probed
+/// mcycle is compared where it stopped. If both machines agree until they stop, the search ends there.
+/// Machines are instantiated from the latest states known to agree, which are kept as templates layered over the
+/// previous ones, so each probe only runs from there and each checkpoint only copies the pages it touched.
+/// Since these templates are taken while machines run, machines with VirtIO devices are not supported.
+/// Neither template is modified.
+CM_API cm_error cm_find_divergence(const cm_machine_template *a, const cm_machine_template *b, uint64_t mcycle_begin,
+    uint64_t mcycle_end, const char *runtime_config, uint64_t max_pages, const char **divergence);
+
 /// \brief Stores a machine instance to a directory, serializing its entire state.
 /// \param m Pointer to a non-empty machine object (holds a machine instance).
 /// \param dir Directory where the machine will be stored.
@@ -515,6 +605,15 @@ CM_API cm_error cm_read_word(const cm_machine *m, uint64_t address, uint64_t *va
 /// \returns 0 for success, non zero code for error.
 CM_API cm_error cm_read_reg(const cm_machine *m, cm_reg reg, uint64_t *val);
 
+/// \brief Reads the values of several registers at once.
+/// \param m Pointer to a non-empty machine object (holds a machine instance).
+/// \param regs Array of registers to read.
+/// \param count Number of registers in the array.
+/// \param vals Receives the values, in the same order as the registers.
+/// \returns 0 for success, non zero code for error.
+/// \details Remote machines fetch all values in a single round-trip to the server.
+CM_API cm_error cm_read_regs(const cm_machine *m, const cm_reg *regs, uint64_t count, uint64_t *vals);
+
 /// \brief Writes the value of a register.
 /// \param m Pointer to a non-empty machine object (holds a machine instance).
 /// \param reg Register to write.
@@ -541,6 +640,29 @@ CM_API cm_error cm_read_memory(const cm_machine *m, uint64_t address, uint8_t *d
 /// Moreover, unlike cm_read_memory(), the memory range written to must not be mapped to a device.
 CM_API cm_error cm_write_memory(cm_machine *m, uint64_t address, const uint8_t *data, uint64_t length);
 
+/// \brief Obtains a pointer to the host memory backing a chunk of a machine memory range, by its physical address.
+/// \param m Pointer to a non-empty machine object (holds a machine instance).
+/// \param address Physical address of the start of the chunk.
+/// \param length Size of chunk in bytes.
+/// \param data Receives the pointer to the chunk. Set to NULL on failure.
+/// \returns 0 for success, non zero code for error.
+/// \details The entire chunk must be inside the same memory range, which must not be mapped to a device.
+/// The chunk can be read and written directly through the pointer, without intermediate copies.
+/// After writing, cm_mark_dirty_memory() must be called on the modified chunk before the machine
+/// runs or its state is hashed, logged, stored, or used as a template.
+/// The pointer remains valid until the memory range is replaced or the machine is destroyed.
+/// Only supported by local machines.
+CM_API cm_error cm_get_host_memory(cm_machine *m, uint64_t address, uint64_t length, uint8_t **data);
+
+/// \brief Marks a chunk of a machine memory range as modified, by its physical address.
+/// \param m Pointer to a non-empty machine object (holds a machine instance).
+/// \param address Physical address of the start of the chunk.
+/// \param length Size of chunk in bytes.
+/// \returns 0 for success, non zero code for error.
+/// \details Must be called after writing to a chunk through a pointer obtained from cm_get_host_memory().
+/// The entire chunk must be inside the same memory range, which must not be mapped to a device.
+CM_API cm_error cm_mark_dirty_memory(cm_machine *m, uint64_t address, uint64_t length);
+
 /// \brief Reads a chunk of data from a machine memory range, by its virtual address.
 /// \param m Pointer to a non-empty machine object (holds a machine instance).
 /// \param address Virtual address to start reading.
@@ -579,6 +701,57 @@ CM_API cm_error cm_translate_virtual_address(cm_machine *m, uint64_t vaddr, uint
 /// \details You may want to receive cmio requests depending on the run break reason.
 CM_API cm_error cm_run(cm_machine *m, uint64_t mcycle_end, cm_break_reason *break_reason);
 
+/// \brief Starts running the machine on a worker thread, as cm_run() would.
+/// \param m Pointer to a non-empty machine object (holds a machine instance).
+/// \param mcycle_end End cycle value.
+/// \param callback Callback invoked when the run completes (can be NULL).
+/// \param context Context pointer passed to the callback.
+/// \param new_run Receives the pointer to the new run object. Set to NULL on failure.
+/// \returns 0 for success, non zero code for error.
+/// \details The worker advances the machine in slices of a bounded number of cycles.
+/// Between slices, the machine is at a safe point, where pause requests and inspections are serviced.
+/// Until the run completes, the machine must not be accessed other than from inspection callbacks.
+/// Use cm_delete_async_run() to delete the run object before deleting the machine object.
+/// Builds without thread support have no worker thread, so the run, including the callback, happens the first time the
+/// run object is checked, waited on, or deleted.
+CM_API cm_error cm_run_async(cm_machine *m, uint64_t mcycle_end, cm_run_async_callback callback, void *context,
+    cm_async_run **new_run);
+
+/// \brief Asks an asynchronous run to stop at its next safe point.
+/// \param run Pointer to the run object.
+/// \returns 0 for success, non zero code for error.
+/// \details The run then completes with CM_BREAK_REASON_PAUSED and can be continued by starting another run.
+CM_API cm_error cm_async_run_pause(cm_async_run *run);
+
+/// \brief Queues a callback to be invoked with exclusive access to the machine of an asynchronous run.
+/// \param run Pointer to the run object.
+/// \param callback Callback to invoke.
+/// \param context Context pointer passed to the callback.
+/// \returns 0 for success, non zero code for error.
+/// \details The callback is invoked on the worker thread at the next safe point, without stopping the run.
+/// Its changes to the machine state are seen by the rest of the run.
+/// If the run has already completed, the callback is invoked immediately on the calling thread.
+CM_API cm_error cm_async_run_inspect(cm_async_run *run, cm_inspect_callback callback, void *context);
+
+/// \brief Checks whether an asynchronous run has completed, without blocking.
+/// \param run Pointer to the run object.
+/// \param done Receives true if the run has completed, false otherwise.
+/// \returns 0 for success, non zero code for error.
+CM_API cm_error cm_async_run_is_done(const cm_async_run *run, bool *done);
+
+/// \brief Waits for an asynchronous run to complete.
+/// \param run Pointer to the run object.
+/// \param break_reason Receives reason for the run to complete (can be NULL). Set to CM_BREAK_REASON_FAILED on failure.
+/// \returns 0 for success, or the error code that stopped the run.
+/// \details The error message is also available through cm_get_last_error_message() on the calling thread.
+CM_API cm_error cm_async_run_wait(const cm_async_run *run, cm_break_reason *break_reason);
+
+/// \brief Deletes an asynchronous run object.
+/// \param run Pointer to the run object (can be NULL).
+/// \details Pauses the run and waits for it to complete, unless called from its own completion callback.
+/// Must not be called from an inspection callback of the run.
+CM_API void cm_delete_async_run(cm_async_run *run);
+
 /// \brief Runs the machine microarchitecture until CM_REG_UARCH_CYCLE reaches uarch_cycle_end or it halts.
 /// \param m Pointer to a non-empty machine object (holds a machine instance).
 /// \param uarch_cycle_end End micro cycle value.
@@ -673,6 +846,23 @@ CM_API cm_error cm_log_send_cmio_response(cm_machine *m, uint16_t reason, const
 CM_API cm_error cm_verify_step(const cm_machine *m, const cm_hash *root_hash_before, const char *log_filename,
     uint64_t mcycle_count, const cm_hash *root_hash_after, cm_break_reason *break_reason);
 
+/// \brief Checks the validity of many step log files, in parallel.
+/// \param m Pointer to a machine object. Can be NULL (for local machines).
+/// \param count Number of step logs.
+/// \param root_hashes_before Array with the state hash before each step.
+/// \param log_filenames Array with the path to each step log file.
+/// \param mcycle_counts Array with the number of mcycles in each step.
+/// \param root_hashes_after Array with the state hash after each step.
+/// \param chained If true, each step must start at the state hash where the previous step ended.
+/// \param concurrency Maximum number of threads to use (0 for the number of hardware threads).
+/// \param break_reasons Array that receives the reason for returning of each step (can be NULL).
+/// \returns 0 for success, non zero code for error.
+/// \details Fails if any of the steps is invalid, and the error message identifies the first one that failed.
+/// Remote machines check the steps one at a time.
+CM_API cm_error cm_verify_steps(const cm_machine *m, uint64_t count, const cm_hash *root_hashes_before,
+    const char *const *log_filenames, const uint64_t *mcycle_counts, const cm_hash *root_hashes_after, bool chained,
+    uint64_t concurrency, cm_break_reason *break_reasons);
+
 /// \brief Checks the validity of a state transition produced by cm_log_step_uarch.
 /// \param m Pointer to a machine object. Can be NULL (for local machines).
 /// \param root_hash_before State hash before step.
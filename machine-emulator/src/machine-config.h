@@ -162,11 +162,23 @@ struct virtio_net_tuntap_config final {
     std::string iface; ///< Host's tap network interface (e.g "tap0")
 };
 
+/// \brief VirtIO memory balloon device state config
+struct virtio_balloon_config final {};
+
+/// \brief VirtIO block device state config
+struct virtio_blk_config final {
+    std::string image_filename; ///< Path to the host disk image file
+    bool read_only{false};      ///< Whether the guest cannot write to the disk
+    bool discard{false};        ///< Whether discarded sectors release host file space
+};
+
 /// \brief VirtIO device state config
 using virtio_device_config = std::variant<virtio_console_config, ///< Console
     virtio_p9fs_config,                                          ///< Plan 9 filesystem
     virtio_net_user_config,                                      ///< User-mode networking
-    virtio_net_tuntap_config                                     ///< TUN/TAP networking
+    virtio_net_tuntap_config,                                    ///< TUN/TAP networking
+    virtio_balloon_config,                                       ///< Memory balloon (free page reporting)
+    virtio_blk_config                                            ///< Block device
     >;
 
 /// \brief List of VirtIO devices
@@ -200,6 +200,37 @@ void machine_merkle_tree::destroy_merkle_tree() {
     memset(&m_root_storage, 0, sizeof(m_root_storage));
 }
 
+machine_merkle_tree::tree_node *machine_merkle_tree::copy_merkle_tree(const tree_node *node, tree_node *parent,
+    address_type address, int log2_size) {
+    if (node == nullptr) {
+        return nullptr;
+    }
+    tree_node *copy = create_node();
+    copy->hash = node->hash;
+    copy->parent = parent;
+    // If this is an inner node, copy children recursively
+    if (log2_size > get_log2_page_size()) {
+        const int log2_child_size = log2_size - 1;
+        copy->child[0] = copy_merkle_tree(node->child[0], copy, address, log2_child_size);
+        copy->child[1] =
+            copy_merkle_tree(node->child[1], copy, address + (UINT64_C(1) << log2_child_size), log2_child_size);
+    } else {
+        set_page_node_map(address, copy);
+    }
+    return copy;
+}
+
+void machine_merkle_tree::copy_from(const machine_merkle_tree &other) {
+    destroy_merkle_tree();
+    m_page_node_map.clear();
+    m_page_node_map.reserve(other.m_page_node_map.size());
+    m_root->hash = other.m_root->hash;
+    const int log2_child_size = get_log2_root_size() - 1;
+    m_root->child[0] = copy_merkle_tree(other.m_root->child[0], m_root, 0, log2_child_size);
+    m_root->child[1] =
+        copy_merkle_tree(other.m_root->child[1], m_root, UINT64_C(1) << log2_child_size, log2_child_size);
+}
+
 void machine_merkle_tree::get_inside_page_sibling_hashes(hasher_type &h, address_type address, int log2_size,
     hash_type &hash, const unsigned char *curr_data, int log2_curr_size, hash_type &curr_hash, int parent_diverged,
     int curr_diverged, proof_type &proof) const {
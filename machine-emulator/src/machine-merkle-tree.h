@@ -212,6 +212,14 @@ private:
     /// \brief Destroys entire Merkle tree.
     void destroy_merkle_tree();
 
+    /// \brief Copies tree rooted at node.
+    /// \param node Root of subtree to copy.
+    /// \param parent Parent of the copy.
+    /// \param address Address of first byte subintended by \p node.
+    /// \param log2_size log<sub>2</sub> of size subintended by \p node.
+    /// \returns Root of copy, or nullptr if \p node is nullptr.
+    tree_node *copy_merkle_tree(const tree_node *node, tree_node *parent, address_type address, int log2_size);
+
     /// \brief Verifies tree rooted at node.
     /// \param h Hasher object.
     /// \param node Root of subtree.
@@ -301,6 +309,11 @@ public:
     /// \details Releases all used memory
     ~machine_merkle_tree();
 
+    /// \brief Replaces the entire tree with a copy of another tree.
+    /// \param other Tree to copy from.
+    /// \details Only the nodes are copied, no hashes are recomputed.
+    void copy_from(const machine_merkle_tree &other);
+
     /// \brief Returns the root hash.
     /// \param hash Receives the hash.
     void get_root_hash(hash_type &hash) const;
@@ -27,6 +27,7 @@ namespace cartesi {
 /// \brief Concurrency runtime configuration
 struct concurrency_runtime_config {
     uint64_t update_merkle_tree{};
+    uint64_t store_pmas{}; ///< Threads writing memory images when storing a machine (0 for all hardware threads)
 };
 
 /// \brief HTIF runtime configuration
@@ -42,6 +43,8 @@ struct machine_runtime_config {
     bool skip_root_hash_store{};
     bool skip_version_check{};
     bool soft_yield{};
+    bool huge_pages{};  ///< Back RAM and flash drives with huge pages, when the host has them
+    bool share_pages{}; ///< Share identical RAM and flash drive pages with other machines in the process at creation
 };
 
 /// \brief CONCURRENCY constants
@@ -0,0 +1,171 @@
+// Copyright Cartesi and individual authors (see AUTHORS)
+// SPDX-License-Identifier: LGPL-3.0-or-later
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any
+// later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License along
+// with this program (see COPYING). If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "machine-template.h"
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "is-pristine.h"
+#include "machine.h"
+#include "os.h"
+#include "pma-constants.h"
+#include "unique-c-ptr.h"
+
+namespace cartesi {
+
+using namespace std::string_literals;
+
+void machine_template::copy_state(const machine &m) {
+    if (!m.m_c.virtio.empty() && m.read_reg(machine_reg::mcycle) != m.m_c.processor.mcycle) {
+        throw std::invalid_argument{"cannot create template from machine with virtio devices that already ran"};
+    }
+    for (const auto &f : m.m_c.flash_drive) {
+        if (f.shared) {
+            throw std::invalid_argument{"cannot create template from machine with shared flash drives"};
+        }
+    }
+    if (m.m_c.cmio.rx_buffer.shared || m.m_c.cmio.tx_buffer.shared) {
+        throw std::invalid_argument{"cannot create template from machine with shared cmio buffers"};
+    }
+    m_c = m.get_current_config();
+    // VirtIO devices that did not run are fully described by the config, so they are left out of the Merkle tree
+    if (!m.update_merkle_tree(!m.m_c.virtio.empty())) {
+        throw std::runtime_error{"error updating Merkle tree"};
+    }
+    m_t.copy_from(m.m_t);
+}
+
+void machine_template::copy_tlb_image(const machine &m) {
+    // Copy contents of TLB device, which holds host-independent entries
+    const pma_entry &tlb = m.find_pma_entry<uint64_t>(PMA_SHADOW_TLB_START);
+    auto scratch = unique_calloc<unsigned char>(PMA_PAGE_SIZE);
+    m_tlb_image.resize(tlb.get_length());
+    for (uint64_t offset = 0; offset < tlb.get_length(); offset += PMA_PAGE_SIZE) {
+        const unsigned char *page_data = nullptr;
+        if (!tlb.get_peek()(tlb, m, offset, &page_data, scratch.get())) {
+            throw std::runtime_error{"peek failed"};
+        }
+        if (page_data != nullptr) {
+            memcpy(m_tlb_image.data() + offset, page_data, PMA_PAGE_SIZE);
+        }
+    }
+}
+
+machine_template::machine_template(const machine &m) {
+    copy_state(m);
+    try {
+        // Copy contents of all memory ranges into memory files, skipping pristine pages so files stay sparse
+        for (const auto *pma : m.m_merkle_pmas) {
+            if (!pma->get_istart_M() || pma->get_length() == 0) {
+                continue;
+            }
+            const int fd = os_create_memory_file(pma->get_description().c_str(), pma->get_length());
+            m_images.push_back(memory_image{.start = pma->get_start(), .length = pma->get_length(), .fd = fd});
+            unsigned char *dest = os_map_fd(fd, pma->get_length(), true);
+            const unsigned char *src = pma->get_memory().get_host_memory();
+            for (uint64_t offset = 0; offset < pma->get_length(); offset += PMA_PAGE_SIZE) {
+                if (!is_pristine(src + offset, PMA_PAGE_SIZE)) {
+                    memcpy(dest + offset, src + offset, PMA_PAGE_SIZE);
+                }
+            }
+            os_unmap_file(dest, pma->get_length());
+        }
+        copy_tlb_image(m);
+    } catch (...) {
+        release();
+        throw;
+    }
+}
+
+/// \brief Collects the pages in a memory range whose hashes differ between two Merkle trees
+/// \param t First Merkle tree
+/// \param base_t Second Merkle tree
+/// \param start Start of memory range
+/// \param length Length of memory range
+/// \param address Start of Merkle tree node to compare
+/// \param log2_size Log2 of size of node
+/// \param pages Receives the start of each page that differs
+static void collect_changed_pages(const machine_merkle_tree &t, const machine_merkle_tree &base_t, uint64_t start,
+    uint64_t length, uint64_t address, int log2_size, std::vector<uint64_t> &pages) {
+    const uint64_t last = address +
+        (log2_size < machine_merkle_tree::get_log2_root_size() ? (UINT64_C(1) << log2_size) - 1 : UINT64_MAX);
+    if (last < start || address >= start + length ||
+        t.get_node_hash(address, log2_size) == base_t.get_node_hash(address, log2_size)) {
+        return;
+    }
+    if (log2_size == machine_merkle_tree::get_log2_page_size()) {
+        pages.push_back(address);
+        return;
+    }
+    collect_changed_pages(t, base_t, start, length, address, log2_size - 1, pages);
+    collect_changed_pages(t, base_t, start, length, address + (UINT64_C(1) << (log2_size - 1)), log2_size - 1,
+        pages);
+}
+
+machine_template::machine_template(const machine &m, const machine_template &base) {
+    copy_state(m);
+    m_pages = base.m_pages;
+    try {
+        // Share the memory files of the base template, and copy only the pages that differ from its contents,
+        // which are found by descending both Merkle trees through the nodes whose hashes differ
+        for (const auto *pma : m.m_merkle_pmas) {
+            if (!pma->get_istart_M() || pma->get_length() == 0) {
+                continue;
+            }
+            const auto i = m_images.size();
+            if (i >= base.m_images.size() || base.m_images[i].start != pma->get_start() ||
+                base.m_images[i].length != pma->get_length()) {
+                throw std::invalid_argument{"machine does not match memory ranges of base template"};
+            }
+            const auto &image = base.m_images[i];
+            m_images.push_back(memory_image{.start = image.start, .length = image.length, .fd = os_dup_fd(image.fd)});
+            std::vector<uint64_t> pages;
+            collect_changed_pages(m.m_t, base.m_t, image.start, image.length, 0,
+                machine_merkle_tree::get_log2_root_size(), pages);
+            const unsigned char *src = pma->get_memory().get_host_memory();
+            for (const auto address : pages) {
+                auto data = std::make_shared<page_data>();
+                memcpy(data->data(), src + (address - image.start), data->size());
+                m_pages.insert_or_assign(address, std::move(data));
+            }
+        }
+        if (m_images.size() != base.m_images.size()) {
+            throw std::invalid_argument{"machine does not match memory ranges of base template"};
+        }
+        copy_tlb_image(m);
+    } catch (...) {
+        release();
+        throw;
+    }
+}
+
+machine_template::~machine_template() {
+    release();
+}
+
+void machine_template::release() {
+    for (const auto &image : m_images) {
+        os_close_fd(image.fd);
+    }
+    m_images.clear();
+}
+
+} // namespace cartesi
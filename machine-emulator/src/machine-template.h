@@ -0,0 +1,128 @@
+// Copyright Cartesi and individual authors (see AUTHORS)
+// SPDX-License-Identifier: LGPL-3.0-or-later
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any
+// later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License along
+// with this program (see COPYING). If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef MACHINE_TEMPLATE_H
+#define MACHINE_TEMPLATE_H
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "machine-config.h"
+#include "machine-merkle-tree.h"
+#include "pma-constants.h"
+
+/// \file
+/// \brief Machine template interface
+
+namespace cartesi {
+
+// Forward declarations
+class machine;
+
+/// \class machine_template
+/// \brief Frozen snapshot of a machine, from which any number of machines can be instantiated cheaply.
+/// \details The contents of each memory range are kept in an anonymous memory file.
+/// Machines instantiated from the template map these files privately, so all of them
+/// share the same host pages until they write to them (copy-on-write).
+/// The Merkle tree of the snapshot is also kept, so instances do not have to rehash memory.
+/// A template can also be layered over another one. It then shares the memory files of the other template,
+/// and keeps copies of only the pages whose contents differ from them.
+class machine_template final {
+public:
+    /// \brief Snapshot of a memory range
+    struct memory_image {
+        uint64_t start;  ///< Start of memory range
+        uint64_t length; ///< Length of memory range
+        int fd;          ///< Anonymous memory file holding contents of memory range
+    };
+
+    /// \brief Contents of a page
+    using page_data = std::array<unsigned char, PMA_PAGE_SIZE>;
+
+    /// \brief Pages whose contents differ from the memory images, by address
+    /// \details Page contents are immutable, so layered templates share them.
+    using page_images = std::map<uint64_t, std::shared_ptr<const page_data>>;
+
+    /// \brief Constructor from existing machine
+    /// \param m Machine to take snapshot from
+    /// \details Later modifications to \p m do not affect the template.
+    explicit machine_template(const machine &m);
+
+    /// \brief Constructor from existing machine, layered over another template
+    /// \param m Machine to take snapshot from, typically instantiated from \p base
+    /// \param base Template to layer the snapshot over, with the same memory ranges as \p m
+    /// \details Memory files are shared with \p base, and only pages whose hashes differ from those in the
+    /// Merkle tree of \p base are copied. For a machine instantiated from \p base, the cost is therefore
+    /// proportional to the pages it touched, rather than to the size of its memory.
+    /// Later modifications to \p m do not affect the template, and \p base can be destroyed before it.
+    machine_template(const machine &m, const machine_template &base);
+
+    /// \brief Destructor
+    ~machine_template();
+
+    machine_template(const machine_template &other) = delete;
+    machine_template(machine_template &&other) = delete;
+    machine_template &operator=(const machine_template &other) = delete;
+    machine_template &operator=(machine_template &&other) = delete;
+
+    /// \brief Returns the configuration holding the processor and device state of the snapshot
+    const machine_config &get_config() const {
+        return m_c;
+    }
+
+    /// \brief Returns the snapshots of all memory ranges
+    const std::vector<memory_image> &get_memory_images() const {
+        return m_images;
+    }
+
+    /// \brief Returns the pages whose contents differ from the snapshots of their memory ranges
+    const page_images &get_page_images() const {
+        return m_pages;
+    }
+
+    /// \brief Returns the contents of the shadow TLB device
+    const std::vector<unsigned char> &get_tlb_image() const {
+        return m_tlb_image;
+    }
+
+    /// \brief Returns the Merkle tree of the snapshot
+    const machine_merkle_tree &get_merkle_tree() const {
+        return m_t;
+    }
+
+private:
+    /// \brief Takes the processor and device state and the Merkle tree from a machine
+    void copy_state(const machine &m);
+
+    /// \brief Copies the contents of the shadow TLB device from a machine
+    void copy_tlb_image(const machine &m);
+
+    /// \brief Closes all memory files
+    void release();
+
+    machine_config m_c;                     ///< Processor and device state
+    std::vector<memory_image> m_images;     ///< Memory range snapshots
+    page_images m_pages;                    ///< Pages that differ from memory range snapshots
+    std::vector<unsigned char> m_tlb_image; ///< Shadow TLB contents
+    machine_merkle_tree m_t;                ///< Merkle tree
+};
+
+} // namespace cartesi
+
+#endif
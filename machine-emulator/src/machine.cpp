@@ -17,11 +17,15 @@
 #include "machine.h"
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cerrno>
 #include <cinttypes>
 #include <cstdint>
 #include <cstdio>
 #include <cstring>
+#include <exception>
+#include <filesystem>
 #include <iomanip>
 #include <iostream>
 #include <memory>
@@ -47,6 +51,7 @@
 #include "machine-memory-range-descr.h"
 #include "machine-runtime-config.h"
 #include "os.h"
+#include "page-store.h"
 #include "plic-factory.h"
 #include "pma-constants.h"
 #include "pma-defines.h"
@@ -56,6 +61,7 @@
 #include "replay-send-cmio-state-access.h"
 #include "replay-step-state-access.h"
 #include "riscv-constants.h"
+#include "scope-exit.h"
 #include "send-cmio-response.h"
 #include "shadow-pmas-factory.h"
 #include "shadow-state-factory.h"
@@ -74,6 +80,8 @@
 #include "uarch-state-access.h"
 #include "uarch-step.h"
 #include "unique-c-ptr.h"
+#include "virtio-balloon.h"
+#include "virtio-blk.h"
 #include "virtio-console.h"
 #include "virtio-device.h"
 #include "virtio-factory.h"
@@ -127,15 +135,17 @@ const pma_entry::flags machine::m_cmio_tx_buffer_flags{.R = true,
     .IW = true,
     .DID = PMA_ISTART_DID::cmio_tx_buffer};
 
-pma_entry machine::make_memory_range_pma_entry(const std::string &description, const memory_range_config &c) {
+pma_entry machine::make_memory_range_pma_entry(const std::string &description, const memory_range_config &c,
+    bool huge_pages) {
     if (c.image_filename.empty()) {
-        return make_callocd_memory_pma_entry(description, c.start, c.length);
+        return make_anonymous_memory_pma_entry(description, c.start, c.length, huge_pages);
     }
-    return make_mmapd_memory_pma_entry(description, c.start, c.length, c.image_filename, c.shared);
+    return make_mmapd_memory_pma_entry(description, c.start, c.length, c.image_filename, c.shared, huge_pages);
 }
 
-pma_entry machine::make_flash_drive_pma_entry(const std::string &description, const memory_range_config &c) {
-    return make_memory_range_pma_entry(description, c).set_flags(m_flash_drive_flags);
+pma_entry machine::make_flash_drive_pma_entry(const std::string &description, const memory_range_config &c,
+    bool huge_pages) {
+    return make_memory_range_pma_entry(description, c, huge_pages).set_flags(m_flash_drive_flags);
 }
 
 pma_entry machine::make_cmio_rx_buffer_pma_entry(const cmio_config &c) {
@@ -160,6 +170,29 @@ pma_entry machine::make_cmio_tx_buffer_pma_entry(const cmio_config &c) {
         .set_flags(m_cmio_tx_buffer_flags);
 }
 
+pma_entry machine::make_template_memory_pma_entry(const machine_template &t, const std::string &description,
+    uint64_t start, uint64_t length) {
+    for (const auto &image : t.get_memory_images()) {
+        if (image.start == start && image.length == length) {
+            auto pma = make_mmapd_memory_pma_entry(description, start, length, image.fd, false);
+            // Contents are identical to the template, and so are the hashes in its Merkle tree
+            pma.mark_pages_clean();
+            return pma;
+        }
+    }
+    throw std::runtime_error{"machine template does not match memory ranges"};
+}
+
+/// \brief Returns the uarch configuration to construct a machine with
+/// \details Machines instantiated from a template take uarch RAM contents from the template, not from an image.
+static uarch_config get_uarch_config(const machine_config &c, const machine_template *t) {
+    uarch_config uc = c.uarch;
+    if (t != nullptr) {
+        uc.ram.image_filename.clear();
+    }
+    return uc;
+}
+
 pma_entry &machine::register_pma_entry(pma_entry &&pma) {
     if (decltype(m_s.pmas)::capacity() <= m_s.pmas.size()) {
         throw std::runtime_error{"too many PMAs when adding "s + pma.get_description()};
@@ -216,7 +249,10 @@ void machine::replace_memory_range(const memory_range_config &range) {
                 throw std::invalid_argument{"attempt to replace a protected range "s + pma.get_description()};
             }
             // replace range preserving original flags
-            pma = make_memory_range_pma_entry(pma.get_description(), range).set_flags(pma.get_flags());
+            pma = make_memory_range_pma_entry(pma.get_description(), range, m_r.huge_pages)
+                      .set_flags(pma.get_flags());
+            // The Merkle tree still holds the hashes of the old contents, so every page must be rehashed
+            pma.mark_dirty_pages(pma.get_start(), pma.get_length());
             return;
         }
     }
@@ -224,7 +260,7 @@ void machine::replace_memory_range(const memory_range_config &range) {
 }
 
 template <TLB_entry_type ETYPE>
-static void load_tlb_entry(machine &m, uint64_t eidx, unsigned char *hmem) {
+static void load_tlb_entry(machine &m, uint64_t eidx, const unsigned char *hmem) {
     tlb_hot_entry &tlbhe = m.get_state().tlb.hot[ETYPE][eidx];
     tlb_cold_entry &tlbce = m.get_state().tlb.cold[ETYPE][eidx];
     auto vaddr_page = aliased_aligned_read<uint64_t>(hmem + tlb_get_vaddr_page_rel_addr<ETYPE>(eidx));
@@ -267,7 +303,12 @@ static void init_tlb_entry(machine &m, uint64_t eidx) {
     tlbce.pma_index = TLB_INVALID_PMA;
 }
 
-machine::machine(const machine_config &c, const machine_runtime_config &r) : m_c{c}, m_uarch{c.uarch}, m_r{r} {
+machine::machine(const machine_config &c, const machine_runtime_config &r) : machine{c, r, nullptr} {}
+
+machine::machine(const machine_config &c, const machine_runtime_config &r, const machine_template *t) :
+    m_c{c},
+    m_uarch{get_uarch_config(c, t)},
+    m_r{r} {
 
     if (m_c.processor.marchid == UINT64_C(-1)) {
         m_c.processor.marchid = MARCHID_INIT;
@@ -339,18 +380,29 @@ machine::machine(const machine_config &c, const machine_runtime_config &r) : m_c
     write_reg(reg::iunrep, m_c.processor.iunrep);
 
     // Register RAM
-    if (m_c.ram.image_filename.empty()) {
-        register_pma_entry(make_callocd_memory_pma_entry("RAM"s, PMA_RAM_START, m_c.ram.length).set_flags(m_ram_flags));
+    if (t != nullptr) {
+        register_pma_entry(
+            make_template_memory_pma_entry(*t, "RAM"s, PMA_RAM_START, m_c.ram.length).set_flags(m_ram_flags));
     } else {
-        register_pma_entry(make_callocd_memory_pma_entry("RAM"s, PMA_RAM_START, m_c.ram.length, m_c.ram.image_filename)
+        register_pma_entry(make_anonymous_memory_pma_entry("RAM"s, PMA_RAM_START, m_c.ram.length,
+            m_c.ram.image_filename, m_r.huge_pages)
                 .set_flags(m_ram_flags));
     }
 
     // Register DTB
-    pma_entry &dtb = register_pma_entry((m_c.dtb.image_filename.empty() ?
-            make_callocd_memory_pma_entry("DTB"s, PMA_DTB_START, PMA_DTB_LENGTH) :
-            make_callocd_memory_pma_entry("DTB"s, PMA_DTB_START, PMA_DTB_LENGTH, m_c.dtb.image_filename))
-            .set_flags(m_dtb_flags));
+    if (t != nullptr) {
+        register_pma_entry(
+            make_template_memory_pma_entry(*t, "DTB"s, PMA_DTB_START, PMA_DTB_LENGTH).set_flags(m_dtb_flags));
+    } else {
+        pma_entry &dtb = register_pma_entry((m_c.dtb.image_filename.empty() ?
+                make_callocd_memory_pma_entry("DTB"s, PMA_DTB_START, PMA_DTB_LENGTH) :
+                make_callocd_memory_pma_entry("DTB"s, PMA_DTB_START, PMA_DTB_LENGTH, m_c.dtb.image_filename))
+                .set_flags(m_dtb_flags));
+        if (m_c.dtb.image_filename.empty()) {
+            // Write the FDT (flattened device tree) into DTB
+            dtb_init(m_c, dtb.get_memory().get_host_memory(), PMA_DTB_LENGTH);
+        }
+    }
 
     // Register all flash drives
     int i = 0; // NOLINT(misc-const-correctness)
@@ -376,13 +428,27 @@ machine::machine(const machine_config &c, const machine_runtime_config &r) : m_c
             }
             f.length = length;
         }
-        register_pma_entry(make_flash_drive_pma_entry(flash_description, f));
+        if (t != nullptr) {
+            register_pma_entry(make_template_memory_pma_entry(*t, flash_description, f.start, f.length)
+                    .set_flags(m_flash_drive_flags));
+        } else {
+            register_pma_entry(make_flash_drive_pma_entry(flash_description, f, m_r.huge_pages));
+        }
         i++;
     }
 
     // Register cmio memory ranges
-    register_pma_entry(make_cmio_tx_buffer_pma_entry(m_c.cmio));
-    register_pma_entry(make_cmio_rx_buffer_pma_entry(m_c.cmio));
+    if (t != nullptr) {
+        register_pma_entry(make_template_memory_pma_entry(*t, "cmio tx buffer memory range"s,
+            PMA_CMIO_TX_BUFFER_START, PMA_CMIO_TX_BUFFER_LENGTH)
+                .set_flags(m_cmio_tx_buffer_flags));
+        register_pma_entry(make_template_memory_pma_entry(*t, "cmio rx buffer memory range"s,
+            PMA_CMIO_RX_BUFFER_START, PMA_CMIO_RX_BUFFER_LENGTH)
+                .set_flags(m_cmio_rx_buffer_flags));
+    } else {
+        register_pma_entry(make_cmio_tx_buffer_pma_entry(m_c.cmio));
+        register_pma_entry(make_cmio_rx_buffer_pma_entry(m_c.cmio));
+    }
 
     // Register HTIF device
     register_pma_entry(make_htif_pma_entry(PMA_HTIF_START, PMA_HTIF_LENGTH));
@@ -467,6 +533,16 @@ machine::machine(const machine_config &c, const machine_runtime_config &r) : m_c
 #else
 
                         throw std::invalid_argument("virtio network TUN/TAP device is unsupported in this platform");
+#endif
+                    } else if constexpr (std::is_same_v<T, cartesi::virtio_balloon_config>) {
+                        pma_name = "VirtIO Balloon";
+                        vdev = std::make_unique<virtio_balloon>(m_vdevs.size());
+                    } else if constexpr (std::is_same_v<T, cartesi::virtio_blk_config>) {
+#ifdef HAVE_VIRTIO_BLK
+                        pma_name = "VirtIO Block";
+                        vdev = std::make_unique<virtio_blk>(m_vdevs.size(), vdev_config);
+#else
+                        throw std::invalid_argument("virtio block device is unsupported in this platform");
 #endif
                     } else {
                         throw std::invalid_argument("invalid virtio device configuration");
@@ -480,12 +556,6 @@ machine::machine(const machine_config &c, const machine_runtime_config &r) : m_c
         }
     }
 
-    // Initialize DTB
-    if (m_c.dtb.image_filename.empty()) {
-        // Write the FDT (flattened device tree) into DTB
-        dtb_init(m_c, dtb.get_memory().get_host_memory(), PMA_DTB_LENGTH);
-    }
-
     // Include machine PMAs in set considered by the Merkle tree.
     for (auto &pma : m_s.pmas) {
         m_merkle_pmas.push_back(&pma);
@@ -505,6 +575,16 @@ machine::machine(const machine_config &c, const machine_runtime_config &r) : m_c
     // Populate shadow PMAs
     populate_shadow_pmas_state(m_s.pmas, shadow_pmas);
 
+    // Replace uarch RAM with the template snapshot
+    if (t != nullptr) {
+        pma_entry &uarch_ram = m_uarch.get_state().ram;
+        const int index = uarch_ram.get_index();
+        uarch_ram = make_template_memory_pma_entry(*t, uarch_ram.get_description(), uarch_ram.get_start(),
+            uarch_ram.get_length())
+                        .set_flags(uarch_ram.get_flags());
+        uarch_ram.set_index(index);
+    }
+
     // Include uarch PMAs in set considered by Merkle tree
     m_merkle_pmas.push_back(&m_uarch.get_state().shadow_state);
     m_merkle_pmas.push_back(&m_uarch.get_state().ram);
@@ -513,7 +593,14 @@ machine::machine(const machine_config &c, const machine_runtime_config &r) : m_c
 
     // Initialize TLB device
     // this must be done after all PMA entries are already registered, so we can lookup page addresses
-    if (!m_c.tlb.image_filename.empty()) {
+    if (t != nullptr) {
+        const unsigned char *hmem = t->get_tlb_image().data();
+        for (uint64_t i = 0; i < PMA_TLB_SIZE; ++i) {
+            load_tlb_entry<TLB_CODE>(*this, i, hmem);
+            load_tlb_entry<TLB_READ>(*this, i, hmem);
+            load_tlb_entry<TLB_WRITE>(*this, i, hmem);
+        }
+    } else if (!m_c.tlb.image_filename.empty()) {
         // Create a temporary PMA entry just to load TLB contents from an image file
         pma_entry tlb_image_pma = make_mmapd_memory_pma_entry("shadow TLB device"s, PMA_SHADOW_TLB_START,
             PMA_SHADOW_TLB_LENGTH, m_c.tlb.image_filename, false);
@@ -556,6 +643,12 @@ machine::machine(const machine_config &c, const machine_runtime_config &r) : m_c
     // when calling write() on closed file descriptors.
     // This can happen with the stdout console file descriptors or network file descriptors.
     os_disable_sigpipe();
+
+    // Deduplicate pages loaded from images with those of other machines in this process,
+    // while instances of templates already share pages with them
+    if (m_r.share_pages && t == nullptr) {
+        share_pages();
+    }
 }
 
 static void load_hash(const std::string &dir, machine::hash_type &h) {
@@ -582,6 +675,17 @@ machine::machine(const std::string &dir, const machine_runtime_config &r) : mach
     }
 }
 
+machine::machine(const machine_template &t, const machine_runtime_config &r) : machine{t.get_config(), r, &t} {
+    // Memory ranges privately map the template snapshots, so pages are shared with the template until written to.
+    // Copy the pages in which the template differs from its snapshots, so they stop being shared.
+    for (const auto &[address, data] : t.get_page_images()) {
+        pma_entry &pma = find_pma_entry(m_merkle_pmas, address, data->size());
+        memcpy(pma.get_memory().get_host_memory() + (address - pma.get_start()), data->data(), data->size());
+    }
+    // Reuse precomputed hashes instead of rehashing all memory
+    m_t.copy_from(t.get_merkle_tree());
+}
+
 void machine::prepare_virtio_devices_select(select_fd_sets *fds, uint64_t *timeout_us) {
     for (auto &vdev : m_vdevs) {
         vdev->prepare_select(fds, timeout_us);
@@ -640,6 +744,10 @@ machine_config machine::get_serialization_config() const {
     if (read_reg(reg::iunrep) != 0) {
         throw std::runtime_error{"cannot serialize configuration of unreproducible machines"};
     }
+    return get_current_config();
+}
+
+machine_config machine::get_current_config() const {
     // Initialize with copy of original config
     machine_config c = m_c;
     // Copy current processor state to config
@@ -742,15 +850,83 @@ static void store_device_pma(const machine &m, const pma_entry &pma, const std::
     }
 }
 
-static void store_memory_pma(const pma_entry &pma, const std::string &dir) {
-    if (!pma.get_istart_M()) {
-        throw std::runtime_error{"attempt to save non-memory PMA"};
+static uint64_t get_task_concurrency(uint64_t value) {
+    const uint64_t concurrency = value > 0 ? value : std::max(os_get_concurrency(), UINT64_C(1));
+    return std::min(concurrency, static_cast<uint64_t>(THREADS_MAX));
+}
+
+/// \brief Memory ranges are split into chunks of this size, so they can be stored in parallel
+constexpr uint64_t STORE_CHUNK_SIZE = UINT64_C(16) << 20;
+
+/// \brief Writes a chunk of a memory range into its (already sized) image file.
+/// \returns True if succeeded, false otherwise.
+static bool store_memory_chunk(const unsigned char *host_memory, const std::string &name, uint64_t offset,
+    uint64_t length) {
+    auto fp = unique_fopen(name.c_str(), "r+b", std::nothrow_t{});
+    if (!fp) {
+        return false;
     }
-    auto name = machine_config::get_image_filename(dir, pma.get_start(), pma.get_length());
-    auto fp = unique_fopen(name.c_str(), "wb");
-    const pma_memory &mem = pma.get_memory();
-    if (fwrite(mem.get_host_memory(), 1, pma.get_length(), fp.get()) != pma.get_length()) {
-        throw std::runtime_error{"error writing to '" + name + "'"};
+    // Write runs of consecutive non-pristine pages, leaving pristine pages as holes in the file
+    const uint64_t end = offset + length;
+    uint64_t run_start = offset;
+    for (uint64_t page = offset; page <= end; page += PMA_PAGE_SIZE) {
+        const uint64_t page_length = std::min<uint64_t>(PMA_PAGE_SIZE, end - page);
+        if (page < end && !is_pristine(host_memory + page, page_length)) {
+            continue;
+        }
+        if (page > run_start) {
+            const uint64_t run_length = page - run_start;
+            if (fseek(fp.get(), static_cast<long>(run_start), SEEK_SET) != 0 ||
+                fwrite(host_memory + run_start, 1, run_length, fp.get()) != run_length) {
+                return false;
+            }
+        }
+        run_start = page + page_length;
+    }
+    return fflush(fp.get()) == 0;
+}
+
+static void store_memory_pmas(const std::vector<const pma_entry *> &pmas, const std::string &dir,
+    uint64_t concurrency) {
+    struct store_chunk {
+        const unsigned char *host_memory;
+        uint64_t name_index;
+        uint64_t offset;
+        uint64_t length;
+    };
+    std::vector<std::string> names;
+    std::vector<store_chunk> chunks;
+    for (const auto *pma : pmas) {
+        if (!pma->get_istart_M()) {
+            throw std::runtime_error{"attempt to save non-memory PMA"};
+        }
+        auto name = machine_config::get_image_filename(dir, pma->get_start(), pma->get_length());
+        // Create the file with its final length up front, so pristine pages that are never written become holes
+        {
+            auto fp = unique_fopen(name.c_str(), "wb");
+        }
+        std::filesystem::resize_file(name, pma->get_length());
+        for (uint64_t offset = 0; offset < pma->get_length(); offset += STORE_CHUNK_SIZE) {
+            chunks.push_back(store_chunk{.host_memory = pma->get_memory().get_host_memory(),
+                .name_index = names.size(),
+                .offset = offset,
+                .length = std::min(STORE_CHUNK_SIZE, pma->get_length() - offset)});
+        }
+        names.push_back(std::move(name));
+    }
+    // Thread j is responsible for chunk i if i % n == j
+    const uint64_t n = std::min<uint64_t>(get_task_concurrency(concurrency), chunks.size());
+    const bool succeeded = os_parallel_for(n, [&](uint64_t j, const parallel_for_mutex & /*mutex*/) -> bool {
+        for (uint64_t i = j; i < chunks.size(); i += n) {
+            const auto &chunk = chunks[i];
+            if (!store_memory_chunk(chunk.host_memory, names[chunk.name_index], chunk.offset, chunk.length)) {
+                return false;
+            }
+        }
+        return true;
+    });
+    if (!succeeded) {
+        throw std::runtime_error{"error writing memory images to '" + dir + "'"};
     }
 }
 
@@ -802,19 +978,21 @@ void machine::store_pmas(const machine_config &c, const std::string &dir) const
     if (read_reg(reg::iunrep) != 0) {
         throw std::runtime_error{"cannot store PMAs of unreproducible machines"};
     }
-    store_memory_pma(find_pma_entry<uint64_t>(PMA_DTB_START), dir);
-    store_memory_pma(find_pma_entry<uint64_t>(PMA_RAM_START), dir);
     store_device_pma(*this, find_pma_entry<uint64_t>(PMA_SHADOW_TLB_START), dir);
+    std::vector<const pma_entry *> pmas;
+    pmas.push_back(&find_pma_entry<uint64_t>(PMA_DTB_START));
+    pmas.push_back(&find_pma_entry<uint64_t>(PMA_RAM_START));
     // Could iterate over PMAs checking for those with a drive DID
     // but this is easier
     for (const auto &f : c.flash_drive) {
-        store_memory_pma(find_pma_entry<uint64_t>(f.start), dir);
+        pmas.push_back(&find_pma_entry<uint64_t>(f.start));
     }
-    store_memory_pma(find_pma_entry<uint64_t>(PMA_CMIO_RX_BUFFER_START), dir);
-    store_memory_pma(find_pma_entry<uint64_t>(PMA_CMIO_TX_BUFFER_START), dir);
+    pmas.push_back(&find_pma_entry<uint64_t>(PMA_CMIO_RX_BUFFER_START));
+    pmas.push_back(&find_pma_entry<uint64_t>(PMA_CMIO_TX_BUFFER_START));
     if (!m_uarch.get_state().ram.get_istart_E()) {
-        store_memory_pma(m_uarch.get_state().ram, dir);
+        pmas.push_back(&m_uarch.get_state().ram);
     }
+    store_memory_pmas(pmas, dir, m_r.concurrency.store_pmas);
 }
 
 static void store_hash(const machine::hash_type &h, const std::string &dir) {
@@ -829,17 +1007,26 @@ void machine::store(const std::string &dir) const {
     if (os_mkdir(dir.c_str(), 0700) != 0) {
         throw std::system_error{errno, std::generic_category(), "error creating directory '"s + dir + "'"s};
     }
+    auto c = get_serialization_config();
+    c.store(dir);
+    // Hashing and writing memory images only read memory, so they can overlap
+    bool hashed = true;
+    os_parallel_for(2, [&](uint64_t j, const parallel_for_mutex & /*mutex*/) -> bool {
+        if (j == 0) {
+            store_pmas(c, dir);
+        } else if (!m_r.skip_root_hash_store) {
+            hashed = update_merkle_tree();
+        }
+        return true;
+    });
     if (!m_r.skip_root_hash_store) {
-        if (!update_merkle_tree()) {
+        if (!hashed) {
             throw std::runtime_error{"error updating Merkle tree"};
         }
         hash_type h;
         m_t.get_root_hash(h);
         store_hash(h, dir);
     }
-    auto c = get_serialization_config();
-    c.store(dir);
-    store_pmas(c, dir);
 }
 
 machine::~machine() {
@@ -1727,12 +1914,7 @@ bool machine::verify_dirty_page_maps() const {
     return !broken;
 }
 
-static uint64_t get_task_concurrency(uint64_t value) {
-    const uint64_t concurrency = value > 0 ? value : std::max(os_get_concurrency(), UINT64_C(1));
-    return std::min(concurrency, static_cast<uint64_t>(THREADS_MAX));
-}
-
-bool machine::update_merkle_tree() const {
+bool machine::update_merkle_tree(bool skip_virtio) const {
     machine_merkle_tree::hasher_type gh;
     static_assert(PMA_PAGE_SIZE == machine_merkle_tree::get_page_size(),
         "PMA and machine_merkle_tree page sizes must match");
@@ -1741,6 +1923,9 @@ bool machine::update_merkle_tree() const {
     // Now go over all PMAs and updating the Merkle tree
     m_t.begin_update();
     for (const auto &pma : m_merkle_pmas) {
+        if (skip_virtio && pma->get_istart_DID() == PMA_ISTART_DID::VIRTIO) {
+            continue;
+        }
         auto peek = pma->get_peek();
         // Each PMA has a number of pages
         auto pages_in_range = (pma->get_length() + PMA_PAGE_SIZE - 1) / PMA_PAGE_SIZE;
@@ -1804,6 +1989,39 @@ bool machine::update_merkle_tree() const {
     return ret;
 }
 
+void machine::share_pages() {
+    if (!update_merkle_tree()) {
+        throw std::runtime_error{"error updating Merkle tree"};
+    }
+    const auto &pristine_hash = machine_merkle_tree::get_pristine_hash(machine_merkle_tree::get_log2_page_size());
+    page_store &store = page_store::get_instance();
+    for (auto *pma : m_merkle_pmas) {
+        if (!pma->get_istart_M() || pma->get_istart_E() || !pma->get_memory().can_share_pages()) {
+            continue;
+        }
+        pma_memory &memory = pma->get_memory();
+        // Offset of the stored page shared by the preceding host page, which the store tries to extend
+        uint64_t previous = page_store::no_offset;
+        for (uint64_t offset = 0; offset < pma->get_length(); offset += PMA_PAGE_SIZE) {
+            hash_type hash;
+            m_t.get_page_node_hash(pma->get_start() + offset, hash);
+            // Pristine pages were never touched, so they take no host memory to begin with
+            if (hash == pristine_hash) {
+                previous = page_store::no_offset;
+                continue;
+            }
+            uint64_t store_offset = 0;
+            uint64_t mappings = 0;
+            if (store.share(memory.get_host_memory() + offset, hash, previous, &store_offset, &mappings)) {
+                memory.add_shared_page(store_offset, mappings);
+                previous = store_offset;
+            } else {
+                previous = page_store::no_offset;
+            }
+        }
+    }
+}
+
 bool machine::update_merkle_tree_page(uint64_t address) {
     static_assert(PMA_PAGE_SIZE == machine_merkle_tree::get_page_size(),
         "PMA and machine_merkle_tree page sizes must match");
@@ -1994,6 +2212,36 @@ void machine::fill_memory(uint64_t address, uint8_t data, uint64_t length) {
     pma.fill_memory(address, data, length);
 }
 
+void machine::discard_memory(uint64_t address, uint64_t length) {
+    if (length == 0) {
+        return;
+    }
+    pma_entry &pma = find_pma_entry(m_merkle_pmas, address, length);
+    if (!pma.get_istart_M() || pma.get_istart_E()) {
+        throw std::invalid_argument{"address range not entirely in memory PMA"};
+    }
+    pma.discard_memory(address, length);
+}
+
+unsigned char *machine::get_host_memory(uint64_t address, uint64_t length) {
+    pma_entry &pma = find_pma_entry(m_merkle_pmas, address, length);
+    if (!pma.get_istart_M() || pma.get_istart_E()) {
+        throw std::invalid_argument{"address range not entirely in memory PMA"};
+    }
+    return pma.get_memory().get_host_memory() + (address - pma.get_start());
+}
+
+void machine::mark_dirty_memory(uint64_t address, uint64_t length) {
+    if (length == 0) {
+        return;
+    }
+    pma_entry &pma = find_pma_entry(m_merkle_pmas, address, length);
+    if (!pma.get_istart_M() || pma.get_istart_E()) {
+        throw std::invalid_argument{"address range not entirely in memory PMA"};
+    }
+    pma.mark_dirty_pages(address, length);
+}
+
 void machine::read_virtual_memory(uint64_t vaddr_start, unsigned char *data, uint64_t length) {
     const state_access a(*this);
     if (length == 0) {
@@ -2263,6 +2511,7 @@ interpreter_break_reason machine::verify_step(const hash_type &root_hash_before,
     uint64_t mcycle_count, const hash_type &root_hash_after) {
     auto data_length = os_get_file_length(filename.c_str(), "step log file");
     auto *data = os_map_file(filename.c_str(), data_length, false /* not shared */);
+    auto unmap = make_scope_exit([data, data_length] { os_unmap_file(data, data_length); });
     replay_step_state_access::context context;
     replay_step_state_access a(context, data, data_length, root_hash_before);
     uint64_t mcycle_end{};
@@ -2271,10 +2520,183 @@ interpreter_break_reason machine::verify_step(const hash_type &root_hash_before,
     }
     auto break_reason = interpret(a, mcycle_end);
     a.finish(root_hash_after);
-    os_unmap_file(data, data_length);
     return break_reason;
 }
 
+std::vector<interpreter_break_reason> machine::verify_steps(const std::vector<step_log_entry> &entries, bool chained,
+    uint64_t concurrency) {
+    if (chained) {
+        for (uint64_t i = 1; i < entries.size(); ++i) {
+            if (entries[i].root_hash_before != entries[i - 1].root_hash_after) {
+                throw std::invalid_argument{"step log "s + std::to_string(i) + " does not start where step log "s +
+                    std::to_string(i - 1) + " ends"s};
+            }
+        }
+    }
+    std::vector<interpreter_break_reason> break_reasons(entries.size(), interpreter_break_reason::failed);
+    std::vector<std::exception_ptr> errors(entries.size());
+    // Threads take the next unchecked log as soon as they are done with the previous one,
+    // so a few long steps do not hold back the others
+    std::atomic<uint64_t> next{0};
+    std::atomic<bool> failed{false};
+    const uint64_t n = std::min<uint64_t>(get_task_concurrency(concurrency), std::max<size_t>(entries.size(), 1));
+    os_parallel_for(n, [&](uint64_t /*j*/, const parallel_for_mutex & /*mutex*/) -> bool {
+        for (uint64_t i = next++; i < entries.size() && !failed; i = next++) {
+            const auto &e = entries[i];
+            try {
+                break_reasons[i] = verify_step(e.root_hash_before, e.log_filename, e.mcycle_count, e.root_hash_after);
+            } catch (...) {
+                errors[i] = std::current_exception();
+                failed = true;
+            }
+        }
+        return true;
+    });
+    // Report the first failure, in the order the logs were given
+    for (uint64_t i = 0; i < errors.size(); ++i) {
+        if (errors[i]) {
+            const auto prefix = "step log "s + std::to_string(i) + " ('"s + entries[i].log_filename + "'): "s;
+            try {
+                std::rethrow_exception(errors[i]);
+            } catch (const std::invalid_argument &e) {
+                throw std::invalid_argument{prefix + e.what()};
+            } catch (const std::exception &e) {
+                throw std::runtime_error{prefix + e.what()};
+            }
+        }
+    }
+    return break_reasons;
+}
+
+/// \brief Collects the pages whose hashes differ between two machines
+/// \param a First machine, with an up-to-date Merkle tree
+/// \param b Second machine, with an up-to-date Merkle tree
+/// \param address Start of Merkle tree node to compare
+/// \param log2_size Log2 of size of node
+/// \param max_pages Maximum number of pages to collect
+/// \param pages Receives the start of each divergent page
+static void collect_divergent_pages(const machine &a, const machine &b, uint64_t address, int log2_size,
+    uint64_t max_pages, std::vector<uint64_t> &pages) {
+    if (pages.size() >= max_pages ||
+        a.get_merkle_tree_node_hash(address, log2_size, skip_merkle_tree_update) ==
+            b.get_merkle_tree_node_hash(address, log2_size, skip_merkle_tree_update)) {
+        return;
+    }
+    if (log2_size == machine_merkle_tree::get_log2_page_size()) {
+        pages.push_back(address);
+        return;
+    }
+    collect_divergent_pages(a, b, address, log2_size - 1, max_pages, pages);
+    collect_divergent_pages(a, b, address + (UINT64_C(1) << (log2_size - 1)), log2_size - 1, max_pages, pages);
+}
+
+machine::divergence machine::find_divergence(const machine_template &a, const machine_template &b,
+    uint64_t mcycle_begin, uint64_t mcycle_end, const machine_runtime_config &r, uint64_t max_pages) {
+    if (a.get_config().processor.mcycle != b.get_config().processor.mcycle) {
+        throw std::invalid_argument{"templates must start at the same mcycle"};
+    }
+    if (mcycle_begin < a.get_config().processor.mcycle) {
+        throw std::invalid_argument{"mcycle_begin is past"};
+    }
+    if (mcycle_end < mcycle_begin) {
+        throw std::invalid_argument{"mcycle_end is before mcycle_begin"};
+    }
+    // Each probe instantiates both machines from the latest templates on which they agree, so they share pages with
+    // the template until written to and only rehash what they touch, and runs them side by side up to the target
+    struct probe_result {
+        std::array<std::unique_ptr<machine>, 2> machines;
+        std::array<hash_type, 2> root_hashes;
+        std::array<uint64_t, 2> mcycles{};
+        std::array<interpreter_break_reason, 2> break_reasons{};
+    };
+    const auto probe = [&r](const machine_template &ta, const machine_template &tb, uint64_t target) {
+        probe_result result;
+        const std::array<const machine_template *, 2> templates{&ta, &tb};
+        std::array<std::exception_ptr, 2> errors;
+        os_parallel_for(2, [&](uint64_t j, const parallel_for_mutex & /*mutex*/) -> bool {
+            try {
+                auto &m = result.machines[j];
+                m = std::make_unique<machine>(*templates[j], r);
+                auto reason = m->run(target);
+                // Automatic and soft yields only hand control to the host, which would resume the machine
+                while (reason == interpreter_break_reason::yielded_automatically ||
+                    reason == interpreter_break_reason::yielded_softly) {
+                    reason = m->run(target);
+                }
+                // Machines that halted or yielded manually stay where they stopped, and are compared there
+                result.break_reasons[j] = reason;
+                result.mcycles[j] = m->read_reg(reg::mcycle);
+                m->get_root_hash(result.root_hashes[j]);
+            } catch (...) {
+                errors[j] = std::current_exception();
+            }
+            return true;
+        });
+        for (const auto &error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+        return result;
+    };
+    const auto agree = [](const probe_result &p) { return p.root_hashes[0] == p.root_hashes[1]; };
+    // Templates of the last mcycle at which both machines were found to agree, each layered over the previous one,
+    // so taking a checkpoint only copies the pages touched since then
+    const std::array<const machine_template *, 2> originals{&a, &b};
+    std::array<std::unique_ptr<machine_template>, 2> checkpoints;
+    const auto take_checkpoints = [&](const probe_result &p) {
+        for (uint64_t j = 0; j < 2; ++j) {
+            const machine_template &base = checkpoints[j] ? *checkpoints[j] : *originals[j];
+            checkpoints[j] = std::make_unique<machine_template>(*p.machines[j], base);
+        }
+    };
+    divergence d;
+    // Reports the states in which the machines were compared, and where each of them actually stopped
+    const auto report = [&d](const probe_result &p) {
+        d.mcycle_a = p.mcycles[0];
+        d.mcycle_b = p.mcycles[1];
+        d.break_reason_a = p.break_reasons[0];
+        d.break_reason_b = p.break_reasons[1];
+        d.root_hash_a = p.root_hashes[0];
+        d.root_hash_b = p.root_hashes[1];
+    };
+    auto probed = probe(a, b, mcycle_begin);
+    uint64_t hi = mcycle_begin;
+    if (agree(probed)) {
+        take_checkpoints(probed);
+        probed = probe(*checkpoints[0], *checkpoints[1], mcycle_end);
+        if (agree(probed)) {
+            // Agreeing machines have the same mcycle, which is before the end if they stopped early
+            d.diverged = false;
+            d.mcycle = probed.mcycles[0];
+            report(probed);
+            return d;
+        }
+        uint64_t lo = mcycle_begin;
+        hi = mcycle_end;
+        // Invariant: machines agree at lo and disagree at hi
+        auto diverged = std::move(probed);
+        while (hi - lo > 1) {
+            const uint64_t mid = lo + (hi - lo) / 2;
+            probed = probe(*checkpoints[0], *checkpoints[1], mid);
+            if (agree(probed)) {
+                take_checkpoints(probed);
+                lo = mid;
+            } else {
+                diverged = std::move(probed);
+                hi = mid;
+            }
+        }
+        probed = std::move(diverged);
+    }
+    d.diverged = true;
+    d.mcycle = hi;
+    report(probed);
+    collect_divergent_pages(*probed.machines[0], *probed.machines[1], 0, machine_merkle_tree::get_log2_root_size(),
+        max_pages, d.page_addresses);
+    return d;
+}
+
 interpreter_break_reason machine::run(uint64_t mcycle_end) {
     if (mcycle_end < read_reg(reg::mcycle)) {
         throw std::invalid_argument{"mcycle is past"};
@@ -36,6 +36,7 @@
 #include "machine-reg.h"
 #include "machine-runtime-config.h"
 #include "machine-state.h"
+#include "machine-template.h"
 #include "os.h"
 #include "pma-constants.h"
 #include "pma.h"
@@ -88,14 +89,18 @@ private:
     /// \brief Creates a new PMA entry reflecting a memory range configuration.
     /// \param description Informative description of PMA entry for use in error messages
     /// \param c Memory range configuration.
+    /// \param huge_pages Whether to try to back the range with huge pages.
     /// \returns New PMA entry (with default flags).
-    static pma_entry make_memory_range_pma_entry(const std::string &description, const memory_range_config &c);
+    static pma_entry make_memory_range_pma_entry(const std::string &description, const memory_range_config &c,
+        bool huge_pages);
 
     /// \brief Creates a new flash drive PMA entry.
     /// \param description Informative description of PMA entry for use in error messages
     /// \param c Memory range configuration.
+    /// \param huge_pages Whether to try to back the range with huge pages.
     /// \returns New PMA entry with flash drive flags already set.
-    static pma_entry make_flash_drive_pma_entry(const std::string &description, const memory_range_config &c);
+    static pma_entry make_flash_drive_pma_entry(const std::string &description, const memory_range_config &c,
+        bool huge_pages);
 
     /// \brief Creates a new cmio rx buffer PMA entry.
     // \param c Optional cmio configuration
@@ -107,6 +112,15 @@ private:
     /// \returns New PMA entry with tx buffer flags already set.
     static pma_entry make_cmio_tx_buffer_pma_entry(const cmio_config &cmio_config);
 
+    /// \brief Creates a new PMA entry privately mapping the snapshot a template keeps of a memory range.
+    /// \param t Template holding the snapshot.
+    /// \param description Informative description of PMA entry for use in error messages
+    /// \param start Start of memory range.
+    /// \param length Length of memory range.
+    /// \returns New PMA entry (with default flags), with all its pages marked clean.
+    static pma_entry make_template_memory_pma_entry(const machine_template &t, const std::string &description,
+        uint64_t start, uint64_t length);
+
     /// \brief Saves PMAs into files for serialization
     /// \param config Machine config to be stored
     /// \param directory Directory where PMAs will be stored
@@ -125,12 +139,51 @@ private:
     template <typename CONTAINER>
     const pma_entry &find_pma_entry(const CONTAINER &pmas, uint64_t paddr, uint64_t length) const;
 
+    /// \brief Copies the current state into a configuration, even for unreproducible machines
+    /// \returns The configuration
+    machine_config get_current_config() const;
+
+    /// \brief Constructor from machine configuration, optionally with memory contents taken from a template
+    /// \param config Machine config to use instantiating machine
+    /// \param runtime Runtime config to use with machine
+    /// \param t Template whose snapshots back the memory ranges, or nullptr to load them as configured
+    /// \details When \p t is given, no image file is opened, the DTB is not initialized and pages are not shared.
+    machine(const machine_config &config, const machine_runtime_config &runtime, const machine_template *t);
+
+    /// \brief Update the Merkle tree so it matches the contents of the machine state.
+    /// \param skip_virtio Whether to leave out VirtIO devices, which cannot be hashed.
+    /// \returns true if succeeded, false otherwise.
+    bool update_merkle_tree(bool skip_virtio) const;
+
+    friend class machine_template;
+
 public:
     /// \brief Type of hash
     using hash_type = machine_merkle_tree::hash_type;
 
     using reg = machine_reg;
 
+    /// \brief Step log to be checked by verify_steps()
+    struct step_log_entry {
+        hash_type root_hash_before; ///< Hash of the state before the step
+        std::string log_filename;   ///< Name of the file containing the log
+        uint64_t mcycle_count{};    ///< Number of mcycles the machine was run for
+        hash_type root_hash_after;  ///< Hash of the state after the step
+    };
+
+    /// \brief Result of find_divergence()
+    struct divergence {
+        bool diverged{};                           ///< Whether the machines diverge within the mcycle range
+        uint64_t mcycle{};                         ///< First mcycle at which root hashes differ (or where search ended)
+        uint64_t mcycle_a{};                       ///< mcycle actually reached by first machine when compared
+        uint64_t mcycle_b{};                       ///< mcycle actually reached by second machine when compared
+        interpreter_break_reason break_reason_a{}; ///< Why first machine stopped when compared
+        interpreter_break_reason break_reason_b{}; ///< Why second machine stopped when compared
+        hash_type root_hash_a;                     ///< Root hash of first machine at mcycle
+        hash_type root_hash_b;                     ///< Root hash of second machine at mcycle
+        std::vector<uint64_t> page_addresses;      ///< Start of pages whose contents differ at mcycle
+    };
+
     /// \brief Constructor from machine configuration
     /// \param config Machine config to use instantiating machine
     /// \param runtime Runtime config to use with machine
@@ -141,6 +194,12 @@ public:
     /// \param runtime Runtime config to use with machine
     explicit machine(const std::string &directory, const machine_runtime_config &runtime = {});
 
+    /// \brief Constructor from machine template
+    /// \param t Template to instantiate machine from
+    /// \param runtime Runtime config to use with machine
+    /// \details The new machine shares all memory pages with the template until it writes to them.
+    explicit machine(const machine_template &t, const machine_runtime_config &runtime = {});
+
     /// \brief Serialize entire state to directory
     /// \param directory Directory to store machine into
     void store(const std::string &directory) const;
@@ -177,6 +236,33 @@ public:
     static interpreter_break_reason verify_step(const hash_type &root_hash_before, const std::string &log_filename,
         uint64_t mcycle_count, const hash_type &root_hash_after);
 
+    /// \brief Checks the validity of many step log files in parallel.
+    /// \param entries Step logs to check.
+    /// \param chained If true, each step must start at the state where the previous step ended.
+    /// \param concurrency Number of threads to use (0 for the number of hardware threads).
+    /// \returns The reason the machine was interrupted at the end of each step.
+    /// \details Throws if any of the steps is invalid, identifying the first one that failed.
+    static std::vector<interpreter_break_reason> verify_steps(const std::vector<step_log_entry> &entries,
+        bool chained, uint64_t concurrency);
+
+    /// \brief Finds the first mcycle at which two machines diverge, by bisection.
+    /// \param a Template holding the state of the first machine.
+    /// \param b Template holding the state of the second machine, at the same mcycle as \p a.
+    /// \param mcycle_begin First mcycle of the range to search.
+    /// \param mcycle_end Last mcycle of the range to search.
+    /// \param r Runtime configuration for the machines instantiated at each probe.
+    /// \param max_pages Maximum number of divergent pages to report.
+    /// \returns The first mcycle in the range at which the root hashes of both machines differ, if any,
+    /// along with the root hashes and the pages that differ at that mcycle.
+    /// \details Assumes machines that diverged stay diverged. Each probe runs both machines up to a target mcycle,
+    /// resuming them after automatic and soft yields. A machine that halts or yields manually before the target is
+    /// compared in the state where it stopped, and the mcycle it actually reached is reported. If both machines
+    /// agree until they stop, the search ends there. Agreeing states are kept as templates layered over the
+    /// previous ones, so each probe only runs from the latest mcycle known to agree, and each checkpoint only
+    /// copies the pages touched since the previous one. Neither template is modified.
+    static divergence find_divergence(const machine_template &a, const machine_template &b, uint64_t mcycle_begin,
+        uint64_t mcycle_end, const machine_runtime_config &r, uint64_t max_pages);
+
     /// \brief Runs the machine in the microarchitecture until the mcycles advances by one unit or the micro cycle
     /// counter (uarch_cycle) reaches uarch_cycle_end
     /// \param uarch_cycle_end uarch_cycle limit
@@ -263,7 +349,9 @@ public:
 
     /// \brief Update the Merkle tree so it matches the contents of the machine state.
     /// \returns true if succeeded, false otherwise.
-    bool update_merkle_tree() const;
+    bool update_merkle_tree() const {
+        return update_merkle_tree(false);
+    }
 
     /// \brief Update the Merkle tree after a page has been modified in the machine state.
     /// \param address Any address inside modified page.
@@ -353,6 +441,30 @@ public:
     /// \param length Size of memory range to fill.
     void fill_memory(uint64_t address, uint8_t data, uint64_t length);
 
+    /// \brief Zeroes a memory range, handing the host pages that back it back to the OS when possible.
+    /// \param address Physical address to start discarding.
+    /// \param length Size of memory range to discard.
+    /// \details Used for guest memory the guest reported as free.
+    void discard_memory(uint64_t address, uint64_t length);
+
+    /// \brief Obtains a host pointer to a chunk of the machine memory.
+    /// \param address Physical address of the start of the chunk.
+    /// \param length Size of chunk.
+    /// \returns Pointer to the host memory backing the chunk.
+    /// \details The entire chunk, from \p address to \p address + \p length must
+    /// be inside the same memory PMA. Data can be read from and written to the pointer directly,
+    /// but writes must be followed by a call to mark_dirty_memory() before the next
+    /// update of the Merkle tree. The pointer remains valid until the memory range is replaced
+    /// or the machine is destroyed.
+    unsigned char *get_host_memory(uint64_t address, uint64_t length);
+
+    /// \brief Marks a chunk of the machine memory as modified.
+    /// \param address Physical address of the start of the chunk.
+    /// \param length Size of chunk.
+    /// \details Must be called after writing to memory through a pointer obtained with get_host_memory().
+    /// The entire chunk must be inside the same memory range, which must not be mapped to a device.
+    void mark_dirty_memory(uint64_t address, uint64_t length);
+
     /// \brief Reads a chunk of data from the machine virtual memory.
     /// \param vaddr_start Virtual address to start reading.
     /// \param data Receives chunk of memory.
@@ -399,6 +511,11 @@ public:
     /// \brief Go over the write TLB and mark as dirty all pages currently there.
     void mark_write_tlb_dirty_pages() const;
 
+    /// \brief Replaces memory pages by copy-on-write mappings of identical pages in the process-wide page store.
+    /// \details Pages are looked up by their Merkle tree hashes, so the tree is brought up to date first.
+    /// Must be called only once, since pages already shared are not told apart from the others.
+    void share_pages();
+
     /// \brief Verify if dirty page maps are consistent.
     /// \returns true if they are, false if there is an error.
     bool verify_dirty_page_maps() const;
@@ -695,6 +695,182 @@ void os_unmap_file(unsigned char *host_memory, [[maybe_unused]] uint64_t length)
 #endif // HAVE_MMAP
 }
 
+int os_create_memory_file([[maybe_unused]] const char *name, [[maybe_unused]] uint64_t length) {
+#if defined(HAVE_MMAP) && defined(__linux__)
+    const int fd = memfd_create(name, MFD_CLOEXEC);
+    if (fd < 0) {
+        throw std::system_error{errno, std::generic_category(), "could not create memory file '"s + name + "'"s};
+    }
+#elif defined(HAVE_MMAP)
+    std::array<char, 32> path{"/tmp/cartesi-memory-XXXXXX"};
+    const int fd = mkstemp(path.data());
+    if (fd < 0) {
+        throw std::system_error{errno, std::generic_category(), "could not create memory file '"s + name + "'"s};
+    }
+    // The file is kept alive by its file descriptor alone
+    unlink(path.data());
+#else
+    throw std::runtime_error{"memory files are unsupported in this platform"s};
+#endif
+
+#ifdef HAVE_MMAP
+    // Extending the file leaves a hole that reads back as zeros and consumes no memory
+    if (ftruncate(fd, static_cast<off_t>(length)) < 0) {
+        const int err = errno;
+        close(fd);
+        throw std::system_error{err, std::generic_category(), "could not resize memory file '"s + name + "'"s};
+    }
+    return fd;
+#endif
+}
+
+unsigned char *os_map_fd([[maybe_unused]] int fd, [[maybe_unused]] uint64_t length, [[maybe_unused]] bool shared) {
+#ifdef HAVE_MMAP
+    const int mflag = shared ? MAP_SHARED : MAP_PRIVATE;
+    auto *host_memory = static_cast<unsigned char *>(mmap(nullptr, length, PROT_READ | PROT_WRITE, mflag, fd, 0));
+    if (host_memory == MAP_FAILED) { // NOLINT(cppcoreguidelines-pro-type-cstyle-cast,performance-no-int-to-ptr)
+        throw std::system_error{errno, std::generic_category(), "could not map file descriptor to memory"s};
+    }
+    return host_memory;
+#else
+    throw std::runtime_error{"mapping file descriptors is unsupported in this platform"s};
+#endif
+}
+
+bool os_map_fd_fixed([[maybe_unused]] unsigned char *host_memory, [[maybe_unused]] int fd,
+    [[maybe_unused]] uint64_t offset, [[maybe_unused]] uint64_t length) {
+#ifdef HAVE_MMAP
+    void *ptr =
+        mmap(host_memory, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, static_cast<off_t>(offset));
+    // This fails when the process runs out of mappings, leaving the original memory untouched
+    return ptr != MAP_FAILED; // NOLINT(cppcoreguidelines-pro-type-cstyle-cast,performance-no-int-to-ptr)
+#else
+    return false;
+#endif
+}
+
+bool os_remap_anonymous([[maybe_unused]] unsigned char *host_memory, [[maybe_unused]] uint64_t length) {
+#ifdef HAVE_MMAP
+    void *ptr = mmap(host_memory, length, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_NORESERVE, -1, 0);
+    return ptr != MAP_FAILED; // NOLINT(cppcoreguidelines-pro-type-cstyle-cast,performance-no-int-to-ptr)
+#else
+    return false;
+#endif
+}
+
+void os_release_fd_range([[maybe_unused]] int fd, [[maybe_unused]] uint64_t offset, [[maybe_unused]] uint64_t length) {
+#if defined(HAVE_MMAP) && defined(FALLOC_FL_PUNCH_HOLE)
+    // Punching a hole is only an optimization, the range is left as is if the file system does not support it
+    std::ignore = fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, static_cast<off_t>(offset),
+        static_cast<off_t>(length));
+#endif
+}
+
+void os_close_fd([[maybe_unused]] int fd) {
+#ifdef HAVE_MMAP
+    close(fd);
+#endif
+}
+
+int os_dup_fd([[maybe_unused]] int fd) {
+#ifdef HAVE_MMAP
+    const int new_fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if (new_fd < 0) {
+        throw std::system_error{errno, std::generic_category(), "could not duplicate file descriptor"s};
+    }
+    return new_fd;
+#else
+    throw std::runtime_error{"memory files are unsupported in this platform"s};
+#endif
+}
+
+#ifdef HAVE_MMAP
+/// \brief Huge page size we align to (the default on both x86-64 and arm64 hosts)
+constexpr uint64_t OS_HUGE_PAGE_SIZE = UINT64_C(2) << 20;
+
+/// \brief Rounds a length up to a multiple of the huge page size
+static uint64_t os_huge_page_round_up(uint64_t length) {
+    return (length + OS_HUGE_PAGE_SIZE - 1) & ~(OS_HUGE_PAGE_SIZE - 1);
+}
+#endif
+
+unsigned char *os_map_anonymous(uint64_t length, [[maybe_unused]] bool huge_pages) {
+#ifdef HAVE_MMAP
+    const int prot = PROT_READ | PROT_WRITE;
+    const int mflag = MAP_PRIVATE | MAP_ANONYMOUS;
+    // Target memory is typically sparse, so do not let the host refuse ranges larger than it could commit at once
+    const int lazy_mflag = mflag | MAP_NORESERVE;
+    if (!huge_pages) {
+        auto *host_memory = static_cast<unsigned char *>(mmap(nullptr, length, prot, lazy_mflag, -1, 0));
+        if (host_memory == MAP_FAILED) { // NOLINT(cppcoreguidelines-pro-type-cstyle-cast,performance-no-int-to-ptr)
+            throw std::system_error{errno, std::generic_category(), "could not map anonymous memory"s};
+        }
+        return host_memory;
+    }
+    const uint64_t huge_length = os_huge_page_round_up(length);
+#ifdef MAP_HUGETLB
+    // Explicit huge pages come from a pool the administrator must reserve, so failure here is expected
+    auto *huge_memory = static_cast<unsigned char *>(mmap(nullptr, huge_length, prot, mflag | MAP_HUGETLB, -1, 0));
+    if (huge_memory != MAP_FAILED) { // NOLINT(cppcoreguidelines-pro-type-cstyle-cast,performance-no-int-to-ptr)
+        return huge_memory;
+    }
+#endif
+    // Fall back to transparent huge pages, which the kernel only uses for huge page aligned regions,
+    // so over-allocate and trim the mapping to a huge page boundary
+    const uint64_t padded_length = huge_length + OS_HUGE_PAGE_SIZE;
+    auto *padded_memory = static_cast<unsigned char *>(mmap(nullptr, padded_length, prot, lazy_mflag, -1, 0));
+    if (padded_memory == MAP_FAILED) { // NOLINT(cppcoreguidelines-pro-type-cstyle-cast,performance-no-int-to-ptr)
+        throw std::system_error{errno, std::generic_category(), "could not map anonymous memory"s};
+    }
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    const auto padded_start = reinterpret_cast<uintptr_t>(padded_memory);
+    const uint64_t head = ((padded_start + OS_HUGE_PAGE_SIZE - 1) & ~(OS_HUGE_PAGE_SIZE - 1)) - padded_start;
+    const uint64_t tail = padded_length - head - huge_length;
+    if (head != 0) {
+        munmap(padded_memory, head);
+    }
+    if (tail != 0) {
+        munmap(padded_memory + head + huge_length, tail);
+    }
+    unsigned char *host_memory = padded_memory + head;
+    os_advise_huge_pages(host_memory, huge_length);
+    return host_memory;
+#else
+    // NOLINTNEXTLINE(cppcoreguidelines-no-malloc,hicpp-no-malloc)
+    auto *host_memory = static_cast<unsigned char *>(std::calloc(1, length));
+    if (host_memory == nullptr) {
+        throw std::runtime_error{"error allocating memory"s};
+    }
+    return host_memory;
+#endif
+}
+
+void os_unmap_anonymous(unsigned char *host_memory, [[maybe_unused]] uint64_t length,
+    [[maybe_unused]] bool huge_pages) {
+#ifdef HAVE_MMAP
+    munmap(host_memory, huge_pages ? os_huge_page_round_up(length) : length);
+#else
+    std::free(host_memory); // NOLINT(cppcoreguidelines-no-malloc,hicpp-no-malloc)
+#endif
+}
+
+void os_advise_huge_pages([[maybe_unused]] unsigned char *host_memory, [[maybe_unused]] uint64_t length) {
+#if defined(HAVE_MMAP) && defined(MADV_HUGEPAGE)
+    // This is only a hint, and it fails harmlessly when transparent huge pages are disabled
+    std::ignore = madvise(host_memory, length, MADV_HUGEPAGE);
+#endif
+}
+
+bool os_discard_memory([[maybe_unused]] unsigned char *host_memory, [[maybe_unused]] uint64_t length) {
+#if defined(HAVE_MMAP) && defined(MADV_DONTNEED)
+    // On private anonymous mappings, discarded pages read back as zeros and no longer count towards RSS
+    return madvise(host_memory, length, MADV_DONTNEED) == 0;
+#else
+    return false;
+#endif
+}
+
 int64_t os_now_us() {
     static const std::chrono::time_point<std::chrono::high_resolution_clock> start{
         std::chrono::high_resolution_clock::now()};
@@ -99,6 +99,68 @@ unsigned char *os_map_file(const char *path, uint64_t length, bool shared);
 /// \brief Unmaps a file from memory
 void os_unmap_file(unsigned char *host_memory, uint64_t length);
 
+/// \brief Creates an anonymous file backed by memory
+/// \param name Informative name for the file (used only for debugging purposes)
+/// \param length Length of the file
+/// \returns File descriptor of the new file
+int os_create_memory_file(const char *name, uint64_t length);
+
+/// \brief Maps an open file descriptor to memory
+/// \param fd File descriptor of the file to map
+/// \param length Length of the mapping
+/// \param shared If true, changes are reflected in the file, otherwise they are private (copy-on-write)
+unsigned char *os_map_fd(int fd, uint64_t length, bool shared);
+
+/// \brief Maps part of an open file descriptor over existing memory, privately (copy-on-write)
+/// \param host_memory Start of the memory to replace, must be aligned to the host page size
+/// \param fd File descriptor of the file to map
+/// \param offset Offset in the file, must be aligned to the host page size
+/// \param length Length of the mapping
+/// \returns True if successful, false if the memory could not be replaced (it is left untouched)
+bool os_map_fd_fixed(unsigned char *host_memory, int fd, uint64_t offset, uint64_t length);
+
+/// \brief Replaces existing memory with fresh zero-filled anonymous memory
+/// \param host_memory Start of the memory to replace, must be aligned to the host page size
+/// \param length Length of the memory to replace
+/// \returns True if successful, false if the memory could not be replaced (it is left untouched)
+bool os_remap_anonymous(unsigned char *host_memory, uint64_t length);
+
+/// \brief Releases the storage backing a range of a file, which then reads back as zeros
+/// \param fd File descriptor of the file
+/// \param offset Offset of the range in the file
+/// \param length Length of the range
+void os_release_fd_range(int fd, uint64_t offset, uint64_t length);
+
+/// \brief Closes a file descriptor
+void os_close_fd(int fd);
+
+/// \brief Duplicates a file descriptor
+/// \param fd File descriptor to duplicate
+/// \returns New file descriptor referring to the same open file
+int os_dup_fd(int fd);
+
+/// \brief Maps zero-filled anonymous memory
+/// \param length Length of the mapping
+/// \param huge_pages If true, tries explicit huge pages first, then transparent huge pages, then regular pages
+/// \returns Pointer to the mapped memory
+unsigned char *os_map_anonymous(uint64_t length, bool huge_pages);
+
+/// \brief Unmaps memory mapped with os_map_anonymous
+/// \param host_memory Pointer returned by os_map_anonymous
+/// \param length Length of the mapping
+/// \param huge_pages Must match the value passed to os_map_anonymous
+void os_unmap_anonymous(unsigned char *host_memory, uint64_t length, bool huge_pages);
+
+/// \brief Advises the host to back a memory mapping with transparent huge pages, if it can
+void os_advise_huge_pages(unsigned char *host_memory, uint64_t length);
+
+/// \brief Releases the host pages backing a range of anonymous memory, which then reads back as zeros
+/// \param host_memory Start of the range, must be aligned to the host page size
+/// \param length Length of the range
+/// \returns True if the pages were released, false if the host does not support it
+/// \details Must only be used on private anonymous mappings, other mappings would not read back as zeros.
+bool os_discard_memory(unsigned char *host_memory, uint64_t length);
+
 /// \brief Get time elapsed since its first call with microsecond precision
 int64_t os_now_us();
 
@@ -0,0 +1,116 @@
+// Copyright Cartesi and individual authors (see AUTHORS)
+// SPDX-License-Identifier: LGPL-3.0-or-later
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any
+// later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License along
+// with this program (see COPYING). If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "page-store.h"
+
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#include "os.h"
+#include "pma-constants.h"
+
+namespace cartesi {
+
+page_store::page_store() : m_fd(os_create_memory_file("page store", capacity)), m_host_memory(nullptr) {
+    try {
+        m_host_memory = os_map_fd(m_fd, capacity, true);
+    } catch (...) {
+        os_close_fd(m_fd);
+        throw;
+    }
+}
+
+page_store::~page_store() {
+    os_unmap_file(m_host_memory, capacity);
+    os_close_fd(m_fd);
+}
+
+page_store &page_store::get_instance() {
+    static page_store store;
+    return store;
+}
+
+bool page_store::share(unsigned char *host_page, const hash_type &hash, uint64_t previous, uint64_t *poffset,
+    uint64_t *pmappings) {
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_pages.find(hash);
+    if (it == m_pages.end()) {
+        // First time we see these contents, copy them into the store,
+        // right after the page shared by the preceding host page when possible, so both mappings coalesce
+        uint64_t offset = m_length;
+        if (!m_free_offsets.empty() && previous + PMA_PAGE_SIZE != m_length) {
+            offset = m_free_offsets.back();
+            m_free_offsets.pop_back();
+        } else if (m_length + PMA_PAGE_SIZE <= capacity) {
+            m_length += PMA_PAGE_SIZE;
+        } else {
+            return false;
+        }
+        memcpy(m_host_memory + offset, host_page, PMA_PAGE_SIZE);
+        it = m_pages.emplace(hash, page_entry{offset, 0}).first;
+        m_offsets.emplace(offset, hash);
+    } else if (memcmp(m_host_memory + it->second.offset, host_page, PMA_PAGE_SIZE) != 0) {
+        // Should never happen, but we never trust a hash alone with the guest memory
+        return false;
+    }
+    page_entry &page = it->second;
+    // A page extending the mapping of the preceding one adds no mapping, one after a page mapped elsewhere ends
+    // up alone in a new mapping, and any other splits the mapping it lands in into three
+    uint64_t mappings = 2;
+    if (previous != no_offset) {
+        mappings = page.offset == previous + PMA_PAGE_SIZE ? 0 : 1;
+    }
+    if (m_mappings + mappings > max_mappings || !os_map_fd_fixed(host_page, m_fd, page.offset, PMA_PAGE_SIZE)) {
+        // Drop the page if it was just added and nobody else is using it
+        if (page.refcount == 0) {
+            release_unreferenced(it);
+        }
+        return false;
+    }
+    ++page.refcount;
+    m_mappings += mappings;
+    *poffset = page.offset;
+    *pmappings = mappings;
+    return true;
+}
+
+void page_store::release(const std::vector<uint64_t> &offsets, uint64_t mappings) {
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    m_mappings -= mappings;
+    for (const uint64_t offset : offsets) {
+        auto it = m_pages.find(m_offsets.at(offset));
+        if (--it->second.refcount == 0) {
+            release_unreferenced(it);
+        }
+    }
+}
+
+uint64_t page_store::get_page_count() {
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    return m_pages.size();
+}
+
+void page_store::release_unreferenced(page_map::iterator it) {
+    const uint64_t offset = it->second.offset;
+    os_release_fd_range(m_fd, offset, PMA_PAGE_SIZE);
+    m_free_offsets.push_back(offset);
+    m_offsets.erase(offset);
+    m_pages.erase(it);
+}
+
+} // namespace cartesi
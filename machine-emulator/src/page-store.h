@@ -0,0 +1,117 @@
+// Copyright Cartesi and individual authors (see AUTHORS)
+// SPDX-License-Identifier: LGPL-3.0-or-later
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any
+// later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License along
+// with this program (see COPYING). If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef PAGE_STORE_H
+#define PAGE_STORE_H
+
+/// \file
+/// \brief Process-wide store of memory pages shared between machines
+
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "machine-merkle-tree.h"
+
+namespace cartesi {
+
+/// \brief Process-wide store of memory pages shared between machines
+/// \details Pages are keyed by their Merkle tree page hash and kept in a memory file.
+/// Machine pages with the same contents are replaced by private (copy-on-write) mappings of the stored page,
+/// so all machines share a single copy of it until they write to it.
+/// Pages are reference counted, and their storage is released when the last machine that shared them goes away.
+/// Every shared page may split a mapping of the process, so the store keeps a budget of mappings it adds and stops
+/// sharing when it runs out, instead of letting the process hit its limit (vm.max_map_count on Linux).
+/// New pages shared by consecutive host pages are stored consecutively, so the OS coalesces their mappings.
+/// Machines share their pages once, when they are created, so pages that become identical later are not merged.
+class page_store final {
+    using hash_type = machine_merkle_tree::hash_type;
+
+    /// \brief Hashes a page hash into a hash table key (it is already uniformly distributed)
+    struct page_hash_hasher {
+        size_t operator()(const hash_type &hash) const {
+            size_t key{};
+            memcpy(&key, hash.data(), sizeof(key));
+            return key;
+        }
+    };
+
+    /// \brief Stored page
+    struct page_entry {
+        uint64_t offset;   ///< Offset of page in memory file
+        uint64_t refcount; ///< Number of machine pages sharing it
+    };
+
+    using page_map = std::unordered_map<hash_type, page_entry, page_hash_hasher>;
+
+    std::mutex m_mutex;                                ///< Serializes concurrent machines
+    int m_fd;                                          ///< Memory file holding the pages
+    unsigned char *m_host_memory;                      ///< Shared mapping of memory file
+    uint64_t m_length{};                               ///< Used length of memory file
+    page_map m_pages;                                  ///< Stored pages by hash
+    std::unordered_map<uint64_t, hash_type> m_offsets; ///< Stored page hashes by offset
+    std::vector<uint64_t> m_free_offsets;              ///< Released offsets for reuse
+    uint64_t m_mappings{};                             ///< Mappings added to the process by shared pages
+
+    page_store();
+
+    /// \brief Removes a page nobody references anymore and releases its storage
+    void release_unreferenced(page_map::iterator it);
+
+public:
+    /// \brief Maximum amount of memory the store can hold (only address space is reserved up front)
+    static constexpr uint64_t capacity = UINT64_C(1) << 38;
+
+    /// \brief Maximum number of mappings shared pages may add to the process (half the Linux default limit)
+    static constexpr uint64_t max_mappings = 32768;
+
+    /// \brief Offset standing for no stored page
+    static constexpr uint64_t no_offset = UINT64_MAX;
+
+    ~page_store();
+    page_store(const page_store &other) = delete;
+    page_store(page_store &&other) = delete;
+    page_store &operator=(const page_store &other) = delete;
+    page_store &operator=(page_store &&other) = delete;
+
+    /// \brief Returns the process-wide instance
+    static page_store &get_instance();
+
+    /// \brief Replaces a page by a copy-on-write mapping of a stored page with the same contents.
+    /// \param host_page Page in host memory, aligned to the host page size, from a private anonymous mapping.
+    /// \param hash Merkle tree hash of page contents.
+    /// \param previous Offset of the stored page shared by the preceding host page, or no_offset if it is not shared.
+    /// \param poffset Receives the offset of the stored page, to be released later.
+    /// \param pmappings Receives the number of mappings charged to the budget, to be released later.
+    /// \returns True if the page is now shared, false otherwise (the page is left untouched).
+    bool share(unsigned char *host_page, const hash_type &hash, uint64_t previous, uint64_t *poffset,
+        uint64_t *pmappings);
+
+    /// \brief Drops references to stored pages.
+    /// \param offsets Offsets of stored pages, as returned by share().
+    /// \param mappings Total number of mappings charged when they were shared.
+    /// \details Storage of pages no longer referenced is released.
+    void release(const std::vector<uint64_t> &offsets, uint64_t mappings);
+
+    /// \brief Returns the number of distinct pages currently stored.
+    uint64_t get_page_count();
+};
+
+} // namespace cartesi
+
+#endif
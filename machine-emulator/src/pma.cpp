@@ -16,6 +16,7 @@
 
 #include "pma.h"
 
+#include <algorithm>
 #include <cerrno>
 #include <cstdint>
 #include <cstdio>
@@ -28,6 +29,7 @@
 
 #include "is-pristine.h"
 #include "os.h"
+#include "page-store.h"
 #include "pma-constants.h"
 #include "pma-driver.h"
 #include "unique-c-ptr.h"
@@ -37,12 +39,26 @@ namespace cartesi {
 using namespace std::string_literals;
 
 void pma_memory::release() {
-    if (m_mmapped) {
-        os_unmap_file(m_host_memory, m_length);
-        m_mmapped = false;
-    } else {
-        std::free(m_host_memory); // NOLINT(cppcoreguidelines-no-malloc,hicpp-no-malloc)
+    switch (m_backing) {
+        case backing::mmapd:
+        case backing::mmapd_private:
+            os_unmap_file(m_host_memory, m_length);
+            break;
+        case backing::anonymous:
+        case backing::anonymous_huge:
+            os_unmap_anonymous(m_host_memory, m_length, m_backing == backing::anonymous_huge);
+            break;
+        default:
+            std::free(m_host_memory); // NOLINT(cppcoreguidelines-no-malloc,hicpp-no-malloc)
+            break;
+    }
+    // Only now that they are no longer mapped, pages can be dropped from the store
+    if (!m_shared_pages.empty()) {
+        page_store::get_instance().release(m_shared_pages, m_shared_mappings);
+        m_shared_pages.clear();
+        m_shared_mappings = 0;
     }
+    m_backing = backing::callocd;
     m_host_memory = nullptr;
     m_length = 0;
 }
@@ -51,20 +67,66 @@ pma_memory::~pma_memory() {
     release();
 }
 
+void pma_memory::discard(uint64_t offset, uint64_t length) {
+    unsigned char *host_memory = m_host_memory + offset;
+    // Only anonymous mappings read back as zeros after their pages are released.
+    // Pages shared from the page store would revert to the stored contents, and so would pages privately mapped
+    // from a file (such as those of template instances), so these are replaced by anonymous memory altogether.
+    // Explicit huge pages cannot be partially released, in which case the OS refuses and we zero them instead.
+    bool discarded = false;
+    if (m_backing == backing::anonymous || m_backing == backing::anonymous_huge) {
+        discarded = m_shared_pages.empty() ? os_discard_memory(host_memory, length) :
+                                             os_remap_anonymous(host_memory, length);
+    } else if (m_backing == backing::mmapd_private) {
+        discarded = os_remap_anonymous(host_memory, length);
+    }
+    if (!discarded) {
+        memset(host_memory, 0, length);
+    }
+}
+
 pma_memory::pma_memory(pma_memory &&other) noexcept :
     m_length{other.m_length},
     m_host_memory{other.m_host_memory},
-    m_mmapped{other.m_mmapped} {
+    m_backing{other.m_backing},
+    m_shared_pages{std::move(other.m_shared_pages)},
+    m_shared_mappings{other.m_shared_mappings} {
     // set other to safe state
     other.m_host_memory = nullptr;
-    other.m_mmapped = false;
+    other.m_backing = backing::callocd;
     other.m_length = 0;
+    other.m_shared_pages.clear();
+    other.m_shared_mappings = 0;
+}
+
+/// \brief Opens an image file for a memory range, making sure it fits in the range.
+static unique_file_ptr open_image_file(const std::string &description, const std::string &path, uint64_t length) {
+    auto fp = unique_fopen(path.c_str(), "rb", std::nothrow_t{});
+    if (!fp) {
+        throw std::system_error{errno, std::generic_category(),
+            "error opening image file '"s + path + "' when initializing "s + description};
+    }
+    // Get file size
+    if (fseek(fp.get(), 0, SEEK_END) != 0) {
+        throw std::system_error{errno, std::generic_category(),
+            "error obtaining length of image file '"s + path + "' when initializing "s + description};
+    }
+    auto file_length = ftell(fp.get());
+    if (fseek(fp.get(), 0, SEEK_SET) != 0) {
+        throw std::system_error{errno, std::generic_category(),
+            "error obtaining length of image file '"s + path + "' when initializing "s + description};
+    }
+    // Check against PMA range size
+    if (static_cast<uint64_t>(file_length) > length) {
+        throw std::runtime_error{"image file '"s + path + "' of "s + description + " is too large for range"s};
+    }
+    return fp;
 }
 
 pma_memory::pma_memory(const std::string &description, uint64_t length, const callocd & /*c*/) :
     m_length{length},
     m_host_memory{nullptr},
-    m_mmapped{false} {
+    m_backing{backing::callocd} {
     // use calloc to improve performance
     // NOLINTNEXTLINE(cppcoreguidelines-no-malloc,hicpp-no-malloc,cppcoreguidelines-prefer-member-initializer)
     m_host_memory = static_cast<unsigned char *>(std::calloc(1, length));
@@ -76,31 +138,13 @@ pma_memory::pma_memory(const std::string &description, uint64_t length, const ca
 pma_memory::pma_memory(const std::string & /*description*/, uint64_t length, const mockd & /*m*/) :
     m_length{length},
     m_host_memory{nullptr},
-    m_mmapped{false} {}
+    m_backing{backing::callocd} {}
 
 pma_memory::pma_memory(const std::string &description, uint64_t length, const std::string &path, const callocd &c) :
     pma_memory{description, length, c} {
     // Try to load image file, if any
     if (!path.empty()) {
-        auto fp = unique_fopen(path.c_str(), "rb", std::nothrow_t{});
-        if (!fp) {
-            throw std::system_error{errno, std::generic_category(),
-                "error opening image file '"s + path + "' when initializing "s + description};
-        }
-        // Get file size
-        if (fseek(fp.get(), 0, SEEK_END) != 0) {
-            throw std::system_error{errno, std::generic_category(),
-                "error obtaining length of image file '"s + path + "' when initializing "s + description};
-        }
-        auto file_length = ftell(fp.get());
-        if (fseek(fp.get(), 0, SEEK_SET) != 0) {
-            throw std::system_error{errno, std::generic_category(),
-                "error obtaining length of image file '"s + path + "' when initializing "s + description};
-        }
-        // Check against PMA range size
-        if (static_cast<uint64_t>(file_length) > length) {
-            throw std::runtime_error{"image file '"s + path + "' of "s + description + " is too large for range"s};
-        }
+        auto fp = open_image_file(description, path, length);
         // Read to host memory
         std::ignore = fread(m_host_memory, 1, length, fp.get());
         if (ferror(fp.get()) != 0) {
@@ -110,28 +154,62 @@ pma_memory::pma_memory(const std::string &description, uint64_t length, const st
     }
 }
 
+pma_memory::pma_memory(const std::string &description, uint64_t length, const anonymousd &a) :
+    m_length{length},
+    m_host_memory{nullptr},
+    m_backing{backing::callocd} {
+    try {
+        m_host_memory = os_map_anonymous(length, a.huge_pages);
+        m_backing = a.huge_pages ? backing::anonymous_huge : backing::anonymous;
+    } catch (std::exception &e) {
+        throw std::runtime_error{e.what() + " when initializing "s + description};
+    }
+}
+
 pma_memory::pma_memory(const std::string &description, uint64_t length, const std::string &path, const mmapd &m) :
     m_length{length},
     m_host_memory{nullptr},
-    m_mmapped{false} {
+    m_backing{backing::callocd} {
     try {
         m_host_memory = os_map_file(path.c_str(), length, m.shared);
-        m_mmapped = true;
+        m_backing = m.shared ? backing::mmapd : backing::mmapd_private;
+    } catch (std::exception &e) {
+        throw std::runtime_error{e.what() + " when initializing "s + description};
+    }
+    if (m.huge_pages) {
+        os_advise_huge_pages(m_host_memory, length);
+    }
+}
+
+pma_memory::pma_memory(const std::string &description, uint64_t length, int fd, const mmapd &m) :
+    m_length{length},
+    m_host_memory{nullptr},
+    m_backing{backing::callocd} {
+    try {
+        m_host_memory = os_map_fd(fd, length, m.shared);
+        m_backing = m.shared ? backing::mmapd : backing::mmapd_private;
     } catch (std::exception &e) {
         throw std::runtime_error{e.what() + " when initializing "s + description};
     }
+    if (m.huge_pages) {
+        os_advise_huge_pages(m_host_memory, length);
+    }
 }
 
 pma_memory &pma_memory::operator=(pma_memory &&other) noexcept {
     release();
     // copy from other
     m_host_memory = other.m_host_memory;
-    m_mmapped = other.m_mmapped;
+    m_backing = other.m_backing;
     m_length = other.m_length;
+    m_shared_pages = std::move(other.m_shared_pages);
+    m_shared_mappings = other.m_shared_mappings;
     // set other to safe state
     other.m_host_memory = nullptr;
-    other.m_mmapped = false;
+    other.m_backing = backing::callocd;
     other.m_length = 0;
+    other.m_shared_pages.clear();
+    other.m_shared_mappings = 0;
     return *this;
 }
 
@@ -209,6 +287,27 @@ void pma_entry::fill_memory(uint64_t paddr, unsigned char value, uint64_t size)
     }
 }
 
+void pma_entry::discard_memory(uint64_t paddr, uint64_t size) {
+    if (!get_istart_M() || get_istart_E()) {
+        throw std::invalid_argument{"address range not entirely in memory PMA"};
+    }
+    if (!contains(paddr, size)) {
+        throw std::invalid_argument{"range not contained in pma"};
+    }
+    unsigned char *host_memory = get_memory().get_host_memory();
+    const uint64_t start = paddr - get_start();
+    const uint64_t end = start + size;
+    // Only whole pages can be handed back to the host, partial pages at the edges are zeroed in place
+    const uint64_t page_start = std::min((start + PMA_PAGE_SIZE - 1) & ~(PMA_PAGE_SIZE - 1), end);
+    const uint64_t page_end = std::max(end & ~(PMA_PAGE_SIZE - 1), page_start);
+    memset(host_memory + start, 0, page_start - start);
+    if (page_end > page_start) {
+        get_memory().discard(page_start, page_end - page_start);
+    }
+    memset(host_memory + page_end, 0, end - page_end);
+    mark_dirty_pages(paddr, size);
+}
+
 bool pma_peek_error(const pma_entry & /*pma*/, const machine & /*m*/, uint64_t /*page_address*/,
     const unsigned char ** /*page_data*/, unsigned char * /*scratch*/) {
     return false;
@@ -235,11 +334,20 @@ static bool memory_peek(const pma_entry &pma, const machine & /*m*/, uint64_t pa
 }
 
 pma_entry make_mmapd_memory_pma_entry(const std::string &description, uint64_t start, uint64_t length,
-    const std::string &path, bool shared) {
+    const std::string &path, bool shared, bool huge_pages) {
+    if (length == 0) {
+        throw std::invalid_argument{description + " length cannot be zero"s};
+    }
+    return pma_entry{description, start, length,
+        pma_memory{description, length, path, pma_memory::mmapd{shared, huge_pages}}, memory_peek};
+}
+
+pma_entry make_mmapd_memory_pma_entry(const std::string &description, uint64_t start, uint64_t length, int fd,
+    bool shared) {
     if (length == 0) {
         throw std::invalid_argument{description + " length cannot be zero"s};
     }
-    return pma_entry{description, start, length, pma_memory{description, length, path, pma_memory::mmapd{shared}},
+    return pma_entry{description, start, length, pma_memory{description, length, fd, pma_memory::mmapd{shared}},
         memory_peek};
 }
 
@@ -259,6 +367,50 @@ pma_entry make_callocd_memory_pma_entry(const std::string &description, uint64_t
         memory_peek};
 }
 
+pma_entry make_anonymous_memory_pma_entry(const std::string &description, uint64_t start, uint64_t length,
+    bool huge_pages) {
+    if (length == 0) {
+        throw std::invalid_argument{description + " length cannot be zero"s};
+    }
+    pma_entry pma{description, start, length, pma_memory{description, length, pma_memory::anonymousd{huge_pages}},
+        memory_peek};
+    // Pages in a fresh anonymous mapping are known to be zero, so they start clean (i.e., pristine in the
+    // Merkle tree) and the host does not have to back them with memory until the target writes to them
+    pma.mark_pages_clean();
+    return pma;
+}
+
+pma_entry make_anonymous_memory_pma_entry(const std::string &description, uint64_t start, uint64_t length,
+    const std::string &path, bool huge_pages) {
+    auto pma = make_anonymous_memory_pma_entry(description, start, length, huge_pages);
+    if (path.empty()) {
+        return pma;
+    }
+    // Copy only non-zero pages from the image file, so zero pages are never touched and remain clean
+    auto fp = open_image_file(description, path, length);
+    unsigned char *host_memory = pma.get_memory().get_host_memory();
+    constexpr uint64_t chunk_length = 256 * PMA_PAGE_SIZE;
+    auto chunk = unique_calloc<unsigned char>(chunk_length);
+    for (uint64_t offset = 0; offset < length; offset += chunk_length) {
+        const uint64_t chunk_read = fread(chunk.get(), 1, std::min(chunk_length, length - offset), fp.get());
+        if (ferror(fp.get()) != 0) {
+            throw std::system_error{errno, std::generic_category(),
+                "error reading from image file '"s + path + "' when initializing "s + description};
+        }
+        for (uint64_t page = 0; page < chunk_read; page += PMA_PAGE_SIZE) {
+            const uint64_t page_length = std::min<uint64_t>(PMA_PAGE_SIZE, chunk_read - page);
+            if (!is_pristine(chunk.get() + page, page_length)) {
+                memcpy(host_memory + offset + page, chunk.get() + page, page_length);
+                pma.mark_dirty_page(offset + page);
+            }
+        }
+        if (chunk_read < chunk_length) {
+            break;
+        }
+    }
+    return pma;
+}
+
 pma_entry make_mockd_memory_pma_entry(const std::string &description, uint64_t start, uint64_t length) {
     if (length == 0) {
         throw std::invalid_argument{description + " length cannot be zero"s};
@@ -100,9 +100,20 @@ public:
 /// \brief Data for memory ranges.
 class pma_memory final {
 
-    uint64_t m_length;            ///< Length of memory range (copy of PMA length field).
-    unsigned char *m_host_memory; ///< Start of associated memory region in host.
-    bool m_mmapped;               ///< True if memory was mapped from a file.
+    /// \brief How host memory was obtained, which determines how it is released.
+    enum class backing : uint8_t {
+        callocd,        ///< Allocated with calloc (or not allocated at all).
+        mmapd,          ///< Mapped from a file, shared with it.
+        mmapd_private,  ///< Mapped from a file, privately, so writes are not reflected in it.
+        anonymous,      ///< Mapped anonymously.
+        anonymous_huge, ///< Mapped anonymously, aligned to huge pages.
+    };
+
+    uint64_t m_length;                    ///< Length of memory range (copy of PMA length field).
+    unsigned char *m_host_memory;         ///< Start of associated memory region in host.
+    backing m_backing;                    ///< How host memory was obtained.
+    std::vector<uint64_t> m_shared_pages; ///< Offsets of pages from the process-wide page store mapped in range.
+    uint64_t m_shared_mappings{};         ///< Mappings charged to the page store for these pages.
 
     /// \brief Close file and/or release memory.
     void release();
@@ -111,6 +122,7 @@ public:
     /// \brief Mmap'd range data (shared or not).
     struct mmapd {
         bool shared;
+        bool huge_pages{}; ///< Whether to advise the host to back the mapping with transparent huge pages.
     };
 
     /// \brief Constructor for mmap'd ranges.
@@ -120,9 +132,21 @@ public:
     /// \param m Mmap'd range data (shared or not).
     pma_memory(const std::string &description, uint64_t length, const std::string &path, const mmapd &m);
 
+    /// \brief Constructor for mmap'd ranges backed by an open file descriptor.
+    /// \param description Informative description of PMA entry for use in error messages
+    /// \param length Length of range.
+    /// \param fd File descriptor of backing file.
+    /// \param m Mmap'd range data (shared or not).
+    pma_memory(const std::string &description, uint64_t length, int fd, const mmapd &m);
+
     /// \brief Calloc'd range data (just a tag).
     struct callocd {};
 
+    /// \brief Anonymously mmap'd range data.
+    struct anonymousd {
+        bool huge_pages; ///< Whether to try to back the range with huge pages.
+    };
+
     /// \brief Mock'd range data (just a tag).
     struct mockd {};
 
@@ -139,6 +163,12 @@ public:
     /// \param c Calloc'd range data (just a tag).
     pma_memory(const std::string &description, uint64_t length, const callocd &c);
 
+    /// \brief Constructor for anonymously mmap'd ranges.
+    /// \param description Informative description of PMA entry for use in error messages
+    /// \param length Length of range.
+    /// \param a Anonymously mmap'd range data.
+    pma_memory(const std::string &description, uint64_t length, const anonymousd &a);
+
     /// \brief Constructor for mock ranges.
     /// \param description Informative description of PMA entry for use in error messages
     /// \param length Length of range.
@@ -174,6 +204,25 @@ public:
     uint64_t get_length() const {
         return m_length;
     }
+
+    /// \brief Zeroes a page-aligned range, returning its host memory to the OS when possible.
+    /// \param offset Offset of range within memory region.
+    /// \param length Length of range.
+    void discard(uint64_t offset, uint64_t length);
+
+    /// \brief Tells whether pages in the range can be replaced by pages from the process-wide page store.
+    /// \details Only private anonymous memory with regular pages can be partially remapped.
+    bool can_share_pages() const {
+        return m_backing == backing::anonymous;
+    }
+
+    /// \brief Records that a page from the process-wide page store was mapped into the range.
+    /// \param store_offset Offset of page in the store, released together with the range.
+    /// \param mappings Mappings charged to the store for the page, released together with the range.
+    void add_shared_page(uint64_t store_offset, uint64_t mappings) {
+        m_shared_pages.push_back(store_offset);
+        m_shared_mappings += mappings;
+    }
 };
 
 /// \brief Data for empty memory ranges (nothing, really)
@@ -452,7 +501,8 @@ public:
         constexpr const auto log2_page_size = PMA_constants::PMA_PAGE_SIZE_LOG2;
         uint64_t page_in_range = ((address - get_start()) >> log2_page_size) << log2_page_size;
         constexpr const auto page_size = PMA_constants::PMA_PAGE_SIZE;
-        auto npages = (size + page_size - 1) / page_size;
+        // Count pages from the start of the first page, so unaligned ranges also mark their last page
+        auto npages = (address - get_start() - page_in_range + size + page_size - 1) / page_size;
         for (decltype(npages) i = 0; i < npages; ++i) {
             mark_dirty_page(page_in_range);
             page_in_range += page_size;
@@ -516,6 +566,12 @@ public:
     /// \param value Value to write
     /// \param size Data size
     void fill_memory(uint64_t paddr, unsigned char value, uint64_t size);
+
+    /// \brief Zeroes pma memory, releasing the host pages that back it when possible
+    /// \param paddr Destination address within pma range
+    /// \param size Data size
+    /// \details Pages entirely inside the range are handed back to the host, the rest is simply zeroed.
+    void discard_memory(uint64_t paddr, uint64_t size);
 };
 
 /// \brief Creates a PMA entry for a new memory range initially filled with zeros.
@@ -545,11 +601,50 @@ pma_entry make_callocd_memory_pma_entry(const std::string &description, uint64_t
 /// for the backing file in the host with the contents of the memory region.
 /// \param shared Whether target modifications to the memory region are
 /// reflected in the host's backing file.
+/// \param huge_pages Whether to advise the host to back the mapping with transparent huge pages.
 /// \returns Corresponding PMA entry
 /// \details \p length must match the size of the backing file.
 /// This function is typically used to map flash drives.
 pma_entry make_mmapd_memory_pma_entry(const std::string &description, uint64_t start, uint64_t length,
-    const std::string &path, bool shared);
+    const std::string &path, bool shared, bool huge_pages = false);
+
+/// \brief Creates a PMA entry for a new memory range initially filled with zeros, backed by anonymous host memory.
+/// \param description Informative description of PMA entry for use in error messages
+/// \param start Start of PMA range.
+/// \param length Length of PMA range.
+/// \param huge_pages Whether to try to back the range with huge pages.
+/// \returns Corresponding PMA entry
+/// \details Falls back to transparent huge pages, and then to regular pages, when huge pages are not available.
+/// All pages start clean, and the host only commits memory to them once they are written to.
+pma_entry make_anonymous_memory_pma_entry(const std::string &description, uint64_t start, uint64_t length,
+    bool huge_pages);
+
+/// \brief Creates a PMA entry for a new memory range initially filled with the contents of a backing file,
+/// backed by anonymous host memory.
+/// \param description Informative description of PMA entry for use in error messages
+/// \param start Start of PMA range.
+/// \param length Length of PMA range.
+/// \param path Path to backing file.
+/// \param huge_pages Whether to try to back the range with huge pages.
+/// \returns Corresponding PMA entry
+/// \details Only pages with non-zero contents in the image file are copied and marked dirty.
+pma_entry make_anonymous_memory_pma_entry(const std::string &description, uint64_t start, uint64_t length,
+    const std::string &path, bool huge_pages);
+
+/// \brief Creates a PMA entry for a new memory region mapping an open file descriptor.
+/// \param description Informative description of PMA entry for use in error messages
+/// \param start Start of physical memory range in the target address
+/// space on which to map the memory region.
+/// \param length Length of physical memory range in the
+/// target address space on which to map the memory region.
+/// \param fd File descriptor of the backing file in the host with the contents of the memory region.
+/// \param shared Whether target modifications to the memory region are
+/// reflected in the host's backing file.
+/// \returns Corresponding PMA entry
+/// \details The file descriptor can be closed after the entry is created.
+/// When \p shared is false, pages are shared with the backing file until they are written to.
+pma_entry make_mmapd_memory_pma_entry(const std::string &description, uint64_t start, uint64_t length, int fd,
+    bool shared);
 
 /// \brief Creates a PMA entry for a new mock memory region (no allocation).
 /// \param description Informative description of PMA entry for use in error messages
@@ -23,13 +23,89 @@
 #include "device-state-access.h"
 #include "i-state-access.h"
 #include "shadow-pmas.h"
-#include "unique-c-ptr.h"
-#include <map>
+#include "step-log-writer.h"
+#include <algorithm>
 #include <optional>
 #include <vector>
 
 namespace cartesi {
 
+/// \class touched_page_set
+/// \brief Addresses of the pages touched during a step
+/// \details Pages are found through an open-addressing hash index, and remember the order in which they were added.
+template <uint64_t PAGE_SIZE>
+class touched_page_set {
+public:
+    using address_type = uint64_t;
+
+private:
+    static constexpr uint64_t INITIAL_SLOTS = 1024; ///< Initial size of hash index (a power of 2)
+    static constexpr uint64_t EMPTY_SLOT = UINT64_MAX;
+
+    std::vector<address_type> m_addresses; ///< Address of each page, in order of insertion
+    std::vector<uint64_t> m_slots;         ///< Hash index from page address to page number
+
+    static uint64_t hash_slot(address_type page, uint64_t mask) {
+        // Fibonacci hashing of the page index spreads consecutive pages over the index
+        return ((page / PAGE_SIZE) * UINT64_C(0x9e3779b97f4a7c15) >> 32) & mask;
+    }
+
+    uint64_t find_slot(address_type page) const {
+        const uint64_t mask = m_slots.size() - 1;
+        uint64_t slot = hash_slot(page, mask);
+        while (m_slots[slot] != EMPTY_SLOT && m_addresses[m_slots[slot]] != page) {
+            slot = (slot + 1) & mask;
+        }
+        return slot;
+    }
+
+    void grow_index() {
+        m_slots.assign(std::max(INITIAL_SLOTS, 2 * m_slots.size()), EMPTY_SLOT);
+        for (uint64_t i = 0; i < m_addresses.size(); ++i) {
+            m_slots[find_slot(m_addresses[i])] = i;
+        }
+    }
+
+public:
+    /// \brief Returns the number of pages in the set
+    uint64_t size() const {
+        return m_addresses.size();
+    }
+
+    /// \brief Returns the address of the i-th page added to the set
+    address_type get_address(uint64_t i) const {
+        return m_addresses[i];
+    }
+
+    /// \brief Adds a page to the set, unless it is already there
+    /// \param page Page address
+    /// \returns True if the page was added, false if it was already in the set
+    bool insert(address_type page) {
+        // Keep the index at most half full, so probe sequences stay short
+        if (2 * (m_addresses.size() + 1) > m_slots.size()) {
+            grow_index();
+        }
+        const uint64_t slot = find_slot(page);
+        if (m_slots[slot] != EMPTY_SLOT) {
+            return false;
+        }
+        m_slots[slot] = m_addresses.size();
+        m_addresses.push_back(page);
+        return true;
+    }
+
+    /// \brief Returns the positions of all pages in the set, sorted by page address
+    std::vector<uint64_t> get_sorted_order() const {
+        std::vector<uint64_t> order(m_addresses.size());
+        for (uint64_t i = 0; i < order.size(); ++i) {
+            order[i] = i;
+        }
+        std::sort(order.begin(), order.end(),
+            [this](uint64_t a, uint64_t b) { return m_addresses[a] < m_addresses[b]; });
+        return order;
+    }
+};
+
 /// \class record_step_state_access
 /// \brief Records machine state access into a step log file
 class record_step_state_access : public i_state_access<record_step_state_access, pma_entry> {
@@ -39,8 +115,7 @@ public:
     constexpr static uint64_t TREE_PAGE_SIZE = UINT64_C(1) << TREE_LOG2_PAGE_SIZE;
 
     using address_type = machine_merkle_tree::address_type;
-    using page_data_type = std::array<uint8_t, TREE_PAGE_SIZE>;
-    using pages_type = std::map<address_type, page_data_type>;
+    using pages_type = touched_page_set<TREE_PAGE_SIZE>;
     using hash_type = machine_merkle_tree::hash_type;
     using sibling_hashes_type = std::vector<hash_type>;
     using page_indices_type = std::vector<address_type>;
@@ -48,11 +123,13 @@ public:
     struct context {
         /// \brief Constructor of record step state access context
         /// \param filename where to save the log
-        explicit context(std::string filename) : filename(std::move(filename)) {
+        /// \details Throws std::runtime_error if the file already exists
+        explicit context(std::string filename) : filename(std::move(filename)), writer(this->filename) {
             ;
         }
         std::string filename;             ///<  where to save the log
-        mutable pages_type touched_pages; ///<  copy of all pages touched during execution
+        mutable pages_type touched_pages; ///<  addresses of all pages touched during execution
+        mutable step_log_writer writer;   ///<  streams touched pages to the log file
     };
 
 private:
@@ -65,51 +142,17 @@ public:
     /// \brief Constructor of record step state access
     /// \param context Context for the recording with the log filename
     /// \param m reference to machine
-    /// \details The log file is saved when finish() is called
+    /// \details Pages are written to the log file as they are touched, and the file is completed by finish()
     record_step_state_access(context &context, machine &m) : m_context(context), m_m(m) {
-        if (os_file_exists(m_context.filename.c_str())) {
-            throw std::runtime_error("file already exists");
-        }
+        ;
     }
 
-    /// \brief Finish recording and save the log file
+    /// \brief Finish recording and complete the log file
     void finish() {
+        const auto order = m_context.touched_pages.get_sorted_order();
         // get sibling hashes of all touched pages
-        auto sibling_hashes = get_sibling_hashes();
-        uint64_t page_count = m_context.touched_pages.size();
-        uint64_t sibling_count = sibling_hashes.size();
-
-        // Write log file.
-        // The log format is as follows:
-        // page_count, [(page_index, data, scratch_area), ...], sibling_count, [sibling_hash, ...]
-        // We store the page index, instead of the page address.
-        // Scratch area is used by the replay to store page hashes, which change during replay
-        // This is to work around the lack of dynamic memory allocation when replaying the log in microarchitectures
-        auto fp = unique_fopen(m_context.filename.c_str(), "wb");
-        if (fwrite(&page_count, sizeof(page_count), 1, fp.get()) != 1) {
-            throw std::runtime_error("Could not write page count to log file");
-        }
-        for (auto &[address, data] : m_context.touched_pages) {
-            const auto page_index = address >> TREE_LOG2_PAGE_SIZE;
-            if (fwrite(&page_index, sizeof(page_index), 1, fp.get()) != 1) {
-                throw std::runtime_error("Could not write page index to log file");
-            }
-            if (fwrite(data.data(), data.size(), 1, fp.get()) != 1) {
-                throw std::runtime_error("Could not write page data to log file");
-            }
-            static const hash_type all_zeros{};
-            if (fwrite(all_zeros.data(), sizeof(all_zeros), 1, fp.get()) != 1) {
-                throw std::runtime_error("Could not write page hash scratch to log file");
-            }
-        }
-        if (fwrite(&sibling_count, sizeof(sibling_count), 1, fp.get()) != 1) {
-            throw std::runtime_error("Could not write sibling count to log file");
-        }
-        for (auto &hash : sibling_hashes) {
-            if (fwrite(hash.data(), sizeof(hash), 1, fp.get()) != 1) {
-                throw std::runtime_error("Could not write sibling hash to log file");
-            }
-        }
+        auto sibling_hashes = get_sibling_hashes(order);
+        m_context.writer.finish(order, sibling_hashes);
     }
 
 private:
@@ -119,21 +162,23 @@ private:
     /// \param address address of the page
     void touch_page(address_type address) const {
         auto page = address & ~(TREE_PAGE_SIZE - 1);
-        if (m_context.touched_pages.find(page) != m_context.touched_pages.end()) {
+        if (!m_context.touched_pages.insert(page)) {
             return; // already saved
         }
-        auto [it, _] = m_context.touched_pages.emplace(page, page_data_type());
-        m_m.read_memory(page, it->second.data(), it->second.size());
+        auto *data = m_context.writer.acquire_page();
+        m_m.read_memory(page, data, TREE_PAGE_SIZE);
+        m_context.writer.submit_page(page >> TREE_LOG2_PAGE_SIZE, data);
     }
 
     /// \brief Get the sibling hashes of all touched pages
-    sibling_hashes_type get_sibling_hashes() {
+    /// \param order Positions of touched pages, sorted by page address
+    sibling_hashes_type get_sibling_hashes(const std::vector<uint64_t> &order) {
         sibling_hashes_type sibling_hashes{};
         // page address are converted to page indices, in order to avoid overflows
         page_indices_type page_indices{};
-        // iterate in ascending order of page addresses (the container is ordered by key)
-        for (const auto &[address, _] : m_context.touched_pages) {
-            page_indices.push_back(address >> TREE_LOG2_PAGE_SIZE);
+        page_indices.reserve(order.size());
+        for (const auto i : order) {
+            page_indices.push_back(m_context.touched_pages.get_address(i) >> TREE_LOG2_PAGE_SIZE);
         }
         auto next_page_index = page_indices.cbegin();
         get_sibling_hashes_impl(0, TREE_LOG2_ROOT_SIZE - TREE_LOG2_PAGE_SIZE, page_indices, next_page_index,
@@ -627,6 +672,28 @@ private:
         throw std::runtime_error("Unexpected call to do_write_memory");
     }
 
+    // NOLINTNEXTLINE(readability-convert-member-functions-to-static)
+    bool do_discard_memory(uint64_t paddr, uint64_t length) {
+        (void) paddr;
+        (void) length;
+        throw std::runtime_error("Unexpected call to do_discard_memory");
+    }
+
+    // NOLINTNEXTLINE(readability-convert-member-functions-to-static)
+    unsigned char *do_get_host_memory_range(uint64_t paddr, uint64_t length, bool writable) {
+        (void) paddr;
+        (void) length;
+        (void) writable;
+        throw std::runtime_error("Unexpected call to do_get_host_memory_range");
+    }
+
+    // NOLINTNEXTLINE(readability-convert-member-functions-to-static)
+    bool do_mark_dirty_memory(uint64_t paddr, uint64_t length) {
+        (void) paddr;
+        (void) length;
+        throw std::runtime_error("Unexpected call to do_mark_dirty_memory");
+    }
+
     static unsigned char *do_get_host_memory(pma_entry &pma) {
         return pma.get_memory_noexcept().get_host_memory();
     }
@@ -885,6 +885,28 @@ private:
         return false;
     }
 
+    // NOLINTNEXTLINE(readability-convert-member-functions-to-static)
+    bool do_discard_memory(uint64_t paddr, uint64_t length) {
+        (void) paddr;
+        (void) length;
+        return false;
+    }
+
+    // NOLINTNEXTLINE(readability-convert-member-functions-to-static)
+    unsigned char *do_get_host_memory_range(uint64_t paddr, uint64_t length, bool writable) {
+        (void) paddr;
+        (void) length;
+        (void) writable;
+        return nullptr;
+    }
+
+    // NOLINTNEXTLINE(readability-convert-member-functions-to-static)
+    bool do_mark_dirty_memory(uint64_t paddr, uint64_t length) {
+        (void) paddr;
+        (void) length;
+        return false;
+    }
+
     template <typename T>
     void do_write_memory_word(uint64_t paddr, const unsigned char *hpage, uint64_t hoffset, T val) {
         (void) hpage;
@@ -479,6 +479,36 @@ private:
         }
     }
 
+    bool do_discard_memory(uint64_t paddr, uint64_t length) {
+        try {
+            m_m.discard_memory(paddr, length);
+            return true;
+        } catch (...) {
+            return false;
+        }
+    }
+
+    unsigned char *do_get_host_memory_range(uint64_t paddr, uint64_t length, bool writable) {
+        try {
+            unsigned char *host_memory = m_m.get_host_memory(paddr, length);
+            if (writable) {
+                m_m.mark_dirty_memory(paddr, length);
+            }
+            return host_memory;
+        } catch (...) {
+            return nullptr;
+        }
+    }
+
+    bool do_mark_dirty_memory(uint64_t paddr, uint64_t length) {
+        try {
+            m_m.mark_dirty_memory(paddr, length);
+            return true;
+        } catch (...) {
+            return false;
+        }
+    }
+
     static unsigned char *do_get_host_memory(pma_entry &pma) {
         return pma.get_memory_noexcept().get_host_memory();
     }
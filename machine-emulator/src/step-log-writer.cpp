@@ -0,0 +1,197 @@
+// Copyright Cartesi and individual authors (see AUTHORS)
+// SPDX-License-Identifier: LGPL-3.0-or-later
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any
+// later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License along
+// with this program (see COPYING). If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "step-log-writer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+#include "os.h"
+
+namespace cartesi {
+
+step_log_writer::step_log_writer(std::string filename, uint64_t queue_size) : m_filename(std::move(filename)) {
+    if (os_file_exists(m_filename.c_str())) {
+        throw std::runtime_error("file already exists");
+    }
+    queue_size = std::max<uint64_t>(queue_size, 1);
+    m_fp = unique_fopen(m_filename.c_str(), "w+b");
+    m_buffers = std::make_unique_for_overwrite<unsigned char[]>(queue_size * PAGE_SIZE);
+    m_free.reserve(queue_size);
+    for (uint64_t i = 0; i < queue_size; ++i) {
+        m_free.push_back(m_buffers.get() + i * PAGE_SIZE);
+    }
+    // Leave room for the page count, written by finish()
+    seek_record(0);
+#ifdef HAVE_THREADS
+    m_thread = std::thread([this] { write_loop(); });
+#endif
+}
+
+step_log_writer::~step_log_writer() {
+    stop();
+    if (!m_finished) {
+        m_fp.reset();
+        std::ignore = std::remove(m_filename.c_str());
+    }
+}
+
+void step_log_writer::stop() {
+#ifdef HAVE_THREADS
+    if (m_thread.joinable()) {
+        {
+            const std::scoped_lock lock(m_mutex);
+            m_stopping = true;
+        }
+        m_queue_cv.notify_one();
+        m_thread.join();
+    }
+#endif
+}
+
+void step_log_writer::seek_record(uint64_t i) {
+    if (fseek(m_fp.get(), static_cast<long>(sizeof(uint64_t) + i * RECORD_SIZE), SEEK_SET) != 0) {
+        throw std::runtime_error("Could not seek in log file");
+    }
+}
+
+void step_log_writer::write_record(uint64_t page_index, const unsigned char *data) {
+    if (fwrite(&page_index, sizeof(page_index), 1, m_fp.get()) != 1) {
+        throw std::runtime_error("Could not write page index to log file");
+    }
+    if (fwrite(data, PAGE_SIZE, 1, m_fp.get()) != 1) {
+        throw std::runtime_error("Could not write page data to log file");
+    }
+    // Scratch area is used by the replay to store page hashes, which change during replay
+    static const hash_type all_zeros{};
+    if (fwrite(all_zeros.data(), sizeof(all_zeros), 1, m_fp.get()) != 1) {
+        throw std::runtime_error("Could not write page hash scratch to log file");
+    }
+}
+
+void step_log_writer::write_loop() {
+    std::unique_lock lock(m_mutex);
+    for (;;) {
+        m_queue_cv.wait(lock, [this] { return !m_queue.empty() || m_stopping; });
+        if (m_queue.empty()) {
+            return;
+        }
+        const auto page = m_queue.front();
+        m_queue.pop_front();
+        if (!m_error) {
+            lock.unlock();
+            try {
+                write_record(page.page_index, page.data);
+            } catch (...) {
+                lock.lock();
+                m_error = std::current_exception();
+                lock.unlock();
+            }
+            lock.lock();
+        }
+        m_free.push_back(page.data);
+        m_free_cv.notify_one();
+    }
+}
+
+unsigned char *step_log_writer::acquire_page() {
+    std::unique_lock lock(m_mutex);
+    m_free_cv.wait(lock, [this] { return !m_free.empty(); });
+    if (m_error) {
+        std::rethrow_exception(m_error);
+    }
+    auto *data = m_free.back();
+    m_free.pop_back();
+    return data;
+}
+
+void step_log_writer::submit_page(uint64_t page_index, unsigned char *data) {
+    ++m_page_count;
+#ifdef HAVE_THREADS
+    {
+        const std::scoped_lock lock(m_mutex);
+        m_queue.push_back({.page_index = page_index, .data = data});
+    }
+    m_queue_cv.notify_one();
+#else
+    m_free.push_back(data);
+    write_record(page_index, data);
+#endif
+}
+
+void step_log_writer::finish(const std::vector<uint64_t> &order, const std::vector<hash_type> &sibling_hashes) {
+    stop();
+    if (m_error) {
+        std::rethrow_exception(m_error);
+    }
+    if (order.size() != m_page_count) {
+        throw std::invalid_argument("page order does not cover all pages written to log file");
+    }
+    // Move records into ascending order of page index by following the cycles of the permutation,
+    // so only two records are ever held in memory
+    std::vector<unsigned char> saved(RECORD_SIZE);
+    std::vector<unsigned char> record(RECORD_SIZE);
+    std::vector<bool> placed(m_page_count, false);
+    const auto read_record = [this](uint64_t i, std::vector<unsigned char> &buf) {
+        seek_record(i);
+        if (fread(buf.data(), buf.size(), 1, m_fp.get()) != 1) {
+            throw std::runtime_error("Could not read page back from log file");
+        }
+    };
+    const auto rewrite_record = [this](uint64_t i, const std::vector<unsigned char> &buf) {
+        seek_record(i);
+        if (fwrite(buf.data(), buf.size(), 1, m_fp.get()) != 1) {
+            throw std::runtime_error("Could not write page to log file");
+        }
+    };
+    for (uint64_t start = 0; start < m_page_count; ++start) {
+        if (placed[start] || order[start] == start) {
+            continue;
+        }
+        read_record(start, saved);
+        uint64_t i = start;
+        while (order[i] != start) {
+            read_record(order[i], record);
+            rewrite_record(i, record);
+            placed[i] = true;
+            i = order[i];
+        }
+        rewrite_record(i, saved);
+        placed[i] = true;
+    }
+    if (fseek(m_fp.get(), 0, SEEK_SET) != 0 || fwrite(&m_page_count, sizeof(m_page_count), 1, m_fp.get()) != 1) {
+        throw std::runtime_error("Could not write page count to log file");
+    }
+    seek_record(m_page_count);
+    const uint64_t sibling_count = sibling_hashes.size();
+    if (fwrite(&sibling_count, sizeof(sibling_count), 1, m_fp.get()) != 1) {
+        throw std::runtime_error("Could not write sibling count to log file");
+    }
+    for (const auto &hash : sibling_hashes) {
+        if (fwrite(hash.data(), sizeof(hash), 1, m_fp.get()) != 1) {
+            throw std::runtime_error("Could not write sibling hash to log file");
+        }
+    }
+    if (fclose(m_fp.release()) != 0) {
+        throw std::runtime_error("Could not close log file");
+    }
+    m_finished = true;
+}
+
+} // namespace cartesi
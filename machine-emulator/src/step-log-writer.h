@@ -0,0 +1,114 @@
+// Copyright Cartesi and individual authors (see AUTHORS)
+// SPDX-License-Identifier: LGPL-3.0-or-later
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any
+// later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License along
+// with this program (see COPYING). If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef STEP_LOG_WRITER_H
+#define STEP_LOG_WRITER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "machine-merkle-tree.h"
+#include "os-features.h"
+#include "unique-c-ptr.h"
+
+#ifdef HAVE_THREADS
+#include <thread>
+#endif
+
+/// \file
+/// \brief Streaming writer for step log files
+
+namespace cartesi {
+
+/// \class step_log_writer
+/// \brief Writes the pages of a step log to its file while the step is being recorded
+/// \details Pages are queued as they are first touched and written, in that order, by a background thread. Only a
+/// bounded number of page buffers exist at any time. When recording ends, finish() moves the page records into
+/// ascending order of page index, in place, and completes the file. The file layout is
+/// page_count, [(page_index, data, scratch_area), ...], sibling_count, [sibling_hash, ...].
+/// If the writer is destroyed before finish() succeeds, the incomplete file is removed.
+class step_log_writer {
+public:
+    static constexpr uint64_t PAGE_SIZE = UINT64_C(1) << machine_merkle_tree::get_log2_page_size();
+    using hash_type = machine_merkle_tree::hash_type;
+
+    /// \brief Constructor
+    /// \param filename Name of log file to create
+    /// \param queue_size Maximum number of pages waiting to be written
+    /// \details Throws std::runtime_error if the file already exists
+    explicit step_log_writer(std::string filename, uint64_t queue_size = 64);
+
+    step_log_writer(const step_log_writer &other) = delete;
+    step_log_writer(step_log_writer &&other) = delete;
+    step_log_writer &operator=(const step_log_writer &other) = delete;
+    step_log_writer &operator=(step_log_writer &&other) = delete;
+
+    /// \brief Destructor
+    ~step_log_writer();
+
+    /// \brief Returns a buffer to be filled with the contents of the next page
+    /// \details Blocks until a buffer is available. Rethrows errors from the writer thread.
+    unsigned char *acquire_page();
+
+    /// \brief Queues a page obtained from acquire_page() to be written
+    /// \param page_index Index of page (i.e., its address divided by the page size)
+    /// \param data Buffer returned by acquire_page(), filled with the page contents
+    void submit_page(uint64_t page_index, unsigned char *data);
+
+    /// \brief Completes the log file
+    /// \param order Position in which each page was submitted, sorted by page index
+    /// \param sibling_hashes Sibling hashes of all pages
+    void finish(const std::vector<uint64_t> &order, const std::vector<hash_type> &sibling_hashes);
+
+private:
+    struct queued_page {
+        uint64_t page_index;
+        unsigned char *data;
+    };
+
+    static constexpr uint64_t RECORD_SIZE = sizeof(uint64_t) + PAGE_SIZE + sizeof(hash_type);
+
+    void write_record(uint64_t page_index, const unsigned char *data);
+    void write_loop();
+    void stop();
+    void seek_record(uint64_t i);
+
+    std::string m_filename;                     ///< Name of log file
+    unique_file_ptr m_fp;                       ///< Log file
+    std::unique_ptr<unsigned char[]> m_buffers; ///< Storage for all page buffers
+    std::vector<unsigned char *> m_free;        ///< Page buffers available to acquire_page()
+    std::deque<queued_page> m_queue;            ///< Pages waiting to be written
+    uint64_t m_page_count{0};                   ///< Number of pages submitted
+    bool m_stopping{false};                     ///< Tells writer thread to exit once the queue is empty
+    bool m_finished{false};                     ///< Whether the log file was completed
+    std::exception_ptr m_error;                 ///< First error found by the writer thread
+    std::mutex m_mutex;                         ///< Protects queue, free buffers, and error
+    std::condition_variable m_queue_cv;         ///< Signaled when a page is queued or on stop
+    std::condition_variable m_free_cv;          ///< Signaled when a buffer is freed
+#ifdef HAVE_THREADS
+    std::thread m_thread; ///< Writer thread
+#endif
+};
+
+} // namespace cartesi
+
+#endif
@@ -16,22 +16,439 @@
 
 #include "uarch-interpret.h"
 
+#include <algorithm>
+#include <array>
 #include <cstdint>
+#include <stdexcept>
 
+#include "pma-constants.h"
+#include "strict-aliasing.h"
+#include "uarch-bridge.h"
+#include "uarch-pristine.h"
 #include "uarch-state-access.h"
 #include "uarch-step.h"
 
+/// \file
+/// \brief Microarchitecture interpreter, used when no state access log is needed
+/// \details Instructions within the embedded RAM image are decoded once and kept in a cache indexed by address.
+/// Each entry remembers the raw instruction it came from, so code that is overwritten is simply decoded again.
+/// Registers and uarch RAM are accessed directly. Everything else (machine state registers, machine memory,
+/// ecalls, misaligned accesses, and illegal instructions) goes through uarch_step(), which remains the reference.
+
 namespace cartesi {
 
 // Declaration of explicit instantiation in module uarch-step.cpp
 extern template UArchStepStatus uarch_step(uarch_state_access &a);
 
+/// \brief Direct view of the state used by the fast path
+struct uarch_fast_view {
+    uarch_state &us;     ///< Uarch state
+    machine_state &s;    ///< Machine state
+    uint64_t ram_start;  ///< Start of uarch RAM
+    uint64_t ram_length; ///< Length of uarch RAM
+    unsigned char *host; ///< Host memory backing uarch RAM
+};
+
+/// \brief Decodes an instruction for the cache
+/// \param insn Raw instruction
+/// \returns Decoded instruction, with operation set to fallback when it must be executed by uarch_step()
+static uarch_decoded_insn uarch_decode(uint32_t insn) {
+    using op = uarch_decoded_op;
+    uarch_decoded_insn d{.insn = insn,
+        .op = op::fallback,
+        .rd = static_cast<uint8_t>((insn >> 7) & 0x1f),
+        .rs1 = static_cast<uint8_t>((insn >> 15) & 0x1f),
+        .rs2 = static_cast<uint8_t>((insn >> 20) & 0x1f),
+        .imm = 0};
+    const uint32_t funct3 = (insn >> 12) & 7;
+    const uint32_t funct7 = insn >> 25;
+    const int32_t imm_i = static_cast<int32_t>(insn) >> 20;
+    const int32_t imm_s = static_cast<int32_t>((static_cast<uint32_t>(static_cast<int32_t>(insn) >> 25) << 5) |
+        ((insn >> 7) & 0x1f));
+    const int32_t imm_b = static_cast<int32_t>((static_cast<uint32_t>(static_cast<int32_t>(insn) >> 31) << 12) |
+        (((insn >> 25) & 0x3f) << 5) | (((insn >> 8) & 0xf) << 1) | (((insn >> 7) & 1) << 11));
+    const int32_t imm_j = static_cast<int32_t>((static_cast<uint32_t>(static_cast<int32_t>(insn) >> 31) << 20) |
+        (((insn >> 21) & 0x3ff) << 1) | (((insn >> 20) & 1) << 11) | (((insn >> 12) & 0xff) << 12));
+    const int32_t shamt6 = static_cast<int32_t>((insn >> 20) & 0x3f);
+    const int32_t shamt5 = static_cast<int32_t>((insn >> 20) & 0x1f);
+    const auto set = [&d](op o, int32_t imm) {
+        d.op = o;
+        d.imm = imm;
+    };
+    switch (insn & 0x7f) {
+        case 0x37:
+            set(op::lui, static_cast<int32_t>(insn & 0xfffff000));
+            break;
+        case 0x17:
+            set(op::auipc, static_cast<int32_t>(insn & 0xfffff000));
+            break;
+        case 0x6f:
+            set(op::jal, imm_j);
+            break;
+        case 0x67:
+            if (funct3 == 0) {
+                set(op::jalr, imm_i);
+            }
+            break;
+        case 0x63: {
+            static constexpr std::array<op, 8> branches{op::beq, op::bne, op::fallback, op::fallback, op::blt,
+                op::bge, op::bltu, op::bgeu};
+            set(branches[funct3], imm_b);
+            break;
+        }
+        case 0x03: {
+            static constexpr std::array<op, 8> loads{op::lb, op::lh, op::lw, op::ld, op::lbu, op::lhu, op::lwu,
+                op::fallback};
+            set(loads[funct3], imm_i);
+            break;
+        }
+        case 0x23: {
+            static constexpr std::array<op, 8> stores{op::sb, op::sh, op::sw, op::sd, op::fallback, op::fallback,
+                op::fallback, op::fallback};
+            set(stores[funct3], imm_s);
+            break;
+        }
+        case 0x13:
+            switch (funct3) {
+                case 0:
+                    set(op::addi, imm_i);
+                    break;
+                case 1:
+                    if ((funct7 >> 1) == 0) {
+                        set(op::slli, shamt6);
+                    }
+                    break;
+                case 2:
+                    set(op::slti, imm_i);
+                    break;
+                case 3:
+                    set(op::sltiu, imm_i);
+                    break;
+                case 4:
+                    set(op::xori, imm_i);
+                    break;
+                case 5:
+                    if ((funct7 >> 1) == 0) {
+                        set(op::srli, shamt6);
+                    } else if ((funct7 >> 1) == 0x10) {
+                        set(op::srai, shamt6);
+                    }
+                    break;
+                case 6:
+                    set(op::ori, imm_i);
+                    break;
+                default:
+                    set(op::andi, imm_i);
+                    break;
+            }
+            break;
+        case 0x1b:
+            if (funct3 == 0) {
+                set(op::addiw, imm_i);
+            } else if (funct3 == 1 && funct7 == 0) {
+                set(op::slliw, shamt5);
+            } else if (funct3 == 5 && funct7 == 0) {
+                set(op::srliw, shamt5);
+            } else if (funct3 == 5 && funct7 == 0x20) {
+                set(op::sraiw, shamt5);
+            }
+            break;
+        case 0x33:
+            if (funct7 == 0) {
+                static constexpr std::array<op, 8> ops{op::add, op::sll, op::slt, op::sltu, op::xor_, op::srl, op::or_,
+                    op::and_};
+                set(ops[funct3], 0);
+            } else if (funct7 == 0x20 && funct3 == 0) {
+                set(op::sub, 0);
+            } else if (funct7 == 0x20 && funct3 == 5) {
+                set(op::sra, 0);
+            }
+            break;
+        case 0x3b:
+            if (funct7 == 0 && funct3 == 0) {
+                set(op::addw, 0);
+            } else if (funct7 == 0x20 && funct3 == 0) {
+                set(op::subw, 0);
+            } else if (funct7 == 0 && funct3 == 1) {
+                set(op::sllw, 0);
+            } else if (funct7 == 0 && funct3 == 5) {
+                set(op::srlw, 0);
+            } else if (funct7 == 0x20 && funct3 == 5) {
+                set(op::sraw, 0);
+            }
+            break;
+        case 0x0f:
+            if (funct3 == 0) {
+                set(op::fence, 0);
+            }
+            break;
+        default:
+            break;
+    }
+    return d;
+}
+
+/// \brief Reads an aligned word, directly from uarch RAM or from the machine state registers when possible
+static inline uint64_t uarch_load_word(uarch_state_access &a, const uarch_fast_view &v, uint64_t paddr) {
+    const uint64_t offset = paddr - v.ram_start;
+    if (offset < v.ram_length) {
+        return aliased_aligned_read<uint64_t>(v.host + offset);
+    }
+    // No memory range overlaps the processor shadow, so its registers can skip the memory range search
+    if (paddr - PMA_SHADOW_STATE_START < PMA_SHADOW_STATE_LENGTH) {
+        return uarch_bridge::read_register(paddr, v.s);
+    }
+    return a.read_word(paddr);
+}
+
+/// \brief Writes an aligned word, directly to uarch RAM or to the machine state registers when possible
+static inline void uarch_store_word(uarch_state_access &a, const uarch_fast_view &v, uint64_t paddr, uint64_t val) {
+    const uint64_t offset = paddr - v.ram_start;
+    if (offset < v.ram_length) {
+        aliased_aligned_write<uint64_t>(v.host + offset, val);
+        v.us.ram.mark_dirty_page(offset & ~PAGE_OFFSET_MASK);
+        return;
+    }
+    if (paddr - PMA_SHADOW_STATE_START < PMA_SHADOW_STATE_LENGTH) {
+        uarch_bridge::write_register(paddr, v.s, val);
+        return;
+    }
+    a.write_word(paddr, val);
+}
+
+/// \brief Reads a naturally aligned value of up to 8 bytes, zero-extended
+static inline uint64_t uarch_load(uarch_state_access &a, const uarch_fast_view &v, uint64_t paddr, int size) {
+    const uint64_t word = uarch_load_word(a, v, paddr & ~UINT64_C(7));
+    const uint64_t val = word >> ((paddr & 7) * 8);
+    return size == 8 ? val : val & ((UINT64_C(1) << (size * 8)) - 1);
+}
+
+/// \brief Writes a naturally aligned value of up to 8 bytes
+static inline void uarch_store(uarch_state_access &a, const uarch_fast_view &v, uint64_t paddr,
+    int size, uint64_t val) {
+    if (size == 8) {
+        uarch_store_word(a, v, paddr, val);
+        return;
+    }
+    // Same read-modify-write of the enclosing word as uarch_step()
+    const uint64_t palign = paddr & ~UINT64_C(7);
+    const uint64_t shift = (paddr & 7) * 8;
+    const uint64_t mask = ((UINT64_C(1) << (size * 8)) - 1) << shift;
+    const uint64_t word = uarch_load_word(a, v, palign);
+    uarch_store_word(a, v, palign, (word & ~mask) | ((val << shift) & mask));
+}
+
+/// \brief Executes a decoded instruction
+/// \returns False if the instruction must be executed by uarch_step() instead, in which case nothing was changed
+static inline bool uarch_execute(uarch_state_access &a, const uarch_fast_view &v,
+    const uarch_decoded_insn &d, uint64_t pc) {
+    using op = uarch_decoded_op;
+    auto &x = v.us.x;
+    const uint64_t rs1 = x[d.rs1];
+    const uint64_t rs2 = x[d.rs2];
+    const auto imm = static_cast<int64_t>(d.imm);
+    const auto write_rd = [&x, &d](uint64_t val) {
+        if (d.rd != 0) {
+            x[d.rd] = val;
+        }
+    };
+    const auto sext32 = [](uint64_t val) {
+        return static_cast<uint64_t>(static_cast<int64_t>(static_cast<int32_t>(val)));
+    };
+    uint64_t next_pc = pc + 4;
+    switch (d.op) {
+        case op::lui:
+            write_rd(static_cast<uint64_t>(imm));
+            break;
+        case op::auipc:
+            write_rd(pc + imm);
+            break;
+        case op::jal:
+            write_rd(pc + 4);
+            next_pc = pc + imm;
+            break;
+        case op::jalr:
+            write_rd(pc + 4);
+            next_pc = (rs1 + imm) & ~UINT64_C(1);
+            break;
+        case op::beq:
+            next_pc = rs1 == rs2 ? pc + imm : next_pc;
+            break;
+        case op::bne:
+            next_pc = rs1 != rs2 ? pc + imm : next_pc;
+            break;
+        case op::blt:
+            next_pc = static_cast<int64_t>(rs1) < static_cast<int64_t>(rs2) ? pc + imm : next_pc;
+            break;
+        case op::bge:
+            next_pc = static_cast<int64_t>(rs1) >= static_cast<int64_t>(rs2) ? pc + imm : next_pc;
+            break;
+        case op::bltu:
+            next_pc = rs1 < rs2 ? pc + imm : next_pc;
+            break;
+        case op::bgeu:
+            next_pc = rs1 >= rs2 ? pc + imm : next_pc;
+            break;
+        case op::lb:
+        case op::lh:
+        case op::lw:
+        case op::ld:
+        case op::lbu:
+        case op::lhu:
+        case op::lwu: {
+            static constexpr std::array<int, 7> sizes{1, 2, 4, 8, 1, 2, 4};
+            const int size = sizes[static_cast<int>(d.op) - static_cast<int>(op::lb)];
+            const uint64_t paddr = rs1 + imm;
+            if ((paddr & (size - 1)) != 0) {
+                return false;
+            }
+            uint64_t val = uarch_load(a, v, paddr, size);
+            if (d.op <= op::ld && size < 8) {
+                const int unused = 64 - (size * 8);
+                val = static_cast<uint64_t>(static_cast<int64_t>(val << unused) >> unused);
+            }
+            write_rd(val);
+            break;
+        }
+        case op::sb:
+        case op::sh:
+        case op::sw:
+        case op::sd: {
+            const int size = 1 << (static_cast<int>(d.op) - static_cast<int>(op::sb));
+            const uint64_t paddr = rs1 + imm;
+            if ((paddr & (size - 1)) != 0) {
+                return false;
+            }
+            uarch_store(a, v, paddr, size, rs2);
+            break;
+        }
+        case op::addi:
+            write_rd(rs1 + imm);
+            break;
+        case op::slti:
+            write_rd(static_cast<int64_t>(rs1) < imm ? 1 : 0);
+            break;
+        case op::sltiu:
+            write_rd(rs1 < static_cast<uint64_t>(imm) ? 1 : 0);
+            break;
+        case op::xori:
+            write_rd(rs1 ^ static_cast<uint64_t>(imm));
+            break;
+        case op::ori:
+            write_rd(rs1 | static_cast<uint64_t>(imm));
+            break;
+        case op::andi:
+            write_rd(rs1 & static_cast<uint64_t>(imm));
+            break;
+        case op::slli:
+            write_rd(rs1 << d.imm);
+            break;
+        case op::srli:
+            write_rd(rs1 >> d.imm);
+            break;
+        case op::srai:
+            write_rd(static_cast<uint64_t>(static_cast<int64_t>(rs1) >> d.imm));
+            break;
+        case op::addiw:
+            write_rd(sext32(rs1 + imm));
+            break;
+        case op::slliw:
+            write_rd(sext32(static_cast<uint32_t>(rs1) << d.imm));
+            break;
+        case op::srliw:
+            write_rd(sext32(static_cast<uint32_t>(rs1) >> d.imm));
+            break;
+        case op::sraiw:
+            write_rd(sext32(static_cast<uint64_t>(static_cast<int32_t>(rs1) >> d.imm)));
+            break;
+        case op::add:
+            write_rd(rs1 + rs2);
+            break;
+        case op::sub:
+            write_rd(rs1 - rs2);
+            break;
+        case op::sll:
+            write_rd(rs1 << (rs2 & 0x3f));
+            break;
+        case op::slt:
+            write_rd(static_cast<int64_t>(rs1) < static_cast<int64_t>(rs2) ? 1 : 0);
+            break;
+        case op::sltu:
+            write_rd(rs1 < rs2 ? 1 : 0);
+            break;
+        case op::xor_:
+            write_rd(rs1 ^ rs2);
+            break;
+        case op::srl:
+            write_rd(rs1 >> (rs2 & 0x3f));
+            break;
+        case op::sra:
+            write_rd(static_cast<uint64_t>(static_cast<int64_t>(rs1) >> (rs2 & 0x3f)));
+            break;
+        case op::or_:
+            write_rd(rs1 | rs2);
+            break;
+        case op::and_:
+            write_rd(rs1 & rs2);
+            break;
+        case op::addw:
+            write_rd(sext32(rs1 + rs2));
+            break;
+        case op::subw:
+            write_rd(sext32(rs1 - rs2));
+            break;
+        case op::sllw:
+            write_rd(sext32(static_cast<uint32_t>(rs1) << (rs2 & 0x1f)));
+            break;
+        case op::srlw:
+            write_rd(sext32(static_cast<uint32_t>(rs1) >> (rs2 & 0x1f)));
+            break;
+        case op::sraw:
+            write_rd(sext32(static_cast<uint64_t>(static_cast<int32_t>(rs1) >> (rs2 & 0x1f))));
+            break;
+        case op::fence:
+            break;
+        default:
+            return false;
+    }
+    v.us.pc = next_pc;
+    return true;
+}
+
 uarch_interpreter_break_reason uarch_interpret(uarch_state_access &a, uint64_t cycle_end) {
     uint64_t cycle = a.read_cycle();
     if (cycle_end < cycle) {
         throw std::invalid_argument{"uarch_cycle is past"};
     }
+    uarch_state &us = a.get_uarch_state();
+    const uarch_fast_view v{.us = us,
+        .s = a.get_machine_state(),
+        .ram_start = us.ram.get_start(),
+        .ram_length = us.ram.get_length(),
+        .host = us.ram.get_memory().get_host_memory()};
+    // Code lives in the embedded RAM image, so only that part of RAM is cached
+    if (us.decode_cache.empty()) {
+        us.decode_cache.resize(std::min<uint64_t>(uarch_pristine_ram_len, v.ram_length) / sizeof(uint32_t));
+    }
+    const uint64_t cached_length = us.decode_cache.size() * sizeof(uint32_t);
     while (cycle < cycle_end) {
+        if (us.halt_flag) {
+            return uarch_interpreter_break_reason::uarch_halted;
+        }
+        const uint64_t pc = us.pc;
+        const uint64_t pc_offset = pc - v.ram_start;
+        if ((pc & 3) == 0 && pc_offset < cached_length) {
+            const auto insn = aliased_aligned_read<uint32_t>(v.host + pc_offset);
+            auto &d = us.decode_cache[pc_offset / sizeof(uint32_t)];
+            if (d.op == uarch_decoded_op::undecoded || d.insn != insn) {
+                d = uarch_decode(insn);
+            }
+            if (uarch_execute(a, v, d, pc)) {
+                cycle += 1;
+                us.cycle = cycle;
+                continue;
+            }
+        }
         const UArchStepStatus status = uarch_step(a);
         switch (status) {
             case UArchStepStatus::Success:
@@ -84,6 +84,16 @@ public:
     /// \brief Default destructor
     ~uarch_state_access() = default;
 
+    /// \brief Returns uarch state for direct access.
+    uarch_state &get_uarch_state() {
+        return m_us;
+    }
+
+    /// \brief Returns machine state for direct access.
+    machine_state &get_machine_state() {
+        return m_s;
+    }
+
 private:
     friend i_uarch_state_access<uarch_state_access>;
 
@@ -22,12 +22,79 @@
 
 #include <array>
 #include <cstdint>
+#include <vector>
 
 #include "pma.h"
 #include "riscv-constants.h"
 
 namespace cartesi {
 
+/// \brief Operations of instructions decoded by uarch_interpret()
+enum class uarch_decoded_op : uint8_t {
+    undecoded, ///< Cache entry holds no decoded instruction
+    fallback,  ///< Instruction is executed by uarch_step()
+    lui,
+    auipc,
+    jal,
+    jalr,
+    beq,
+    bne,
+    blt,
+    bge,
+    bltu,
+    bgeu,
+    lb,
+    lh,
+    lw,
+    ld,
+    lbu,
+    lhu,
+    lwu,
+    sb,
+    sh,
+    sw,
+    sd,
+    addi,
+    slti,
+    sltiu,
+    xori,
+    ori,
+    andi,
+    slli,
+    srli,
+    srai,
+    addiw,
+    slliw,
+    srliw,
+    sraiw,
+    add,
+    sub,
+    sll,
+    slt,
+    sltu,
+    xor_,
+    srl,
+    sra,
+    or_,
+    and_,
+    addw,
+    subw,
+    sllw,
+    srlw,
+    sraw,
+    fence,
+};
+
+/// \brief Instruction decoded by uarch_interpret()
+struct uarch_decoded_insn {
+    uint32_t insn{};                                  ///< Raw instruction the entry was decoded from
+    uarch_decoded_op op{uarch_decoded_op::undecoded}; ///< Operation
+    uint8_t rd{};                                     ///< Destination register
+    uint8_t rs1{};                                    ///< First source register
+    uint8_t rs2{};                                    ///< Second source register
+    int32_t imm{};                                    ///< Immediate operand or shift amount
+};
+
 struct uarch_state {
     uarch_state() = default;
     ~uarch_state() = default;
@@ -42,9 +109,10 @@ struct uarch_state {
     std::array<uint64_t, UARCH_X_REG_COUNT> x{}; ///< Register file.
     uint64_t cycle{};                            ///< Cycles counter
     bool halt_flag{};
-    pma_entry shadow_state; ///< Shadow uarch state
-    pma_entry ram;          ///< Memory range for micro RAM
-    pma_entry empty_pma;    ///< Empty range fallback
+    pma_entry shadow_state;                       ///< Shadow uarch state
+    pma_entry ram;                                ///< Memory range for micro RAM
+    pma_entry empty_pma;                          ///< Empty range fallback
+    std::vector<uarch_decoded_insn> decode_cache; ///< Instructions of the RAM image, decoded by uarch_interpret()
 };
 
 } // namespace cartesi
@@ -0,0 +1,72 @@
+// Copyright Cartesi and individual authors (see AUTHORS)
+// SPDX-License-Identifier: LGPL-3.0-or-later
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any
+// later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License along
+// with this program (see COPYING). If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "virtio-balloon.h"
+
+#include <cstdint>
+
+#include "i-device-state-access.h"
+#include "virtio-device.h"
+
+namespace cartesi {
+
+virtio_balloon::virtio_balloon(uint32_t virtio_idx) :
+    virtio_device(virtio_idx, VIRTIO_DEVICE_MEMORY_BALLOONING, VIRTIO_BALLOON_F_PAGE_REPORTING,
+        sizeof(virtio_balloon_config_space)) {}
+
+void virtio_balloon::on_device_reset() {
+    // Nothing to do, the device keeps no state besides its queues
+}
+
+void virtio_balloon::on_device_ok(i_device_state_access * /*a*/) {
+    // Nothing to do, we never ask the guest to inflate the balloon
+}
+
+bool virtio_balloon::on_device_queue_available(i_device_state_access *a, uint32_t queue_idx, uint16_t desc_idx,
+    uint32_t /*read_avail_len*/, uint32_t /*write_avail_len*/) {
+    if (queue_idx == VIRTIO_BALLOON_REPORTINGQ) { // Guest reported free pages
+        return discard_reported_pages(a, queue_idx, desc_idx);
+    }
+    if (queue_idx == VIRTIO_BALLOON_INFLATEQ || queue_idx == VIRTIO_BALLOON_DEFLATEQ) {
+        // The balloon target is always 0, so the guest has no reason to use these queues,
+        // just hand the buffers back in case it does
+        if (!consume_queue(a, queue_idx, desc_idx)) {
+            notify_device_needs_reset(a);
+            return false;
+        }
+        return true;
+    } // Other queues are unexpected
+    notify_device_needs_reset(a);
+    return false;
+}
+
+bool virtio_balloon::discard_reported_pages(i_device_state_access *a, uint32_t queue_idx, uint16_t desc_idx) {
+    const virtq &vq = queue[queue_idx];
+    // Each write buffer in the chain is a range of free guest pages
+    uint32_t discarded_len = 0;
+    if (!vq.discard_desc_mem(a, desc_idx, &discarded_len)) {
+        notify_device_needs_reset(a);
+        return false;
+    }
+    // Consume the queue and notify the driver, so it can reuse the pages
+    if (!consume_queue(a, queue_idx, desc_idx, discarded_len)) {
+        notify_device_needs_reset(a);
+        return false;
+    }
+    return true;
+}
+
+} // namespace cartesi
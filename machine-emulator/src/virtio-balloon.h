@@ -0,0 +1,77 @@
+// Copyright Cartesi and individual authors (see AUTHORS)
+// SPDX-License-Identifier: LGPL-3.0-or-later
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any
+// later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License along
+// with this program (see COPYING). If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef VIRTIO_BALLOON_H
+#define VIRTIO_BALLOON_H
+
+#include <cstdint>
+
+#include "i-device-state-access.h"
+#include "virtio-device.h"
+
+namespace cartesi {
+
+/// \brief VirtIO balloon features
+enum virtio_balloon_features : uint64_t {
+    VIRTIO_BALLOON_F_MUST_TELL_HOST = (UINT64_C(1) << 0),  ///< Host must be told before balloon pages are used.
+    VIRTIO_BALLOON_F_STATS_VQ = (UINT64_C(1) << 1),        ///< A virtqueue for reporting guest memory statistics.
+    VIRTIO_BALLOON_F_DEFLATE_ON_OOM = (UINT64_C(1) << 2),  ///< Deflate balloon on guest out of memory condition.
+    VIRTIO_BALLOON_F_FREE_PAGE_HINT = (UINT64_C(1) << 3),  ///< Device has support for free page hinting.
+    VIRTIO_BALLOON_F_PAGE_POISON = (UINT64_C(1) << 4),     ///< Guest is using page poisoning.
+    VIRTIO_BALLOON_F_PAGE_REPORTING = (UINT64_C(1) << 5),  ///< Device has support for free page reporting.
+};
+
+/// \brief VirtIO balloon virtqueue indexes
+/// \details Optional queues are numbered contiguously after the ones that exist,
+/// and since statistics and free page hinting are not offered, the reporting queue comes right after deflateq.
+enum virtio_balloon_virtq : uint32_t {
+    VIRTIO_BALLOON_INFLATEQ = 0,   ///< Queue with pages the guest gives to the balloon
+    VIRTIO_BALLOON_DEFLATEQ = 1,   ///< Queue with pages the guest takes back from the balloon
+    VIRTIO_BALLOON_REPORTINGQ = 2, ///< Queue with ranges of free pages reported by the guest
+};
+
+/// \brief VirtIO balloon config space
+struct virtio_balloon_config_space {
+    uint32_t num_pages;             ///< Number of pages the host wants in the balloon
+    uint32_t actual;                ///< Number of pages the guest has in the balloon
+    uint32_t free_page_hint_cmd_id; ///< Free page hinting command id
+    uint32_t poison_val;            ///< Page poisoning value
+};
+
+/// \brief VirtIO balloon device
+/// \details Only free page reporting is implemented: the host never asks the guest to inflate the balloon,
+/// but ranges of pages the guest reports as free are zeroed and their host memory is released.
+class virtio_balloon final : public virtio_device {
+public:
+    explicit virtio_balloon(uint32_t virtio_idx);
+
+    void on_device_reset() override;
+    void on_device_ok(i_device_state_access *a) override;
+    bool on_device_queue_available(i_device_state_access *a, uint32_t queue_idx, uint16_t desc_idx,
+        uint32_t read_avail_len, uint32_t write_avail_len) override;
+
+    /// \brief Releases the memory of reported free pages and hands the buffer back to the guest.
+    bool discard_reported_pages(i_device_state_access *a, uint32_t queue_idx, uint16_t desc_idx);
+
+    virtio_balloon_config_space *get_config() {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        return reinterpret_cast<virtio_balloon_config_space *>(config_space.data());
+    }
+};
+
+} // namespace cartesi
+
+#endif
@@ -0,0 +1,489 @@
+// Copyright Cartesi and individual authors (see AUTHORS)
+// SPDX-License-Identifier: LGPL-3.0-or-later
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any
+// later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License along
+// with this program (see COPYING). If not, see <https://www.gnu.org/licenses/>.
+//
+
+/// \file
+/// \brief VirtIO block device.
+/// \details \{
+///
+/// The block device serves guest sector reads and writes from a host disk image file.
+/// The guest sees it as /dev/vda (then /dev/vdb, and so on for each block device).
+///
+/// \}
+
+// Enable this define to debug VirtIO block operations
+// #define DEBUG_VIRTIO_BLK
+
+#include "virtio-blk.h"
+
+#ifdef HAVE_VIRTIO_BLK
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/select.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "i-device-state-access.h"
+#include "machine-config.h"
+#include "os.h"
+#include "virtio-device.h"
+
+namespace cartesi {
+
+using namespace std::string_literals;
+
+/// \brief Reads from or writes to the disk image straight from host memory spans of a queue buffer
+static ssize_t transfer_host_spans(int fd, const virtq_host_spans &spans, uint64_t offset, bool write) {
+    std::array<iovec, VIRTIO_QUEUE_NUM_MAX> iov{};
+    const int iovcnt = virtq_host_spans_to_iovec(spans, iov);
+    if (write) {
+        return pwritev(fd, iov.data(), iovcnt, static_cast<off_t>(offset));
+    }
+    return preadv(fd, iov.data(), iovcnt, static_cast<off_t>(offset));
+}
+
+/// \brief Discards a range of the disk image
+/// \returns 0 on success, otherwise the host errno.
+static int discard_range([[maybe_unused]] int fd, [[maybe_unused]] uint64_t offset,
+    [[maybe_unused]] uint64_t length) {
+#ifdef FALLOC_FL_PUNCH_HOLE
+    if (fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, static_cast<off_t>(offset),
+            static_cast<off_t>(length)) < 0) {
+        // Discard is only a hint, it is fine if the host file system cannot release the range
+        return (errno == EOPNOTSUPP) ? 0 : errno;
+    }
+#endif
+    return 0;
+}
+
+/// \brief Performs the host I/O of a job
+/// \details This is safe to call from worker threads.
+static void execute_io_job(virtio_blk_io_job &job) {
+    if (job.status != VIRTIO_BLK_S_OK) {
+        return;
+    }
+    int err = 0;
+    switch (job.type) {
+        case VIRTIO_BLK_T_IN:
+        case VIRTIO_BLK_T_OUT: {
+            const bool write = job.type == VIRTIO_BLK_T_OUT;
+            ssize_t ret = 0;
+            if (job.in_place) {
+                ret = transfer_host_spans(job.fd, job.spans, job.offset, write);
+            } else if (write) {
+                ret = pwrite(job.fd, job.buf.data(), job.len, static_cast<off_t>(job.offset));
+            } else {
+                ret = pread(job.fd, job.buf.data(), job.len, static_cast<off_t>(job.offset));
+            }
+            // Sectors are always inside the disk image, so a short transfer is an error as well
+            if (ret < 0) {
+                err = errno;
+            } else if (static_cast<uint64_t>(ret) != job.len) {
+                err = EIO;
+            }
+            break;
+        }
+        case VIRTIO_BLK_T_FLUSH:
+            if (fdatasync(job.fd) < 0) {
+                err = errno;
+            }
+            break;
+        case VIRTIO_BLK_T_DISCARD:
+            for (const auto &seg : job.segs) {
+                err = discard_range(job.fd, seg.sector * VIRTIO_BLK_SECTOR_SIZE,
+                    static_cast<uint64_t>(seg.num_sectors) * VIRTIO_BLK_SECTOR_SIZE);
+                if (err != 0) {
+                    break;
+                }
+            }
+            break;
+        default:
+            // Nothing to do for requests replied from memory (e.g. get id)
+            break;
+    }
+    if (err != 0) {
+#ifdef DEBUG_VIRTIO_BLK
+        std::ignore = fprintf(stderr, "virtio-blk: request type=%d failed: errno=%d\n", job.type, err);
+#endif
+        job.status = VIRTIO_BLK_S_IOERR;
+    }
+}
+
+/// \brief Gets the features offered by a block device
+static uint64_t get_blk_features(const virtio_blk_config &config) {
+    uint64_t features = VIRTIO_BLK_F_SEG_MAX | VIRTIO_BLK_F_FLUSH;
+    if (config.read_only) {
+        features |= VIRTIO_BLK_F_RO;
+    } else if (config.discard) {
+        features |= VIRTIO_BLK_F_DISCARD;
+    }
+    return features;
+}
+
+virtio_blk::virtio_blk(uint32_t virtio_idx, const virtio_blk_config &config) :
+    virtio_device(virtio_idx, VIRTIO_DEVICE_BLOCK, get_blk_features(config), sizeof(virtio_blk_config_space)),
+    m_read_only(config.read_only),
+    m_discard(config.discard && !config.read_only) {
+    const auto &path = config.image_filename;
+    if (path.empty()) {
+        throw std::invalid_argument{"virtio block device image filename is missing"};
+    }
+    m_fd = open(path.c_str(), (m_read_only ? O_RDONLY : O_RDWR) | O_CLOEXEC);
+    if (m_fd < 0) {
+        throw std::system_error{errno, std::generic_category(), "could not open image file '"s + path + "'"s};
+    }
+    struct stat st{};
+    if (fstat(m_fd, &st) < 0) {
+        const int err = errno;
+        std::ignore = close(m_fd);
+        throw std::system_error{err, std::generic_category(), "unable to obtain length of image file '"s + path + "'"s};
+    }
+    if (!S_ISREG(st.st_mode) || st.st_size % VIRTIO_BLK_SECTOR_SIZE != 0) {
+        std::ignore = close(m_fd);
+        throw std::invalid_argument{"image file '"s + path + "' length must be a multiple of 512"s};
+    }
+    m_capacity = static_cast<uint64_t>(st.st_size) / VIRTIO_BLK_SECTOR_SIZE;
+    // The id is the image file name, truncated (and not null terminated) when too long
+    const auto slash = path.find_last_of('/');
+    m_id = (slash == std::string::npos) ? path : path.substr(slash + 1);
+    m_id.resize(std::min<size_t>(m_id.size(), VIRTIO_BLK_ID_BYTES));
+    // Initialize config space
+    virtio_blk_config_space *cfg = get_config();
+    cfg->capacity = m_capacity;
+    cfg->seg_max = VIRTIO_BLK_SEG_MAX;
+    cfg->max_discard_sectors = VIRTIO_BLK_MAX_DISCARD_SECTORS;
+    cfg->max_discard_seg = VIRTIO_BLK_MAX_DISCARD_SEG;
+    cfg->discard_sector_alignment = 1;
+}
+
+virtio_blk::~virtio_blk() {
+    // Jobs may still be using the file descriptor and guest memory
+    drain_io_jobs(true);
+    if (m_fd >= 0) {
+        std::ignore = close(m_fd);
+    }
+}
+
+void virtio_blk::on_device_reset() {
+    // Statuses of pending jobs must not reach the reinitialized queues
+    drain_io_jobs(false);
+}
+
+void virtio_blk::on_device_ok(i_device_state_access * /*a*/) {
+    // Nothing to do.
+}
+
+bool virtio_blk::on_device_queue_available(i_device_state_access *a, uint32_t queue_idx, uint16_t desc_idx,
+    uint32_t read_avail_len, uint32_t write_avail_len) {
+    // There is a single request queue
+    if (queue_idx != 0) {
+        notify_device_needs_reset(a);
+        return false;
+    }
+    auto job = std::make_unique<virtio_blk_io_job>();
+    job->queue_idx = queue_idx;
+    job->desc_idx = desc_idx;
+    job->fd = m_fd;
+    if (!prepare_io_job(a, *job, read_avail_len, write_avail_len)) {
+        notify_device_needs_reset(a);
+        return false;
+    }
+    return dispatch_io_job(a, std::move(job));
+}
+
+bool virtio_blk::prepare_io_job(i_device_state_access *a, virtio_blk_io_job &job, uint32_t read_avail_len,
+    uint32_t write_avail_len) {
+    const virtq &vq = queue[job.queue_idx];
+    // Every request must have a header and room for the status
+    virtio_blk_req_header header{};
+    if (read_avail_len < sizeof(header) || write_avail_len < 1) {
+        return false;
+    }
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    if (!vq.read_desc_mem(a, job.desc_idx, 0, reinterpret_cast<unsigned char *>(&header), sizeof(header))) {
+        return false;
+    }
+    job.type = header.type;
+    job.status_off = write_avail_len - 1;
+#ifdef DEBUG_VIRTIO_BLK
+    std::ignore = fprintf(stderr, "virtio-blk: request type=%d sector=%ld read_len=%d write_len=%d\n", header.type,
+        header.sector, read_avail_len, write_avail_len);
+#endif
+    // Checks whether a range of sectors is inside the disk
+    const auto is_inside = [this](uint64_t sector, uint64_t num_sectors) {
+        return sector <= m_capacity && num_sectors <= m_capacity - sector;
+    };
+    switch (header.type) {
+        case VIRTIO_BLK_T_IN:
+        case VIRTIO_BLK_T_OUT: {
+            const bool write = header.type == VIRTIO_BLK_T_OUT;
+            // Data follows the header when writing, and precedes the status when reading
+            job.len = write ? read_avail_len - sizeof(header) : job.status_off;
+            job.offset = header.sector * VIRTIO_BLK_SECTOR_SIZE;
+            if ((write && m_read_only) || job.len % VIRTIO_BLK_SECTOR_SIZE != 0 ||
+                !is_inside(header.sector, job.len / VIRTIO_BLK_SECTOR_SIZE)) {
+                job.status = VIRTIO_BLK_S_IOERR;
+                return true;
+            }
+            if (write) {
+                // Write to the disk straight from the request data,
+                // copying it to a temporary buffer only when the guest memory cannot be accessed in place
+                job.in_place = vq.get_desc_host_spans(a, job.desc_idx, sizeof(header), job.len, false, job.spans);
+                if (!job.in_place) {
+                    job.buf.resize(job.len);
+                    return vq.read_desc_mem(a, job.desc_idx, sizeof(header), job.buf.data(), job.len);
+                }
+                return true;
+            }
+#ifndef HAVE_VIRTIO_BLK_ASYNC_IO
+            // Read from the disk straight into the request data.
+            // Worker threads must not write guest memory behind the device back, so they always use a temporary buffer.
+            job.in_place = vq.get_desc_host_spans(a, job.desc_idx, 0, job.len, true, job.spans);
+#endif
+            if (!job.in_place) {
+                job.buf.resize(job.len);
+            }
+            return true;
+        }
+        case VIRTIO_BLK_T_FLUSH:
+            return true;
+        case VIRTIO_BLK_T_GET_ID:
+            job.len = std::min<uint32_t>(job.status_off, VIRTIO_BLK_ID_BYTES);
+            job.buf.assign(job.len, 0);
+            std::copy_n(m_id.begin(), std::min<size_t>(m_id.size(), job.len), job.buf.begin());
+            return true;
+        case VIRTIO_BLK_T_DISCARD: {
+            if (!m_discard) {
+                job.status = VIRTIO_BLK_S_UNSUPP;
+                return true;
+            }
+            const uint32_t segs_len = read_avail_len - sizeof(header);
+            const uint32_t num_segs = segs_len / sizeof(virtio_blk_discard_segment);
+            if (segs_len % sizeof(virtio_blk_discard_segment) != 0 || num_segs == 0 ||
+                num_segs > VIRTIO_BLK_MAX_DISCARD_SEG) {
+                job.status = VIRTIO_BLK_S_IOERR;
+                return true;
+            }
+            job.segs.resize(num_segs);
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+            if (!vq.read_desc_mem(a, job.desc_idx, sizeof(header), reinterpret_cast<unsigned char *>(job.segs.data()),
+                    segs_len)) {
+                return false;
+            }
+            for (const auto &seg : job.segs) {
+                // The unmap flag is only meaningful for write zeroes requests
+                if (seg.flags != 0) {
+                    job.status = VIRTIO_BLK_S_UNSUPP;
+                    return true;
+                }
+                if (!is_inside(seg.sector, seg.num_sectors)) {
+                    job.status = VIRTIO_BLK_S_IOERR;
+                    return true;
+                }
+            }
+            return true;
+        }
+        default:
+            job.status = VIRTIO_BLK_S_UNSUPP;
+            return true;
+    }
+}
+
+bool virtio_blk::dispatch_io_job(i_device_state_access *a, std::unique_ptr<virtio_blk_io_job> job) {
+#ifdef HAVE_VIRTIO_BLK_ASYNC_IO
+    // Failed requests and requests without host I/O are replied right away
+    const bool has_io = job->status == VIRTIO_BLK_S_OK && job->type != VIRTIO_BLK_T_GET_ID;
+    if (has_io && start_io_workers()) {
+        // The status is written later, when polled after the job is finished
+        {
+            const std::lock_guard<std::mutex> lock(m_io_mutex);
+            ++m_io_pending;
+            m_io_queue.push_back(std::move(job));
+        }
+        m_io_queue_cv.notify_one();
+        return true;
+    }
+#endif
+    execute_io_job(*job);
+    return complete_io_job(a, *job);
+}
+
+bool virtio_blk::complete_io_job(i_device_state_access *a, virtio_blk_io_job &job) {
+    const virtq &vq = queue[job.queue_idx];
+    uint32_t written_len = 0;
+    const bool has_data = job.type == VIRTIO_BLK_T_IN || job.type == VIRTIO_BLK_T_GET_ID;
+    if (has_data && job.status == VIRTIO_BLK_S_OK) {
+        if (!job.in_place && !vq.write_desc_mem(a, job.desc_idx, 0, job.buf.data(), job.len)) {
+            notify_device_needs_reset(a);
+            return false;
+        }
+        written_len = job.len;
+    }
+    // The status is the last byte of the write buffer
+    if (!vq.write_desc_mem(a, job.desc_idx, job.status_off, &job.status, sizeof(job.status))) {
+        notify_device_needs_reset(a);
+        return false;
+    }
+    written_len += sizeof(job.status);
+    // Consume the queue and notify the driver
+    if (!consume_queue(a, job.queue_idx, job.desc_idx, written_len)) {
+        notify_device_needs_reset(a);
+        return false;
+    }
+    notify_queue_used(a);
+    return true;
+}
+
+void virtio_blk::drain_io_jobs([[maybe_unused]] bool stop) {
+#ifdef HAVE_VIRTIO_BLK_ASYNC_IO
+    if (m_io_workers.empty()) {
+        return;
+    }
+    {
+        std::unique_lock<std::mutex> lock(m_io_mutex);
+        m_io_done_cv.wait(lock, [this] { return m_io_pending == 0; });
+        m_io_done.clear();
+        if (!stop) {
+            return;
+        }
+        m_io_stopping = true;
+    }
+    m_io_queue_cv.notify_all();
+    for (auto &worker : m_io_workers) {
+        worker.join();
+    }
+    m_io_workers.clear();
+    for (int &fd : m_io_wakeup_fds) {
+        std::ignore = close(fd);
+        fd = -1;
+    }
+#endif
+}
+
+#ifdef HAVE_VIRTIO_BLK_ASYNC_IO
+
+bool virtio_blk::start_io_workers() {
+    if (!m_io_workers.empty()) {
+        return true;
+    }
+    if (m_io_stopping) {
+        return false;
+    }
+    // Finished jobs write to this pipe, so the device is polled right away even when the guest is idle
+    if (pipe(m_io_wakeup_fds.data()) != 0) {
+        m_io_wakeup_fds = {-1, -1};
+        return false;
+    }
+    for (const int fd : m_io_wakeup_fds) {
+        std::ignore = fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        std::ignore = fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+    try {
+        for (uint32_t i = 0; i < VIRTIO_BLK_IO_WORKERS; ++i) {
+            m_io_workers.emplace_back([this] { run_io_worker(); });
+        }
+    } catch (std::system_error &) {
+        // Run with the workers we managed to start, or synchronously if none
+        if (m_io_workers.empty()) {
+            for (int &fd : m_io_wakeup_fds) {
+                std::ignore = close(fd);
+                fd = -1;
+            }
+            return false;
+        }
+    }
+    return true;
+}
+
+void virtio_blk::run_io_worker() {
+    std::unique_lock<std::mutex> lock(m_io_mutex);
+    while (true) {
+        m_io_queue_cv.wait(lock, [this] { return m_io_stopping || !m_io_queue.empty(); });
+        if (m_io_queue.empty()) {
+            return;
+        }
+        std::unique_ptr<virtio_blk_io_job> job = std::move(m_io_queue.front());
+        m_io_queue.pop_front();
+        lock.unlock();
+        execute_io_job(*job);
+        lock.lock();
+        --m_io_pending;
+        m_io_done.push_back(std::move(job));
+        m_io_done_cv.notify_all();
+        // Wake up the device thread, a full pipe is fine because it is going to wake up anyway
+        const char wakeup = 0;
+        std::ignore = write(m_io_wakeup_fds[1], &wakeup, sizeof(wakeup));
+    }
+}
+
+#endif
+
+void virtio_blk::prepare_select([[maybe_unused]] select_fd_sets *fds, uint64_t * /*timeout_us*/) {
+#ifdef HAVE_VIRTIO_BLK_ASYNC_IO
+    if (m_io_workers.empty()) {
+        return;
+    }
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    auto *readfds = reinterpret_cast<fd_set *>(fds->readfds);
+    FD_SET(m_io_wakeup_fds[0], readfds);
+    fds->maxfd = std::max(m_io_wakeup_fds[0], fds->maxfd);
+#endif
+}
+
+bool virtio_blk::poll_selected([[maybe_unused]] int select_ret, [[maybe_unused]] select_fd_sets *fds,
+    [[maybe_unused]] i_device_state_access *da) {
+#ifdef HAVE_VIRTIO_BLK_ASYNC_IO
+    if (m_io_workers.empty()) {
+        return false;
+    }
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    auto *readfds = reinterpret_cast<fd_set *>(fds->readfds);
+    if (select_ret > 0 && FD_ISSET(m_io_wakeup_fds[0], readfds)) {
+        std::array<char, 64> wakeups{};
+        while (read(m_io_wakeup_fds[0], wakeups.data(), wakeups.size()) > 0) {
+        }
+    }
+    // Complete finished jobs, even if their wake ups were consumed by an earlier poll
+    std::vector<std::unique_ptr<virtio_blk_io_job>> done;
+    {
+        const std::lock_guard<std::mutex> lock(m_io_mutex);
+        done.swap(m_io_done);
+    }
+    for (auto &job : done) {
+        std::ignore = complete_io_job(da, *job);
+    }
+    return !done.empty();
+#else
+    return false;
+#endif
+}
+
+} // namespace cartesi
+
+#endif // HAVE_VIRTIO_BLK
@@ -0,0 +1,234 @@
+// Copyright Cartesi and individual authors (see AUTHORS)
+// SPDX-License-Identifier: LGPL-3.0-or-later
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any
+// later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License along
+// with this program (see COPYING). If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef VIRTIO_BLK_H
+#define VIRTIO_BLK_H
+
+#include "os-features.h"
+
+#if defined(HAVE_POSIX_FS) && !defined(_WIN32)
+#define HAVE_VIRTIO_BLK
+
+#ifdef HAVE_THREADS
+// Service requests on host worker threads, with many of them in flight
+#define HAVE_VIRTIO_BLK_ASYNC_IO
+#endif
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef HAVE_VIRTIO_BLK_ASYNC_IO
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#endif
+
+#include "compiler-defines.h"
+#include "i-device-state-access.h"
+#include "machine-config.h"
+#include "virtio-device.h"
+
+namespace cartesi {
+
+/// \brief VirtIO block features
+enum virtio_blk_features : uint64_t {
+    VIRTIO_BLK_F_SIZE_MAX = (UINT64_C(1) << 1),      ///< Maximum size of any single segment is in size_max.
+    VIRTIO_BLK_F_SEG_MAX = (UINT64_C(1) << 2),       ///< Maximum number of segments in a request is in seg_max.
+    VIRTIO_BLK_F_GEOMETRY = (UINT64_C(1) << 4),      ///< Disk-style geometry specified in geometry.
+    VIRTIO_BLK_F_RO = (UINT64_C(1) << 5),            ///< Device is read-only.
+    VIRTIO_BLK_F_BLK_SIZE = (UINT64_C(1) << 6),      ///< Block size of disk is in blk_size.
+    VIRTIO_BLK_F_FLUSH = (UINT64_C(1) << 9),         ///< Cache flush command support.
+    VIRTIO_BLK_F_TOPOLOGY = (UINT64_C(1) << 10),     ///< Device exports information on optimal I/O alignment.
+    VIRTIO_BLK_F_CONFIG_WCE = (UINT64_C(1) << 11),   ///< Device can toggle its cache writeback mode.
+    VIRTIO_BLK_F_MQ = (UINT64_C(1) << 12),           ///< Device supports multiqueue.
+    VIRTIO_BLK_F_DISCARD = (UINT64_C(1) << 13),      ///< Device can support discard command.
+    VIRTIO_BLK_F_WRITE_ZEROES = (UINT64_C(1) << 14), ///< Device can support write zeroes command.
+};
+
+/// \brief VirtIO block constants
+enum virtio_blk_constants : uint32_t {
+    VIRTIO_BLK_SECTOR_SIZE = 512,                  ///< Sector size, requests always address 512 byte sectors
+    VIRTIO_BLK_SEG_MAX = VIRTIO_QUEUE_NUM_MAX - 2, ///< Maximum number of data segments (header and status aside)
+    VIRTIO_BLK_MAX_DISCARD_SEG = 32,               ///< Maximum number of segments in a discard request
+    VIRTIO_BLK_MAX_DISCARD_SECTORS = UINT32_MAX,   ///< Maximum number of sectors in a discard segment
+    VIRTIO_BLK_ID_BYTES = 20,                      ///< Length of the device id string
+    VIRTIO_BLK_IO_WORKERS = 4,                     ///< Number of host worker threads servicing requests
+};
+
+/// \brief VirtIO block request types
+enum virtio_blk_req_type : uint32_t {
+    VIRTIO_BLK_T_IN = 0,            ///< Read sectors
+    VIRTIO_BLK_T_OUT = 1,           ///< Write sectors
+    VIRTIO_BLK_T_FLUSH = 4,         ///< Flush written sectors to the host file
+    VIRTIO_BLK_T_GET_ID = 8,        ///< Get device id string
+    VIRTIO_BLK_T_DISCARD = 11,      ///< Discard sectors
+    VIRTIO_BLK_T_WRITE_ZEROES = 13, ///< Write zeroes to sectors
+};
+
+/// \brief VirtIO block request status
+enum virtio_blk_req_status : uint8_t {
+    VIRTIO_BLK_S_OK = 0,     ///< Success
+    VIRTIO_BLK_S_IOERR = 1,  ///< Device or driver error
+    VIRTIO_BLK_S_UNSUPP = 2, ///< Request unsupported by device
+};
+
+/// \brief VirtIO block request header, at the start of the read buffer
+struct PACKED virtio_blk_req_header {
+    uint32_t type;     ///< Request type (see virtio_blk_req_type)
+    uint32_t reserved; ///< Reserved
+    uint64_t sector;   ///< First sector of the request
+};
+
+/// \brief VirtIO block discard segment, following the request header
+struct PACKED virtio_blk_discard_segment {
+    uint64_t sector;      ///< First sector of the segment
+    uint32_t num_sectors; ///< Number of sectors in the segment
+    uint32_t flags;       ///< Segment flags
+};
+
+/// \brief VirtIO block config space
+struct PACKED virtio_blk_config_space {
+    uint64_t capacity;                 ///< Capacity in 512 byte sectors
+    uint32_t size_max;                 ///< Maximum segment size (valid with VIRTIO_BLK_F_SIZE_MAX)
+    uint32_t seg_max;                  ///< Maximum number of segments (valid with VIRTIO_BLK_F_SEG_MAX)
+    uint16_t cylinders;                ///< Geometry cylinders (valid with VIRTIO_BLK_F_GEOMETRY)
+    uint8_t heads;                     ///< Geometry heads (valid with VIRTIO_BLK_F_GEOMETRY)
+    uint8_t sectors;                   ///< Geometry sectors (valid with VIRTIO_BLK_F_GEOMETRY)
+    uint32_t blk_size;                 ///< Block size (valid with VIRTIO_BLK_F_BLK_SIZE)
+    uint8_t physical_block_exp;        ///< Logical blocks per physical block, log2 (valid with VIRTIO_BLK_F_TOPOLOGY)
+    uint8_t alignment_offset;          ///< Offset of first aligned logical block (valid with VIRTIO_BLK_F_TOPOLOGY)
+    uint16_t min_io_size;              ///< Suggested minimum I/O size in blocks (valid with VIRTIO_BLK_F_TOPOLOGY)
+    uint32_t opt_io_size;              ///< Optimal sustained I/O size in blocks (valid with VIRTIO_BLK_F_TOPOLOGY)
+    uint8_t writeback;                 ///< Writeback mode (valid with VIRTIO_BLK_F_CONFIG_WCE)
+    uint8_t unused0;                   ///< Reserved
+    uint16_t num_queues;               ///< Number of queues (valid with VIRTIO_BLK_F_MQ)
+    uint32_t max_discard_sectors;      ///< Maximum discard sectors in a segment (valid with VIRTIO_BLK_F_DISCARD)
+    uint32_t max_discard_seg;          ///< Maximum number of discard segments (valid with VIRTIO_BLK_F_DISCARD)
+    uint32_t discard_sector_alignment; ///< Discard alignment in sectors (valid with VIRTIO_BLK_F_DISCARD)
+    uint32_t max_write_zeroes_sectors; ///< Maximum write zeroes sectors (valid with VIRTIO_BLK_F_WRITE_ZEROES)
+    uint32_t max_write_zeroes_seg;     ///< Maximum write zeroes segments (valid with VIRTIO_BLK_F_WRITE_ZEROES)
+    uint8_t write_zeroes_may_unmap;    ///< Whether write zeroes may unmap (valid with VIRTIO_BLK_F_WRITE_ZEROES)
+    std::array<uint8_t, 3> unused1;    ///< Reserved
+};
+
+/// \brief VirtIO block request that performs host I/O
+/// \details The host I/O only works on copies of the request arguments, without touching the device
+/// or guest memory, so it can be executed by a worker thread while the guest keeps running.
+/// The status is then written to the queue by the device.
+struct virtio_blk_io_job {
+    uint32_t queue_idx = 0;                       ///< Queue index of the request
+    uint16_t desc_idx = 0;                        ///< Head descriptor index of the request
+    uint32_t type = 0;                            ///< Request type (see virtio_blk_req_type)
+    int fd = -1;                                  ///< Host file descriptor of the disk image
+    uint64_t offset = 0;                          ///< Request offset in the disk image
+    uint32_t len = 0;                             ///< Request data length
+    uint32_t status_off = 0;                      ///< Offset of the status byte in the write buffer
+    bool in_place = false;                        ///< Whether data is accessed in place, through spans
+    virtq_host_spans spans;                       ///< Host memory spans of the request data (valid only when in_place)
+    std::vector<uint8_t> buf;                     ///< Request data (valid only when not in_place)
+    std::vector<virtio_blk_discard_segment> segs; ///< Discard segments (discard only)
+    uint8_t status = VIRTIO_BLK_S_OK;             ///< Request status
+};
+
+/// \brief VirtIO block device
+/// \details Sectors are read from and written to a host disk image file, instead of being mapped
+/// into the guest address space like flash drives, so large disks cost neither address space nor hashing.
+class virtio_blk final : public virtio_device {
+    int m_fd = -1;            ///< Host file descriptor of the disk image
+    uint64_t m_capacity = 0;  ///< Disk capacity in sectors
+    bool m_read_only = false; ///< Whether the disk is read-only
+    bool m_discard = false;   ///< Whether discard requests are supported
+    std::string m_id;         ///< Device id string reported to the guest
+
+#ifdef HAVE_VIRTIO_BLK_ASYNC_IO
+    std::vector<std::thread> m_io_workers;                     ///< Worker threads, started lazily
+    std::deque<std::unique_ptr<virtio_blk_io_job>> m_io_queue; ///< Jobs waiting for a worker
+    std::vector<std::unique_ptr<virtio_blk_io_job>> m_io_done; ///< Finished jobs waiting to be replied
+    uint64_t m_io_pending = 0;                                 ///< Number of jobs not finished yet
+    std::mutex m_io_mutex;                                     ///< Protects the job queues
+    std::condition_variable m_io_queue_cv;                     ///< Signaled when a job is queued or on stop
+    std::condition_variable m_io_done_cv;                      ///< Signaled when a job is finished
+    std::array<int, 2> m_io_wakeup_fds{-1, -1};                ///< Pipe written by workers after finishing a job
+    bool m_io_stopping = false;                                ///< Whether workers must exit
+#endif
+
+public:
+    /// \brief Constructor
+    /// \param virtio_idx VirtIO device index.
+    /// \param config Block device configuration.
+    virtio_blk(uint32_t virtio_idx, const virtio_blk_config &config);
+    ~virtio_blk() override;
+    virtio_blk(const virtio_blk &other) = delete;
+    virtio_blk(virtio_blk &&other) = delete;
+    virtio_blk &operator=(const virtio_blk &other) = delete;
+    virtio_blk &operator=(virtio_blk &&other) = delete;
+
+    void on_device_reset() override;
+    void on_device_ok(i_device_state_access *a) override;
+    bool on_device_queue_available(i_device_state_access *a, uint32_t queue_idx, uint16_t desc_idx,
+        uint32_t read_avail_len, uint32_t write_avail_len) override;
+    void prepare_select(select_fd_sets *fds, uint64_t *timeout_us) override;
+    bool poll_selected(int select_ret, select_fd_sets *fds, i_device_state_access *da) override;
+
+    virtio_blk_config_space *get_config() {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        return reinterpret_cast<virtio_blk_config_space *>(config_space.data());
+    }
+
+private:
+    /// \brief Parses a request into a job
+    /// \param a The state accessor for the current device.
+    /// \param job Receives the request, its status is set to a failure when the request is invalid.
+    /// \param read_avail_len Total readable length in the descriptor buffer.
+    /// \param write_avail_len Total writable length in the descriptor buffer.
+    /// \returns True if successful, false if an error happened while reading the queue buffer.
+    bool prepare_io_job(i_device_state_access *a, virtio_blk_io_job &job, uint32_t read_avail_len,
+        uint32_t write_avail_len);
+
+    /// \brief Executes the host I/O of a request, asynchronously when possible
+    /// \param a The state accessor for the current device.
+    /// \param job Request job.
+    /// \returns True if successful, false if an error happened while replying.
+    bool dispatch_io_job(i_device_state_access *a, std::unique_ptr<virtio_blk_io_job> job);
+
+    /// \brief Writes the data and status of a request whose host I/O was executed, and consumes its buffer
+    /// \param a The state accessor for the current device.
+    /// \param job Request job.
+    /// \returns True if successful, false if an error happened while replying.
+    bool complete_io_job(i_device_state_access *a, virtio_blk_io_job &job);
+
+    /// \brief Waits until all jobs are finished and drops their replies, stopping worker threads if requested
+    void drain_io_jobs(bool stop);
+
+#ifdef HAVE_VIRTIO_BLK_ASYNC_IO
+    /// \brief Starts the worker threads, if not started yet
+    /// \returns True if the workers are running, false if jobs must be executed synchronously.
+    bool start_io_workers();
+
+    /// \brief Worker thread loop
+    void run_io_worker();
+#endif
+};
+
+} // namespace cartesi
+
+#endif // defined(HAVE_POSIX_FS) && !defined(_WIN32)
+
+#endif
@@ -29,6 +29,7 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstddef>
 #include <cstdint>
 
 namespace cartesi {
@@ -69,12 +70,148 @@ static bool virtq_get_ring_avail_elem_desc_idx(const virtq &vq, i_device_state_a
     return a->read_memory(addr, reinterpret_cast<unsigned char *>(pdesc_idx), sizeof(uint16_t));
 }
 
+static bool virtq_get_used_event(const virtq &vq, i_device_state_access *a, uint16_t *pused_event) {
+    // The used_event field follows the available ring
+    const uint64_t addr = vq.avail_addr + sizeof(virtq_header) + (vq.num * sizeof(uint16_t));
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    return a->read_memory(addr, reinterpret_cast<unsigned char *>(pused_event), sizeof(uint16_t));
+}
+
+static bool virtq_set_avail_event(const virtq &vq, i_device_state_access *a, uint16_t avail_event) {
+    // The avail_event field follows the used ring
+    const uint64_t addr = vq.used_addr + sizeof(virtq_header) + (vq.num * sizeof(virtq_used_elem));
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    return a->write_memory(addr, reinterpret_cast<const unsigned char *>(&avail_event), sizeof(uint16_t));
+}
+
 static bool virtq_get_desc(const virtq &vq, i_device_state_access *a, uint16_t desc_idx, virtq_desc *pdesc) {
+    // Packed buffer descriptors were copied when the buffer was made available
+    if (vq.packed) {
+        *pdesc = vq.packed_descs[desc_idx & (VIRTIO_QUEUE_NUM_MAX - 1)];
+        return true;
+    }
     const uint64_t addr = vq.desc_addr + ((desc_idx & (vq.num - 1)) * sizeof(virtq_desc));
     // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
     return a->read_memory(addr, reinterpret_cast<unsigned char *>(pdesc), sizeof(virtq_desc));
 }
 
+static inline bool virtq_get_packed_wrap_counter(const virtq &vq, uint16_t desc_pos) {
+    // The wrap counter starts at 1 and flips every time the position wraps around the ring
+    return (desc_pos & vq.num) == 0;
+}
+
+static inline uint16_t virtq_get_packed_off_wrap(const virtq &vq, uint16_t desc_pos) {
+    const uint16_t wrap_counter = virtq_get_packed_wrap_counter(vq, desc_pos) ? 1 : 0;
+    return static_cast<uint16_t>((desc_pos & (vq.num - 1)) | (wrap_counter << 15));
+}
+
+static bool virtq_get_packed_desc(const virtq &vq, i_device_state_access *a, uint16_t desc_pos,
+    virtq_packed_desc *pdesc) {
+    const uint64_t addr = vq.desc_addr + ((desc_pos & (vq.num - 1)) * sizeof(virtq_packed_desc));
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    return a->read_memory(addr, reinterpret_cast<unsigned char *>(pdesc), sizeof(virtq_packed_desc));
+}
+
+static bool virtq_set_packed_used_desc(const virtq &vq, i_device_state_access *a, uint16_t desc_pos, uint16_t id,
+    uint32_t len) {
+    virtq_packed_desc used_desc{};
+    used_desc.len = len;
+    used_desc.id = id;
+    // Both flags match the wrap counter in used descriptors
+    if (virtq_get_packed_wrap_counter(vq, desc_pos)) {
+        used_desc.flags = VIRTQ_PACKED_DESC_F_AVAIL | VIRTQ_PACKED_DESC_F_USED;
+    }
+    // The buffer address is left untouched
+    constexpr uint64_t used_off = offsetof(virtq_packed_desc, len);
+    const uint64_t addr = vq.desc_addr + ((desc_pos & (vq.num - 1)) * sizeof(virtq_packed_desc)) + used_off;
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    const auto *data = reinterpret_cast<const unsigned char *>(&used_desc) + used_off;
+    return a->write_memory(addr, data, sizeof(virtq_packed_desc) - used_off);
+}
+
+static bool virtq_get_packed_driver_event(const virtq &vq, i_device_state_access *a, virtq_packed_event *pevent) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    return a->read_memory(vq.avail_addr, reinterpret_cast<unsigned char *>(pevent), sizeof(virtq_packed_event));
+}
+
+static bool virtq_set_packed_device_event(const virtq &vq, i_device_state_access *a, const virtq_packed_event *pevent) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    return a->write_memory(vq.used_addr, reinterpret_cast<const unsigned char *>(pevent), sizeof(virtq_packed_event));
+}
+
+static inline bool virtq_need_event(uint16_t event_idx, uint16_t new_idx, uint16_t old_idx) {
+    // Whether event_idx is among the indexes from old_idx up to new_idx, exclusive, using the same wrap around
+    // arithmetic as the driver
+    return static_cast<uint16_t>(new_idx - event_idx - 1) < static_cast<uint16_t>(new_idx - old_idx);
+}
+
+static bool virtq_fetch_packed_buffer(virtq &vq, i_device_state_access *a, bool *pfetched) {
+    *pfetched = false;
+    const bool wrap_counter = virtq_get_packed_wrap_counter(vq, vq.avail_desc_pos);
+    uint16_t desc_pos = vq.avail_desc_pos;
+    uint16_t head_idx = 0;
+    uint16_t prev_idx = 0;
+    uint16_t count = 0;
+    // Copy all descriptors of the buffer, they are laid out sequentially in the ring
+    while (true) {
+        virtq_packed_desc desc{};
+        if (!virtq_get_packed_desc(vq, a, desc_pos, &desc)) {
+            return false;
+        }
+        if (count == 0) {
+            // The buffer is available when its avail flag matches the wrap counter and its used flag does not
+            const bool avail = (desc.flags & VIRTQ_PACKED_DESC_F_AVAIL) != 0;
+            const bool used = (desc.flags & VIRTQ_PACKED_DESC_F_USED) != 0;
+            if (avail != wrap_counter || used == wrap_counter) {
+                return true;
+            }
+        }
+        // The driver can never make more descriptors available than the ring size,
+        // and indirect descriptors were not negotiated
+        if (vq.free_desc_count == 0 || (desc.flags & VIRTQ_DESC_F_INDIRECT) != 0) {
+            return false;
+        }
+        const uint16_t desc_idx = vq.free_desc_idx;
+        vq.free_desc_idx = vq.packed_descs[desc_idx].next;
+        --vq.free_desc_count;
+        virtq_desc &copy = vq.packed_descs[desc_idx];
+        copy.paddr = desc.paddr;
+        copy.len = desc.len;
+        copy.flags = desc.flags & (VIRTQ_DESC_F_NEXT | VIRTQ_DESC_F_WRITE);
+        copy.next = 0;
+        if (count == 0) {
+            head_idx = desc_idx;
+        } else {
+            vq.packed_descs[prev_idx].next = desc_idx;
+        }
+        prev_idx = desc_idx;
+        ++count;
+        ++desc_pos;
+        // The buffer id is in its last descriptor
+        if ((desc.flags & VIRTQ_DESC_F_NEXT) == 0) {
+            vq.packed_buffer_ids[head_idx] = desc.id;
+            break;
+        }
+    }
+    vq.packed_buffer_counts[head_idx] = count;
+    vq.avail_desc_pos = desc_pos;
+    vq.pending_desc_idx = head_idx;
+    vq.has_pending_desc = true;
+    *pfetched = true;
+    return true;
+}
+
+static void virtq_release_packed_buffer(virtq &vq, uint16_t head_idx) {
+    uint16_t desc_idx = head_idx;
+    for (uint16_t i = 0; i < vq.packed_buffer_counts[head_idx]; ++i) {
+        const uint16_t next_idx = vq.packed_descs[desc_idx].next;
+        vq.packed_descs[desc_idx].next = vq.free_desc_idx;
+        vq.free_desc_idx = desc_idx;
+        ++vq.free_desc_count;
+        desc_idx = next_idx;
+    }
+}
+
 #if defined(DEBUG_VIRTIO_MMIO) || defined(DEBUG_VIRTIO_ERRORS)
 static const char *get_virtio_mmio_offset_name(uint64_t offset) {
     if (offset >= VIRTIO_MMIO_CONFIG) {
@@ -280,25 +417,257 @@ bool virtq::write_desc_mem(i_device_state_access *a, uint16_t desc_idx, uint32_t
     }
 }
 
-bool virtq::consume_desc(i_device_state_access *a, uint16_t desc_idx, uint32_t written_len, uint16_t used_flags) {
-    // Sets the used ring element desc index and written length
-    virtq_used_elem used_elem{};
-    used_elem.id = desc_idx;
-    used_elem.len = written_len;
-    if (!virtq_set_ring_used_elem(*this, a, last_used_idx, &used_elem)) {
+bool virtq::get_desc_host_spans(i_device_state_access *a, uint16_t desc_idx, uint32_t start_off, uint32_t len,
+    bool write, virtq_host_spans &spans, bool mark_dirty) const {
+    spans.clear();
+    // Really do nothing when length is 0
+    if (len == 0) {
+        return true;
+    }
+    const uint32_t end_off = start_off + len;
+    uint32_t buf_start_off = 0;
+    const uint16_t write_flag = write ? VIRTQ_DESC_F_WRITE : 0;
+    // Traverse all buffers in queue
+    for (uint32_t i = 0; i < num; ++i) {
+        virtq_desc desc{};
+        // Retrieve queue buffer description
+        if (!virtq_get_desc(*this, a, desc_idx, &desc)) {
+            return false;
+        }
+        // We are only interested in buffers of the requested direction
+        if ((desc.flags & VIRTQ_DESC_F_WRITE) == write_flag) {
+            const uint32_t buf_end_off = buf_start_off + desc.len;
+            const uint32_t chunk_start_off = std::max(buf_start_off, start_off);
+            const uint32_t chunk_end_off = std::min(buf_end_off, end_off);
+            // Resolve chunk when it intersects with the desired interval
+            if (chunk_end_off > chunk_start_off) {
+                const uint32_t paddr_off = chunk_start_off - buf_start_off;
+                const uint32_t chunk_len = chunk_end_off - chunk_start_off;
+                const uint64_t paddr = desc.paddr + paddr_off;
+                unsigned char *data = a->get_host_memory_range(paddr, chunk_len, write && mark_dirty);
+                if (data == nullptr || spans.size() == spans.capacity()) {
+                    return false;
+                }
+                spans.push_back(virtq_host_span{.data = data, .len = chunk_len, .paddr = paddr});
+            }
+            buf_start_off += desc.len;
+            // Stop when we reach the buffer end offset
+            if (chunk_end_off >= end_off) {
+                return true;
+            }
+        }
+        // Stop when there are no more buffers in queue
+        if ((desc.flags & VIRTQ_DESC_F_NEXT) == 0) {
+            // Operation failed because more chunks were expected
+            return false;
+        }
+        // Move to the next buffer description
+        desc_idx = desc.next;
+    }
+    return false;
+}
+
+bool virtq_mark_host_spans_dirty(i_device_state_access *a, const virtq_host_spans &spans, uint32_t len) {
+    for (const auto &span : spans) {
+        if (len == 0) {
+            break;
+        }
+        const uint32_t chunk_len = std::min(span.len, len);
+        if (!a->mark_dirty_memory(span.paddr, chunk_len)) {
+            return false;
+        }
+        len -= chunk_len;
+    }
+    return true;
+}
+
+bool virtq::discard_desc_mem(i_device_state_access *a, uint16_t desc_idx, uint32_t *pdiscarded_len) const {
+    uint32_t discarded_len = 0;
+    bool ret = false;
+    // Traverse all buffers in queue
+    for (uint32_t i = 0; i < num; ++i) {
+        virtq_desc desc{};
+        // Retrieve queue buffer description
+        if (!virtq_get_desc(*this, a, desc_idx, &desc)) {
+            break;
+        }
+        // We are only interested in write-only buffers
+        if ((desc.flags & VIRTQ_DESC_F_WRITE) != 0) {
+            if (!a->discard_memory(desc.paddr, desc.len)) {
+                break;
+            }
+            discarded_len += desc.len;
+        }
+        // Stop when there are no more buffers in queue
+        if ((desc.flags & VIRTQ_DESC_F_NEXT) == 0) {
+            ret = true;
+            break;
+        }
+        // Move to the next buffer description
+        desc_idx = desc.next;
+    }
+    if (pdiscarded_len != nullptr) {
+        *pdiscarded_len = discarded_len;
+    }
+    return ret;
+}
+
+void virtq::reset_ring() {
+    last_used_idx = 0;
+    last_avail_idx = 0;
+    shadow_avail_idx = 0;
+    signaled_used_idx = 0;
+    has_pending_desc = false;
+    pending_desc_idx = 0;
+    avail_desc_pos = 0;
+    used_desc_pos = 0;
+    // All descriptor copies start free
+    free_desc_idx = 0;
+    free_desc_count = static_cast<uint16_t>(std::min<uint32_t>(num, VIRTIO_QUEUE_NUM_MAX));
+    for (uint16_t i = 0; i < free_desc_count; ++i) {
+        packed_descs[i].next = static_cast<uint16_t>(i + 1);
+    }
+}
+
+bool virtq::peek_avail_desc(i_device_state_access *a, uint16_t *pdesc_idx, bool *pavailable) {
+    *pavailable = false;
+    if (packed) {
+        // Copy the next buffer, unless the last one copied was not taken yet
+        if (!has_pending_desc) {
+            bool fetched = false;
+            if (!virtq_fetch_packed_buffer(*this, a, &fetched)) {
+                return false;
+            }
+            if (!fetched) {
+                return true;
+            }
+        }
+        *pdesc_idx = pending_desc_idx;
+        *pavailable = true;
+        return true;
+    }
+    // Read the available ring index again only when the device caught up with the one last read.
+    // We can only use equality operator for this check,
+    // because the last available ring index may wraparound before the last used ring index,
+    // but eventually the last used ring index will also wraparound.
+    if (last_avail_idx == shadow_avail_idx) {
+        virtq_header avail_header{};
+        if (!virtq_get_avail_header(*this, a, &avail_header)) {
+            return false;
+        }
+        shadow_avail_idx = avail_header.idx;
+        if (last_avail_idx == shadow_avail_idx) {
+            return true;
+        }
+    }
+    // Retrieve descriptor index for the next available ring element
+    if (!virtq_get_ring_avail_elem_desc_idx(*this, a, last_avail_idx, pdesc_idx)) {
         return false;
     }
+    *pavailable = true;
+    return true;
+}
+
+void virtq::take_avail_desc() {
     // Note that this increment will eventually wrap around after 65535,
     // in both driver and device.
-    const uint16_t next_last_used_idx = last_used_idx + 1;
-    // Advance the last used ring index
-    virtq_header used_header{};
-    used_header.flags = used_flags;
-    used_header.idx = next_last_used_idx;
-    if (!virtq_set_used_header(*this, a, &used_header)) {
+    ++last_avail_idx;
+    has_pending_desc = false;
+}
+
+bool virtq::update_avail_event(i_device_state_access *a) const {
+    if (!event_idx) {
+        return true;
+    }
+    if (packed) {
+        // Ask for a notification once the driver makes available the next descriptor not copied yet
+        virtq_packed_event device_event{};
+        device_event.off_wrap = virtq_get_packed_off_wrap(*this, avail_desc_pos);
+        device_event.flags = VIRTQ_PACKED_EVENT_F_DESC;
+        return virtq_set_packed_device_event(*this, a, &device_event);
+    }
+    return virtq_set_avail_event(*this, a, last_avail_idx);
+}
+
+bool virtq::check_used_notification(i_device_state_access *a) {
+    const uint16_t old_used_idx = signaled_used_idx;
+    const uint16_t new_used_idx = packed ? used_desc_pos : last_used_idx;
+    // Nothing was used since the last notification
+    if (old_used_idx == new_used_idx) {
         return false;
     }
-    last_used_idx = next_last_used_idx;
+    signaled_used_idx = new_used_idx;
+    if (packed) {
+        virtq_packed_event driver_event{};
+        if (!virtq_get_packed_driver_event(*this, a, &driver_event)) {
+            return true;
+        }
+        if (driver_event.flags == VIRTQ_PACKED_EVENT_F_DISABLE) {
+            return false;
+        }
+        if (!event_idx || driver_event.flags != VIRTQ_PACKED_EVENT_F_DESC) {
+            return true;
+        }
+        // Find the most recent used descriptor position matching the event offset and wrap counter,
+        // positions repeat every two turns around the ring
+        const bool event_wrap_counter = (driver_event.off_wrap >> 15) != 0;
+        const auto event_turn_pos =
+            static_cast<uint16_t>((driver_event.off_wrap & (num - 1)) + (event_wrap_counter ? 0 : num));
+        const auto event_pos =
+            static_cast<uint16_t>(new_used_idx - ((new_used_idx - event_turn_pos) & ((2 * num) - 1)));
+        return virtq_need_event(event_pos, new_used_idx, old_used_idx);
+    }
+    if (event_idx) {
+        uint16_t used_event{};
+        if (!virtq_get_used_event(*this, a, &used_event)) {
+            return true;
+        }
+        // Notify only if used_event is among the used ring indexes written since the last notification
+        return virtq_need_event(used_event, new_used_idx, old_used_idx);
+    }
+    virtq_header avail_header{};
+    if (!virtq_get_avail_header(*this, a, &avail_header)) {
+        return true;
+    }
+    return (avail_header.flags & VIRTQ_AVAIL_F_NO_INTERRUPT) == 0;
+}
+
+bool virtq::consume_desc(i_device_state_access *a, uint16_t desc_idx, uint32_t written_len, uint16_t used_flags) {
+    if (packed) {
+        // Write the used descriptor in place of the first descriptor not used yet,
+        // skipping as many descriptors as the buffer had
+        const uint16_t head_idx = desc_idx & (VIRTIO_QUEUE_NUM_MAX - 1);
+        if (!virtq_set_packed_used_desc(*this, a, used_desc_pos, packed_buffer_ids[head_idx], written_len)) {
+            return false;
+        }
+        used_desc_pos += packed_buffer_counts[head_idx];
+        virtq_release_packed_buffer(*this, head_idx);
+    } else {
+        // Sets the used ring element desc index and written length
+        virtq_used_elem used_elem{};
+        used_elem.id = desc_idx;
+        used_elem.len = written_len;
+        if (!virtq_set_ring_used_elem(*this, a, last_used_idx, &used_elem)) {
+            return false;
+        }
+        // Advance the last used ring index
+        virtq_header used_header{};
+        used_header.flags = used_flags;
+        used_header.idx = last_used_idx + 1;
+        if (!virtq_set_used_header(*this, a, &used_header)) {
+            return false;
+        }
+    }
+    // When nothing is in flight, the buffer was taken straight from the available ring (e.g. to receive data)
+    const bool taken = last_avail_idx == last_used_idx;
+    // Note that this increment will eventually wrap around after 65535,
+    // in both driver and device.
+    ++last_used_idx;
+    if (taken) {
+        take_avail_desc();
+        // Let the driver notify again when it refills the queue after the device runs out of buffers
+        return update_avail_event(a);
+    }
     return true;
 }
 
@@ -306,7 +675,7 @@ virtio_device::virtio_device(uint32_t virtio_idx, uint32_t device_id, uint64_t d
     uint32_t config_space_size) :
     virtio_idx(virtio_idx),
     device_id(device_id),
-    device_features(device_features | VIRTIO_F_VERSION_1),
+    device_features(device_features | VIRTIO_F_VERSION_1 | VIRTIO_F_EVENT_IDX | VIRTIO_F_RING_PACKED),
     config_space_size(config_space_size) {}
 
 void virtio_device::reset(i_device_state_access *a) {
@@ -328,8 +697,10 @@ void virtio_device::reset(i_device_state_access *a) {
         vq.avail_addr = 0;
         vq.used_addr = 0;
         vq.num = 0;
-        vq.last_used_idx = 0;
         vq.ready = 0;
+        vq.event_idx = false;
+        vq.packed = false;
+        vq.reset_ring();
     }
     // The device MUST have all queue and configuration change events unmapped upon reset.
     reset_irq(a, VIRTIO_INT_STATUS_USED_BUFFER | VIRTIO_INT_STATUS_CONFIG_CHANGE);
@@ -365,7 +736,17 @@ void virtio_device::notify_queue_used(i_device_state_access *a) {
     std::ignore = fprintf(stderr, "virtio[%d]: notify_queue_used\n", virtio_idx);
 #endif
     // A device MUST NOT consume buffers or send any used buffer notifications to the driver before DRIVER_OK.
-    if (driver_ok) {
+    if (!driver_ok) {
+        return;
+    }
+    // Check all queues, so each one keeps track of what the driver was notified about
+    bool notify = false;
+    for (auto &vq : queue) {
+        if (vq.ready != 0 && vq.check_used_notification(a)) {
+            notify = true;
+        }
+    }
+    if (notify) {
         set_irq(a, VIRTIO_INT_STATUS_USED_BUFFER);
     }
 }
@@ -397,37 +778,28 @@ void virtio_device::notify_config_change(i_device_state_access *a) {
 }
 
 bool virtio_device::prepare_queue_write(i_device_state_access *a, uint32_t queue_idx, uint16_t *pdesc_idx,
-    uint32_t *pwrite_avail_len) const {
+    uint32_t *pwrite_avail_len) {
     *pdesc_idx = 0;
     *pwrite_avail_len = 0;
     // A device MUST NOT send notifications until the driver initializes the device.
     assert(driver_ok);
     assert(queue_idx < VIRTIO_QUEUE_COUNT);
     // Retrieve queue
-    const virtq &vq = queue[queue_idx];
+    virtq &vq = queue[queue_idx];
     // Silently ignore when the queue is not ready yet
     if (vq.ready == 0) {
         return true;
     }
     // Retrieve available buffer
-    virtq_header avail_header{};
-    if (!virtq_get_avail_header(vq, a, &avail_header)) {
+    uint16_t desc_idx{};
+    bool available = false;
+    if (!vq.peek_avail_desc(a, &desc_idx, &available)) {
         return false;
     }
-    const uint16_t last_avail_idx = avail_header.idx;
-    // Check if have an available index in the ring to write to.
-    // We can only use equality operator for this check,
-    // because the last available ring index may wraparound before the last used ring index,
-    // but eventually the last used ring index will also wraparound.
-    if (vq.last_used_idx == last_avail_idx) {
+    if (!available) {
         // Queue is full, we have to wait the driver to free a queue
         return true;
     }
-    // Retrieve descriptor index for the next available ring element
-    uint16_t desc_idx{};
-    if (!virtq_get_ring_avail_elem_desc_idx(vq, a, vq.last_used_idx, &desc_idx)) {
-        return false;
-    }
     *pdesc_idx = desc_idx;
     // Retrieve maximum amount of bytes we can write to queue buffer
     uint32_t write_avail_len{};
@@ -459,28 +831,26 @@ void virtio_device::on_device_queue_notify(i_device_state_access *a, uint32_t qu
         return;
     }
     // Retrieve queue
-    const virtq &vq = queue[queue_idx];
+    virtq &vq = queue[queue_idx];
     // The device MUST NOT access virtual queue contents when QueueReady is zero.
     if (vq.ready == 0) {
         return;
     }
-    // When the driver wants to send a buffer to the device, it fills in a slot in the descriptor table
-    // (or chains several together), and writes the descriptor index into the available ring.
-    virtq_header avail_header{};
-    if (!virtq_get_avail_header(vq, a, &avail_header)) {
-        notify_device_needs_reset(a);
-        return;
-    }
-    const uint16_t last_avail_idx = avail_header.idx;
-    // Process all queues until we reach the last available index
-    while (vq.last_used_idx != last_avail_idx) {
-        // Retrieve description index for this ring element
-        const uint32_t last_used_idx = vq.last_used_idx;
+    const uint16_t first_used_idx = vq.last_used_idx;
+    // Process all buffers until there are no more available
+    while (true) {
+        // When the driver wants to send a buffer to the device, it fills in a slot in the descriptor table
+        // (or chains several together), and writes the descriptor index into the available ring.
+        const uint16_t taken_avail_idx = vq.last_avail_idx;
         uint16_t desc_idx{};
-        if (!virtq_get_ring_avail_elem_desc_idx(vq, a, last_used_idx, &desc_idx)) {
+        bool available = false;
+        if (!vq.peek_avail_desc(a, &desc_idx, &available)) {
             notify_device_needs_reset(a);
             return;
         }
+        if (!available) {
+            break;
+        }
         uint32_t read_avail_len{};
         uint32_t write_avail_len{};
         if (!vq.get_desc_rw_avail_len(a, desc_idx, &read_avail_len, &write_avail_len)) {
@@ -491,15 +861,27 @@ void virtio_device::on_device_queue_notify(i_device_state_access *a, uint32_t qu
         std::ignore = fprintf(stderr,
             "virtio[%d]: on_device_queue_available queue_idx=%d last_avail_idx=%d last_used_idx=%d desc_idx=%d "
             "read_avail_len=%d write_avail_len=%d\n",
-            virtio_idx, queue_idx, last_avail_idx, last_used_idx, desc_idx, read_avail_len, write_avail_len);
+            virtio_idx, queue_idx, vq.last_avail_idx, vq.last_used_idx, desc_idx, read_avail_len, write_avail_len);
 #endif
         // Process the queue
         if (!on_device_queue_available(a, queue_idx, desc_idx, read_avail_len, write_avail_len)) {
             // The device doesn't want to continue consuming this queue
             break;
         }
-        // We expect the device receive to always consume queue before continuing
-        assert(last_used_idx != vq.last_used_idx);
+        // The device took the buffer, it may have consumed it already or it will consume it later
+        if (vq.last_avail_idx == taken_avail_idx) {
+            vq.take_avail_desc();
+        }
+    }
+    // Ask the driver to notify only about buffers the device has not seen yet
+    if (!vq.update_avail_event(a)) {
+        notify_device_needs_reset(a);
+        return;
+    }
+    // Buffers consumed right away (e.g. transmitted data) must be notified as well,
+    // the driver decides if it wants an interrupt for them
+    if (vq.last_used_idx != first_used_idx) {
+        notify_queue_used(a);
     }
 }
 
@@ -713,7 +1095,11 @@ execute_status virtio_device::mmio_write(i_device_state_access *a, uint64_t offs
         case VIRTIO_MMIO_QUEUE_READY:
             // Writing one to this register notifies the device that it can execute requests from this virtual queue.
             if (queue_sel < VIRTIO_QUEUE_COUNT) {
-                queue[queue_sel].ready = (val == 1) ? 1 : 0;
+                virtq &vq = queue[queue_sel];
+                if (vq.ready == 0 && val == 1) {
+                    vq.reset_ring();
+                }
+                vq.ready = (val == 1) ? 1 : 0;
             }
             return execute_status::success;
         case VIRTIO_MMIO_QUEUE_NOTIFY:
@@ -741,9 +1127,15 @@ execute_status virtio_device::mmio_write(i_device_state_access *a, uint64_t offs
                     // The driver will re-read device status to ensure the FEATURES_OK bit is really set.
                     // We allow the device initialization to succeed only if the driver supports our device
                     // features.
-                    if (driver_features != device_features) {
+                    // Only notification suppression and the packed layout can be declined by the driver.
+                    constexpr uint64_t optional_features = VIRTIO_F_EVENT_IDX | VIRTIO_F_RING_PACKED;
+                    if ((driver_features | optional_features) != (device_features | optional_features)) {
                         return execute_status::success;
                     }
+                    for (auto &vq : queue) {
+                        vq.event_idx = (driver_features & VIRTIO_F_EVENT_IDX) != 0;
+                        vq.packed = (driver_features & VIRTIO_F_RING_PACKED) != 0;
+                    }
                 }
                 // Writing non-zero values to this register sets the status flags, indicating the driver progress.
                 device_status = val;
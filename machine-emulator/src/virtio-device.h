@@ -18,9 +18,12 @@
 #define VIRTIO_DEVICE_H
 
 #include <array>
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
 
+#include <boost/container/static_vector.hpp>
+
 #include "i-device-state-access.h"
 #include "interpret.h"
 #include "os.h"
@@ -33,7 +36,7 @@ enum virtio_constants : uint32_t {
     VIRTIO_MAGIC_VALUE = 0x74726976, // Little-endian equivalent of the "virt" string
     VIRTIO_VERSION = 0x2,            ///< Compliance with VirtIO v1.2 specification for non-legacy devices
     VIRTIO_VENDOR_ID = 0xffff,       ///< Dummy vendor ID
-    VIRTIO_QUEUE_COUNT = 2,          ///< All devices we implement so far just need 2 queues
+    VIRTIO_QUEUE_COUNT = 3,          ///< Most devices need 2 queues, the balloon needs a third one for reporting
     VIRTIO_QUEUE_NUM_MAX = 128,      ///< Number of elements in queue ring, it should be at least 128 for most drivers
     VIRTIO_MAX_CONFIG_SPACE_SIZE = 256, ///< Maximum size of config space
     VIRTIO_MAX = 31,                    ///< Maximum number of virtio devices
@@ -174,6 +177,19 @@ enum virtq_avail_flags : uint16_t {
         1, ///< The driver uses this in avail flags to advise the device: don't interrupt me when you consume a buffer.
 };
 
+/// \brief Packed virtqueue descriptor flags, in addition to virtq_desc_flags
+enum virtq_packed_desc_flags : uint16_t {
+    VIRTQ_PACKED_DESC_F_AVAIL = 1 << 7, ///< Set to the driver wrap counter when the descriptor is made available.
+    VIRTQ_PACKED_DESC_F_USED = 1 << 15, ///< Set to the device wrap counter when the descriptor is used.
+};
+
+/// \brief Packed virtqueue event suppression flags
+enum virtq_packed_event_flags : uint16_t {
+    VIRTQ_PACKED_EVENT_F_ENABLE = 0,  ///< Events are enabled.
+    VIRTQ_PACKED_EVENT_F_DISABLE = 1, ///< Events are disabled.
+    VIRTQ_PACKED_EVENT_F_DESC = 2,    ///< Events are enabled only for the descriptor in off_wrap (needs EVENT_IDX).
+};
+
 /// \brief Virtqueue buffer descriptor
 struct virtq_desc {
     uint64_t paddr; ///< Guest physical address
@@ -194,14 +210,91 @@ struct virtq_used_elem {
     uint32_t len; ///< Total length of the descriptor chain which was written to.
 };
 
-/// \brief VirtIO's split Virtqueue implementation
+/// \brief Packed virtqueue descriptor
+struct virtq_packed_desc {
+    uint64_t paddr; ///< Guest physical address
+    uint32_t len;   ///< Guest physical length, or the length written by the device when used
+    uint16_t id;    ///< Buffer id, taken from the last descriptor of a buffer
+    uint16_t flags; ///< Descriptor flags (see virtq_desc_flags and virtq_packed_desc_flags)
+};
+
+/// \brief Packed virtqueue event suppression structure
+struct virtq_packed_event {
+    uint16_t off_wrap; ///< Descriptor ring offset, with the wrap counter in the most significant bit
+    uint16_t flags;    ///< Event flags (see virtq_packed_event_flags)
+};
+
+/// \brief Host memory backing a contiguous part of a queue buffer
+struct virtq_host_span {
+    unsigned char *data; ///< Host pointer to the start of the span
+    uint32_t len;        ///< Length of the span
+    uint64_t paddr;      ///< Guest physical address of the start of the span
+};
+
+/// \brief Host memory spans backing a range of a queue buffer, in buffer order
+using virtq_host_spans = boost::container::static_vector<virtq_host_span, VIRTIO_QUEUE_NUM_MAX>;
+
+/// \brief Gathers host memory spans of a queue buffer into an I/O vector, for readv() and writev() like calls
+/// \param spans Host memory spans.
+/// \param iov Receives the I/O vector entries, starting from its first entry.
+/// \returns Number of I/O vector entries filled.
+template <typename IOVEC, size_t N>
+int virtq_host_spans_to_iovec(const virtq_host_spans &spans, std::array<IOVEC, N> &iov) {
+    static_assert(N >= VIRTIO_QUEUE_NUM_MAX, "I/O vector is too small to hold all spans");
+    for (size_t i = 0; i < spans.size(); ++i) {
+        iov[i] = IOVEC{.iov_base = spans[i].data, .iov_len = spans[i].len};
+    }
+    return static_cast<int>(spans.size());
+}
+
+/// \brief Marks the leading bytes of host memory spans of a write buffer as dirty.
+/// \param a The state accessor for the current device.
+/// \param spans Host memory spans, obtained without marking them dirty.
+/// \param len Amount of bytes written to the spans, starting from the first one.
+/// \returns True if successful, false otherwise.
+bool virtq_mark_host_spans_dirty(i_device_state_access *a, const virtq_host_spans &spans, uint32_t len);
+
+/// \brief VirtIO's Virtqueue implementation, with either the split or the packed layout
+/// \details Buffers of packed queues are copied when the device takes them from the descriptor ring,
+/// so their descriptor indexes refer to packed_descs instead of the ring.
 struct virtq {
-    uint64_t desc_addr;     ///< Used for describing buffers
-    uint64_t avail_addr;    ///< Data supplied by driver to the device (available ring)
-    uint64_t used_addr;     ///< Data supplied by device to driver (used ring)
-    uint32_t num;           ///< Maximum number of elements in the queue ring
-    uint16_t last_used_idx; ///< Last used ring index, this always increment
-    uint16_t ready;         ///< Whether the queue is ready
+    uint64_t desc_addr;         ///< Used for describing buffers
+    uint64_t avail_addr;        ///< Data supplied by driver to the device (available ring or driver event)
+    uint64_t used_addr;         ///< Data supplied by device to driver (used ring or device event)
+    uint32_t num;               ///< Maximum number of elements in the queue ring
+    uint16_t last_used_idx;     ///< Last used ring index, this always increment
+    uint16_t last_avail_idx;    ///< Last available ring index taken by the device, ahead of last_used_idx while
+                                ///< buffers are in flight
+    uint16_t shadow_avail_idx;  ///< Last available ring index read from the driver
+    uint16_t signaled_used_idx; ///< Last used ring index (or used descriptor position) the driver was notified about
+    uint16_t ready;             ///< Whether the queue is ready
+    bool event_idx;             ///< Whether VIRTIO_F_EVENT_IDX was negotiated, enabling used_event and avail_event
+    bool packed;                ///< Whether VIRTIO_F_RING_PACKED was negotiated
+    bool has_pending_desc;      ///< Whether a packed buffer was copied from the ring but not taken yet
+    uint16_t pending_desc_idx;  ///< Descriptor index of the packed buffer copied but not taken yet
+    uint16_t avail_desc_pos;    ///< Position of the next packed descriptor to be made available, this always increment
+    uint16_t used_desc_pos;     ///< Position of the next packed descriptor to be used, this always increment
+    uint16_t free_desc_idx;     ///< First free entry of packed_descs, chained through their next field
+    uint16_t free_desc_count;   ///< Number of free entries in packed_descs
+
+    std::array<virtq_desc, VIRTIO_QUEUE_NUM_MAX> packed_descs;       ///< Copies of packed buffer descriptors
+    std::array<uint16_t, VIRTIO_QUEUE_NUM_MAX> packed_buffer_ids;    ///< Packed buffer id, by head descriptor index
+    std::array<uint16_t, VIRTIO_QUEUE_NUM_MAX> packed_buffer_counts; ///< Packed buffer length in descriptors, by
+                                                                     ///< head descriptor index
+
+    /// \brief Resets the device side indexes of the queue, before the driver starts using it.
+    void reset_ring();
+
+    /// \brief Retrieves the next buffer made available by the driver, without taking it.
+    /// \param a The state accessor for the current device.
+    /// \param pdesc_idx Receives the buffer head descriptor index.
+    /// \param pavailable Receives true if a buffer is available, false otherwise.
+    /// \returns True if successful, false if an error happened while reading the queue.
+    /// \details The available ring index is only read again once the device catches up with it.
+    bool peek_avail_desc(i_device_state_access *a, uint16_t *pdesc_idx, bool *pavailable);
+
+    /// \brief Takes the buffer returned by the last peek_avail_desc(), putting it in flight.
+    void take_avail_desc();
 
     /// \brief Gets how many bytes are available in queue read/write buffers.
     /// \param a The state accessor for the current device.
@@ -232,6 +325,46 @@ struct virtq {
     bool write_desc_mem(i_device_state_access *a, uint16_t desc_idx, uint32_t start_off, const unsigned char *data,
         uint32_t len) const;
 
+    /// \brief Obtains the host memory spans backing a range of a queue buffer descriptor, to access it in place.
+    /// \param a The state accessor for the current device.
+    /// \param desc_idx Index of queue's descriptor be traversed.
+    /// \param start_off Starting offset of the range in the queue read or write buffer.
+    /// \param len Amount of bytes in the range.
+    /// \param write True for a range of the write buffer, false for a range of the read buffer.
+    /// \param spans Receives the spans.
+    /// \param mark_dirty True to mark spans of the write buffer dirty up front.
+    /// \returns True if successful, false if the range cannot be accessed in place.
+    /// \details Devices fall back to read_desc_mem() or write_desc_mem() on failure.
+    /// Devices that do not know up front how much they will write pass false for mark_dirty,
+    /// and later call virtq_mark_host_spans_dirty() with the amount actually written.
+    bool get_desc_host_spans(i_device_state_access *a, uint16_t desc_idx, uint32_t start_off, uint32_t len,
+        bool write, virtq_host_spans &spans, bool mark_dirty = true) const;
+
+    /// \brief Discards the guest memory referenced by all write buffers of a queue descriptor.
+    /// \param a The state accessor for the current device.
+    /// \param desc_idx Index of queue's descriptor be traversed.
+    /// \param pdiscarded_len Receives the total length discarded.
+    /// \returns True if successful, false if an error happened while discarding the queue buffers.
+    /// \details The memory reads back as zeros, and its host pages are released when possible.
+    bool discard_desc_mem(i_device_state_access *a, uint16_t desc_idx, uint32_t *pdiscarded_len) const;
+
+    /// \brief Tells the driver which available ring index it should notify the device about next.
+    /// \param a The state accessor for the current device.
+    /// \returns True if successful, false if an error happened while writing the used ring.
+    /// \details The driver is only asked to notify after adding buffers past the ones already taken by the device,
+    /// so buffers it adds while the device has not caught up yet do not cost a notification.
+    /// Packed queues use the device event suppression structure instead.
+    /// This does nothing unless VIRTIO_F_EVENT_IDX was negotiated.
+    bool update_avail_event(i_device_state_access *a) const;
+
+    /// \brief Checks whether the driver wants to be notified about buffers used since the last notification.
+    /// \param a The state accessor for the current device.
+    /// \returns True if the driver should be notified.
+    /// \details With VIRTIO_F_EVENT_IDX the driver tells through used_event which used ring index it is waiting for,
+    /// otherwise it can only disable notifications altogether with VIRTQ_AVAIL_F_NO_INTERRUPT.
+    /// Packed queues use the driver event suppression structure instead.
+    bool check_used_notification(i_device_state_access *a);
+
     /// \brief Consumes a queue buffer, marking it a used to the driver.
     /// \brief The driver will notify later when the buffer becomes available again,
     /// after it finishes processing the buffer.
@@ -239,8 +372,10 @@ struct virtq {
     /// \param desc_idx Index of queue's header descriptor to be consumed.
     /// \param written_len Amount of bytes written in case of write-only queues,
     /// should be 0 for read-only queues.
-    /// \param flags Used flags to passed to the driver.
+    /// \param flags Used flags to passed to the driver, packed queues have no used flags.
     /// \returns True if successful, false if an error happened.
+    /// \details Buffers may be consumed in any order. A buffer consumed while none is in flight
+    /// is taken from the available ring as well.
     bool consume_desc(i_device_state_access *a, uint16_t desc_idx, uint32_t written_len, uint16_t flags);
 };
 
@@ -297,7 +432,9 @@ public:
     /// \details A good driver implementation will issue a reset and reinitialize the device this call.
     void notify_device_needs_reset(i_device_state_access *a);
 
-    /// \brief Notify the driver that a queue buffer has just been used.
+    /// \brief Notify the driver that queue buffers have just been used.
+    /// \details The interrupt is suppressed when the driver does not want it for any of the buffers used since
+    /// the last notification.
     void notify_queue_used(i_device_state_access *a);
 
     /// \brief Notify the driver that device has configuration changed.
@@ -312,7 +449,7 @@ public:
     /// \details In case the queue is full or not ready yet, this function will still return true,
     /// however pwrite_avail_len will be set to 0.
     bool prepare_queue_write(i_device_state_access *a, uint32_t queue_idx, uint16_t *pdesc_idx,
-        uint32_t *pwrite_avail_len) const;
+        uint32_t *pwrite_avail_len);
 
     /// Consume an available queue's descriptor (sets it as used).
     /// \param queue_idx Queue index to consume and notify.
@@ -338,6 +475,8 @@ public:
     /// \param desc_idx Queue's available descriptor index.
     /// \param read_avail_len Total readable length in the descriptor buffer.
     /// \param write_avail_len Total writable length in the descriptor buffer.
+    /// \returns True if the descriptor was taken, false to stop processing the queue.
+    /// \details A taken descriptor may be consumed right away or later, once its request completes.
     virtual bool on_device_queue_available(i_device_state_access *a, uint32_t queue_idx, uint16_t desc_idx,
         uint32_t read_avail_len, uint32_t write_avail_len) = 0;
 
@@ -346,12 +346,19 @@ bool virtio_net_carrier_slirp::write_packet_to_host(i_device_state_access *a, vi
 #endif
         return true;
     }
-    slirp_packet packet{.len = packet_len};
-    if (!vq.read_desc_mem(a, desc_idx, VIRTIO_NET_ETHERNET_FRAME_OFFSET, packet.buf.data(), packet.len)) {
-        // Failure while accessing guest memory, the driver or guest messed up, return false to reset the device.
-        return false;
+    // Hand the packet to slirp straight from guest memory when it is contiguous there
+    virtq_host_spans spans;
+    if (vq.get_desc_host_spans(a, desc_idx, VIRTIO_NET_ETHERNET_FRAME_OFFSET, packet_len, false, spans) &&
+        spans.size() == 1) {
+        slirp_input(slirp, spans[0].data, static_cast<int>(packet_len));
+    } else {
+        slirp_packet packet{.len = packet_len};
+        if (!vq.read_desc_mem(a, desc_idx, VIRTIO_NET_ETHERNET_FRAME_OFFSET, packet.buf.data(), packet.len)) {
+            // Failure while accessing guest memory, the driver or guest messed up, return false to reset the device.
+            return false;
+        }
+        slirp_input(slirp, packet.buf.data(), static_cast<int>(packet.len));
     }
-    slirp_input(slirp, packet.buf.data(), static_cast<int>(packet.len));
     // Packet was read and the queue is ready to be consumed.
     *pread_len = read_avail_len;
     return true;
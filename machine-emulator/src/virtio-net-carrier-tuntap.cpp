@@ -56,6 +56,7 @@
 
 #ifdef HAVE_TUNTAP
 
+#include <algorithm>
 #include <array>
 #include <cerrno>
 #include <cstdint>
@@ -69,6 +70,7 @@
 #include <sys/ioctl.h>
 #include <sys/select.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include "i-device-state-access.h"
@@ -148,33 +150,41 @@ bool virtio_net_carrier_tuntap::write_packet_to_host(i_device_state_access *a, v
 #endif
         return true;
     }
-    // Read packet from queue buffer
+    // Send the packet straight from guest memory when the queue buffer can be accessed in place
     std::array<uint8_t, VIRTIO_NET_ETHERNET_MAX_LENGTH> packet_buf{};
-    if (!vq.read_desc_mem(a, desc_idx, VIRTIO_NET_ETHERNET_FRAME_OFFSET, packet_buf.data(), packet_len)) {
-        // Failure while accessing guest memory, the driver or guest messed up, return false to reset the device.
-        return false;
+    std::array<iovec, VIRTIO_QUEUE_NUM_MAX> iov{};
+    int iovcnt = 0;
+    virtq_host_spans spans;
+    if (vq.get_desc_host_spans(a, desc_idx, VIRTIO_NET_ETHERNET_FRAME_OFFSET, packet_len, false, spans)) {
+        iovcnt = virtq_host_spans_to_iovec(spans, iov);
+    } else {
+        // Read packet from queue buffer
+        if (!vq.read_desc_mem(a, desc_idx, VIRTIO_NET_ETHERNET_FRAME_OFFSET, packet_buf.data(), packet_len)) {
+            // Failure while accessing guest memory, the driver or guest messed up, return false to reset the device.
+            return false;
+        }
+        iov[0] = iovec{.iov_base = packet_buf.data(), .iov_len = packet_len};
+        iovcnt = 1;
     }
-    // Keep writing until all packet bytes are written
-    uint32_t written_packet_len = 0;
-    while (written_packet_len < packet_len) {
-        // Set errno to zero because write() may not set it when its return is zero
+    // Keep trying until the packet is written, the network interface takes whole packets at once
+    while (packet_len > 0) {
+        // Set errno to zero because writev() may not set it when its return is zero
         errno = 0;
         // Write to the network interface
-        const ssize_t written_len =
-            write(m_tapfd, packet_buf.data() + written_packet_len, packet_len - written_packet_len);
-        if (written_len <= 0) {
-            // Retry again when the operation would block or was interrupted
-            if (errno == EAGAIN || errno == EINTR) {
-                // sched_yield() lets the host CPU scheduler switch to other processes,
-                // so we avoid consuming host CPU resources in this infinite loop,
-                // ??E: We could also use a usleep() here when sched_yield() is not supported.
-                sched_yield();
-            } else {
-                // Unexpected error, return false to reset the device.
-                return false;
-            }
+        const ssize_t written_len = writev(m_tapfd, iov.data(), iovcnt);
+        if (written_len > 0) {
+            break;
+        }
+        // Retry again when the operation would block or was interrupted
+        if (errno == EAGAIN || errno == EINTR) {
+            // sched_yield() lets the host CPU scheduler switch to other processes,
+            // so we avoid consuming host CPU resources in this infinite loop,
+            // ??E: We could also use a usleep() here when sched_yield() is not supported.
+            sched_yield();
+        } else {
+            // Unexpected error, return false to reset the device.
+            return false;
         }
-        written_packet_len += static_cast<uint32_t>(written_len);
     }
     // Packet was read and the queue is ready to be consumed.
     *pread_len = read_avail_len;
@@ -183,12 +193,34 @@ bool virtio_net_carrier_tuntap::write_packet_to_host(i_device_state_access *a, v
 
 bool virtio_net_carrier_tuntap::read_packet_from_host(i_device_state_access *a, virtq &vq, uint16_t desc_idx,
     uint32_t write_avail_len, uint32_t *pwritten_len) {
-    // Write network to queue buffer in chunks
+    // Receive the packet straight into guest memory when the queue buffer can be accessed in place
     std::array<uint8_t, VIRTIO_NET_ETHERNET_MAX_LENGTH> packet_buf{};
-    // Set errno to zero because read() will not set it when it returns zero (end of file)
+    std::array<iovec, VIRTIO_QUEUE_NUM_MAX + 1> iov{};
+    int iovcnt = 0;
+    bool in_place = false;
+    virtq_host_spans spans;
+    if (write_avail_len > VIRTIO_NET_ETHERNET_FRAME_OFFSET) {
+        const uint32_t buf_len =
+            std::min<uint32_t>(write_avail_len - VIRTIO_NET_ETHERNET_FRAME_OFFSET, VIRTIO_NET_ETHERNET_MAX_LENGTH);
+        // Spans are marked dirty only once we know how many bytes were received into them
+        if (vq.get_desc_host_spans(a, desc_idx, VIRTIO_NET_ETHERNET_FRAME_OFFSET, buf_len, true, spans, false)) {
+            iovcnt = virtq_host_spans_to_iovec(spans, iov);
+            // Bytes past the queue buffer go to the packet buffer, so packets too large can still be detected
+            if (buf_len < VIRTIO_NET_ETHERNET_MAX_LENGTH) {
+                iov[iovcnt++] =
+                    iovec{.iov_base = packet_buf.data(), .iov_len = VIRTIO_NET_ETHERNET_MAX_LENGTH - buf_len};
+            }
+            in_place = true;
+        }
+    }
+    if (!in_place) {
+        iov[0] = iovec{.iov_base = packet_buf.data(), .iov_len = VIRTIO_NET_ETHERNET_MAX_LENGTH};
+        iovcnt = 1;
+    }
+    // Set errno to zero because readv() will not set it when it returns zero (end of file)
     errno = 0;
     // Read the next packet from the network interface
-    const ssize_t read_len = read(m_tapfd, packet_buf.data(), VIRTIO_NET_ETHERNET_MAX_LENGTH);
+    const ssize_t read_len = readv(m_tapfd, iov.data(), iovcnt);
     if (read_len <= 0) {
         // Stop when the operation would block or was interrupted,
         // the next poll will read any pending packet.
@@ -200,6 +232,10 @@ bool virtio_net_carrier_tuntap::read_packet_from_host(i_device_state_access *a,
         return false;
     }
     const auto packet_len = static_cast<uint32_t>(read_len);
+    // Even packets that are dropped below were partially received into guest memory
+    if (in_place && !virtq_mark_host_spans_dirty(a, spans, packet_len)) {
+        return false;
+    }
     // Is there enough space in the write buffer to write this packet?
     if (VIRTIO_NET_ETHERNET_FRAME_OFFSET + packet_len > write_avail_len ||
         packet_len == VIRTIO_NET_ETHERNET_MAX_LENGTH) {
@@ -211,8 +247,9 @@ bool virtio_net_carrier_tuntap::read_packet_from_host(i_device_state_access *a,
         *pwritten_len = 0;
         return true;
     }
-    // Write to queue buffer
-    if (!vq.write_desc_mem(a, desc_idx, VIRTIO_NET_ETHERNET_FRAME_OFFSET, packet_buf.data(), packet_len)) {
+    // Write to queue buffer, unless the packet was received in place
+    if (!in_place &&
+        !vq.write_desc_mem(a, desc_idx, VIRTIO_NET_ETHERNET_FRAME_OFFSET, packet_buf.data(), packet_len)) {
         // Failure while accessing guest memory, the driver or guest messed up, return false to reset the device.
         return false;
     }
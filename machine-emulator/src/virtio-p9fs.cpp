@@ -43,11 +43,14 @@
 #include <cstdio>
 #include <cstring>
 #include <ctime>
+#include <memory>
 #include <new>
 #include <stdexcept>
 #include <string>
+#include <system_error>
 #include <tuple>
 #include <utility>
+#include <vector>
 
 #include <dirent.h>
 #include <fcntl.h>
@@ -65,9 +68,16 @@
 #include <sys/statfs.h>
 #include <sys/sysmacros.h>
 #endif
+#ifndef _WIN32
+#include <sys/uio.h>
+#endif
+#ifdef HAVE_VIRTIO_P9FS_ASYNC_IO
+#include <sys/select.h>
+#endif
 #include <unistd.h>
 
 #include "i-device-state-access.h"
+#include "os.h"
 #include "virtio-device.h"
 #include "virtio-serializer.h"
 
@@ -118,6 +128,41 @@ ssize_t pwrite(int fd, const void *buf, size_t count, uint64_t offset) {
     return dwBytesWritten;
 }
 
+struct iovec {
+    void *iov_base;
+    size_t iov_len;
+};
+
+ssize_t preadv(int fd, const struct iovec *iov, int iovcnt, uint64_t offset) {
+    ssize_t total = 0;
+    for (int i = 0; i < iovcnt; ++i) {
+        const ssize_t ret = pread(fd, iov[i].iov_base, iov[i].iov_len, offset + total);
+        if (ret < 0) {
+            return total > 0 ? total : ret;
+        }
+        total += ret;
+        if (static_cast<size_t>(ret) < iov[i].iov_len) {
+            break;
+        }
+    }
+    return total;
+}
+
+ssize_t pwritev(int fd, const struct iovec *iov, int iovcnt, uint64_t offset) {
+    ssize_t total = 0;
+    for (int i = 0; i < iovcnt; ++i) {
+        const ssize_t ret = pwrite(fd, iov[i].iov_base, iov[i].iov_len, offset + total);
+        if (ret < 0) {
+            return total > 0 ? total : ret;
+        }
+        total += ret;
+        if (static_cast<size_t>(ret) < iov[i].iov_len) {
+            break;
+        }
+    }
+    return total;
+}
+
 #define UTIME_NOW -1
 #define UTIME_OMIT -2
 
@@ -155,6 +200,32 @@ static int futimens(int fd, const struct timespec times[2]) {
     return 0;
 }
 
+#define AT_FDCWD -100
+#define AT_SYMLINK_NOFOLLOW 0x100
+#define AT_REMOVEDIR 0x200
+
+// Windows has no directory handles, so the *at() family below only accepts AT_FDCWD and full paths
+
+static int openat(int /*dirfd*/, const char *path, int flags, mode_t mode) {
+    return open(path, flags, mode);
+}
+
+static int fstatat(int /*dirfd*/, const char *path, struct stat *st, int /*flags*/) {
+    return stat(path, st);
+}
+
+static int mkdirat(int /*dirfd*/, const char *path, mode_t /*mode*/) {
+    return _mkdir(path);
+}
+
+static int unlinkat(int /*dirfd*/, const char *path, int flags) {
+    return ((flags & AT_REMOVEDIR) != 0) ? rmdir(path) : unlink(path);
+}
+
+static int renameat(int /*olddirfd*/, const char *oldpath, int /*newdirfd*/, const char *newpath) {
+    return rename(oldpath, newpath);
+}
+
 #endif // _WIN32
 
 namespace cartesi {
@@ -837,6 +908,20 @@ static p9_error host_errno_to_p9(int err) {
     return P9_EINVAL;
 }
 
+/// \brief Reads from a file at an offset straight into host memory spans of a queue buffer
+static ssize_t read_host_spans(int fd, const virtq_host_spans &spans, uint64_t offset) {
+    std::array<iovec, VIRTIO_QUEUE_NUM_MAX> iov{};
+    const int iovcnt = virtq_host_spans_to_iovec(spans, iov);
+    return preadv(fd, iov.data(), iovcnt, static_cast<off_t>(offset));
+}
+
+/// \brief Writes to a file at an offset straight from host memory spans of a queue buffer
+static ssize_t write_host_spans(int fd, const virtq_host_spans &spans, uint64_t offset) {
+    std::array<iovec, VIRTIO_QUEUE_NUM_MAX> iov{};
+    const int iovcnt = virtq_host_spans_to_iovec(spans, iov);
+    return pwritev(fd, iov.data(), iovcnt, static_cast<off_t>(offset));
+}
+
 static int p9_open_flags_to_host(uint32_t flags) {
     int oflags = 0;
     for (uint32_t i = 1; i <= P9_O_SYNC; i = i << 1) {
@@ -999,28 +1084,6 @@ static bool is_same_stat_ino(const stat_t *a, const stat_t *b) {
     return a->st_dev == b->st_dev && a->st_ino == b->st_ino;
 }
 
-static int close_fid_state(p9_fid_state *fidp) {
-    if (fidp == nullptr) {
-        return 0;
-    }
-    int err = 0;
-    if (fidp->dirp != nullptr) {
-        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
-        DIR *dirp = reinterpret_cast<DIR *>(fidp->dirp);
-        if (closedir(dirp) != 0) {
-            err = errno;
-        }
-        fidp->dirp = nullptr;
-    }
-    if (fidp->fd >= 0) {
-        if (close(fidp->fd) != 0) {
-            err = errno;
-        }
-        fidp->fd = -1;
-    }
-    return err;
-}
-
 static std::string join_path_name(const std::string &path, const std::string &name) {
     if (path.empty()) {
         return name;
@@ -1043,6 +1106,26 @@ static std::string remove_path_name(const std::string &path) {
     return path;
 }
 
+/// \brief Returns the part of a path relative to a base directory path, or nullptr if it is not below it
+static const char *get_relative_path_name(const std::string &base, const std::string &path) {
+    if (base.empty() || path.length() <= base.length() || path.compare(0, base.length(), base) != 0) {
+        return nullptr;
+    }
+    if (base[base.length() - 1] == '/') {
+        return path.c_str() + base.length();
+    }
+    if (path[base.length()] != '/') {
+        return nullptr;
+    }
+    return path.c_str() + base.length() + 1;
+}
+
+/// \brief Returns the name of a directory entry suitable for *at() syscalls based on the given directory handle
+static const char *get_at_name(int dir_fd, const char *name, const std::string &path) {
+    // Without a directory handle we have to fall back to the full path
+    return (dir_fd != AT_FDCWD) ? name : path.c_str();
+}
+
 static bool is_name_legal(const std::string &name) {
     if (name.empty()) {
         return false;
@@ -1056,6 +1139,131 @@ static bool is_name_legal(const std::string &name) {
     return true;
 }
 
+/// \brief Appends raw bytes to a buffer, in the same layout virtq_serializer writes them
+static void append_bytes(std::vector<uint8_t> &buf, const void *data, size_t len) {
+    const auto *bytes = static_cast<const uint8_t *>(data);
+    buf.insert(buf.end(), bytes, bytes + len);
+}
+
+/// \brief Opens a directory stream for a readdir job
+/// \returns Directory stream, or nullptr with errno set.
+static DIR *open_dir_stream(const p9_io_job &job) {
+#ifndef _WIN32
+    // The fid directory handle spares walking its path again
+    const int fd = openat(job.fd, get_at_name(job.fd, ".", job.path), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+    DIR *dirp = fdopendir(fd);
+    if (dirp == nullptr) {
+        const int err = errno;
+        close(fd);
+        errno = err;
+    }
+    return dirp;
+#else
+    return opendir(job.path.c_str());
+#endif
+}
+
+/// \brief Captures all entries of the directory of a readdir job
+/// \returns Number of entries, or -1 with errno set when the directory could not be read.
+static ssize_t read_dir_entries(p9_io_job &job) {
+    DIR *dirp = open_dir_stream(job);
+    if (dirp == nullptr) {
+        return -1;
+    }
+    job.entries.clear();
+    while (true) {
+        // Get the next directory entry
+        errno = 0;
+        const dirent *dir_entry = readdir(dirp);
+        if (dir_entry == nullptr) {
+            break;
+        }
+        p9_dir_entry entry;
+        entry.name = dir_entry->d_name;
+        // Get entry qid and type
+#if defined(DT_UNKNOWN) && defined(DT_DIR) && defined(DT_LNK)
+        // In some filesystems dtype may be DT_UNKNOWN as an optimization to save lstat() calls
+        if (dir_entry->d_type == DT_UNKNOWN) {
+            stat_t st{};
+            if (fstatat(dirfd(dirp), dir_entry->d_name, &st, AT_SYMLINK_NOFOLLOW) < 0) {
+                // The entry was removed while reading the directory
+                continue;
+            }
+            entry.type = host_mode_to_p9(st.st_mode) >> 12;
+            entry.qid = stat_to_qid(st);
+        } else {
+            entry.type = dir_entry->d_type;
+            if (entry.type == DT_DIR) {
+                entry.qid.type = P9_QID_DIR;
+            } else if (entry.type == DT_LNK) {
+                entry.qid.type = P9_QID_SYMLINK;
+            } else {
+                entry.qid.type = P9_QID_FILE;
+            }
+            entry.qid.inode = dir_entry->d_ino;
+        }
+#endif
+        job.entries.push_back(std::move(entry));
+    }
+    const int err = errno;
+    std::ignore = closedir(dirp);
+    if (err != 0) {
+        job.entries.clear();
+        errno = err;
+        return -1;
+    }
+    return static_cast<ssize_t>(job.entries.size());
+}
+
+/// \brief Performs the host I/O of a job
+/// \details This is safe to call from worker threads.
+static void execute_io_job(p9_io_job &job) {
+    ssize_t ret = -1;
+    errno = 0;
+    switch (job.opcode) {
+        case P9_TREAD:
+            if (job.in_place) {
+                ret = read_host_spans(job.fd, job.spans, job.offset);
+            } else {
+                ret = pread(job.fd, job.buf.data(), static_cast<size_t>(job.count), static_cast<off_t>(job.offset));
+            }
+            break;
+        case P9_TWRITE:
+            if (job.in_place) {
+                ret = write_host_spans(job.fd, job.spans, job.offset);
+            } else {
+                ret = pwrite(job.fd, job.buf.data(), static_cast<size_t>(job.count), static_cast<off_t>(job.offset));
+            }
+            break;
+        case P9_TFSYNC:
+            ret = fsync(job.fd);
+            break;
+        case P9_TREADDIR:
+            ret = read_dir_entries(job);
+            break;
+        default:
+            errno = EINVAL;
+            break;
+    }
+    job.ret = ret;
+    job.err = (ret < 0) ? errno : 0;
+}
+
+/// \brief Creates a job for a request
+static std::unique_ptr<p9_io_job> make_io_job(const virtq_unserializer &msg, uint16_t tag, p9_opcode opcode,
+    uint32_t fid) {
+    auto job = std::make_unique<p9_io_job>();
+    job->queue_idx = msg.queue_idx;
+    job->desc_idx = static_cast<uint16_t>(msg.desc_idx);
+    job->tag = tag;
+    job->opcode = opcode;
+    job->fid = fid;
+    return job;
+}
+
 virtio_p9fs_device::virtio_p9fs_device(uint32_t virtio_idx, const std::string &mount_tag,
     const std::string &root_path) :
     virtio_device(virtio_idx, VIRTIO_DEVICE_9P, VIRTIO_9P_F_MOUNT_TAG, mount_tag.length() + sizeof(uint16_t)),
@@ -1078,6 +1286,8 @@ virtio_p9fs_device::virtio_p9fs_device(uint32_t virtio_idx, const std::string &m
 }
 
 virtio_p9fs_device::~virtio_p9fs_device() {
+    // Jobs may still be using file descriptors and guest memory
+    drain_io_jobs(true);
     // Close all file descriptors
     for (auto &it : m_fids) {
         p9_fid_state *fidp = &it.second;
@@ -1088,12 +1298,332 @@ virtio_p9fs_device::~virtio_p9fs_device() {
 
 void virtio_p9fs_device::on_device_reset() {
     m_msize = P9_MAX_MSIZE;
+    // Replies of pending jobs must not reach the reinitialized queues
+    drain_io_jobs(false);
     // Close all file descriptors
     for (auto &it : m_fids) {
         p9_fid_state *fidp = &it.second;
         close_fid_state(fidp);
     }
     m_fids.clear();
+    m_attr_cache.clear();
+}
+
+int virtio_p9fs_device::close_fid_state(p9_fid_state *fidp) {
+    if (fidp == nullptr) {
+        return 0;
+    }
+    int err = 0;
+    fidp->dir_entries.clear();
+    fidp->dir_entries.shrink_to_fit();
+    fidp->has_dir_entries = false;
+    if (fidp->fd >= 0) {
+        if (close(fidp->fd) != 0) {
+            err = errno;
+        }
+        fidp->fd = -1;
+    }
+    if (fidp->dir_fd >= 0) {
+        if (close(fidp->dir_fd) != 0 && err == 0) {
+            err = errno;
+        }
+        fidp->dir_fd = -1;
+        --m_dir_handles;
+    }
+    return err;
+}
+
+int virtio_p9fs_device::get_dir_handle(p9_fid_state *fidp) {
+#ifndef _WIN32
+    if (fidp->dir_fd >= 0) {
+        return fidp->dir_fd;
+    }
+    // Keep the number of handles bounded, fids beyond the limit just use full paths
+    if (m_dir_handles >= P9_DIR_HANDLES_MAX) {
+        return AT_FDCWD;
+    }
+#ifdef O_PATH
+    // The handle is only used as base for lookups, so it does not need read permission on the directory
+    const int dir_fd = open(fidp->path.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC);
+#else
+    const int dir_fd = open(fidp->path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+#endif
+    if (dir_fd < 0) {
+        errno = 0;
+        return AT_FDCWD;
+    }
+    fidp->dir_fd = dir_fd;
+    ++m_dir_handles;
+    return dir_fd;
+#else
+    (void) fidp;
+    return AT_FDCWD;
+#endif
+}
+
+int virtio_p9fs_device::lstat_cached(p9_fid_state *basep, const std::string &path, stat_t *st) {
+    const int64_t now_us = os_now_us();
+    auto it = m_attr_cache.find(path);
+    if (it != m_attr_cache.end()) {
+        const p9_attr_cache_entry &entry = it->second;
+        if (now_us < entry.expire_us) {
+            if (entry.err != 0) {
+                errno = entry.err;
+                return -1;
+            }
+            *st = entry.st;
+            return 0;
+        }
+        m_attr_cache.erase(it);
+    }
+    // Resolve the path relative to the base directory handle when possible, so the host walks fewer components
+    int ret = 0;
+    const char *rel_name = (basep != nullptr) ? get_relative_path_name(basep->path, path) : nullptr;
+    const int base_fd = (rel_name != nullptr) ? get_dir_handle(basep) : AT_FDCWD;
+    if (base_fd != AT_FDCWD) {
+        ret = fstatat(base_fd, rel_name, st, AT_SYMLINK_NOFOLLOW);
+    } else {
+        ret = lstat(path.c_str(), st);
+    }
+    const int err = (ret != 0) ? errno : 0;
+    // Only cache found entries and missing entries, other errors may be transient
+    if (err == 0 || err == ENOENT || err == ENOTDIR) {
+        // The cache is small, so just start over when it gets full
+        if (m_attr_cache.size() >= P9_ATTR_CACHE_MAX) {
+            m_attr_cache.clear();
+        }
+        p9_attr_cache_entry &entry = m_attr_cache[path];
+        entry.st = (err == 0) ? *st : stat_t{};
+        entry.err = err;
+        entry.expire_us = now_us + P9_ATTR_CACHE_TTL_US;
+    }
+    errno = err;
+    return ret;
+}
+
+void virtio_p9fs_device::invalidate_attr(const std::string &path, bool recursive) {
+    m_attr_cache.erase(path);
+    if (recursive) {
+        std::erase_if(m_attr_cache,
+            [&path](const auto &entry) { return get_relative_path_name(path, entry.first) != nullptr; });
+    }
+}
+
+void virtio_p9fs_device::forget_dir_entry(const std::string &dir_path, const std::string &name) {
+    // Entries keep their place, so the offsets the guest already got stay valid
+    for (auto &[fid, fid_state] : m_fids) {
+        if (!fid_state.has_dir_entries || fid_state.path != dir_path) {
+            continue;
+        }
+        for (auto &entry : fid_state.dir_entries) {
+            if (entry.name == name) {
+                entry.removed = true;
+            }
+        }
+    }
+}
+
+bool virtio_p9fs_device::dispatch_io_job(i_device_state_access *a, std::unique_ptr<p9_io_job> job) {
+#ifdef HAVE_VIRTIO_P9FS_ASYNC_IO
+    if (start_io_workers()) {
+        // The reply is sent later, when polled after the job is finished
+        {
+            const std::lock_guard<std::mutex> lock(m_io_mutex);
+            ++m_io_fid_jobs[job->fid];
+            m_io_queue.push_back(std::move(job));
+        }
+        m_io_queue_cv.notify_one();
+        return true;
+    }
+#endif
+    execute_io_job(*job);
+    return complete_io_job(a, *job);
+}
+
+bool virtio_p9fs_device::complete_io_job(i_device_state_access *a, p9_io_job &job) {
+    const virtq_unserializer msg(a, queue[job.queue_idx], job.queue_idx, job.desc_idx);
+    if (job.err != 0) {
+        return send_error(msg, job.tag, host_errno_to_p9(job.err));
+    }
+    virtq_serializer out_msg(a, queue[job.queue_idx], job.queue_idx, job.desc_idx, P9_OUT_MSG_OFFSET);
+    switch (job.opcode) {
+        case P9_TREAD: {
+            auto ret_count = static_cast<uint32_t>(job.ret);
+            if (!out_msg.pack(&ret_count)) {
+                return send_error(msg, job.tag, P9_EPROTO);
+            }
+            if (job.in_place) {
+                out_msg.skip_bytes(ret_count);
+            } else if (!out_msg.write_bytes(job.buf.data(), ret_count)) {
+                return send_error(msg, job.tag, P9_EPROTO);
+            }
+            return send_reply(std::move(out_msg), job.tag, P9_RREAD);
+        }
+        case P9_TWRITE: {
+            // Size and modification time have changed
+            auto it = m_fids.find(job.fid);
+            if (it != m_fids.end()) {
+                invalidate_attr(it->second.path);
+            }
+            auto ret_count = static_cast<uint32_t>(job.ret);
+            if (!out_msg.pack(&ret_count)) {
+                return send_error(msg, job.tag, P9_EPROTO);
+            }
+            return send_reply(std::move(out_msg), job.tag, P9_RWRITE);
+        }
+        case P9_TFSYNC:
+            return send_reply(std::move(out_msg), job.tag, P9_RFSYNC);
+        case P9_TREADDIR: {
+            // Keep the snapshot in the fid, so the next requests are replied from it without host I/O
+            auto it = m_fids.find(job.fid);
+            if (it == m_fids.end()) {
+                return send_dir_entries(msg, job.tag, job.entries, job.offset, job.count);
+            }
+            p9_fid_state &fid_state = it->second;
+            fid_state.dir_entries = std::move(job.entries);
+            fid_state.has_dir_entries = true;
+            return send_dir_entries(msg, job.tag, fid_state.dir_entries, job.offset, job.count);
+        }
+        default:
+            return send_error(msg, job.tag, P9_EPROTO);
+    }
+}
+
+void virtio_p9fs_device::wait_io_jobs([[maybe_unused]] uint32_t fid) {
+#ifdef HAVE_VIRTIO_P9FS_ASYNC_IO
+    if (m_io_workers.empty()) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(m_io_mutex);
+    m_io_done_cv.wait(lock, [this, fid] { return !m_io_fid_jobs.contains(fid); });
+#endif
+}
+
+void virtio_p9fs_device::drain_io_jobs([[maybe_unused]] bool stop) {
+#ifdef HAVE_VIRTIO_P9FS_ASYNC_IO
+    if (m_io_workers.empty()) {
+        return;
+    }
+    {
+        std::unique_lock<std::mutex> lock(m_io_mutex);
+        m_io_done_cv.wait(lock, [this] { return m_io_fid_jobs.empty(); });
+        m_io_done.clear();
+        if (!stop) {
+            return;
+        }
+        m_io_stopping = true;
+    }
+    m_io_queue_cv.notify_all();
+    for (auto &worker : m_io_workers) {
+        worker.join();
+    }
+    m_io_workers.clear();
+    for (int &fd : m_io_wakeup_fds) {
+        std::ignore = close(fd);
+        fd = -1;
+    }
+#endif
+}
+
+#ifdef HAVE_VIRTIO_P9FS_ASYNC_IO
+
+bool virtio_p9fs_device::start_io_workers() {
+    if (!m_io_workers.empty()) {
+        return true;
+    }
+    if (m_io_stopping) {
+        return false;
+    }
+    // Finished jobs write to this pipe, so the device is polled right away even when the guest is idle
+    if (pipe(m_io_wakeup_fds.data()) != 0) {
+        m_io_wakeup_fds = {-1, -1};
+        return false;
+    }
+    for (const int fd : m_io_wakeup_fds) {
+        std::ignore = fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        std::ignore = fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+    try {
+        for (uint32_t i = 0; i < P9_IO_WORKERS; ++i) {
+            m_io_workers.emplace_back([this] { run_io_worker(); });
+        }
+    } catch (std::system_error &) {
+        // Run with the workers we managed to start, or synchronously if none
+        if (m_io_workers.empty()) {
+            for (int &fd : m_io_wakeup_fds) {
+                std::ignore = close(fd);
+                fd = -1;
+            }
+            return false;
+        }
+    }
+    return true;
+}
+
+void virtio_p9fs_device::run_io_worker() {
+    std::unique_lock<std::mutex> lock(m_io_mutex);
+    while (true) {
+        m_io_queue_cv.wait(lock, [this] { return m_io_stopping || !m_io_queue.empty(); });
+        if (m_io_queue.empty()) {
+            return;
+        }
+        std::unique_ptr<p9_io_job> job = std::move(m_io_queue.front());
+        m_io_queue.pop_front();
+        lock.unlock();
+        execute_io_job(*job);
+        lock.lock();
+        auto it = m_io_fid_jobs.find(job->fid);
+        if (--it->second == 0) {
+            m_io_fid_jobs.erase(it);
+        }
+        m_io_done.push_back(std::move(job));
+        m_io_done_cv.notify_all();
+        // Wake up the device thread, a full pipe is fine because it is going to wake up anyway
+        const char wakeup = 0;
+        std::ignore = write(m_io_wakeup_fds[1], &wakeup, sizeof(wakeup));
+    }
+}
+
+#endif
+
+void virtio_p9fs_device::prepare_select([[maybe_unused]] select_fd_sets *fds, uint64_t * /*timeout_us*/) {
+#ifdef HAVE_VIRTIO_P9FS_ASYNC_IO
+    if (m_io_workers.empty()) {
+        return;
+    }
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    auto *readfds = reinterpret_cast<fd_set *>(fds->readfds);
+    FD_SET(m_io_wakeup_fds[0], readfds);
+    fds->maxfd = std::max(m_io_wakeup_fds[0], fds->maxfd);
+#endif
+}
+
+bool virtio_p9fs_device::poll_selected([[maybe_unused]] int select_ret, [[maybe_unused]] select_fd_sets *fds,
+    [[maybe_unused]] i_device_state_access *da) {
+#ifdef HAVE_VIRTIO_P9FS_ASYNC_IO
+    if (m_io_workers.empty()) {
+        return false;
+    }
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    auto *readfds = reinterpret_cast<fd_set *>(fds->readfds);
+    if (select_ret > 0 && FD_ISSET(m_io_wakeup_fds[0], readfds)) {
+        std::array<char, 64> wakeups{};
+        while (read(m_io_wakeup_fds[0], wakeups.data(), wakeups.size()) > 0) {
+        }
+    }
+    // Reply to finished jobs, even if their wake ups were consumed by an earlier poll
+    std::vector<std::unique_ptr<p9_io_job>> done;
+    {
+        const std::lock_guard<std::mutex> lock(m_io_mutex);
+        done.swap(m_io_done);
+    }
+    for (auto &job : done) {
+        std::ignore = complete_io_job(da, *job);
+    }
+    return !done.empty();
+#else
+    return false;
+#endif
 }
 
 void virtio_p9fs_device::on_device_ok(i_device_state_access * /*a*/) {
@@ -1319,6 +1849,10 @@ bool virtio_p9fs_device::op_lopen(virtq_unserializer &&mmsg, uint16_t tag) {
         }
         return false;
     }
+    // Truncation changes the file attributes
+    if ((flags & P9_O_TRUNC) != 0) {
+        invalidate_attr(fidp->path);
+    }
     // Update fid
     fidp->fd = fd;
     return true;
@@ -1355,10 +1889,13 @@ bool virtio_p9fs_device::op_lcreate(virtq_unserializer &&mmsg, uint16_t tag) {
     const std::string path = join_path_name(fidp->path, name);
     const int oflags = p9_open_flags_to_host(flags) | O_CREAT;
     const auto omode = static_cast<mode_t>(mode);
-    const int fd = open(path.c_str(), oflags, omode);
+    const int dir_fd = get_dir_handle(fidp);
+    const int fd = openat(dir_fd, get_at_name(dir_fd, name, path), oflags, omode);
     if (fd < 0) {
         return send_error(msg, tag, host_errno_to_p9(errno));
     }
+    invalidate_attr(fidp->path);
+    invalidate_attr(path);
 #ifndef _WIN32
     // If we fail to change ownership, we silent ignore the error
     if (fchown(fd, static_cast<uid_t>(fidp->uid), static_cast<gid_t>(gid)) != 0) {
@@ -1386,7 +1923,8 @@ bool virtio_p9fs_device::op_lcreate(virtq_unserializer &&mmsg, uint16_t tag) {
         std::ignore = unlink(path.c_str());
         return false;
     }
-    // Update fid to represent the newly opened file
+    // Update fid to represent the newly opened file, releasing what it held for its directory
+    close_fid_state(fidp);
     fidp->path = path;
     fidp->fd = fd;
     return true;
@@ -1417,16 +1955,21 @@ bool virtio_p9fs_device::op_symlink(virtq_unserializer &&mmsg, uint16_t tag) {
     }
     // Create the symlink
     const std::string path = join_path_name(dfidp->path, name);
-    if (symlink(symtgt, path.c_str()) != 0) {
+    const int dir_fd = get_dir_handle(dfidp);
+    const char *at_name = get_at_name(dir_fd, name, path);
+    if (symlinkat(symtgt, dir_fd, at_name) != 0) {
         return send_error(msg, tag, host_errno_to_p9(errno));
     }
+    invalidate_attr(dfidp->path);
+    invalidate_attr(path);
     // If we fail to change ownership, we silent ignore the error
-    if (lchown(path.c_str(), static_cast<uid_t>(dfidp->uid), static_cast<gid_t>(gid)) != 0) {
+    if (fchownat(dir_fd, at_name, static_cast<uid_t>(dfidp->uid), static_cast<gid_t>(gid), AT_SYMLINK_NOFOLLOW) !=
+        0) {
         errno = 0;
     }
     // Get the path qid
     stat_t st{};
-    if (lstat(path.c_str(), &st) != 0) {
+    if (fstatat(dir_fd, at_name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
         std::ignore = unlink(path.c_str());
         return send_error(msg, tag, host_errno_to_p9(errno));
     }
@@ -1478,6 +2021,8 @@ bool virtio_p9fs_device::op_mknod(virtq_unserializer &&mmsg, uint16_t tag) {
     if (mknod(path.c_str(), static_cast<mode_t>(mode), dev) != 0) {
         return send_error(msg, tag, host_errno_to_p9(errno));
     }
+    invalidate_attr(dfidp->path);
+    invalidate_attr(path);
     // If we fail to change ownership, we silent ignore the error
     if (lchown(path.c_str(), static_cast<uid_t>(dfidp->uid), static_cast<gid_t>(gid)) != 0) {
         errno = 0;
@@ -1531,6 +2076,8 @@ bool virtio_p9fs_device::op_setattr(virtq_unserializer &&mmsg, uint16_t tag) {
     if (fidp == nullptr) {
         return send_error(msg, tag, P9_EPROTO);
     }
+    // Even a partially failed change may have modified the attributes
+    invalidate_attr(fidp->path);
     bool ctime_updated = false;
     // Modify ownership
     if ((mask & (P9_SETATTR_UID | P9_SETATTR_GID)) != 0) {
@@ -1695,15 +2242,16 @@ bool virtio_p9fs_device::op_getattr(virtq_unserializer &&mmsg, uint16_t tag) {
         return send_error(msg, tag, P9_EPROTO);
     }
     stat_t st{};
-    // Use fd when available, because its path might have been removed while fd still open
-    if (fidp->fd >= 0) {
+    // Use fd or directory handle when available, because its path might have been removed while still open
+    const int fd = (fidp->fd >= 0) ? fidp->fd : fidp->dir_fd;
+    if (fd >= 0) {
         // Get the attributes
-        if (fstat(fidp->fd, &st) != 0) {
+        if (fstat(fd, &st) != 0) {
             return send_error(msg, tag, host_errno_to_p9(errno));
         }
     } else {
-        // Get the attributes
-        if (lstat(fidp->path.c_str(), &st) != 0) {
+        // Get the attributes, most likely already looked up by the walk that created this fid
+        if (lstat_cached(nullptr, fidp->path, &st) != 0) {
             return send_error(msg, tag, host_errno_to_p9(errno));
         }
     }
@@ -1907,97 +2455,17 @@ bool virtio_p9fs_device::op_readdir(virtq_unserializer &&mmsg, uint16_t tag) {
     if (fidp == nullptr) {
         return send_error(msg, tag, P9_EPROTO);
     }
-    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
-    DIR *dirp = reinterpret_cast<DIR *>(fidp->dirp);
-    // Open directory in case it's not yet
-    if (dirp == nullptr) {
-        dirp = opendir(fidp->path.c_str());
-        if (dirp == nullptr) {
-            return send_error(msg, tag, host_errno_to_p9(errno));
-        }
-        fidp->dirp = dirp;
-    }
-    constexpr uint32_t start_offset = P9_OUT_MSG_OFFSET + sizeof(uint32_t);
-    virtq_serializer out_msg(msg.a, msg.vq, msg.queue_idx, msg.desc_idx, start_offset);
-    // Seek directory
-    if (offset == 0) {
-        rewinddir(dirp);
-    } else {
-        seekdir(dirp, static_cast<int64_t>(offset));
-    }
-    // Traverse directory entries
-    while (true) {
-        const bool first_entry = (msg.offset == start_offset);
-        // Get the next directory entry
-        errno = 0;
-        dirent *dir_entry = readdir(dirp);
-        if (dir_entry == nullptr) {
-            if (errno != 0 && first_entry) {
-                return send_error(msg, tag, host_errno_to_p9(errno));
-            }
-            break;
-        }
-        const char *name = dir_entry->d_name;
-        // Check if there is enough space to add this entry
-        const uint32_t data_len = out_msg.offset - start_offset;
-        const uint32_t entry_len =
-            sizeof(p9_qid) + sizeof(uint64_t) + sizeof(uint8_t) + sizeof(uint16_t) + strlen(name);
-        if (data_len + entry_len > count) {
-            break;
-        }
-        // Get entry offset
-        const int64_t entry_off = telldir(dirp);
-        if (entry_off < 0) {
-            if (first_entry) {
-                return send_error(msg, tag, host_errno_to_p9(errno));
-            }
-            break;
-        }
-        // Get entry qid and type
-        p9_qid qid{};
-        bool take_qid_from_stat = false;
-        uint8_t type = 0;
-#if defined(DT_UNKNOWN) && defined(DT_DIR) && defined(DT_LNK)
-        // In some filesystems dtype may be DT_UNKNOWN as an optimization to save lstat() calls
-        if (dir_entry->d_type == DT_UNKNOWN) {
-            take_qid_from_stat = true;
-        } else {
-            type = dir_entry->d_type;
-            if (type == DT_DIR) {
-                qid.type = P9_QID_DIR;
-            } else if (type == DT_LNK) {
-                qid.type = P9_QID_SYMLINK;
-            } else {
-                qid.type = P9_QID_FILE;
-            }
-            qid.inode = dir_entry->d_ino;
-        }
-#endif
-        if (take_qid_from_stat) {
-            stat_t st{};
-            const std::string path = join_path_name(fidp->path, dir_entry->d_name);
-            if (lstat(path.c_str(), &st) < 0) {
-                if (errno != 0 && first_entry) {
-                    return send_error(msg, tag, host_errno_to_p9(errno));
-                }
-                break;
-            }
-            type = host_mode_to_p9(st.st_mode) >> 12;
-            qid = stat_to_qid(st);
-        }
-        // Add the entry to our reply
-        auto off = static_cast<uint64_t>(entry_off);
-        if (!out_msg.pack(&qid, &off, &type, name)) {
-            return send_error(msg, tag, P9_EPROTO);
-        }
-    }
-    // Reply
-    uint32_t data_len = out_msg.length - start_offset;
-    out_msg.offset = P9_OUT_MSG_OFFSET;
-    if (!out_msg.pack(&data_len)) {
-        return send_error(msg, tag, P9_EPROTO);
+    // Entries are served from a snapshot of the directory taken when reading it from the start,
+    // so their offsets are stable and no host I/O is needed to continue reading it
+    if (offset != 0 && fidp->has_dir_entries) {
+        return send_dir_entries(msg, tag, fidp->dir_entries, offset, count);
     }
-    return send_reply(std::move(out_msg), tag, P9_RREADDIR);
+    auto job = make_io_job(msg, tag, P9_TREADDIR, fid);
+    job->fd = get_dir_handle(fidp);
+    job->path = fidp->path;
+    job->offset = offset;
+    job->count = count;
+    return dispatch_io_job(msg.a, std::move(job));
 }
 
 bool virtio_p9fs_device::op_fsync(virtq_unserializer &&mmsg, uint16_t tag) {
@@ -2010,16 +2478,14 @@ bool virtio_p9fs_device::op_fsync(virtq_unserializer &&mmsg, uint16_t tag) {
     std::ignore = fprintf(stderr, "p9fs fsync: tag=%d fid=%d\n", tag, fid);
 #endif
     // Get the fid state
-    p9_fid_state *fidp = get_fid_state(fid);
+    p9_fid_state *fidp = get_fid_state(fid, false);
     if ((fidp == nullptr) || fidp->fd < 0) {
         return send_error(msg, tag, P9_EPROTO);
     }
     // Sync the file
-    if (fsync(fidp->fd) != 0) {
-        return send_error(msg, tag, host_errno_to_p9(errno));
-    }
-    // Reply
-    return send_ok(msg, tag, P9_RFSYNC);
+    auto job = make_io_job(msg, tag, P9_TFSYNC, fid);
+    job->fd = fidp->fd;
+    return dispatch_io_job(msg.a, std::move(job));
 }
 
 bool virtio_p9fs_device::op_link(virtq_unserializer &&mmsg, uint16_t tag) {
@@ -2046,9 +2512,13 @@ bool virtio_p9fs_device::op_link(virtq_unserializer &&mmsg, uint16_t tag) {
     }
     // Create the hard link
     const std::string path = join_path_name(dfidp->path, name);
-    if (link(fidp->path.c_str(), path.c_str()) != 0) {
+    const int dir_fd = get_dir_handle(dfidp);
+    if (linkat(AT_FDCWD, fidp->path.c_str(), dir_fd, get_at_name(dir_fd, name, path), 0) != 0) {
         return send_error(msg, tag, host_errno_to_p9(errno));
     }
+    invalidate_attr(dfidp->path);
+    invalidate_attr(fidp->path);
+    invalidate_attr(path);
     // Reply
     if (!send_ok(msg, tag, P9_RLINK)) {
         std::ignore = unlink(path.c_str());
@@ -2083,22 +2553,23 @@ bool virtio_p9fs_device::op_mkdir(virtq_unserializer &&mmsg, uint16_t tag) {
     }
     // Create the directory
     const std::string path = join_path_name(dfidp->path, name);
-#ifdef _WIN32
-    if (_mkdir(path.c_str()) != 0) {
-        return send_error(msg, tag, host_errno_to_p9(errno));
-    }
-#else
-    if (mkdir(path.c_str(), static_cast<mode_t>(mode)) != 0) {
+    const int dir_fd = get_dir_handle(dfidp);
+    const char *at_name = get_at_name(dir_fd, name, path);
+    if (mkdirat(dir_fd, at_name, static_cast<mode_t>(mode)) != 0) {
         return send_error(msg, tag, host_errno_to_p9(errno));
     }
+    invalidate_attr(dfidp->path);
+    invalidate_attr(path);
+#ifndef _WIN32
     // If we fail to change ownership, we silent ignore the error
-    if (lchown(path.c_str(), static_cast<uid_t>(dfidp->uid), static_cast<gid_t>(gid)) != 0) {
+    if (fchownat(dir_fd, at_name, static_cast<uid_t>(dfidp->uid), static_cast<gid_t>(gid), AT_SYMLINK_NOFOLLOW) !=
+        0) {
         errno = 0;
     }
 #endif
     // Get the path qid
     stat_t st{};
-    if (lstat(path.c_str(), &st) != 0) {
+    if (fstatat(dir_fd, at_name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
         std::ignore = rmdir(path.c_str());
         return send_error(msg, tag, host_errno_to_p9(errno));
     }
@@ -2134,18 +2605,26 @@ bool virtio_p9fs_device::op_renameat(virtq_unserializer &&mmsg, uint16_t tag) {
         return send_error(msg, tag, P9_ENOENT);
     }
     // Get the fid state
-    const p9_fid_state *oldfidp = get_fid_state(oldfid);
-    const p9_fid_state *newfidp = get_fid_state(newfid);
+    p9_fid_state *oldfidp = get_fid_state(oldfid);
+    p9_fid_state *newfidp = get_fid_state(newfid);
     if ((newfidp == nullptr) || (oldfidp == nullptr)) {
         return send_error(msg, tag, P9_EPROTO);
     }
     // Rename the file
     const std::string oldpath = join_path_name(oldfidp->path, oldname);
     const std::string newpath = join_path_name(newfidp->path, newname);
-    const int ret = rename(oldpath.c_str(), newpath.c_str());
+    const int olddir_fd = get_dir_handle(oldfidp);
+    const int newdir_fd = get_dir_handle(newfidp);
+    const int ret = renameat(olddir_fd, get_at_name(olddir_fd, oldname, oldpath), newdir_fd,
+        get_at_name(newdir_fd, newname, newpath));
     if (ret != 0) {
         return send_error(msg, tag, host_errno_to_p9(errno));
     }
+    invalidate_attr(oldfidp->path);
+    invalidate_attr(newfidp->path);
+    invalidate_attr(oldpath, true);
+    invalidate_attr(newpath, true);
+    forget_dir_entry(oldfidp->path, oldname);
     // Reply
     if (!send_ok(msg, tag, P9_RRENAMEAT)) {
         std::ignore = rename(newpath.c_str(), oldpath.c_str());
@@ -2178,21 +2657,20 @@ bool virtio_p9fs_device::op_unlinkat(virtq_unserializer &&mmsg, uint16_t tag) {
         return send_error(msg, tag, P9_ENOENT);
     }
     // Get the fid state
-    const p9_fid_state *dfidp = get_fid_state(dfid);
+    p9_fid_state *dfidp = get_fid_state(dfid);
     if (dfidp == nullptr) {
         return send_error(msg, tag, P9_EPROTO);
     }
     // Remove the path
     const std::string path = join_path_name(dfidp->path, name);
-    if ((flags & P9_AT_REMOVEDIR) != 0) {
-        if (rmdir(path.c_str()) != 0) {
-            return send_error(msg, tag, host_errno_to_p9(errno));
-        }
-    } else {
-        if (unlink(path.c_str()) != 0) {
-            return send_error(msg, tag, host_errno_to_p9(errno));
-        }
+    const int dir_fd = get_dir_handle(dfidp);
+    const int at_flags = ((flags & P9_AT_REMOVEDIR) != 0) ? AT_REMOVEDIR : 0;
+    if (unlinkat(dir_fd, get_at_name(dir_fd, name, path), at_flags) != 0) {
+        return send_error(msg, tag, host_errno_to_p9(errno));
     }
+    invalidate_attr(dfidp->path);
+    invalidate_attr(path, true);
+    forget_dir_entry(dfidp->path, name);
     return send_ok(msg, tag, P9_RUNLINKAT);
 }
 
@@ -2204,10 +2682,13 @@ bool virtio_p9fs_device::op_version(virtq_unserializer &&mmsg, uint16_t tag) {
         return send_error(msg, tag, P9_EPROTO);
     }
 #ifdef DEBUG_VIRTIO_P9FS
-    std::ignore = fprintf(stderr, "p9fs version: tag=%d msize=%d version=%s\n", tag, m_msize, version);
+    std::ignore = fprintf(stderr, "p9fs version: tag=%d msize=%d version=%s\n", tag, msize, version);
 #endif
-    // Set msize
-    m_msize = std::min<uint32_t>(m_msize, P9_MAX_MSIZE);
+    // Negotiate msize, the client may ask for less than we support
+    if (msize < P9_MIN_MSIZE) {
+        return send_error(msg, tag, P9_EPROTO);
+    }
+    m_msize = std::min<uint32_t>(msize, P9_MAX_MSIZE);
     // Reply with the protocol version we support
     virtq_serializer out_msg(msg.a, msg.vq, msg.queue_idx, msg.desc_idx, P9_OUT_MSG_OFFSET);
     const char P9_PROTO_VERSION[] = "9P2000.L";
@@ -2286,7 +2767,7 @@ bool virtio_p9fs_device::op_walk(virtq_unserializer &&mmsg, uint16_t tag) {
     // Get the start for the starting path and root path
     stat_t st{};
     stat_t root_st{};
-    if (lstat(fidp->path.c_str(), &st) != 0 || lstat(m_root_path.c_str(), &root_st) != 0) {
+    if (lstat_cached(nullptr, fidp->path, &st) != 0 || lstat_cached(nullptr, m_root_path, &root_st) != 0) {
         return send_error(msg, tag, host_errno_to_p9(errno));
     }
     // Walk path retrieving qid for each name
@@ -2311,8 +2792,8 @@ bool virtio_p9fs_device::op_walk(virtq_unserializer &&mmsg, uint16_t tag) {
             } else {
                 next_path = join_path_name(path, name);
             }
-            // Get next path qid
-            if (lstat(next_path.c_str(), &st) != 0) {
+            // Get next path qid, resolved relative to the fid directory when possible
+            if (lstat_cached(fidp, next_path, &st) != 0) {
                 // Return an error only for the first walk
                 if (nwalked == 0) {
                     return send_error(msg, tag, host_errno_to_p9(errno));
@@ -2351,7 +2832,8 @@ bool virtio_p9fs_device::op_walk(virtq_unserializer &&mmsg, uint16_t tag) {
         }
         return false;
     }
-    // Update the new fid state
+    // Update the new fid state, releasing what it held in case it is being reused
+    close_fid_state(newfidp);
     *newfidp = p9_fid_state{.uid = uid, .path = path, .fd = -1};
     return true;
 }
@@ -2367,28 +2849,29 @@ bool virtio_p9fs_device::op_read(virtq_unserializer &&mmsg, uint16_t tag) {
 #ifdef DEBUG_VIRTIO_P9FS
     std::ignore = fprintf(stderr, "p9fs read: tag=%d fid=%d offset=%ld count=%d\n", tag, fid, offset, count);
 #endif
-    // Get the fid state, only file fids are accepted
-    const p9_fid_state *fidp = get_fid_state(fid);
+    // Get the fid state, only file fids are accepted,
+    // other reads and writes may share its file descriptor concurrently
+    const p9_fid_state *fidp = get_fid_state(fid, false);
     if ((fidp == nullptr) || fidp->fd < 0) {
         return send_error(msg, tag, P9_EPROTO);
     }
-    // Prepare temporary output buffer
-    std::array<uint8_t, P9_IOUNIT_MAX> buf{};
-    if (count > buf.size()) {
+    if (count > get_iounit()) {
         return send_error(msg, tag, P9_EPROTO);
     }
-    // Read from fd
-    const ssize_t ret = pread(fidp->fd, buf.data(), static_cast<size_t>(count), static_cast<off_t>(offset));
-    if (ret < 0) {
-        return send_error(msg, tag, host_errno_to_p9(errno));
-    }
-    auto ret_count = static_cast<uint32_t>(ret);
-    // Reply
-    virtq_serializer out_msg(msg.a, msg.vq, msg.queue_idx, msg.desc_idx, P9_OUT_MSG_OFFSET);
-    if (!out_msg.pack(&ret_count) || !out_msg.write_bytes(buf.data(), count)) {
-        return send_error(msg, tag, P9_EPROTO);
+    auto job = make_io_job(msg, tag, P9_TREAD, fid);
+    job->fd = fidp->fd;
+    job->offset = offset;
+    job->count = count;
+#ifndef HAVE_VIRTIO_P9FS_ASYNC_IO
+    // Read from fd straight into the reply data, which follows the count field.
+    // Worker threads must not write guest memory behind the device back, so they always use a temporary buffer.
+    const uint32_t data_off = P9_OUT_MSG_OFFSET + sizeof(uint32_t);
+    job->in_place = msg.vq.get_desc_host_spans(msg.a, msg.desc_idx, data_off, count, true, job->spans);
+#endif
+    if (!job->in_place) {
+        job->buf.resize(count);
     }
-    return send_reply(std::move(out_msg), tag, P9_RREAD);
+    return dispatch_io_job(msg.a, std::move(job));
 }
 
 bool virtio_p9fs_device::op_write(virtq_unserializer &&mmsg, uint16_t tag) {
@@ -2402,28 +2885,29 @@ bool virtio_p9fs_device::op_write(virtq_unserializer &&mmsg, uint16_t tag) {
 #ifdef DEBUG_VIRTIO_P9FS
     std::ignore = fprintf(stderr, "p9fs write: tag=%d fid=%d offset=%ld count=%d\n", tag, fid, offset, count);
 #endif
-    // Get the fid state, only file fids are accepted
-    const p9_fid_state *fidp = get_fid_state(fid);
+    // Get the fid state, only file fids are accepted,
+    // other reads and writes may share its file descriptor concurrently
+    const p9_fid_state *fidp = get_fid_state(fid, false);
     if ((fidp == nullptr) || fidp->fd < 0) {
         return send_error(msg, tag, P9_EPROTO);
     }
-    // Read from input buffer
-    std::array<uint8_t, P9_IOUNIT_MAX> buf{};
-    if (count > buf.size() || !msg.read_bytes(buf.data(), count)) {
+    if (count > get_iounit()) {
         return send_error(msg, tag, P9_EPROTO);
     }
-    // Write to fd
-    const ssize_t ret = pwrite(fidp->fd, buf.data(), static_cast<size_t>(count), static_cast<off_t>(offset));
-    if (ret < 0) {
-        return send_error(msg, tag, host_errno_to_p9(errno));
-    }
-    auto ret_count = static_cast<uint32_t>(ret);
-    // Reply
-    virtq_serializer out_msg(msg.a, msg.vq, msg.queue_idx, msg.desc_idx, P9_OUT_MSG_OFFSET);
-    if (!out_msg.pack(&ret_count)) {
-        return send_error(msg, tag, P9_EPROTO);
+    auto job = make_io_job(msg, tag, P9_TWRITE, fid);
+    job->fd = fidp->fd;
+    job->offset = offset;
+    job->count = count;
+    // Write to fd straight from the request data,
+    // copying it to a temporary buffer only when the guest memory cannot be accessed in place
+    job->in_place = msg.vq.get_desc_host_spans(msg.a, msg.desc_idx, msg.offset, count, false, job->spans);
+    if (!job->in_place) {
+        job->buf.resize(count);
+        if (!msg.read_bytes(job->buf.data(), count)) {
+            return send_error(msg, tag, P9_EPROTO);
+        }
     }
-    return send_reply(std::move(out_msg), tag, P9_RREAD);
+    return dispatch_io_job(msg.a, std::move(job));
 }
 
 bool virtio_p9fs_device::op_clunk(virtq_unserializer &&mmsg, uint16_t tag) {
@@ -2498,6 +2982,37 @@ bool virtio_p9fs_device::send_error(const virtq_unserializer &in_msg, uint16_t t
     return send_reply(std::move(out_msg), tag, P9_RLERROR);
 }
 
+bool virtio_p9fs_device::send_dir_entries(const virtq_unserializer &in_msg, uint16_t tag,
+    const std::vector<p9_dir_entry> &entries, uint64_t offset, uint32_t count) {
+    // Pack as many entries as fit, so the guest needs as few requests as possible to read the whole directory
+    const uint32_t max_len = std::min(count, get_iounit());
+    std::vector<uint8_t> buf;
+    for (uint64_t i = offset; i < entries.size(); ++i) {
+        const p9_dir_entry &entry = entries[i];
+        if (entry.removed) {
+            continue;
+        }
+        const auto name_len = static_cast<uint16_t>(entry.name.length());
+        const uint32_t entry_len = sizeof(p9_qid) + sizeof(uint64_t) + sizeof(uint8_t) + sizeof(uint16_t) + name_len;
+        if (buf.size() + entry_len > max_len) {
+            break;
+        }
+        const uint64_t entry_off = i + 1;
+        append_bytes(buf, &entry.qid, sizeof(entry.qid));
+        append_bytes(buf, &entry_off, sizeof(entry_off));
+        append_bytes(buf, &entry.type, sizeof(entry.type));
+        append_bytes(buf, &name_len, sizeof(name_len));
+        append_bytes(buf, entry.name.data(), name_len);
+    }
+    // The entries follow the data length field
+    virtq_serializer out_msg(in_msg.a, in_msg.vq, in_msg.queue_idx, in_msg.desc_idx, P9_OUT_MSG_OFFSET);
+    auto data_len = static_cast<uint32_t>(buf.size());
+    if (!out_msg.pack(&data_len) || (data_len > 0 && !out_msg.write_bytes(buf.data(), data_len))) {
+        return send_error(in_msg, tag, P9_EPROTO);
+    }
+    return send_reply(std::move(out_msg), tag, P9_RREADDIR);
+}
+
 } // namespace cartesi
 
 #endif // HAVE_POSIX_FS
@@ -21,11 +21,27 @@
 
 #ifdef HAVE_POSIX_FS
 
+#if defined(HAVE_THREADS) && !defined(_WIN32)
+// Service slow requests (read, write, readdir and fsync) on host worker threads
+#define HAVE_VIRTIO_P9FS_ASYNC_IO
+#endif
+
 #include <algorithm>
 #include <array>
 #include <cstdint>
+#include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
+
+#ifdef HAVE_VIRTIO_P9FS_ASYNC_IO
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#endif
+
+#include <sys/stat.h>
 
 #include "compiler-defines.h"
 #include "i-device-state-access.h"
@@ -46,10 +62,15 @@ enum virtio_p9fs_constants : uint32_t {
     P9_PATH_MAX = 4096,      ///< Maximum filesystem path length
     P9_ROOT_PATH_MAX = 1024, ///< Maximum root path size
     P9_MOUNT_TAG_MAX = VIRTIO_MAX_CONFIG_SPACE_SIZE - sizeof(uint16_t), ///< Maximum mount tag size
-    P9_IOUNIT_MAX = 8192,                                 ///< Maximum buffer size for IO operations (read/write)
+    P9_MAX_MSIZE = 512000,                                ///< Maximum message size, as large as Linux virtio accepts
+    P9_MIN_MSIZE = 4096,                                  ///< Minimum message size
     P9_IOUNIT_HEADER_SIZE = 24,                           ///< Message header size of IO operations (read/write)
-    P9_MAX_MSIZE = P9_IOUNIT_MAX + P9_IOUNIT_HEADER_SIZE, ///< Maximum message size, including message headers
+    P9_IOUNIT_MAX = P9_MAX_MSIZE - P9_IOUNIT_HEADER_SIZE, ///< Maximum buffer size for IO operations (read/write)
     P9_OUT_MSG_OFFSET = 7,                                ///< Offset for 9P reply messages
+    P9_DIR_HANDLES_MAX = 256,      ///< Maximum number of host directory handles kept open by fids
+    P9_ATTR_CACHE_MAX = 4096,      ///< Maximum number of entries in the attribute cache
+    P9_ATTR_CACHE_TTL_US = 500000, ///< Lifetime of attribute cache entries, bounds staleness from host changes
+    P9_IO_WORKERS = 4,             ///< Number of host worker threads servicing slow requests
 };
 
 /// \brief 9P2000.L opcodes
@@ -380,13 +401,53 @@ struct PACKED p9_stat {
     uint64_t data_version; ///< Reserved for future use
 };
 
+/// \brief 9P2000.L directory entry, as returned by readdir
+struct p9_dir_entry {
+    p9_qid qid{};         ///< Entry qid
+    uint8_t type = 0;     ///< Entry type (DT_* constant)
+    std::string name;     ///< Entry name
+    bool removed = false; ///< Whether the entry was removed through the device after the snapshot was taken
+};
+
 /// \brief 9P2000.L fid state
 /// \details A fid is a file system object identifier, each one has its own state.
 struct p9_fid_state {
-    uint32_t uid = 0;     ///< Guest user id
-    std::string path;     ///< File system path
-    int fd = -1;          ///< Host file descriptor (valid only for opened files)
-    void *dirp = nullptr; ///< Host directory (valid only for opened directories)
+    uint32_t uid = 0;                        ///< Guest user id
+    std::string path;                        ///< File system path
+    int fd = -1;                             ///< Host file descriptor (valid only for opened files)
+    int dir_fd = -1;                         ///< Host directory handle for *at() syscalls (valid only for directories)
+    bool has_dir_entries = false;            ///< Whether dir_entries holds a snapshot of the directory
+    std::vector<p9_dir_entry> dir_entries{}; ///< Directory snapshot, entry i is at readdir offset i + 1
+};
+
+/// \brief Cached result of a host attribute lookup
+/// \details Failed lookups are cached too, as negative directory entries.
+struct p9_attr_cache_entry {
+    struct stat st{};      ///< Host attributes (valid only when err is 0)
+    int err = 0;           ///< Host errno of a failed lookup, or 0
+    int64_t expire_us = 0; ///< Host time when the entry becomes stale
+};
+
+/// \brief 9P2000.L request that performs slow host I/O
+/// \details The host I/O only works on copies of the request arguments, without touching the device,
+/// its fids or guest memory, so it can be executed by a worker thread while the guest keeps running.
+/// The reply is then written to the queue by the device.
+struct p9_io_job {
+    uint32_t queue_idx = 0;            ///< Queue index of the request
+    uint16_t desc_idx = 0;             ///< Head descriptor index of the request
+    uint16_t tag = 0;                  ///< Request tag
+    p9_opcode opcode{};                ///< Request opcode
+    uint32_t fid = 0;                  ///< Request fid
+    int fd = -1;                       ///< Host file descriptor of the fid (its directory handle for readdir)
+    std::string path;                  ///< Host path of the fid (readdir only, used when it has no handle)
+    std::vector<p9_dir_entry> entries; ///< Captured directory entries (readdir only)
+    uint64_t offset = 0;               ///< Request offset
+    uint32_t count = 0;                ///< Request count
+    bool in_place = false;             ///< Whether data is accessed in place, through spans
+    virtq_host_spans spans;            ///< Host memory spans of the request data (valid only when in_place is true)
+    std::vector<uint8_t> buf;          ///< Request data (valid only when in_place is false)
+    int64_t ret = 0;                   ///< Amount of data transferred by the host
+    int err = 0;                       ///< Host errno, or 0 on success
 };
 
 /// \brief VirtIO Plan 9 filesystem configuration space
@@ -400,6 +461,19 @@ class virtio_p9fs_device final : public virtio_device {
     uint32_t m_msize = 0;
     std::string m_root_path;
     std::unordered_map<uint32_t, p9_fid_state> m_fids;
+    std::unordered_map<std::string, p9_attr_cache_entry> m_attr_cache;
+    uint32_t m_dir_handles = 0;
+#ifdef HAVE_VIRTIO_P9FS_ASYNC_IO
+    std::vector<std::thread> m_io_workers;                ///< Worker threads, started on first use
+    std::deque<std::unique_ptr<p9_io_job>> m_io_queue;    ///< Jobs waiting for a worker
+    std::vector<std::unique_ptr<p9_io_job>> m_io_done;    ///< Jobs waiting for their replies
+    std::unordered_map<uint32_t, uint32_t> m_io_fid_jobs; ///< Number of unfinished jobs of each fid
+    std::mutex m_io_mutex;                                ///< Protects the queues and the fid job counts
+    std::condition_variable m_io_queue_cv;                ///< Signaled when a job is queued or on stop
+    std::condition_variable m_io_done_cv;                 ///< Signaled when a job finishes
+    std::array<int, 2> m_io_wakeup_fds{-1, -1};           ///< Pipe that wakes select() when a job finishes
+    bool m_io_stopping = false;                           ///< Tells worker threads to exit
+#endif
 
 public:
     virtio_p9fs_device(uint32_t virtio_idx, const std::string &mount_tag, const std::string &root_path);
@@ -413,6 +487,8 @@ public:
     void on_device_ok(i_device_state_access *a) override;
     bool on_device_queue_available(i_device_state_access *a, uint32_t queue_idx, uint16_t desc_idx,
         uint32_t read_avail_len, uint32_t write_avail_len) override;
+    void prepare_select(select_fd_sets *fds, uint64_t *timeout_us) override;
+    bool poll_selected(int select_ret, select_fd_sets *fds, i_device_state_access *da) override;
 
     bool op_statfs(virtq_unserializer &&msg, uint16_t tag);
     bool op_lopen(virtq_unserializer &&msg, uint16_t tag);
@@ -441,16 +517,90 @@ public:
     bool send_ok(const virtq_unserializer &in_msg, uint16_t tag, p9_opcode opcode);
     bool send_error(const virtq_unserializer &in_msg, uint16_t tag, p9_error error);
 
+    /// \brief Replies to a readdir request with entries of a directory snapshot
+    /// \param in_msg Request message.
+    /// \param tag Request tag.
+    /// \param entries Directory snapshot.
+    /// \param offset Readdir offset, the index of the first entry to reply.
+    /// \param count Maximum length of the entries, it is capped by the negotiated message size.
+    /// \returns True if successful, false if an error happened while replying.
+    bool send_dir_entries(const virtq_unserializer &in_msg, uint16_t tag, const std::vector<p9_dir_entry> &entries,
+        uint64_t offset, uint32_t count);
+
     virtio_p9fs_config_space *get_config() {
         // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
         return reinterpret_cast<virtio_p9fs_config_space *>(config_space.data());
     }
 
-    p9_fid_state *get_fid_state(uint32_t fid) {
+    /// \brief Gets a fid state
+    /// \param fid Fid.
+    /// \param wait_io Wait until jobs using the fid host resources are finished.
+    /// Only requests that merely share the fid file descriptor with such jobs may skip waiting.
+    /// \returns The fid state, or nullptr if the fid does not exist.
+    p9_fid_state *get_fid_state(uint32_t fid, bool wait_io = true) {
         auto it = m_fids.find(fid);
-        return (it != m_fids.end()) ? &it->second : nullptr;
+        if (it == m_fids.end()) {
+            return nullptr;
+        }
+        if (wait_io) {
+            wait_io_jobs(fid);
+        }
+        return &it->second;
     }
 
+    /// \brief Executes the host I/O of a request, asynchronously when possible
+    /// \param a The state accessor for the current device.
+    /// \param job Request job.
+    /// \returns True if successful, false if an error happened while replying.
+    bool dispatch_io_job(i_device_state_access *a, std::unique_ptr<p9_io_job> job);
+
+    /// \brief Replies to a request whose host I/O was executed
+    /// \param a The state accessor for the current device.
+    /// \param job Request job.
+    /// \returns True if successful, false if an error happened while replying.
+    bool complete_io_job(i_device_state_access *a, p9_io_job &job);
+
+    /// \brief Waits until the host I/O of all jobs of a fid is finished, their replies may still be pending
+    void wait_io_jobs(uint32_t fid);
+
+    /// \brief Starts the worker threads, if not started yet
+    /// \returns True if the workers are running, false if jobs must be executed synchronously.
+    bool start_io_workers();
+
+    /// \brief Worker thread loop
+    void run_io_worker();
+
+    /// \brief Waits until all jobs are finished and drops their replies, stopping worker threads if requested
+    void drain_io_jobs(bool stop);
+
+    /// \brief Returns a host directory handle to be used as base for *at() syscalls on entries of a fid
+    /// \param fidp Directory fid state.
+    /// \returns The fid directory handle, or AT_FDCWD when it is not available.
+    /// \details The handle is opened lazily, and when not available callers must use full host paths.
+    int get_dir_handle(p9_fid_state *fidp);
+
+    /// \brief Looks up attributes of a host path without following symbolic links, going through the cache
+    /// \param basep Fid state of a directory the path may be relative to, or nullptr.
+    /// \param path Full host path.
+    /// \param st Receives the attributes.
+    /// \returns 0 on success, or -1 with errno set.
+    int lstat_cached(p9_fid_state *basep, const std::string &path, struct stat *st);
+
+    /// \brief Drops cached attributes of a host path after it was modified
+    /// \param path Full host path.
+    /// \param recursive Also drop cached attributes of all paths below it.
+    void invalidate_attr(const std::string &path, bool recursive = false);
+
+    /// \brief Hides an entry removed through the device from the directory snapshots of fids
+    /// \param dir_path Full host path of the directory.
+    /// \param name Name of the entry.
+    void forget_dir_entry(const std::string &dir_path, const std::string &name);
+
+    /// \brief Closes the host resources held by a fid state
+    /// \param fidp Fid state.
+    /// \returns 0 on success, otherwise the host errno of the first failure.
+    int close_fid_state(p9_fid_state *fidp);
+
     uint32_t get_iounit() const {
         return std::min<uint32_t>(m_msize - P9_IOUNIT_HEADER_SIZE, P9_IOUNIT_MAX);
     }
@@ -27,12 +27,17 @@
 namespace cartesi {
 
 /// \brief Utility for unpacking formatted bytes from a Virtqueue buffer
+/// \details The read buffer is resolved to host memory on the first read, so unpacking copies straight from it.
+/// Buffers that cannot be accessed in place are read through the state accessor instead.
 struct virtq_unserializer {
     i_device_state_access *a;
     virtq &vq; // NOLINT(cppcoreguidelines-avoid-const-or-ref-data-members)
     uint32_t queue_idx;
     uint32_t desc_idx;
     uint32_t offset;
+    virtq_host_spans spans;      ///< Host memory spans of the whole read buffer
+    uint32_t spans_len = 0;      ///< Length of the read buffer covered by spans
+    bool spans_resolved = false; ///< Whether the read buffer was already resolved to host memory
 
     explicit virtq_unserializer(i_device_state_access *a, virtq &vq, uint32_t queue_idx, uint32_t desc_idx,
         uint32_t offset = 0) :
@@ -48,8 +53,42 @@ struct virtq_unserializer {
     virtq_unserializer &operator=(const virtq_unserializer &other) = delete;
     virtq_unserializer &operator=(virtq_unserializer &&other) = delete;
 
+    /// \brief Reads bytes from the read buffer, without advancing
+    bool read_desc_mem(uint32_t start_off, unsigned char *data, uint32_t len) {
+        if (!spans_resolved) {
+            spans_resolved = true;
+            uint32_t read_len = 0;
+            if (!vq.get_desc_rw_avail_len(a, desc_idx, &read_len, nullptr) ||
+                !vq.get_desc_host_spans(a, desc_idx, 0, read_len, false, spans)) {
+                spans.clear();
+                read_len = 0;
+            }
+            spans_len = read_len;
+        }
+        if (start_off > spans_len || len > spans_len - start_off) {
+            return vq.read_desc_mem(a, desc_idx, start_off, data, len);
+        }
+        // Copy from the spans intersecting the desired interval
+        uint32_t span_start_off = 0;
+        for (const auto &span : spans) {
+            if (len == 0) {
+                break;
+            }
+            const uint32_t span_end_off = span_start_off + span.len;
+            if (start_off < span_end_off) {
+                const uint32_t chunk_len = std::min(len, span_end_off - start_off);
+                memcpy(data, span.data + (start_off - span_start_off), chunk_len);
+                data += chunk_len;
+                start_off += chunk_len;
+                len -= chunk_len;
+            }
+            span_start_off = span_end_off;
+        }
+        return true;
+    }
+
     bool read_bytes(unsigned char *data, uint32_t data_len) {
-        if (!vq.read_desc_mem(a, desc_idx, offset, data, data_len)) {
+        if (!read_desc_mem(offset, data, data_len)) {
             return false;
         }
         // Advance
@@ -60,7 +99,7 @@ struct virtq_unserializer {
     template <typename T>
     bool read_value(T *pval) {
         // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
-        if (!vq.read_desc_mem(a, desc_idx, offset, reinterpret_cast<unsigned char *>(pval), sizeof(T))) {
+        if (!read_desc_mem(offset, reinterpret_cast<unsigned char *>(pval), sizeof(T))) {
             return false;
         }
         // Advance
@@ -86,7 +125,7 @@ struct virtq_unserializer {
         // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
         auto *data_uchar = reinterpret_cast<unsigned char *>(data);
         // Read the string
-        if (!vq.read_desc_mem(a, desc_idx, offset, data_uchar, len)) {
+        if (!read_desc_mem(offset, data_uchar, len)) {
             return false;
         }
         data_uchar[len] = 0;
@@ -135,6 +174,12 @@ struct virtq_serializer {
         return true;
     }
 
+    /// \brief Advances past bytes that were written to the buffer in place, through its host memory spans
+    void skip_bytes(uint32_t data_len) {
+        offset += data_len;
+        length = std::max(length, offset);
+    }
+
     bool write_u16_string(const void *data, uint16_t data_len) {
         // Write the string size
         if (!write_value(&data_len)) {
@@ -18,6 +18,7 @@
 
 #include <cstdint>
 #include <string>
+#include <vector>
 
 #include "access-log.h"
 #include "interpret.h"
@@ -46,6 +47,14 @@ void virtual_machine::do_load(const std::string &directory, const machine_runtim
     m_machine = new machine(directory, runtime);
 }
 
+void virtual_machine::do_create_from_template(const machine_template &t, const machine_runtime_config &runtime) {
+    m_machine = new machine(t, runtime);
+}
+
+machine_template *virtual_machine::do_create_template() const {
+    return new machine_template(*get_machine());
+}
+
 virtual_machine::~virtual_machine() {
     delete m_machine;
     m_machine = nullptr;
@@ -97,6 +106,15 @@ uint64_t virtual_machine::do_read_reg(reg r) const {
     return get_machine()->read_reg(r);
 }
 
+std::vector<uint64_t> virtual_machine::do_read_regs(const std::vector<reg> &regs) const {
+    std::vector<uint64_t> vals;
+    vals.reserve(regs.size());
+    for (const auto r : regs) {
+        vals.push_back(get_machine()->read_reg(r));
+    }
+    return vals;
+}
+
 void virtual_machine::do_write_reg(reg w, uint64_t val) {
     get_machine()->write_reg(w, val);
 }
@@ -109,6 +127,14 @@ void virtual_machine::do_write_memory(uint64_t address, const unsigned char *dat
     get_machine()->write_memory(address, data, length);
 }
 
+unsigned char *virtual_machine::do_get_host_memory(uint64_t address, uint64_t length) {
+    return get_machine()->get_host_memory(address, length);
+}
+
+void virtual_machine::do_mark_dirty_memory(uint64_t address, uint64_t length) {
+    get_machine()->mark_dirty_memory(address, length);
+}
+
 void virtual_machine::do_read_virtual_memory(uint64_t address, unsigned char *data, uint64_t length) {
     get_machine()->read_virtual_memory(address, data, length);
 }
@@ -188,6 +214,11 @@ interpreter_break_reason virtual_machine::do_verify_step(const hash_type &root_h
     return machine::verify_step(root_hash_before, log_filename, mcycle_count, root_hash_after);
 }
 
+std::vector<interpreter_break_reason> virtual_machine::do_verify_steps(
+    const std::vector<machine::step_log_entry> &entries, bool chained, uint64_t concurrency) const {
+    return machine::verify_steps(entries, chained, concurrency);
+}
+
 void virtual_machine::do_verify_step_uarch(const hash_type &root_hash_before, const access_log &log,
     const hash_type &root_hash_after) const {
     machine::verify_step_uarch(root_hash_before, log, root_hash_after);
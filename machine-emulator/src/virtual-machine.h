@@ -19,6 +19,7 @@
 
 #include <cstdint>
 #include <string>
+#include <vector>
 
 #include "access-log.h"
 #include "i-virtual-machine.h"
@@ -26,6 +27,7 @@
 #include "machine-config.h"
 #include "machine-memory-range-descr.h"
 #include "machine-merkle-tree.h"
+#include "machine-template.h"
 #include "machine-runtime-config.h"
 #include "machine.h"
 #include "uarch-interpret.h"
@@ -48,6 +50,8 @@ private:
     bool do_is_empty() const override;
     void do_create(const machine_config &config, const machine_runtime_config &runtime) override;
     void do_load(const std::string &directory, const machine_runtime_config &runtime) override;
+    void do_create_from_template(const machine_template &t, const machine_runtime_config &runtime) override;
+    machine_template *do_create_template() const override;
     interpreter_break_reason do_run(uint64_t mcycle_end) override;
     interpreter_break_reason do_log_step(uint64_t mcycle_count, const std::string &filename) override;
     void do_store(const std::string &directory) const override;
@@ -56,9 +60,12 @@ private:
     void do_get_root_hash(hash_type &hash) const override;
     bool do_verify_merkle_tree() const override;
     uint64_t do_read_reg(reg r) const override;
+    std::vector<uint64_t> do_read_regs(const std::vector<reg> &regs) const override;
     void do_write_reg(reg w, uint64_t val) override;
     void do_read_memory(uint64_t address, unsigned char *data, uint64_t length) const override;
     void do_write_memory(uint64_t address, const unsigned char *data, uint64_t length) override;
+    unsigned char *do_get_host_memory(uint64_t address, uint64_t length) override;
+    void do_mark_dirty_memory(uint64_t address, uint64_t length) override;
     void do_read_virtual_memory(uint64_t address, unsigned char *data, uint64_t length) override;
     void do_write_virtual_memory(uint64_t address, const unsigned char *data, uint64_t length) override;
     uint64_t do_translate_virtual_address(uint64_t vaddr) override;
@@ -80,6 +87,8 @@ private:
     machine_config do_get_default_config() const override;
     interpreter_break_reason do_verify_step(const hash_type &root_hash_before, const std::string &log_filename,
         uint64_t mcycle_count, const hash_type &root_hash_after) const override;
+    std::vector<interpreter_break_reason> do_verify_steps(const std::vector<machine::step_log_entry> &entries,
+        bool chained, uint64_t concurrency) const override;
     void do_verify_step_uarch(const hash_type &root_hash_before, const access_log &log,
         const hash_type &root_hash_after) const override;
     void do_verify_reset_uarch(const hash_type &root_hash_before, const access_log &log,
@@ -1255,6 +1255,21 @@ end
 
 test_send_cmio_input_with_different_arguments()
 
+do_test("binary log produced by send_cmio_response should verify", function(machine)
+    machine:write_reg("iflags_Y", 1)
+    local data = "0123456789"
+    local reason = 7
+    local root_hash_before = machine:get_root_hash()
+    local log = machine:log_send_cmio_response(reason, data, cartesi.ACCESS_LOG_TYPE_BINARY)
+    local root_hash_after = machine:get_root_hash()
+    assert(type(log) == "string")
+    machine:verify_send_cmio_response(reason, data, root_hash_before, log, root_hash_after)
+    local success, err = pcall(function()
+        machine:verify_send_cmio_response(reason, data, root_hash_before, log:sub(1, -9), root_hash_after)
+    end)
+    assert(not success and err:match("truncated"))
+end)
+
 do_test("Dump of log produced by send_cmio_response should match", function(machine)
     machine:write_reg("iflags_Y", 1)
     local data = "0123456789"
@@ -0,0 +1,138 @@
+#!/usr/bin/env lua5.4
+
+-- Copyright Cartesi and individual authors (see AUTHORS)
+-- SPDX-License-Identifier: LGPL-3.0-or-later
+--
+-- This program is free software: you can redistribute it and/or modify it under
+-- the terms of the GNU Lesser General Public License as published by the Free
+-- Software Foundation, either version 3 of the License, or (at your option) any
+-- later version.
+--
+-- This program is distributed in the hope that it will be useful, but WITHOUT ANY
+-- WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+-- PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+--
+-- You should have received a copy of the GNU Lesser General Public License along
+-- with this program (see COPYING). If not, see <https://www.gnu.org/licenses/>.
+--
+
+local cartesi = require("cartesi")
+local jsonrpc = require("cartesi.jsonrpc")
+
+local remote_address = nil
+
+-- Print help and exit
+local function help()
+    io.stderr:write(string.format(
+        [=[
+Usage:
+
+  %s --remote-address=<host>:<port>
+
+where remote-address gives the address of a running
+jsonrpc remote Cartesi machine server.
+
+]=],
+        arg[0]
+    ))
+    os.exit()
+end
+
+local options = {
+    {
+        "^%-%-h$",
+        function(all)
+            if not all then
+                return false
+            end
+            help()
+        end,
+    },
+    {
+        "^%-%-help$",
+        function(all)
+            if not all then
+                return false
+            end
+            help()
+        end,
+    },
+    {
+        "^%-%-remote%-address%=(.*)$",
+        function(o)
+            if not o or #o < 1 then
+                return false
+            end
+            remote_address = o
+            return true
+        end,
+    },
+    {
+        ".*",
+        function(all)
+            error("unrecognized option " .. all)
+        end,
+    },
+}
+
+-- Process command line options
+for _, argument in ipairs({ ... }) do
+    if argument:sub(1, 1) == "-" then
+        for _, option in ipairs(options) do
+            if option[2](argument:match(option[1])) then
+                break
+            end
+        end
+    else
+        error("unrecognized argument " .. argument)
+    end
+end
+
+-- This test exercises the methods that travel through the binary transport of the server,
+-- both on the machine served at the root target and on a hosted machine.
+-- When the server runs with --no-binary-transport, the same requests must fall back to JSON.
+
+local function check_binary_methods(machine)
+    -- Large memory transfers
+    local data = {}
+    for i = 1, 1 << 12 do
+        data[i] = string.pack("<I8I8I8I8", i, i * 3, i * 5, i * 7)
+    end
+    data = table.concat(data)
+    machine:write_memory(0x80000000, data)
+    assert(machine:read_memory(0x80000000, #data) == data, "memory mismatch after round trip")
+    -- Logs and their verification, in both log formats
+    for _, log_type in ipairs({ cartesi.ACCESS_LOG_TYPE_ANNOTATIONS, cartesi.ACCESS_LOG_TYPE_BINARY }) do
+        local root_hash_before = machine:get_root_hash()
+        local log = machine:log_step_uarch(log_type)
+        local root_hash_after = machine:get_root_hash()
+        assert(root_hash_before ~= root_hash_after)
+        machine:verify_step_uarch(root_hash_before, log, root_hash_after)
+        -- The root hashes must reach the server along with the log
+        local success, err = pcall(machine.verify_step_uarch, machine, root_hash_after, log, root_hash_before)
+        assert(not success and err:match("[Mm]ismatch in root hash"), err)
+        root_hash_before = root_hash_after
+        log = machine:log_reset_uarch(log_type)
+        root_hash_after = machine:get_root_hash()
+        machine:verify_reset_uarch(root_hash_before, log, root_hash_after)
+        success, err = pcall(machine.verify_reset_uarch, machine, root_hash_before, log, root_hash_before)
+        assert(not success and err:match("[Mm]ismatch in root hash"), err)
+    end
+end
+
+local server = assert(jsonrpc.connect_server(remote_address))
+local config = server:get_default_config()
+config.ram.length = 1 << 20
+server:create(config)
+print("testing binary methods on the root target")
+check_binary_methods(server)
+
+do
+    -- Closing the hosted machine deletes it from the server
+    local hosted <close> = server:new_hosted_machine()
+    hosted:create(config)
+    print("testing binary methods on a hosted machine")
+    check_binary_methods(hosted)
+end
+
+server:shutdown_server()
@@ -0,0 +1,255 @@
+#!/usr/bin/env lua5.4
+
+-- Copyright Cartesi and individual authors (see AUTHORS)
+-- SPDX-License-Identifier: LGPL-3.0-or-later
+--
+-- This program is free software: you can redistribute it and/or modify it under
+-- the terms of the GNU Lesser General Public License as published by the Free
+-- Software Foundation, either version 3 of the License, or (at your option) any
+-- later version.
+--
+-- This program is distributed in the hope that it will be useful, but WITHOUT ANY
+-- WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+-- PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+--
+-- You should have received a copy of the GNU Lesser General Public License along
+-- with this program (see COPYING). If not, see <https://www.gnu.org/licenses/>.
+--
+
+local cartesi = require("cartesi")
+local jsonrpc = require("cartesi.jsonrpc")
+local socket = require("socket")
+
+local remote_address = nil
+
+-- Print help and exit
+local function help()
+    io.stderr:write(string.format(
+        [=[
+Usage:
+
+  %s --remote-address=<host>:<port>
+
+where remote-address gives the address of a running
+jsonrpc remote Cartesi machine server.
+
+]=],
+        arg[0]
+    ))
+    os.exit()
+end
+
+local options = {
+    {
+        "^%-%-h$",
+        function(all)
+            if not all then
+                return false
+            end
+            help()
+        end,
+    },
+    {
+        "^%-%-help$",
+        function(all)
+            if not all then
+                return false
+            end
+            help()
+        end,
+    },
+    {
+        "^%-%-remote%-address%=(.*)$",
+        function(o)
+            if not o or #o < 1 then
+                return false
+            end
+            remote_address = o
+            return true
+        end,
+    },
+    {
+        ".*",
+        function(all)
+            error("unrecognized option " .. all)
+        end,
+    },
+}
+
+-- Process command line options
+for _, argument in ipairs({ ... }) do
+    if argument:sub(1, 1) == "-" then
+        for _, option in ipairs(options) do
+            if option[2](argument:match(option[1])) then
+                break
+            end
+        end
+    else
+        error("unrecognized argument " .. argument)
+    end
+end
+
+-- This test exercises machines hosted by the server at /machines/<handle>.
+-- The client bindings are used where they suffice, while raw JSONRPC requests
+-- reach targets the bindings never post to.
+
+-- Posts a JSONRPC request to a target of the server and returns the open connection
+local function send_request(target, method, params)
+    local host, port = remote_address:match("^(.*):(%d+)$")
+    local connection = assert(socket.connect(host, tonumber(port)))
+    local body = cartesi.tojson({ jsonrpc = "2.0", id = 0, method = method, params = params })
+    assert(connection:send(string.format(
+        "POST %s HTTP/1.1\r\nHost: %s\r\nContent-Type: application/json\r\nContent-Length: %d\r\n"
+            .. "Connection: close\r\n\r\n%s",
+        target,
+        host,
+        #body,
+        body
+    )))
+    return connection
+end
+
+-- Receives the response to a request and returns its HTTP status and JSONRPC response, if any
+local function receive_response(connection)
+    local status = assert(connection:receive("*l"))
+    local code = assert(tonumber(status:match("^HTTP/%d%.%d (%d+)")), "invalid status line")
+    local length = 0
+    while true do
+        local line = assert(connection:receive("*l"))
+        if line == "" then
+            break
+        end
+        length = tonumber(line:lower():match("^content%-length:%s*(%d+)$")) or length
+    end
+    local body = length > 0 and assert(connection:receive(length)) or nil
+    connection:close()
+    return code, body and cartesi.fromjson(body)
+end
+
+local function request(target, method, params)
+    return receive_response(send_request(target, method, params))
+end
+
+local function hosted_target(handle)
+    return "/machines/" .. handle
+end
+
+local function new_raw_hosted_machine(template)
+    local code, response = request("/", "host.new_machine", { template })
+    assert(code == 200 and response.result, "failed to host machine")
+    return response.result
+end
+
+local function delete_raw_hosted_machine(handle)
+    local code, response = request("/", "host.delete_machine", { handle })
+    assert(code == 200 and response.result, "failed to delete hosted machine")
+end
+
+local function pattern(seed, length)
+    local words = {}
+    for i = 1, length // 32 do
+        words[i] = string.pack("<I8I8I8I8", seed, i, i * 3, i * 5)
+    end
+    return table.concat(words)
+end
+
+local RAM_START = 0x80000000
+local DATA_LENGTH = 1 << 16
+local first_data = pattern(1, DATA_LENGTH)
+local second_data = pattern(2, DATA_LENGTH)
+
+local server = assert(jsonrpc.connect_server(remote_address))
+local config = server:get_default_config()
+config.ram.length = 1 << 20
+server:create(config)
+server:write_memory(RAM_START, first_data)
+local template = server:new_hosted_template()
+
+print("testing hosted machines created from a template")
+do
+    local first <close> = server:new_hosted_machine(template)
+    local second <close> = server:new_hosted_machine(template, server:get_runtime_config())
+    assert(first:get_root_hash() == server:get_root_hash(), "hosted machine differs from its template")
+    assert(second:get_root_hash() == server:get_root_hash(), "hosted machine differs from its template")
+    -- Machines share the pages of the template until they write to them
+    first:write_memory(RAM_START, second_data)
+    assert(first:read_memory(RAM_START, DATA_LENGTH) == second_data)
+    assert(second:read_memory(RAM_START, DATA_LENGTH) == first_data, "write leaked to another hosted machine")
+    assert(server:read_memory(RAM_START, DATA_LENGTH) == first_data, "write leaked to the served machine")
+    assert(first:get_root_hash() ~= second:get_root_hash())
+    first:verify_merkle_tree()
+    second:verify_merkle_tree()
+    -- Nor do writes to the machine the template was created from reach it
+    server:write_memory(RAM_START, second_data)
+    local third <close> = server:new_hosted_machine(template)
+    assert(third:read_memory(RAM_START, DATA_LENGTH) == first_data, "write leaked to the template")
+    server:write_memory(RAM_START, first_data)
+end
+
+print("testing concurrent requests to hosted machines")
+do
+    local busy = new_raw_hosted_machine(template)
+    local idle = new_raw_hosted_machine(template)
+    -- Keep one hosted machine running while the other serves requests
+    local MCYCLE_END = 1 << 26
+    local running = send_request(hosted_target(busy), "machine.run", { MCYCLE_END })
+    for i = 1, 8 do
+        local code, response = request(hosted_target(idle), "machine.write_reg", { "x1", i })
+        assert(code == 200 and response.result, "request to idle hosted machine failed")
+        code, response = request(hosted_target(idle), "machine.read_reg", { "x1" })
+        assert(code == 200 and response.result == i, "request to idle hosted machine failed")
+    end
+    local readable = socket.select({ running }, nil, 0)
+    assert(#readable == 0, "requests to idle hosted machine waited for the busy one")
+    local code, response = receive_response(running)
+    assert(code == 200 and response.result == "reached_target_mcycle", "run on busy hosted machine failed")
+    code, response = request(hosted_target(busy), "machine.read_reg", { "mcycle" })
+    assert(code == 200 and response.result == MCYCLE_END)
+    delete_raw_hosted_machine(busy)
+    delete_raw_hosted_machine(idle)
+end
+
+print("testing server methods rejected by hosted machines")
+do
+    local handle = new_raw_hosted_machine(template)
+    local server_methods = {
+        { "fork" },
+        { "rebind", { remote_address } },
+        { "shutdown" },
+        { "emancipate" },
+        { "delay_next_request", { 1 } },
+        { "host.new_machine" },
+        { "host.delete_machine", { handle } },
+        { "host.delete_template", { template } },
+    }
+    for _, method in ipairs(server_methods) do
+        local code, response = request(hosted_target(handle), method[1], method[2])
+        assert(code == 200 and response.error, method[1] .. " was not rejected")
+        assert(response.error.message:match("method unavailable for hosted machines"), response.error.message)
+    end
+    -- The hosted machine is still there
+    local code, response = request(hosted_target(handle), "machine.read_memory", { RAM_START, 8 })
+    assert(code == 200 and response.result, "hosted machine was affected by rejected methods")
+    delete_raw_hosted_machine(handle)
+end
+
+print("testing deletion of hosted machines and templates")
+do
+    local handle = new_raw_hosted_machine(template)
+    delete_raw_hosted_machine(handle)
+    local code = request(hosted_target(handle), "machine.get_root_hash")
+    assert(code == 404, "deleted hosted machine still served")
+    code = request(hosted_target(handle) .. "/binary", "machine.get_root_hash")
+    assert(code == 404, "deleted hosted machine still served")
+    local response
+    code, response = request("/", "host.delete_machine", { handle })
+    assert(code == 200 and response.error and response.error.message:match("hosted machine not found"))
+    -- Machines keep the pages they share with a deleted template
+    local hosted <close> = server:new_hosted_machine(template)
+    server:delete_hosted_template(template)
+    assert(hosted:read_memory(RAM_START, DATA_LENGTH) == first_data)
+    local success, err = pcall(server.new_hosted_machine, server, template)
+    assert(not success and err:match("template not found"), err)
+end
+
+server:shutdown_server()
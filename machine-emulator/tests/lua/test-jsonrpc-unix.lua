@@ -0,0 +1,149 @@
+#!/usr/bin/env lua5.4
+
+-- Copyright Cartesi and individual authors (see AUTHORS)
+-- SPDX-License-Identifier: LGPL-3.0-or-later
+--
+-- This program is free software: you can redistribute it and/or modify it under
+-- the terms of the GNU Lesser General Public License as published by the Free
+-- Software Foundation, either version 3 of the License, or (at your option) any
+-- later version.
+--
+-- This program is distributed in the hope that it will be useful, but WITHOUT ANY
+-- WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+-- PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+--
+-- You should have received a copy of the GNU Lesser General Public License along
+-- with this program (see COPYING). If not, see <https://www.gnu.org/licenses/>.
+--
+
+local jsonrpc = require("cartesi.jsonrpc")
+
+local remote_address = nil
+
+-- Print help and exit
+local function help()
+    io.stderr:write(string.format(
+        [=[
+Usage:
+
+  %s --remote-address=unix:<path>
+
+where remote-address gives the Unix domain socket address of a running
+jsonrpc remote Cartesi machine server.
+
+]=],
+        arg[0]
+    ))
+    os.exit()
+end
+
+local options = {
+    {
+        "^%-%-h$",
+        function(all)
+            if not all then
+                return false
+            end
+            help()
+        end,
+    },
+    {
+        "^%-%-help$",
+        function(all)
+            if not all then
+                return false
+            end
+            help()
+        end,
+    },
+    {
+        "^%-%-remote%-address%=(.*)$",
+        function(o)
+            if not o or #o < 1 then
+                return false
+            end
+            remote_address = o
+            return true
+        end,
+    },
+    {
+        ".*",
+        function(all)
+            error("unrecognized option " .. all)
+        end,
+    },
+}
+
+-- Process command line options
+for _, argument in ipairs({ ... }) do
+    if argument:sub(1, 1) == "-" then
+        for _, option in ipairs(options) do
+            if option[2](argument:match(option[1])) then
+                break
+            end
+        end
+    else
+        error("unrecognized argument " .. argument)
+    end
+end
+
+-- This test checks that servers listening on Unix domain sockets manage their socket files
+-- Servers forked from them listen on paths next to theirs, and each server removes its socket when it stops
+
+local path = assert(remote_address and remote_address:match("^unix:(.+)$"), "remote address must be unix:<path>")
+
+local function is_socket(socket_path)
+    return os.execute("test -S '" .. socket_path .. "'") == true
+end
+
+-- Servers remove their sockets right after replying, so give them a moment
+local function wait_removed(socket_path)
+    for _ = 1, 50 do
+        if not is_socket(socket_path) then
+            return
+        end
+        os.execute("sleep 0.02")
+    end
+    error("socket " .. socket_path .. " was not removed")
+end
+
+local root = assert(jsonrpc.connect_server(remote_address))
+assert(is_socket(path), "server is not listening at its path")
+assert(root:get_server_address() == remote_address)
+
+-- Forked servers listen at <path>.<pid>.<n>
+local child, child_address = root:fork_server()
+local child_path = assert(child_address:match("^unix:(.+)$"))
+local pid, n = child_path:sub(#path + 1):match("^%.(%d+)%.(%d+)$")
+assert(child_path:sub(1, #path) == path and pid and n, "unexpected forked server path " .. child_path)
+assert(is_socket(child_path), "forked server is not listening at its path")
+assert(child:get_server_address() == child_address)
+
+-- Rebinding moves the socket to the new path
+local rebound_address = remote_address .. ".rebound"
+assert(child:rebind_server(rebound_address) == rebound_address)
+assert(not is_socket(child_path), "rebound server left its old socket behind")
+assert(is_socket(rebound_address:sub(6)), "rebound server is not listening at its new path")
+assert(child:get_server_address() == rebound_address)
+assert(child:get_server_version())
+
+-- The socket of a server that is gone is replaced when binding
+local _, stale_address, stale_pid = root:fork_server()
+local stale_path = stale_address:sub(6)
+os.execute("kill -9 " .. stale_pid)
+assert(is_socket(stale_path), "killed server did not leave its socket behind")
+assert(child:rebind_server(stale_address) == stale_address)
+assert(child:get_server_version())
+wait_removed(rebound_address:sub(6))
+
+-- The socket of a server that is still listening is not
+assert(not pcall(child.rebind_server, child, remote_address), "rebinding to a socket in use succeeded")
+assert(is_socket(path), "rebinding removed a socket in use")
+assert(child:get_server_address() == stale_address)
+
+-- Stopping a server removes its socket, and leaves the others alone
+child:shutdown_server()
+wait_removed(stale_path)
+assert(is_socket(path), "forked server removed the socket of its parent")
+root:shutdown_server()
+wait_removed(path)
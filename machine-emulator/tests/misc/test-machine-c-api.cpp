@@ -33,16 +33,26 @@
 #define JSON_HAS_FILESYSTEM 0
 #include <json.hpp>
 
+#include <algorithm>
 #include <array>
 #include <chrono>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <future>
 #include <iostream>
+#include <iterator>
+#include <map>
+#include <set>
 #include <thread>
 
 #include <machine-c-api.h>
+#include <pma-constants.h>
 #include <riscv-constants.h>
 #include <uarch-constants.h>
+#include <virtio-balloon.h>
+#include <virtio-blk.h>
+#include <virtio-p9fs.h>
 
 #include "test-utils.h"
 #include "uarch-solidity-compat.h"
@@ -194,6 +204,1275 @@ BOOST_FIXTURE_TEST_CASE_NOLINT(replace_memory_range_not_addressable_test, machin
     BOOST_CHECK_EQUAL(origin, result);
 }
 
+BOOST_FIXTURE_TEST_CASE_NOLINT(create_machine_huge_pages_test, machine_flash_simple_fixture) {
+    const nlohmann::json runtime_config{{"huge_pages", true}};
+    cm_error error_code = cm_create_new(_machine_config.dump().c_str(), runtime_config.dump().c_str(), &_machine);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    cm_machine *regular{};
+    error_code = cm_create_new(_machine_config.dump().c_str(), nullptr, &regular);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+
+    // Backing memory with huge pages must not change the machine state
+    std::array<uint8_t, 4> data{0xde, 0xad, 0xbe, 0xef};
+    for (auto *m : {_machine, regular}) {
+        BOOST_REQUIRE_EQUAL(cm_write_memory(m, 0x80000000, data.data(), data.size()), CM_ERROR_OK);
+        BOOST_REQUIRE_EQUAL(cm_write_memory(m, 0x80000000003000, data.data(), data.size()), CM_ERROR_OK);
+    }
+    cm_hash huge_hash{};
+    cm_hash regular_hash{};
+    BOOST_REQUIRE_EQUAL(cm_get_root_hash(_machine, &huge_hash), CM_ERROR_OK);
+    BOOST_REQUIRE_EQUAL(cm_get_root_hash(regular, &regular_hash), CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(0, memcmp(huge_hash, regular_hash, sizeof(cm_hash)));
+
+    bool result{};
+    BOOST_REQUIRE_EQUAL(cm_verify_merkle_tree(_machine, &result), CM_ERROR_OK);
+    BOOST_CHECK(result);
+    cm_delete(regular);
+    cm_delete(_machine);
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(create_machine_sparse_ram_image_test, incomplete_machine_fixture) {
+    // RAM image with two non-zero pages separated by zero pages
+    const auto ram_image_path = (std::filesystem::temp_directory_path() / "sparse-ram-image.bin").string();
+    std::string ram_image(0x9000, '\0');
+    ram_image[0] = 'x';
+    ram_image[0x8fff] = 'y';
+    {
+        std::ofstream ofs(ram_image_path, std::ios::binary);
+        ofs << ram_image;
+    }
+    _machine_config["ram"]["image_filename"] = ram_image_path;
+    cm_error error_code = cm_create_new(_machine_config.dump().c_str(), nullptr, &_machine);
+    std::filesystem::remove(ram_image_path);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+
+    std::array<uint8_t, 0x9000> read_data{};
+    BOOST_REQUIRE_EQUAL(cm_read_memory(_machine, 0x80000000, read_data.data(), read_data.size()), CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(0, memcmp(ram_image.data(), read_data.data(), read_data.size()));
+
+    // Zero pages skipped while loading the image must still hash as zeros
+    cm_hash root_hash{};
+    BOOST_REQUIRE_EQUAL(cm_get_root_hash(_machine, &root_hash), CM_ERROR_OK);
+    auto verification = calculate_emulator_hash(_machine);
+    BOOST_CHECK_EQUAL_COLLECTIONS(verification.begin(), verification.end(), root_hash, root_hash + sizeof(cm_hash));
+    bool result{};
+    BOOST_REQUIRE_EQUAL(cm_verify_dirty_page_maps(_machine, &result), CM_ERROR_OK);
+    BOOST_CHECK(result);
+    cm_delete(_machine);
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(create_machine_share_pages_test, incomplete_machine_fixture) {
+    const auto ram_image_path = (std::filesystem::temp_directory_path() / "shared-ram-image.bin").string();
+    std::string ram_image(0x3000, 'x');
+    {
+        std::ofstream ofs(ram_image_path, std::ios::binary);
+        ofs << ram_image;
+    }
+    _machine_config["ram"]["image_filename"] = ram_image_path;
+    const auto runtime_config = nlohmann::json{{"share_pages", true}}.dump();
+    cm_machine *other_machine{};
+    BOOST_REQUIRE_EQUAL(cm_create_new(_machine_config.dump().c_str(), runtime_config.c_str(), &_machine), CM_ERROR_OK);
+    BOOST_REQUIRE_EQUAL(cm_create_new(_machine_config.dump().c_str(), runtime_config.c_str(), &other_machine),
+        CM_ERROR_OK);
+    std::filesystem::remove(ram_image_path);
+
+    // Writes to a shared page must not leak into the other machine
+    const uint8_t data = 'y';
+    BOOST_REQUIRE_EQUAL(cm_write_memory(_machine, 0x80001000, &data, sizeof(data)), CM_ERROR_OK);
+    std::array<uint8_t, 0x3000> read_data{};
+    BOOST_REQUIRE_EQUAL(cm_read_memory(other_machine, 0x80000000, read_data.data(), read_data.size()), CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(0, memcmp(ram_image.data(), read_data.data(), read_data.size()));
+    BOOST_REQUIRE_EQUAL(cm_read_memory(_machine, 0x80001000, read_data.data(), 1), CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(read_data[0], data);
+
+    // Pages must outlive the machine that first shared them
+    cm_delete(_machine);
+    BOOST_REQUIRE_EQUAL(cm_read_memory(other_machine, 0x80000000, read_data.data(), read_data.size()), CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(0, memcmp(ram_image.data(), read_data.data(), read_data.size()));
+    cm_hash root_hash{};
+    BOOST_REQUIRE_EQUAL(cm_get_root_hash(other_machine, &root_hash), CM_ERROR_OK);
+    auto verification = calculate_emulator_hash(other_machine);
+    BOOST_CHECK_EQUAL_COLLECTIONS(verification.begin(), verification.end(), root_hash, root_hash + sizeof(cm_hash));
+    cm_delete(other_machine);
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(create_machine_share_pages_budget_test, incomplete_machine_fixture) {
+    const auto count_mappings = []() {
+        std::ifstream ifs("/proc/self/maps");
+        return std::count(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>(), '\n');
+    };
+    const bool can_count_mappings = std::filesystem::exists("/proc/self/maps");
+    // Identical pages all map the same stored page, so each one would take a mapping of its own
+    const auto ram_image_path = (std::filesystem::temp_directory_path() / "shared-ram-budget-image.bin").string();
+    const uint64_t ram_image_length = UINT64_C(0xa000000);
+    {
+        std::ofstream ofs(ram_image_path, std::ios::binary);
+        const std::string page(0x1000, 'x');
+        for (uint64_t offset = 0; offset < ram_image_length; offset += page.size()) {
+            ofs << page;
+        }
+    }
+    _machine_config["ram"]["length"] = ram_image_length;
+    _machine_config["ram"]["image_filename"] = ram_image_path;
+    const auto runtime_config = nlohmann::json{{"share_pages", true}}.dump();
+    const auto mappings_before = count_mappings();
+    cm_error error_code = cm_create_new(_machine_config.dump().c_str(), runtime_config.c_str(), &_machine);
+    const auto mappings_after = count_mappings();
+    std::filesystem::remove(ram_image_path);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+
+    // Sharing must stop well before the process runs out of mappings
+    if (can_count_mappings) {
+        BOOST_CHECK_LE(mappings_after - mappings_before, 32768 + 64);
+    }
+    std::vector<uint8_t> read_data(0x1000);
+    BOOST_REQUIRE_EQUAL(cm_read_memory(_machine, 0x80000000 + ram_image_length - read_data.size(), read_data.data(),
+                            read_data.size()),
+        CM_ERROR_OK);
+    BOOST_CHECK(read_data == std::vector<uint8_t>(read_data.size(), 'x'));
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(create_machine_virtio_balloon_test, incomplete_machine_fixture) {
+    _machine_config["virtio"] = nlohmann::json::array({{{"type", "balloon"}}});
+    // VirtIO devices are only accepted in unreproducible machines
+    cm_error error_code = cm_create_new(_machine_config.dump().c_str(), nullptr, &_machine);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_INVALID_ARGUMENT);
+
+    _machine_config["processor"]["iunrep"] = 1;
+    error_code = cm_create_new(_machine_config.dump().c_str(), nullptr, &_machine);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    const char *cfg{};
+    BOOST_REQUIRE_EQUAL(cm_get_initial_config(_machine, &cfg), CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(nlohmann::json::parse(cfg)["virtio"], _machine_config["virtio"]);
+    cm_delete(_machine);
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(create_machine_virtio_blk_test, incomplete_machine_fixture) {
+    const auto disk_image_path = (std::filesystem::temp_directory_path() / "virtio-blk-disk.img").string();
+    {
+        std::ofstream ofs(disk_image_path, std::ios::binary);
+        ofs << std::string(0x1000, 'x');
+    }
+    _machine_config["processor"]["iunrep"] = 1;
+    _machine_config["virtio"] = nlohmann::json::array(
+        {{{"type", "blk"}, {"image_filename", disk_image_path}, {"read_only", false}, {"discard", true}}});
+    cm_error error_code = cm_create_new(_machine_config.dump().c_str(), nullptr, &_machine);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    const char *cfg{};
+    BOOST_REQUIRE_EQUAL(cm_get_initial_config(_machine, &cfg), CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(nlohmann::json::parse(cfg)["virtio"], _machine_config["virtio"]);
+    cm_delete(_machine);
+    _machine = nullptr;
+
+    // Disk images must hold whole sectors
+    {
+        std::ofstream ofs(disk_image_path, std::ios::binary);
+        ofs << std::string(0x1001, 'x');
+    }
+    error_code = cm_create_new(_machine_config.dump().c_str(), nullptr, &_machine);
+    std::filesystem::remove(disk_image_path);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_INVALID_ARGUMENT);
+}
+
+namespace {
+
+// Drives one queue of a VirtIO device through a split or packed virtqueue, as a guest driver would.
+// Device registers can only be accessed by the guest, so a guest program loads and stores the registers listed in a
+// table and then spins, while the interpreter polls the device.
+class virtio_test_driver {
+public:
+    static constexpr uint64_t program_start = 0x80000000;
+    static constexpr uint64_t mmio_table_start = 0x80001000;
+    static constexpr uint64_t desc_start = 0x80002000;
+    static constexpr uint64_t avail_start = 0x80003000;
+    static constexpr uint64_t used_start = 0x80004000;
+    static constexpr uint16_t queue_num = 16;
+
+    explicit virtio_test_driver(cm_machine *m, uint64_t mmio_start = cartesi::PMA_FIRST_VIRTIO_START) :
+        m_machine(m),
+        m_mmio_start(mmio_start) {
+        // Table entries are address and value pairs, ending at a zero address.
+        // Values with the sign bit set are replaced by what is loaded from the address, the others are stored to it.
+        const std::array<uint32_t, 12> program{
+            0x00001297, // auipc t0, 0x1
+            0x0002b303, // ld t1, 0(t0)
+            0x02030263, // beqz t1, 36
+            0x0082b383, // ld t2, 8(t0)
+            0x0003c663, // bltz t2, 12
+            0x00732023, // sw t2, 0(t1)
+            0x00c0006f, // j 12
+            0x00036383, // lwu t2, 0(t1)
+            0x0072b423, // sd t2, 8(t0)
+            0x01028293, // addi t0, t0, 16
+            0xfddff06f, // j -36
+            0x0000006f, // j .
+        };
+        BOOST_REQUIRE_EQUAL(cm_write_memory(m, program_start, reinterpret_cast<const uint8_t *>(program.data()),
+                                program.size() * sizeof(uint32_t)),
+            CM_ERROR_OK);
+    }
+
+    // Returns the features offered by the device
+    uint64_t device_features() {
+        mmio_write(cartesi::VIRTIO_MMIO_DEVICE_FEATURES_SEL, 1);
+        mmio_read(cartesi::VIRTIO_MMIO_DEVICE_FEATURES);
+        mmio_write(cartesi::VIRTIO_MMIO_DEVICE_FEATURES_SEL, 0);
+        mmio_read(cartesi::VIRTIO_MMIO_DEVICE_FEATURES);
+        const auto values = run_mmio();
+        return (values[1] << 32) | values[3];
+    }
+
+    // Negotiates features and makes the given queue ready
+    void init(uint64_t features, uint32_t queue = 0) {
+        using namespace cartesi;
+        m_packed = (features & VIRTIO_F_RING_PACKED) != 0;
+        m_queue = queue;
+        mmio_write(VIRTIO_MMIO_STATUS, VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER);
+        mmio_write(VIRTIO_MMIO_DRIVER_FEATURES_SEL, 1);
+        mmio_write(VIRTIO_MMIO_DRIVER_FEATURES, static_cast<uint32_t>((features | VIRTIO_F_VERSION_1) >> 32));
+        mmio_write(VIRTIO_MMIO_DRIVER_FEATURES_SEL, 0);
+        mmio_write(VIRTIO_MMIO_DRIVER_FEATURES, static_cast<uint32_t>(features));
+        mmio_write(VIRTIO_MMIO_STATUS, VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER | VIRTIO_STATUS_FEATURES_OK);
+        mmio_write(VIRTIO_MMIO_QUEUE_SEL, queue);
+        mmio_write(VIRTIO_MMIO_QUEUE_NUM, queue_num);
+        mmio_write(VIRTIO_MMIO_QUEUE_DESC_LOW, static_cast<uint32_t>(desc_start));
+        mmio_write(VIRTIO_MMIO_QUEUE_AVAIL_LOW, static_cast<uint32_t>(avail_start));
+        mmio_write(VIRTIO_MMIO_QUEUE_USED_LOW, static_cast<uint32_t>(used_start));
+        mmio_write(VIRTIO_MMIO_QUEUE_READY, 1);
+        mmio_write(VIRTIO_MMIO_STATUS,
+            VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER | VIRTIO_STATUS_FEATURES_OK | VIRTIO_STATUS_DRIVER_OK);
+        run_mmio();
+    }
+
+    // Makes a chain of buffers available to the device, without notifying it, and returns the buffer id
+    uint16_t add(const std::vector<cartesi::virtq_desc> &chain) {
+        if (m_packed) {
+            return add_packed(chain);
+        }
+        const uint16_t head = m_next_desc;
+        for (size_t i = 0; i < chain.size(); ++i) {
+            auto desc = chain[i];
+            desc.next = (m_next_desc + 1) % queue_num;
+            if (i + 1 < chain.size()) {
+                desc.flags |= cartesi::VIRTQ_DESC_F_NEXT;
+            }
+            write(desc_start + (m_next_desc * sizeof(desc)), desc);
+            m_next_desc = desc.next;
+        }
+        write(avail_start + 4 + (2 * (m_avail_idx % queue_num)), head);
+        write(avail_start + 2, ++m_avail_idx);
+        return head;
+    }
+
+    // Notifies the device of new available buffers
+    void kick() {
+        mmio_write(cartesi::VIRTIO_MMIO_QUEUE_NOTIFY, m_queue);
+        run_mmio();
+    }
+
+    uint16_t post(const std::vector<cartesi::virtq_desc> &chain) {
+        const uint16_t id = add(chain);
+        kick();
+        return id;
+    }
+
+    // Runs the machine until the device has used the given total number of buffers
+    void wait_used(uint64_t count) {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (used_count() < count && std::chrono::steady_clock::now() < deadline) {
+            run(UINT64_C(1) << 16);
+        }
+        BOOST_REQUIRE_EQUAL(used_count(), count);
+    }
+
+    // Collects the buffers used by the device so far, and returns their total number
+    uint64_t used_count() {
+        if (m_packed) {
+            for (;;) {
+                const auto desc =
+                    read<cartesi::virtq_packed_desc>(desc_start + (m_used_pos * sizeof(cartesi::virtq_packed_desc)));
+                const bool avail = (desc.flags & cartesi::VIRTQ_PACKED_DESC_F_AVAIL) != 0;
+                const bool used = (desc.flags & cartesi::VIRTQ_PACKED_DESC_F_USED) != 0;
+                if (avail != m_used_wrap || used != m_used_wrap) {
+                    break;
+                }
+                m_used.emplace_back(desc.id, desc.len);
+                m_used_pos += m_buffer_sizes[desc.id];
+                if (m_used_pos >= queue_num) {
+                    m_used_pos -= queue_num;
+                    m_used_wrap = !m_used_wrap;
+                }
+            }
+        } else {
+            const auto used_idx = read<uint16_t>(used_start + 2);
+            for (; m_used_idx != used_idx; ++m_used_idx) {
+                const auto elem = read<cartesi::virtq_used_elem>(used_start + 4 + (8 * (m_used_idx % queue_num)));
+                m_used.emplace_back(static_cast<uint16_t>(elem.id), elem.len);
+            }
+        }
+        return m_used.size();
+    }
+
+    // Id of the buffer the device used in the given order
+    uint16_t used_id(uint64_t i) const {
+        return m_used.at(i).first;
+    }
+
+    // Length the device wrote to the buffer it used in the given order
+    uint32_t used_len(uint64_t i) const {
+        return m_used.at(i).second;
+    }
+
+    // Returns and acknowledges the interrupt status
+    uint32_t take_interrupt_status() {
+        mmio_read(cartesi::VIRTIO_MMIO_INTERRUPT_STATUS);
+        mmio_write(cartesi::VIRTIO_MMIO_INTERRUPT_ACK,
+            cartesi::VIRTIO_INT_STATUS_USED_BUFFER | cartesi::VIRTIO_INT_STATUS_CONFIG_CHANGE);
+        return static_cast<uint32_t>(run_mmio()[0]);
+    }
+
+    uint32_t device_status() {
+        mmio_read(cartesi::VIRTIO_MMIO_STATUS);
+        return static_cast<uint32_t>(run_mmio()[0]);
+    }
+
+    // Split queues: the used ring index the driver wants an interrupt after
+    void set_used_event(uint16_t used_event) const {
+        write(avail_start + 4 + (2 * queue_num), used_event);
+    }
+
+    // Split queues: the available ring index the device wants a notification after
+    uint16_t avail_event() const {
+        return read<uint16_t>(used_start + 4 + (8 * queue_num));
+    }
+
+    // Packed queues: when the driver wants interrupts
+    void set_driver_event(uint16_t off_wrap, uint16_t flags) const {
+        write(avail_start, cartesi::virtq_packed_event{off_wrap, flags});
+    }
+
+    // Packed queues: when the device wants notifications
+    cartesi::virtq_packed_event device_event() const {
+        return read<cartesi::virtq_packed_event>(used_start);
+    }
+
+    template <typename T>
+    void write(uint64_t paddr, const T &value) const {
+        BOOST_REQUIRE_EQUAL(cm_write_memory(m_machine, paddr, reinterpret_cast<const uint8_t *>(&value), sizeof(T)),
+            CM_ERROR_OK);
+    }
+
+    template <typename T>
+    T read(uint64_t paddr) const {
+        T value{};
+        BOOST_REQUIRE_EQUAL(cm_read_memory(m_machine, paddr, reinterpret_cast<uint8_t *>(&value), sizeof(T)),
+            CM_ERROR_OK);
+        return value;
+    }
+
+private:
+    static constexpr uint64_t mmio_load = UINT64_MAX;
+
+    uint16_t add_packed(const std::vector<cartesi::virtq_desc> &chain) {
+        using namespace cartesi;
+        // Buffers are identified by the ring position of their first descriptor
+        const uint16_t id = m_avail_pos;
+        m_buffer_sizes[id] = static_cast<uint16_t>(chain.size());
+        std::vector<std::pair<uint16_t, virtq_packed_desc>> descs;
+        for (size_t i = 0; i < chain.size(); ++i) {
+            auto flags = static_cast<uint16_t>(chain[i].flags & (VIRTQ_DESC_F_WRITE | VIRTQ_DESC_F_INDIRECT));
+            if (i + 1 < chain.size()) {
+                flags |= VIRTQ_DESC_F_NEXT;
+            }
+            flags |= m_avail_wrap ? VIRTQ_PACKED_DESC_F_AVAIL : VIRTQ_PACKED_DESC_F_USED;
+            descs.emplace_back(m_avail_pos, virtq_packed_desc{chain[i].paddr, chain[i].len, id, flags});
+            if (++m_avail_pos == queue_num) {
+                m_avail_pos = 0;
+                m_avail_wrap = !m_avail_wrap;
+            }
+        }
+        // The first descriptor makes the whole buffer available, so it goes last
+        for (auto it = descs.rbegin(); it != descs.rend(); ++it) {
+            write(desc_start + (it->first * sizeof(virtq_packed_desc)), it->second);
+        }
+        return id;
+    }
+
+    void mmio_write(uint32_t offset, uint32_t value) {
+        m_mmio.emplace_back(m_mmio_start + offset, value);
+    }
+
+    void mmio_read(uint32_t offset) {
+        m_mmio.emplace_back(m_mmio_start + offset, mmio_load);
+    }
+
+    // Runs the accesses queued so far, and returns the values in the table after that
+    std::vector<uint64_t> run_mmio() {
+        m_mmio.emplace_back(0, 0);
+        const size_t table_len = m_mmio.size() * sizeof(m_mmio[0]);
+        BOOST_REQUIRE_EQUAL(cm_write_memory(m_machine, mmio_table_start,
+                                reinterpret_cast<const uint8_t *>(m_mmio.data()), table_len),
+            CM_ERROR_OK);
+        BOOST_REQUIRE_EQUAL(cm_write_reg(m_machine, CM_REG_PC, program_start), CM_ERROR_OK);
+        run(4096);
+        BOOST_REQUIRE_EQUAL(
+            cm_read_memory(m_machine, mmio_table_start, reinterpret_cast<uint8_t *>(m_mmio.data()), table_len),
+            CM_ERROR_OK);
+        std::vector<uint64_t> values;
+        for (const auto &[paddr, value] : m_mmio) {
+            values.push_back(value);
+        }
+        m_mmio.clear();
+        return values;
+    }
+
+    void run(uint64_t cycles) const {
+        uint64_t mcycle{};
+        BOOST_REQUIRE_EQUAL(cm_read_reg(m_machine, CM_REG_MCYCLE, &mcycle), CM_ERROR_OK);
+        cm_break_reason break_reason{};
+        BOOST_REQUIRE_EQUAL(cm_run(m_machine, mcycle + cycles, &break_reason), CM_ERROR_OK);
+        BOOST_REQUIRE_EQUAL(break_reason, CM_BREAK_REASON_REACHED_TARGET_MCYCLE);
+    }
+
+    cm_machine *m_machine;
+    uint64_t m_mmio_start;
+    std::vector<std::pair<uint64_t, uint64_t>> m_mmio;
+    uint32_t m_queue{0};
+    bool m_packed{false};
+    // Split queue state
+    uint16_t m_next_desc{0};
+    uint16_t m_avail_idx{0};
+    uint16_t m_used_idx{0};
+    // Packed queue state, with both wrap counters starting at 1
+    uint16_t m_avail_pos{0};
+    bool m_avail_wrap{true};
+    uint16_t m_used_pos{0};
+    bool m_used_wrap{true};
+    std::array<uint16_t, queue_num> m_buffer_sizes{};
+    // Ids and written lengths of used buffers, in the order they were used
+    std::vector<std::pair<uint16_t, uint32_t>> m_used;
+};
+
+// NOLINTNEXTLINE(cppcoreguidelines-special-member-functions)
+class virtio_blk_machine_fixture : public incomplete_machine_fixture {
+public:
+    static constexpr uint64_t header_start = 0x80010000;
+    static constexpr uint64_t data_start = 0x80011000;
+    static constexpr uint64_t status_start = 0x80020000;
+    static constexpr uint32_t sector_size = cartesi::VIRTIO_BLK_SECTOR_SIZE;
+    static constexpr uint64_t disk_sectors = 8;
+
+    virtio_blk_machine_fixture() :
+        _disk_image_path((std::filesystem::temp_directory_path() / "virtio-blk-io-disk.img").string()) {
+        // Sector i is filled with the letter 'A' + i
+        std::ofstream ofs(_disk_image_path, std::ios::binary);
+        for (uint64_t i = 0; i < disk_sectors; ++i) {
+            ofs << std::string(sector_size, static_cast<char>('A' + i));
+        }
+    }
+    ~virtio_blk_machine_fixture() {
+        cm_delete(_machine);
+        std::filesystem::remove(_disk_image_path);
+    }
+
+protected:
+    void create(bool read_only, uint64_t queue_features = 0) {
+        _machine_config["processor"]["iunrep"] = 1;
+        _machine_config["virtio"] = nlohmann::json::array(
+            {{{"type", "blk"}, {"image_filename", _disk_image_path}, {"read_only", read_only}, {"discard", true}}});
+        BOOST_REQUIRE_EQUAL(cm_create_new(_machine_config.dump().c_str(), nullptr, &_machine), CM_ERROR_OK);
+        _driver = std::make_unique<virtio_test_driver>(_machine);
+        uint64_t features = cartesi::VIRTIO_BLK_F_SEG_MAX | cartesi::VIRTIO_BLK_F_FLUSH;
+        features |= read_only ? cartesi::VIRTIO_BLK_F_RO : cartesi::VIRTIO_BLK_F_DISCARD;
+        _driver->init(features | queue_features);
+    }
+
+    // Makes the given number of get id requests available, and returns whether the device interrupted once it used
+    // them. These requests are answered without host I/O, as soon as the device is notified.
+    bool get_ids(uint64_t count) {
+        _driver->write(header_start, cartesi::virtio_blk_req_header{cartesi::VIRTIO_BLK_T_GET_ID, 0, 0});
+        for (uint64_t i = 0; i < count; ++i) {
+            _driver->add({{header_start, sizeof(cartesi::virtio_blk_req_header), 0, 0},
+                {data_start, cartesi::VIRTIO_BLK_ID_BYTES + 1, cartesi::VIRTQ_DESC_F_WRITE, 0}});
+        }
+        _driver->kick();
+        _requests += count;
+        _driver->wait_used(_requests);
+        return (_driver->take_interrupt_status() & cartesi::VIRTIO_INT_STATUS_USED_BUFFER) != 0;
+    }
+
+    // Sends a request, optionally with data for the device to read or write, and returns its status
+    uint8_t request(uint32_t type, uint64_t sector, uint32_t data_len = 0, bool device_writes_data = false) {
+        _driver->write(header_start, cartesi::virtio_blk_req_header{type, 0, sector});
+        _driver->write(status_start, uint8_t{0xff});
+        std::vector<cartesi::virtq_desc> chain{{header_start, sizeof(cartesi::virtio_blk_req_header), 0, 0}};
+        if (data_len != 0) {
+            chain.push_back({data_start, data_len,
+                static_cast<uint16_t>(device_writes_data ? cartesi::VIRTQ_DESC_F_WRITE : 0), 0});
+        }
+        chain.push_back({status_start, 1, cartesi::VIRTQ_DESC_F_WRITE, 0});
+        _driver->post(chain);
+        _driver->wait_used(++_requests);
+        const auto status = _driver->read<uint8_t>(status_start);
+        // Data is only written for requests that succeed, and the status always is
+        const uint32_t written_len = (device_writes_data && status == cartesi::VIRTIO_BLK_S_OK ? data_len : 0) + 1;
+        BOOST_CHECK_EQUAL(_driver->used_len(_requests - 1), written_len);
+        return status;
+    }
+
+    std::string read_data(uint32_t length) const {
+        std::string data(length, '\0');
+        BOOST_REQUIRE_EQUAL(cm_read_memory(_machine, data_start, reinterpret_cast<uint8_t *>(data.data()), length),
+            CM_ERROR_OK);
+        return data;
+    }
+
+    void write_data(const std::string &data) const {
+        BOOST_REQUIRE_EQUAL(
+            cm_write_memory(_machine, data_start, reinterpret_cast<const uint8_t *>(data.data()), data.size()),
+            CM_ERROR_OK);
+    }
+
+    std::string read_disk() const {
+        std::ifstream ifs(_disk_image_path, std::ios::binary);
+        return {std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>()};
+    }
+
+    std::string _disk_image_path;
+    std::unique_ptr<virtio_test_driver> _driver;
+    uint64_t _requests{0};
+};
+
+} // namespace
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(virtio_blk_read_write_test, virtio_blk_machine_fixture) {
+    create(false);
+    // Read two sectors
+    BOOST_CHECK_EQUAL(request(cartesi::VIRTIO_BLK_T_IN, 1, 2 * sector_size, true), cartesi::VIRTIO_BLK_S_OK);
+    BOOST_CHECK(read_data(2 * sector_size) == std::string(sector_size, 'B') + std::string(sector_size, 'C'));
+    // Write a sector, which changes the host image in place
+    write_data(std::string(sector_size, 'z'));
+    BOOST_CHECK_EQUAL(request(cartesi::VIRTIO_BLK_T_OUT, 3, sector_size), cartesi::VIRTIO_BLK_S_OK);
+    BOOST_CHECK_EQUAL(request(cartesi::VIRTIO_BLK_T_FLUSH, 0), cartesi::VIRTIO_BLK_S_OK);
+    BOOST_CHECK(read_disk().substr(3 * sector_size, sector_size) == std::string(sector_size, 'z'));
+    BOOST_CHECK(read_disk().substr(4 * sector_size, sector_size) == std::string(sector_size, 'E'));
+    // The guest reads back what it wrote
+    write_data(std::string(sector_size, '\0'));
+    BOOST_CHECK_EQUAL(request(cartesi::VIRTIO_BLK_T_IN, 3, sector_size, true), cartesi::VIRTIO_BLK_S_OK);
+    BOOST_CHECK(read_data(sector_size) == std::string(sector_size, 'z'));
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(virtio_blk_out_of_bounds_test, virtio_blk_machine_fixture) {
+    create(false);
+    // Requests that run past the last sector, or start after it, fail without touching the data buffer
+    write_data(std::string(2 * sector_size, '?'));
+    BOOST_CHECK_EQUAL(request(cartesi::VIRTIO_BLK_T_IN, disk_sectors - 1, 2 * sector_size, true),
+        cartesi::VIRTIO_BLK_S_IOERR);
+    BOOST_CHECK_EQUAL(request(cartesi::VIRTIO_BLK_T_IN, disk_sectors, sector_size, true),
+        cartesi::VIRTIO_BLK_S_IOERR);
+    BOOST_CHECK_EQUAL(request(cartesi::VIRTIO_BLK_T_OUT, UINT64_MAX, sector_size), cartesi::VIRTIO_BLK_S_IOERR);
+    BOOST_CHECK(read_data(2 * sector_size) == std::string(2 * sector_size, '?'));
+    // So do transfers of partial sectors
+    BOOST_CHECK_EQUAL(request(cartesi::VIRTIO_BLK_T_IN, 0, sector_size / 2, true), cartesi::VIRTIO_BLK_S_IOERR);
+    BOOST_CHECK_EQUAL(read_disk().size(), disk_sectors * sector_size);
+    // The last sector is still readable
+    BOOST_CHECK_EQUAL(request(cartesi::VIRTIO_BLK_T_IN, disk_sectors - 1, sector_size, true),
+        cartesi::VIRTIO_BLK_S_OK);
+    BOOST_CHECK(read_data(sector_size) == std::string(sector_size, 'H'));
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(virtio_blk_read_only_test, virtio_blk_machine_fixture) {
+    create(true);
+    const auto disk = read_disk();
+    write_data(std::string(sector_size, 'z'));
+    BOOST_CHECK_EQUAL(request(cartesi::VIRTIO_BLK_T_OUT, 0, sector_size), cartesi::VIRTIO_BLK_S_IOERR);
+    // Discard is not offered for read-only disks, even when asked for
+    const cartesi::virtio_blk_discard_segment segment{0, 1, 0};
+    _driver->write(data_start, segment);
+    BOOST_CHECK_EQUAL(request(cartesi::VIRTIO_BLK_T_DISCARD, 0, sizeof(segment)), cartesi::VIRTIO_BLK_S_UNSUPP);
+    BOOST_CHECK(read_disk() == disk);
+    // Reads still work
+    BOOST_CHECK_EQUAL(request(cartesi::VIRTIO_BLK_T_IN, 0, sector_size, true), cartesi::VIRTIO_BLK_S_OK);
+    BOOST_CHECK(read_data(sector_size) == std::string(sector_size, 'A'));
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(virtio_blk_discard_test, virtio_blk_machine_fixture) {
+    create(false);
+    const cartesi::virtio_blk_discard_segment segment{4, 2, 0};
+    _driver->write(data_start, segment);
+    BOOST_CHECK_EQUAL(request(cartesi::VIRTIO_BLK_T_DISCARD, 0, sizeof(segment)), cartesi::VIRTIO_BLK_S_OK);
+    // Discarded sectors read back as zeros, and the disk keeps its size
+    BOOST_CHECK_EQUAL(request(cartesi::VIRTIO_BLK_T_IN, 3, 4 * sector_size, true), cartesi::VIRTIO_BLK_S_OK);
+    BOOST_CHECK(read_data(4 * sector_size) ==
+        std::string(sector_size, 'D') + std::string(2 * sector_size, '\0') + std::string(sector_size, 'G'));
+    BOOST_CHECK_EQUAL(read_disk().size(), disk_sectors * sector_size);
+    // Segments past the end of the disk fail
+    const cartesi::virtio_blk_discard_segment past_end{disk_sectors - 1, 2, 0};
+    _driver->write(data_start, past_end);
+    BOOST_CHECK_EQUAL(request(cartesi::VIRTIO_BLK_T_DISCARD, 0, sizeof(past_end)), cartesi::VIRTIO_BLK_S_IOERR);
+    BOOST_CHECK(read_disk().substr(7 * sector_size) == std::string(sector_size, 'H'));
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(virtio_event_idx_split_test, virtio_blk_machine_fixture) {
+    create(false, cartesi::VIRTIO_F_EVENT_IDX);
+    // The device interrupts only when the used ring index moves past used_event,
+    // and asks to be notified when the driver makes available the next buffer
+    _driver->set_used_event(5);
+    BOOST_CHECK(!get_ids(3));
+    BOOST_CHECK_EQUAL(_driver->avail_event(), 3);
+    BOOST_CHECK(get_ids(3));
+    BOOST_CHECK_EQUAL(_driver->avail_event(), 6);
+    BOOST_CHECK(!get_ids(2));
+    _driver->set_used_event(8);
+    BOOST_CHECK(get_ids(1));
+    // Indexes are 16-bit counters that wrap around
+    while (_requests + 8 <= 65530) {
+        get_ids(8);
+    }
+    get_ids(65530 - _requests);
+    BOOST_CHECK_EQUAL(_driver->avail_event(), 65530);
+    _driver->set_used_event(65535);
+    BOOST_CHECK(!get_ids(4));
+    BOOST_CHECK_EQUAL(_driver->avail_event(), 65534);
+    BOOST_CHECK(get_ids(4));
+    BOOST_CHECK_EQUAL(_driver->avail_event(), 2);
+    _driver->set_used_event(3);
+    BOOST_CHECK(!get_ids(1));
+    BOOST_CHECK(get_ids(1));
+    BOOST_CHECK_EQUAL(_driver->avail_event(), 4);
+    _driver->set_used_event(65534);
+    BOOST_CHECK(!get_ids(8));
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(virtio_event_idx_packed_test, virtio_blk_machine_fixture) {
+    using namespace cartesi;
+    create(false, VIRTIO_F_EVENT_IDX | VIRTIO_F_RING_PACKED);
+    // Each request takes two descriptors, so the ring holds 8 requests per turn.
+    // Event offsets carry the wrap counter of the turn they are in, which starts at 1.
+    const auto off_wrap = [](uint16_t offset, bool wrap_counter) {
+        return static_cast<uint16_t>(offset | (wrap_counter ? 0x8000 : 0));
+    };
+    _driver->set_driver_event(off_wrap(6, true), VIRTQ_PACKED_EVENT_F_DESC);
+    BOOST_CHECK(!get_ids(3));
+    BOOST_CHECK_EQUAL(_driver->device_event().flags, VIRTQ_PACKED_EVENT_F_DESC);
+    BOOST_CHECK_EQUAL(_driver->device_event().off_wrap, off_wrap(6, true));
+    BOOST_CHECK(get_ids(1));
+    // An event in the next turn of the ring has the wrap counter flipped
+    _driver->set_driver_event(off_wrap(2, false), VIRTQ_PACKED_EVENT_F_DESC);
+    BOOST_CHECK(!get_ids(4));
+    BOOST_CHECK_EQUAL(_driver->device_event().off_wrap, off_wrap(0, false));
+    BOOST_CHECK(get_ids(2));
+    BOOST_CHECK_EQUAL(_driver->device_event().off_wrap, off_wrap(4, false));
+    // The same event comes around again two turns later
+    BOOST_CHECK(!get_ids(8));
+    BOOST_CHECK_EQUAL(_driver->device_event().off_wrap, off_wrap(4, true));
+    BOOST_CHECK(get_ids(8));
+    BOOST_CHECK_EQUAL(_driver->device_event().off_wrap, off_wrap(4, false));
+    // Interrupts can also be disabled, or enabled for every used buffer
+    _driver->set_driver_event(0, VIRTQ_PACKED_EVENT_F_DISABLE);
+    BOOST_CHECK(!get_ids(8));
+    _driver->set_driver_event(0, VIRTQ_PACKED_EVENT_F_ENABLE);
+    BOOST_CHECK(get_ids(1));
+    BOOST_CHECK(get_ids(1));
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(virtio_packed_ring_chained_test, virtio_blk_machine_fixture) {
+    using namespace cartesi;
+    create(false, VIRTIO_F_RING_PACKED);
+    // Each request is a chain of three descriptors, so chains keep straddling the end of the ring
+    // while the wrap counters flip every turn
+    for (uint64_t i = 0; i < 23; ++i) {
+        const uint64_t sector = i % disk_sectors;
+        const std::string data(sector_size, static_cast<char>('a' + i));
+        write_data(data);
+        BOOST_CHECK_EQUAL(request(VIRTIO_BLK_T_OUT, sector, sector_size), VIRTIO_BLK_S_OK);
+        write_data(std::string(sector_size, '\0'));
+        BOOST_CHECK_EQUAL(request(VIRTIO_BLK_T_IN, sector, sector_size, true), VIRTIO_BLK_S_OK);
+        BOOST_CHECK(read_data(sector_size) == data);
+    }
+    for (uint64_t i = 0; i < _requests; ++i) {
+        BOOST_CHECK_EQUAL(_driver->used_id(i), (3 * i) % virtio_test_driver::queue_num);
+    }
+    // Several chains in flight across the end of the ring, possibly used out of order
+    const uint64_t first = _requests;
+    BOOST_REQUIRE_EQUAL((3 * first) % virtio_test_driver::queue_num, 10);
+    std::map<uint16_t, uint64_t> sectors;
+    for (uint64_t i = 0; i < 5; ++i) {
+        const uint64_t header = header_start + (i * 0x100);
+        const uint64_t data = data_start + (i * 0x1000);
+        _driver->write(header, virtio_blk_req_header{VIRTIO_BLK_T_IN, 0, i});
+        _driver->write(status_start + i, uint8_t{0xff});
+        sectors[_driver->add({{header, sizeof(virtio_blk_req_header), 0, 0},
+            {data, sector_size, VIRTQ_DESC_F_WRITE, 0}, {status_start + i, 1, VIRTQ_DESC_F_WRITE, 0}})] = i;
+    }
+    _driver->kick();
+    _requests += 5;
+    _driver->wait_used(_requests);
+    for (uint64_t i = first; i < _requests; ++i) {
+        const uint64_t sector = sectors.at(_driver->used_id(i));
+        BOOST_CHECK_EQUAL(_driver->used_len(i), sector_size + 1);
+        BOOST_CHECK_EQUAL(_driver->read<uint8_t>(status_start + sector), VIRTIO_BLK_S_OK);
+        std::string data(sector_size, '\0');
+        BOOST_REQUIRE_EQUAL(cm_read_memory(_machine, data_start + (sector * 0x1000),
+                                reinterpret_cast<uint8_t *>(data.data()), sector_size),
+            CM_ERROR_OK);
+        BOOST_CHECK(data == read_disk().substr(sector * sector_size, sector_size));
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(virtio_packed_ring_indirect_test, virtio_blk_machine_fixture) {
+    using namespace cartesi;
+    create(false, VIRTIO_F_RING_PACKED);
+    // Indirect descriptors are not offered, so a driver that uses them anyway gets the device to ask for a reset,
+    // instead of having its buffer misread
+    const uint64_t features = _driver->device_features();
+    BOOST_CHECK((features & VIRTIO_F_RING_PACKED) != 0);
+    BOOST_CHECK((features & VIRTIO_F_INDIRECT_DESC) == 0);
+    const uint64_t table = data_start + 0x1000;
+    const std::array<virtq_packed_desc, 3> descs{{
+        {header_start, sizeof(virtio_blk_req_header), 0, 0},
+        {data_start, sector_size, VIRTQ_DESC_F_WRITE, 0},
+        {status_start, 1, VIRTQ_DESC_F_WRITE, 0},
+    }};
+    _driver->write(table, descs);
+    _driver->write(header_start, virtio_blk_req_header{VIRTIO_BLK_T_IN, 0, 0});
+    _driver->write(status_start, uint8_t{0xff});
+    _driver->post({{table, sizeof(descs), VIRTQ_DESC_F_INDIRECT, 0}});
+    BOOST_CHECK((_driver->device_status() & VIRTIO_STATUS_DEVICE_NEEDS_RESET) != 0);
+    BOOST_CHECK_EQUAL(_driver->used_count(), 0);
+    BOOST_CHECK_EQUAL(_driver->read<uint8_t>(status_start), 0xff);
+}
+
+namespace {
+
+// Builds a 9P2000.L request, whose fields are little-endian like the host ones
+class p9_message {
+public:
+    p9_message(uint8_t type, uint16_t tag) {
+        add(uint32_t{0}).add(type).add(tag);
+    }
+
+    template <typename T>
+    p9_message &add(const T &value) {
+        m_data.append(reinterpret_cast<const char *>(&value), sizeof(T));
+        return *this;
+    }
+
+    p9_message &add_string(const std::string &value) {
+        add(static_cast<uint16_t>(value.size()));
+        m_data.append(value);
+        return *this;
+    }
+
+    // Returns the request, with its size filled in
+    std::string finish() {
+        const auto size = static_cast<uint32_t>(m_data.size());
+        std::memcpy(m_data.data(), &size, sizeof(size));
+        return m_data;
+    }
+
+private:
+    std::string m_data;
+};
+
+// NOLINTNEXTLINE(cppcoreguidelines-special-member-functions)
+class virtio_p9fs_machine_fixture : public incomplete_machine_fixture {
+public:
+    // Each slot holds a request of up to the maximum message size, followed by the buffer for its reply
+    static constexpr uint64_t slots_start = 0x80100000;
+    static constexpr uint64_t slot_size = 0x100000;
+    static constexpr uint64_t slots_count = 8;
+    static constexpr uint64_t reply_offset = 0x80000;
+    // Split buffers leave a gap between their halves, so they are not contiguous in guest memory
+    static constexpr uint32_t split_gap = 16;
+    static constexpr uint32_t reply_header_size = 7;
+    static constexpr uint32_t root_fid = 0;
+    static constexpr uint32_t iounit = cartesi::P9_MAX_MSIZE - cartesi::P9_IOUNIT_HEADER_SIZE;
+
+    virtio_p9fs_machine_fixture() :
+        _host_directory(std::filesystem::temp_directory_path() / "virtio-p9fs-root") {
+        std::filesystem::remove_all(_host_directory);
+        std::filesystem::create_directory(_host_directory);
+    }
+    ~virtio_p9fs_machine_fixture() {
+        cm_delete(_machine);
+        std::filesystem::remove_all(_host_directory);
+    }
+
+protected:
+    // Creates the machine, negotiates the message size and attaches the root fid to the host directory
+    void create() {
+        using namespace cartesi;
+        _machine_config["ram"]["length"] = 16 << 20;
+        _machine_config["processor"]["iunrep"] = 1;
+        _machine_config["virtio"] = nlohmann::json::array(
+            {{{"type", "p9fs"}, {"tag", "vfs0"}, {"host_directory", _host_directory.string()}}});
+        BOOST_REQUIRE_EQUAL(cm_create_new(_machine_config.dump().c_str(), nullptr, &_machine), CM_ERROR_OK);
+        _driver = std::make_unique<virtio_test_driver>(_machine);
+        _driver->init(VIRTIO_9P_F_MOUNT_TAG);
+        // The device caps the message size the driver asks for
+        const auto version = request(p9_message(P9_TVERSION, UINT16_MAX)
+                .add(uint32_t{2 * P9_MAX_MSIZE})
+                .add_string("9P2000.L")
+                .finish());
+        BOOST_REQUIRE_EQUAL(reply_type(version), P9_RVERSION);
+        BOOST_REQUIRE_EQUAL(reply_field<uint32_t>(version, 0), P9_MAX_MSIZE);
+        BOOST_REQUIRE_EQUAL(reply_type(request(attach(root_fid))), P9_RATTACH);
+    }
+
+    std::string attach(uint32_t fid) {
+        return p9_message(cartesi::P9_TATTACH, ++_tag)
+            .add(fid)
+            .add(UINT32_MAX)
+            .add_string("root")
+            .add_string("")
+            .add(uint32_t{0})
+            .finish();
+    }
+
+    std::string walk(uint32_t fid, uint32_t newfid, const std::vector<std::string> &names) {
+        p9_message msg(cartesi::P9_TWALK, ++_tag);
+        msg.add(fid).add(newfid).add(static_cast<uint16_t>(names.size()));
+        for (const auto &name : names) {
+            msg.add_string(name);
+        }
+        return msg.finish();
+    }
+
+    std::string lopen(uint32_t fid, uint32_t flags) {
+        return p9_message(cartesi::P9_TLOPEN, ++_tag).add(fid).add(flags).finish();
+    }
+
+    std::string read(uint32_t fid, uint64_t offset, uint32_t count) {
+        return p9_message(cartesi::P9_TREAD, ++_tag).add(fid).add(offset).add(count).finish();
+    }
+
+    std::string write(uint32_t fid, uint64_t offset, const std::string &data) {
+        p9_message msg(cartesi::P9_TWRITE, ++_tag);
+        msg.add(fid).add(offset).add(static_cast<uint32_t>(data.size()));
+        return msg.finish() + data;
+    }
+
+    std::string getattr(uint32_t fid) {
+        return p9_message(cartesi::P9_TGETATTR, ++_tag).add(fid).add(uint64_t{cartesi::P9_GETATTR_SIZE}).finish();
+    }
+
+    std::string fsync(uint32_t fid) {
+        return p9_message(cartesi::P9_TFSYNC, ++_tag).add(fid).add(uint32_t{0}).finish();
+    }
+
+    std::string clunk(uint32_t fid) {
+        return p9_message(cartesi::P9_TCLUNK, ++_tag).add(fid).finish();
+    }
+
+    std::string readdir(uint32_t fid, uint64_t offset, uint32_t count) {
+        return p9_message(cartesi::P9_TREADDIR, ++_tag).add(fid).add(offset).add(count).finish();
+    }
+
+    std::string unlinkat(uint32_t dfid, const std::string &name) {
+        return p9_message(cartesi::P9_TUNLINKAT, ++_tag).add(dfid).add_string(name).add(uint32_t{0}).finish();
+    }
+
+    // Returns the names and offsets of the entries in a readdir reply
+    static std::vector<std::pair<std::string, uint64_t>> dir_entries(const std::string &r) {
+        BOOST_REQUIRE_EQUAL(reply_type(r), cartesi::P9_RREADDIR);
+        const auto data_len = reply_field<uint32_t>(r, 0);
+        BOOST_REQUIRE_EQUAL(reply_header_size + sizeof(uint32_t) + data_len, r.size());
+        std::vector<std::pair<std::string, uint64_t>> entries;
+        for (size_t pos = reply_header_size + sizeof(uint32_t); pos < r.size();) {
+            pos += sizeof(cartesi::p9_qid);
+            const auto offset = reply_field_at<uint64_t>(r, pos);
+            pos += sizeof(uint64_t) + sizeof(uint8_t);
+            const auto name_len = reply_field_at<uint16_t>(r, pos);
+            pos += sizeof(uint16_t);
+            BOOST_REQUIRE_LE(pos + name_len, r.size());
+            entries.emplace_back(r.substr(pos, name_len), offset);
+            pos += name_len;
+        }
+        return entries;
+    }
+
+    // Makes a request available in a slot, without notifying the device.
+    // When split is not zero, the reply buffer is split in two descriptors at that offset, and so is the request
+    // when it is longer.
+    void add(uint64_t slot, const std::string &msg, uint32_t split = 0) {
+        using namespace cartesi;
+        BOOST_REQUIRE_LT(slot, slots_count);
+        BOOST_REQUIRE_LE(msg.size() + split_gap, reply_offset);
+        const uint64_t request_start = slots_start + (slot * slot_size);
+        const uint64_t reply_start = request_start + reply_offset;
+        const auto msg_len = static_cast<uint32_t>(msg.size());
+        const uint32_t reply_len = reply_offset - split_gap;
+        std::vector<virtq_desc> chain;
+        if (split == 0 || split >= msg_len) {
+            write_bytes(request_start, msg);
+            chain.push_back({request_start, msg_len, 0, 0});
+        } else {
+            write_bytes(request_start, msg.substr(0, split));
+            write_bytes(request_start + split + split_gap, msg.substr(split));
+            chain.push_back({request_start, split, 0, 0});
+            chain.push_back({request_start + split + split_gap, msg_len - split, 0, 0});
+        }
+        if (split == 0) {
+            chain.push_back({reply_start, reply_len, VIRTQ_DESC_F_WRITE, 0});
+        } else {
+            chain.push_back({reply_start, split, VIRTQ_DESC_F_WRITE, 0});
+            chain.push_back({reply_start + split + split_gap, reply_len - split, VIRTQ_DESC_F_WRITE, 0});
+        }
+        _splits[slot] = split;
+        _driver->add(chain);
+    }
+
+    // Reads the reply in a slot, joining split reply buffers
+    std::string reply(uint64_t slot) {
+        const uint64_t reply_start = slots_start + (slot * slot_size) + reply_offset;
+        const uint32_t split = _splits[slot];
+        const auto size = _driver->read<uint32_t>(reply_start);
+        BOOST_REQUIRE_GE(size, reply_header_size);
+        BOOST_REQUIRE_LE(size, cartesi::P9_MAX_MSIZE);
+        if (split == 0 || size <= split) {
+            return read_bytes(reply_start, size);
+        }
+        return read_bytes(reply_start, split) + read_bytes(reply_start + split + split_gap, size - split);
+    }
+
+    // Sends requests that are in flight together, and returns their replies in the same order
+    std::vector<std::string> requests(const std::vector<std::string> &msgs) {
+        for (uint64_t slot = 0; slot < msgs.size(); ++slot) {
+            add(slot, msgs[slot]);
+        }
+        _driver->kick();
+        _requests += msgs.size();
+        _driver->wait_used(_requests);
+        std::vector<std::string> replies;
+        for (uint64_t slot = 0; slot < msgs.size(); ++slot) {
+            replies.push_back(reply(slot));
+            BOOST_CHECK_EQUAL(reply_field_at<uint16_t>(replies.back(), 5), reply_field_at<uint16_t>(msgs[slot], 5));
+        }
+        return replies;
+    }
+
+    // Sends a request, and returns its reply
+    std::string request(const std::string &msg, uint32_t split = 0) {
+        add(0, msg, split);
+        _driver->kick();
+        _driver->wait_used(++_requests);
+        auto r = reply(0);
+        BOOST_CHECK_EQUAL(_driver->used_len(_requests - 1), r.size());
+        BOOST_CHECK_EQUAL(reply_field_at<uint16_t>(r, 5), reply_field_at<uint16_t>(msg, 5));
+        return r;
+    }
+
+    static uint8_t reply_type(const std::string &r) {
+        return static_cast<uint8_t>(r.at(4));
+    }
+
+    // Reads a field of a reply, at an offset from the end of its header
+    template <typename T>
+    static T reply_field(const std::string &r, size_t offset) {
+        return reply_field_at<T>(r, reply_header_size + offset);
+    }
+
+    template <typename T>
+    static T reply_field_at(const std::string &r, size_t offset) {
+        T value{};
+        BOOST_REQUIRE_LE(offset + sizeof(T), r.size());
+        std::memcpy(&value, r.data() + offset, sizeof(T));
+        return value;
+    }
+
+    // Returns the size the device reports for a fid
+    uint64_t file_size(uint32_t fid) {
+        const auto r = request(getattr(fid));
+        BOOST_REQUIRE_EQUAL(reply_type(r), cartesi::P9_RGETATTR);
+        return reply_field<cartesi::p9_stat>(r, sizeof(uint64_t) + sizeof(cartesi::p9_qid)).size;
+    }
+
+    void write_host_file(const std::string &name, const std::string &data) const {
+        std::ofstream ofs(_host_directory / name, std::ios::binary);
+        ofs << data;
+    }
+
+    std::string read_host_file(const std::string &name) const {
+        std::ifstream ifs(_host_directory / name, std::ios::binary);
+        return {std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>()};
+    }
+
+    std::filesystem::path _host_directory;
+    std::unique_ptr<virtio_test_driver> _driver;
+    uint64_t _requests{0};
+
+private:
+    void write_bytes(uint64_t paddr, const std::string &data) const {
+        BOOST_REQUIRE_EQUAL(
+            cm_write_memory(_machine, paddr, reinterpret_cast<const uint8_t *>(data.data()), data.size()),
+            CM_ERROR_OK);
+    }
+
+    std::string read_bytes(uint64_t paddr, uint64_t length) const {
+        std::string data(length, '\0');
+        BOOST_REQUIRE_EQUAL(cm_read_memory(_machine, paddr, reinterpret_cast<uint8_t *>(data.data()), length),
+            CM_ERROR_OK);
+        return data;
+    }
+
+    uint16_t _tag{0};
+    std::array<uint32_t, slots_count> _splits{};
+};
+
+} // namespace
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(virtio_p9fs_large_io_test, virtio_p9fs_machine_fixture) {
+    using namespace cartesi;
+    create();
+    write_host_file("big", "");
+    BOOST_REQUIRE_EQUAL(reply_type(request(walk(root_fid, 1, {"big"}))), P9_RWALK);
+    const auto opened = request(lopen(1, P9_O_RDWR));
+    BOOST_REQUIRE_EQUAL(reply_type(opened), P9_RLOPEN);
+    BOOST_CHECK_EQUAL(reply_field<uint32_t>(opened, sizeof(p9_qid)), iounit);
+    std::string data(2 * static_cast<size_t>(iounit), '\0');
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<char>((i * 7) + (i / 251));
+    }
+    // Writes of a whole iounit, from one buffer and from two buffers that are not contiguous
+    auto r = request(write(1, 0, data.substr(0, iounit)));
+    BOOST_REQUIRE_EQUAL(reply_type(r), P9_RWRITE);
+    BOOST_CHECK_EQUAL(reply_field<uint32_t>(r, 0), iounit);
+    r = request(write(1, iounit, data.substr(iounit)), 4099);
+    BOOST_REQUIRE_EQUAL(reply_type(r), P9_RWRITE);
+    BOOST_CHECK_EQUAL(reply_field<uint32_t>(r, 0), iounit);
+    BOOST_CHECK(read_host_file("big") == data);
+    // Reads of a whole iounit, into one buffer and into two buffers that are not contiguous
+    const uint32_t read_header_size = reply_header_size + sizeof(uint32_t);
+    r = request(read(1, 1, iounit));
+    BOOST_REQUIRE_EQUAL(reply_type(r), P9_RREAD);
+    BOOST_CHECK_EQUAL(reply_field<uint32_t>(r, 0), iounit);
+    BOOST_CHECK(r.substr(read_header_size) == data.substr(1, iounit));
+    r = request(read(1, iounit - 5, iounit), 4099);
+    BOOST_REQUIRE_EQUAL(reply_type(r), P9_RREAD);
+    BOOST_CHECK_EQUAL(reply_field<uint32_t>(r, 0), iounit);
+    BOOST_CHECK(r.substr(read_header_size) == data.substr(iounit - 5, iounit));
+    // Reads stop at the end of the file
+    r = request(read(1, data.size() - 10, iounit));
+    BOOST_REQUIRE_EQUAL(reply_type(r), P9_RREAD);
+    BOOST_CHECK(r.substr(read_header_size) == data.substr(data.size() - 10));
+    // Counts that do not fit in the negotiated message size are rejected
+    r = request(read(1, 0, iounit + 1));
+    BOOST_REQUIRE_EQUAL(reply_type(r), P9_RLERROR);
+    BOOST_CHECK_EQUAL(reply_field<uint32_t>(r, 0), P9_EPROTO);
+    r = request(write(1, 0, std::string(iounit + 1, 'x')));
+    BOOST_REQUIRE_EQUAL(reply_type(r), P9_RLERROR);
+    BOOST_CHECK_EQUAL(reply_field<uint32_t>(r, 0), P9_EPROTO);
+    BOOST_CHECK(read_host_file("big") == data);
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(virtio_p9fs_attr_cache_test, virtio_p9fs_machine_fixture) {
+    using namespace cartesi;
+    create();
+    write_host_file("f", "");
+    // Fid 1 is only walked, so its attributes come from the cache the walks fill
+    BOOST_REQUIRE_EQUAL(reply_type(request(walk(root_fid, 1, {"f"}))), P9_RWALK);
+    BOOST_REQUIRE_EQUAL(reply_type(request(walk(root_fid, 2, {"f"}))), P9_RWALK);
+    BOOST_REQUIRE_EQUAL(reply_type(request(lopen(2, P9_O_RDWR))), P9_RLOPEN);
+    BOOST_CHECK_EQUAL(file_size(1), 0);
+    // Once a write through another fid is replied, the cached attributes of the file are gone
+    auto r = request(write(2, 0, "hello"));
+    BOOST_REQUIRE_EQUAL(reply_type(r), P9_RWRITE);
+    BOOST_CHECK_EQUAL(file_size(1), 5);
+    r = request(write(2, 5, std::string(1000, 'x')));
+    BOOST_REQUIRE_EQUAL(reply_type(r), P9_RWRITE);
+    BOOST_CHECK_EQUAL(file_size(1), 1005);
+    // New walks see the new size too
+    BOOST_REQUIRE_EQUAL(reply_type(request(walk(root_fid, 3, {"f"}))), P9_RWALK);
+    BOOST_CHECK_EQUAL(file_size(3), 1005);
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(virtio_p9fs_dir_handle_test, virtio_p9fs_machine_fixture) {
+    using namespace cartesi;
+    std::filesystem::create_directories(_host_directory / "d" / "e");
+    write_host_file("x", "1");
+    write_host_file("d/x", "22");
+    write_host_file("d/e/x", "333");
+    // Open host files are counted to check that handles are not leaked
+    const auto count_open_files = [] {
+        return std::distance(std::filesystem::directory_iterator("/proc/self/fd"),
+            std::filesystem::directory_iterator{});
+    };
+    const bool can_count_open_files = std::filesystem::exists("/proc/self/fd");
+    create();
+    const auto open_files = can_count_open_files ? count_open_files() : 0;
+    // Walks from a fid resolve names relative to its directory handle
+    BOOST_REQUIRE_EQUAL(reply_type(request(walk(root_fid, 1, {"d"}))), P9_RWALK);
+    BOOST_REQUIRE_EQUAL(reply_type(request(walk(1, 2, {"x"}))), P9_RWALK);
+    BOOST_CHECK_EQUAL(file_size(2), 2);
+    // Walking a fid onto itself releases its handle, so names resolve in the new directory
+    BOOST_REQUIRE_EQUAL(reply_type(request(walk(1, 1, {"e"}))), P9_RWALK);
+    BOOST_REQUIRE_EQUAL(reply_type(request(walk(1, 3, {"x"}))), P9_RWALK);
+    BOOST_CHECK_EQUAL(file_size(3), 3);
+    BOOST_REQUIRE_EQUAL(reply_type(request(walk(1, 4, {"..", "x"}))), P9_RWALK);
+    BOOST_CHECK_EQUAL(file_size(4), 2);
+    // Missing names are reported through handles as well
+    auto r = request(walk(1, 5, {"missing"}));
+    BOOST_REQUIRE_EQUAL(reply_type(r), P9_RLERROR);
+    BOOST_CHECK_EQUAL(reply_field<uint32_t>(r, 0), P9_ENOENT);
+    // Attributes of directories are read through their handles
+    r = request(getattr(1));
+    BOOST_REQUIRE_EQUAL(reply_type(r), P9_RGETATTR);
+    BOOST_CHECK_EQUAL(reply_field<p9_qid>(r, sizeof(uint64_t)).type, P9_QID_DIR);
+    // Attaching again after a clunk starts over from the root, and so does a second attach
+    BOOST_REQUIRE_EQUAL(reply_type(request(clunk(root_fid))), P9_RCLUNK);
+    BOOST_REQUIRE_EQUAL(reply_type(request(attach(root_fid))), P9_RATTACH);
+    BOOST_REQUIRE_EQUAL(reply_type(request(attach(6))), P9_RATTACH);
+    BOOST_REQUIRE_EQUAL(reply_type(request(walk(root_fid, 7, {"x"}))), P9_RWALK);
+    BOOST_CHECK_EQUAL(file_size(7), 1);
+    BOOST_REQUIRE_EQUAL(reply_type(request(walk(6, 8, {"d", "e", "x"}))), P9_RWALK);
+    BOOST_CHECK_EQUAL(file_size(8), 3);
+    // Handles beyond the limit are not opened, and those fids fall back to full paths
+    const uint32_t many_fids_start = 100;
+    const uint32_t many_fids_end = many_fids_start + P9_DIR_HANDLES_MAX + 8;
+    for (uint32_t fid = many_fids_start; fid < many_fids_end; ++fid) {
+        BOOST_REQUIRE_EQUAL(reply_type(request(walk(6, fid, {"d"}))), P9_RWALK);
+        r = request(walk(fid, fid, {"x"}));
+        BOOST_REQUIRE_EQUAL(reply_type(r), P9_RWALK);
+        BOOST_CHECK_EQUAL(reply_field<uint16_t>(r, 0), 1);
+    }
+    if (can_count_open_files) {
+        BOOST_CHECK_LE(count_open_files(), open_files + P9_DIR_HANDLES_MAX);
+    }
+    // All handles are closed once their fids are clunked
+    for (const uint32_t fid : {root_fid, 1U, 2U, 3U, 4U, 6U, 7U, 8U}) {
+        BOOST_REQUIRE_EQUAL(reply_type(request(clunk(fid))), P9_RCLUNK);
+    }
+    for (uint32_t fid = many_fids_start; fid < many_fids_end; ++fid) {
+        BOOST_REQUIRE_EQUAL(reply_type(request(clunk(fid))), P9_RCLUNK);
+    }
+    if (can_count_open_files) {
+        BOOST_CHECK_EQUAL(count_open_files(), open_files);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(virtio_p9fs_concurrent_io_test, virtio_p9fs_machine_fixture) {
+    using namespace cartesi;
+    create();
+    write_host_file("f", "");
+    const uint32_t chunk = 0x10000;
+    const std::string data = std::string(chunk, 'a') + std::string(chunk, 'b') + std::string(chunk, 'c') +
+        std::string(chunk, 'd');
+    // Writes to the same fid in flight together, followed by requests on it that wait for them to finish
+    BOOST_REQUIRE_EQUAL(reply_type(request(walk(root_fid, 1, {"f"}))), P9_RWALK);
+    BOOST_REQUIRE_EQUAL(reply_type(request(lopen(1, P9_O_RDWR))), P9_RLOPEN);
+    auto replies = requests({write(1, 0, data.substr(0, chunk)), write(1, chunk, data.substr(chunk, chunk)),
+        write(1, 2 * chunk, data.substr(2 * chunk, chunk)), write(1, 3 * chunk, data.substr(3 * chunk)),
+        fsync(1), getattr(1), clunk(1)});
+    for (size_t i = 0; i < 4; ++i) {
+        BOOST_REQUIRE_EQUAL(reply_type(replies[i]), P9_RWRITE);
+        BOOST_CHECK_EQUAL(reply_field<uint32_t>(replies[i], 0), chunk);
+    }
+    BOOST_CHECK_EQUAL(reply_type(replies[4]), P9_RFSYNC);
+    BOOST_REQUIRE_EQUAL(reply_type(replies[5]), P9_RGETATTR);
+    BOOST_CHECK_EQUAL(reply_field<p9_stat>(replies[5], sizeof(uint64_t) + sizeof(p9_qid)).size, data.size());
+    BOOST_CHECK_EQUAL(reply_type(replies[6]), P9_RCLUNK);
+    BOOST_CHECK(read_host_file("f") == data);
+    // Reads from the same fid in flight together, including one that straddles chunks and one past the end
+    BOOST_REQUIRE_EQUAL(reply_type(request(walk(root_fid, 2, {"f"}))), P9_RWALK);
+    BOOST_REQUIRE_EQUAL(reply_type(request(lopen(2, P9_O_RDONLY))), P9_RLOPEN);
+    const std::vector<std::pair<uint64_t, uint32_t>> reads{{3 * chunk, chunk}, {2 * chunk, chunk}, {chunk, chunk},
+        {0, chunk}, {chunk / 2, chunk}, {data.size(), chunk}};
+    std::vector<std::string> msgs;
+    for (const auto &[offset, count] : reads) {
+        msgs.push_back(read(2, offset, count));
+    }
+    msgs.push_back(getattr(2));
+    replies = requests(msgs);
+    const uint32_t read_header_size = reply_header_size + sizeof(uint32_t);
+    for (size_t i = 0; i < reads.size(); ++i) {
+        BOOST_REQUIRE_EQUAL(reply_type(replies[i]), P9_RREAD);
+        BOOST_CHECK(replies[i].substr(read_header_size) == data.substr(reads[i].first, reads[i].second));
+    }
+    BOOST_REQUIRE_EQUAL(reply_type(replies.back()), P9_RGETATTR);
+    // Reads and writes of different ranges of the same fid in flight together
+    BOOST_REQUIRE_EQUAL(reply_type(request(walk(root_fid, 3, {"f"}))), P9_RWALK);
+    BOOST_REQUIRE_EQUAL(reply_type(request(lopen(3, P9_O_RDWR))), P9_RLOPEN);
+    replies = requests({write(3, 0, std::string(chunk, 'z')), read(3, 2 * chunk, chunk),
+        write(3, 4 * chunk, std::string(chunk, 'y')), read(3, chunk, chunk), clunk(3)});
+    BOOST_REQUIRE_EQUAL(reply_type(replies[0]), P9_RWRITE);
+    BOOST_REQUIRE_EQUAL(reply_type(replies[1]), P9_RREAD);
+    BOOST_CHECK(replies[1].substr(read_header_size) == std::string(chunk, 'c'));
+    BOOST_REQUIRE_EQUAL(reply_type(replies[2]), P9_RWRITE);
+    BOOST_REQUIRE_EQUAL(reply_type(replies[3]), P9_RREAD);
+    BOOST_CHECK(replies[3].substr(read_header_size) == std::string(chunk, 'b'));
+    BOOST_CHECK_EQUAL(reply_type(replies[4]), P9_RCLUNK);
+    // The writes are visible to other fids
+    const auto r = request(read(2, 0, 1));
+    BOOST_REQUIRE_EQUAL(reply_type(r), P9_RREAD);
+    BOOST_CHECK_EQUAL(r.substr(read_header_size), "z");
+    BOOST_CHECK(read_host_file("f") == std::string(chunk, 'z') + data.substr(chunk) + std::string(chunk, 'y'));
+    BOOST_CHECK_EQUAL(file_size(2), 5 * chunk);
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(virtio_p9fs_readdir_test, virtio_p9fs_machine_fixture) {
+    using namespace cartesi;
+    // Long names make the directory take a few replies, even with the largest message size
+    std::filesystem::create_directory(_host_directory / "d");
+    const auto entry_name = [](int i) {
+        std::string name = std::to_string(i);
+        return name + std::string(120 - name.size(), 'n');
+    };
+    const int entries_count = 5000;
+    std::set<std::string> expected{".", ".."};
+    for (int i = 0; i < entries_count; ++i) {
+        write_host_file("d/" + entry_name(i), "");
+        expected.insert(entry_name(i));
+    }
+    create();
+    BOOST_REQUIRE_EQUAL(reply_type(request(walk(root_fid, 1, {"d"}))), P9_RWALK);
+    BOOST_REQUIRE_EQUAL(reply_type(request(lopen(1, P9_O_RDONLY | P9_O_DIRECTORY))), P9_RLOPEN);
+    // Replies are filled with as many entries as fit in the negotiated message size
+    const uint32_t max_entry_len = sizeof(p9_qid) + sizeof(uint64_t) + sizeof(uint8_t) + sizeof(uint16_t) + 120;
+    auto r = request(readdir(1, 0, iounit));
+    BOOST_CHECK_LE(r.size(), P9_MAX_MSIZE);
+    BOOST_CHECK_GT(reply_field<uint32_t>(r, 0), iounit - max_entry_len);
+    auto entries = dir_entries(r);
+    BOOST_REQUIRE_LT(entries.size(), expected.size());
+    // An entry removed while the directory is being listed is skipped, and one created meanwhile is not listed
+    std::set<std::string> pending = expected;
+    for (const auto &entry : entries) {
+        pending.erase(entry.first);
+    }
+    pending.erase(".");
+    pending.erase("..");
+    BOOST_REQUIRE(!pending.empty());
+    const std::string removed = *pending.begin();
+    BOOST_REQUIRE_EQUAL(reply_type(request(unlinkat(1, removed))), P9_RUNLINKAT);
+    write_host_file("d/created", "");
+    // Reading resumes from the offset of the last entry received
+    std::set<std::string> listed;
+    uint64_t last_offset = 0;
+    while (!entries.empty()) {
+        for (const auto &[name, offset] : entries) {
+            BOOST_CHECK_GT(offset, last_offset);
+            BOOST_CHECK(listed.insert(name).second);
+            last_offset = offset;
+        }
+        entries = dir_entries(request(readdir(1, last_offset, iounit)));
+    }
+    expected.erase(removed);
+    BOOST_CHECK(listed == expected);
+    // Reading again from the start takes a fresh snapshot of the directory
+    listed.clear();
+    last_offset = 0;
+    do {
+        entries = dir_entries(request(readdir(1, last_offset, iounit)));
+        for (const auto &[name, offset] : entries) {
+            listed.insert(name);
+            last_offset = offset;
+        }
+    } while (!entries.empty());
+    expected.insert("created");
+    BOOST_CHECK(listed == expected);
+    BOOST_REQUIRE_EQUAL(reply_type(request(clunk(1))), P9_RCLUNK);
+}
+
 class ordinary_machine_fixture : public incomplete_machine_fixture {
 public:
     ordinary_machine_fixture() {
@@ -356,6 +1635,316 @@ BOOST_FIXTURE_TEST_CASE_NOLINT(serde_complex_test, ordinary_machine_fixture) {
     cm_delete(restored_machine);
 }
 
+BOOST_FIXTURE_TEST_CASE_NOLINT(serde_sparse_ram_test, incomplete_machine_fixture) {
+    // Large enough RAM to be split into several chunks stored by different threads
+    constexpr uint64_t ram_length = 64 << 20;
+    _machine_config["ram"]["length"] = ram_length;
+    const auto runtime_config = nlohmann::json{{"concurrency", {{"store_pmas", 3}}}}.dump();
+    BOOST_REQUIRE_EQUAL(cm_create_new(_machine_config.dump().c_str(), runtime_config.c_str(), &_machine),
+        CM_ERROR_OK);
+    // Data straddling a chunk boundary, and at the very end of RAM
+    const std::array<uint8_t, 2> data{'x', 'y'};
+    BOOST_REQUIRE_EQUAL(cm_write_memory(_machine, 0x80000000 + (16 << 20) - 1, data.data(), data.size()),
+        CM_ERROR_OK);
+    BOOST_REQUIRE_EQUAL(cm_write_memory(_machine, 0x80000000 + ram_length - 2, data.data(), data.size()),
+        CM_ERROR_OK);
+
+    const auto dir = (std::filesystem::temp_directory_path() / "serde-sparse-ram").string();
+    std::filesystem::remove_all(dir);
+    BOOST_REQUIRE_EQUAL(cm_store(_machine, dir.c_str()), CM_ERROR_OK);
+    // Pristine pages are left out, but the image still has the full RAM length
+    std::ostringstream ram_image_name;
+    ram_image_name << dir << "/" << std::hex << std::setw(16) << std::setfill('0') << 0x80000000 << "-" << ram_length
+                   << ".bin";
+    BOOST_CHECK_EQUAL(std::filesystem::file_size(ram_image_name.str()), ram_length);
+
+    cm_machine *restored_machine{};
+    BOOST_REQUIRE_EQUAL(cm_load_new(dir.c_str(), nullptr, &restored_machine), CM_ERROR_OK);
+    std::array<uint8_t, 2> read_data{};
+    BOOST_REQUIRE_EQUAL(cm_read_memory(restored_machine, 0x80000000 + (16 << 20) - 1, read_data.data(),
+                            read_data.size()),
+        CM_ERROR_OK);
+    BOOST_CHECK(read_data == data);
+    cm_hash origin_hash{};
+    cm_hash restored_hash{};
+    BOOST_REQUIRE_EQUAL(cm_get_root_hash(_machine, &origin_hash), CM_ERROR_OK);
+    BOOST_REQUIRE_EQUAL(cm_get_root_hash(restored_machine, &restored_hash), CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(0, memcmp(origin_hash, restored_hash, sizeof(cm_hash)));
+
+    cm_delete(restored_machine);
+    cm_delete(_machine);
+    std::filesystem::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_CASE_NOLINT(new_template_null_machine_test) {
+    cm_machine_template *t{};
+    cm_error error_code = cm_new_template(nullptr, &t);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_INVALID_ARGUMENT);
+    BOOST_CHECK(t == nullptr);
+    BOOST_CHECK_NO_THROW(cm_delete_template(nullptr));
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(create_from_template_null_template_test, default_machine_fixture) {
+    cm_error error_code = cm_create_new_from_template(nullptr, nullptr, &_machine);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_INVALID_ARGUMENT);
+    BOOST_CHECK_EQUAL(std::string(cm_get_last_error_message()), std::string("invalid machine template"));
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(create_from_template_complex_test, ordinary_machine_fixture) {
+    const uint64_t address = 0x80000000;
+    std::array<uint8_t, 4> data{0xde, 0xad, 0xbe, 0xef};
+    BOOST_REQUIRE_EQUAL(cm_write_memory(_machine, address, data.data(), data.size()), CM_ERROR_OK);
+    BOOST_REQUIRE_EQUAL(cm_write_reg(_machine, CM_REG_X1, 0x1234), CM_ERROR_OK);
+
+    cm_machine_template *t{};
+    cm_error error_code = cm_new_template(_machine, &t);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(std::string(""), std::string(cm_get_last_error_message()));
+
+    cm_hash origin_hash{};
+    BOOST_REQUIRE_EQUAL(cm_get_root_hash(_machine, &origin_hash), CM_ERROR_OK);
+
+    // Changes to the original machine must not leak into the template
+    std::array<uint8_t, 4> other_data{0xca, 0xfe, 0xba, 0xbe};
+    BOOST_REQUIRE_EQUAL(cm_write_memory(_machine, address, other_data.data(), other_data.size()), CM_ERROR_OK);
+
+    cm_machine *first{};
+    cm_machine *second{};
+    BOOST_REQUIRE_EQUAL(cm_create_new_from_template(t, nullptr, &first), CM_ERROR_OK);
+    BOOST_REQUIRE_EQUAL(cm_create_new_from_template(t, nullptr, &second), CM_ERROR_OK);
+    // Instances must outlive the template
+    cm_delete_template(t);
+
+    cm_hash first_hash{};
+    BOOST_REQUIRE_EQUAL(cm_get_root_hash(first, &first_hash), CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(0, memcmp(origin_hash, first_hash, sizeof(cm_hash)));
+    auto verification = calculate_emulator_hash(first);
+    BOOST_CHECK_EQUAL_COLLECTIONS(verification.begin(), verification.end(), first_hash, first_hash + sizeof(cm_hash));
+
+    uint64_t x1{};
+    BOOST_REQUIRE_EQUAL(cm_read_reg(first, CM_REG_X1, &x1), CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(x1, 0x1234);
+
+    // Writes to one instance must not affect the other
+    BOOST_REQUIRE_EQUAL(cm_write_memory(first, address, other_data.data(), other_data.size()), CM_ERROR_OK);
+    std::array<uint8_t, 4> read_data{};
+    BOOST_REQUIRE_EQUAL(cm_read_memory(second, address, read_data.data(), read_data.size()), CM_ERROR_OK);
+    BOOST_CHECK_EQUAL_COLLECTIONS(read_data.begin(), read_data.end(), data.begin(), data.end());
+
+    bool result{};
+    BOOST_REQUIRE_EQUAL(cm_verify_merkle_tree(second, &result), CM_ERROR_OK);
+    BOOST_CHECK(result);
+    BOOST_REQUIRE_EQUAL(cm_verify_dirty_page_maps(first, &result), CM_ERROR_OK);
+    BOOST_CHECK(result);
+
+    cm_delete(first);
+    cm_delete(second);
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(create_from_template_without_images_test, incomplete_machine_fixture) {
+    const auto ram_image_path = (std::filesystem::temp_directory_path() / "template-ram.bin").string();
+    const auto flash_image_path = (std::filesystem::temp_directory_path() / "template-flash.bin").string();
+    {
+        std::ofstream ofs(ram_image_path, std::ios::binary);
+        ofs << std::string(0x1000, 'r');
+    }
+    {
+        std::ofstream ofs(flash_image_path, std::ios::binary);
+        ofs << std::string(0x1000, 'f');
+    }
+    _machine_config["ram"]["image_filename"] = ram_image_path;
+    _machine_config["flash_drive"] = nlohmann::json::array({{{"image_filename", flash_image_path}}});
+    BOOST_REQUIRE_EQUAL(cm_create_new(_machine_config.dump().c_str(), nullptr, &_machine), CM_ERROR_OK);
+    cm_machine_template *t{};
+    BOOST_REQUIRE_EQUAL(cm_new_template(_machine, &t), CM_ERROR_OK);
+
+    // Instances take memory contents from the template, so image files are no longer needed
+    std::filesystem::remove(ram_image_path);
+    std::filesystem::remove(flash_image_path);
+    cm_machine *m{};
+    cm_error error_code = cm_create_new_from_template(t, nullptr, &m);
+    cm_delete_template(t);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+
+    cm_hash origin_hash{};
+    cm_hash hash{};
+    BOOST_REQUIRE_EQUAL(cm_get_root_hash(_machine, &origin_hash), CM_ERROR_OK);
+    BOOST_REQUIRE_EQUAL(cm_get_root_hash(m, &hash), CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(0, memcmp(origin_hash, hash, sizeof(cm_hash)));
+    std::array<uint8_t, 2> ram_data{};
+    BOOST_REQUIRE_EQUAL(cm_read_memory(m, cartesi::PMA_RAM_START + 0xfff, ram_data.data(), ram_data.size()),
+        CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(ram_data[0], 'r');
+    BOOST_CHECK_EQUAL(ram_data[1], 0);
+    std::array<uint8_t, 1> flash_data{};
+    BOOST_REQUIRE_EQUAL(cm_read_memory(m, cartesi::PMA_DRIVE_START, flash_data.data(), flash_data.size()),
+        CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(flash_data[0], 'f');
+    bool result{};
+    BOOST_REQUIRE_EQUAL(cm_verify_merkle_tree(m, &result), CM_ERROR_OK);
+    BOOST_CHECK(result);
+    cm_delete(m);
+}
+
+namespace {
+
+// Returns the private dirty memory of the process, in bytes, or 0 when the OS does not report it
+uint64_t private_dirty_bytes() {
+    std::ifstream ifs("/proc/self/smaps_rollup");
+    std::string line;
+    uint64_t total = 0;
+    while (std::getline(ifs, line)) {
+        if (line.rfind("Private_Dirty:", 0) == 0) {
+            total += std::stoull(line.substr(line.find_first_of("0123456789"))) << 10;
+        }
+    }
+    return total;
+}
+
+} // namespace
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(create_from_template_discard_test, incomplete_machine_fixture) {
+    constexpr uint64_t discard_start = cartesi::PMA_RAM_START + 0x100000;
+    constexpr uint64_t discard_length = 0x800000;
+    _machine_config["ram"]["length"] = 0x1000000;
+    _machine_config["processor"]["iunrep"] = 1;
+    _machine_config["virtio"] = nlohmann::json::array({{{"type", "balloon"}}});
+    BOOST_REQUIRE_EQUAL(cm_create_new(_machine_config.dump().c_str(), nullptr, &_machine), CM_ERROR_OK);
+    const std::vector<uint8_t> data(discard_length, 'd');
+    BOOST_REQUIRE_EQUAL(cm_write_memory(_machine, discard_start, data.data(), data.size()), CM_ERROR_OK);
+    cm_machine_template *t{};
+    BOOST_REQUIRE_EQUAL(cm_new_template(_machine, &t), CM_ERROR_OK);
+    cm_machine *m{};
+    BOOST_REQUIRE_EQUAL(cm_create_new_from_template(t, nullptr, &m), CM_ERROR_OK);
+
+    // Instance memory is a private mapping of the template, so reported pages must be replaced by fresh
+    // anonymous memory rather than by private copies filled with zeros
+    virtio_test_driver driver{m};
+    driver.init(cartesi::VIRTIO_BALLOON_F_PAGE_REPORTING, cartesi::VIRTIO_BALLOON_REPORTINGQ);
+    const uint64_t dirty_before = private_dirty_bytes();
+    driver.post({{discard_start, static_cast<uint32_t>(discard_length), cartesi::VIRTQ_DESC_F_WRITE, 0}});
+    driver.wait_used(1);
+    const uint64_t dirty_after = private_dirty_bytes();
+    BOOST_CHECK_EQUAL(driver.used_len(0), discard_length);
+    if (dirty_before != 0) {
+        BOOST_CHECK_LT(dirty_after, dirty_before + (discard_length / 2));
+    }
+
+    std::vector<uint8_t> read_data(discard_length, 'x');
+    BOOST_REQUIRE_EQUAL(cm_read_memory(m, discard_start, read_data.data(), read_data.size()), CM_ERROR_OK);
+    BOOST_CHECK(read_data == std::vector<uint8_t>(discard_length, 0));
+
+    // Neither the template nor its other instances may see the discard
+    cm_machine *other{};
+    BOOST_REQUIRE_EQUAL(cm_create_new_from_template(t, nullptr, &other), CM_ERROR_OK);
+    BOOST_REQUIRE_EQUAL(cm_read_memory(other, discard_start, read_data.data(), read_data.size()), CM_ERROR_OK);
+    BOOST_CHECK(read_data == data);
+    cm_delete(other);
+    cm_delete(m);
+    cm_delete_template(t);
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(find_divergence_test, ordinary_machine_fixture) {
+    cm_machine_template *a{};
+    BOOST_REQUIRE_EQUAL(cm_new_template(_machine, &a), CM_ERROR_OK);
+    const uint64_t address = 0x80010000;
+    std::array<uint8_t, 4> data{0xde, 0xad, 0xbe, 0xef};
+    BOOST_REQUIRE_EQUAL(cm_write_memory(_machine, address + 8, data.data(), data.size()), CM_ERROR_OK);
+    cm_machine_template *b{};
+    BOOST_REQUIRE_EQUAL(cm_new_template(_machine, &b), CM_ERROR_OK);
+
+    // identical snapshots never diverge
+    const char *divergence{};
+    cm_error error_code = cm_find_divergence(a, a, 0, 1000, nullptr, 16, &divergence);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    auto j = nlohmann::json::parse(divergence);
+    BOOST_CHECK(!j["diverged"].get<bool>());
+    BOOST_CHECK_EQUAL(j["mcycle"].get<uint64_t>(), 1000);
+    BOOST_CHECK_EQUAL(j["root_hash_a"], j["root_hash_b"]);
+    BOOST_CHECK(j["page_addresses"].empty());
+
+    // different snapshots diverge as soon as the range starts, at the page that was written
+    error_code = cm_find_divergence(a, b, 10, 1000, nullptr, 16, &divergence);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    j = nlohmann::json::parse(divergence);
+    BOOST_CHECK(j["diverged"].get<bool>());
+    BOOST_CHECK_EQUAL(j["mcycle"].get<uint64_t>(), 10);
+    BOOST_CHECK_NE(j["root_hash_a"], j["root_hash_b"]);
+    BOOST_CHECK_EQUAL(j["page_addresses"], nlohmann::json::array({address}));
+
+    error_code = cm_find_divergence(a, b, 10, 1000, nullptr, 0, &divergence);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    j = nlohmann::json::parse(divergence);
+    BOOST_CHECK(j["diverged"].get<bool>());
+    BOOST_CHECK(j["page_addresses"].empty());
+
+    error_code = cm_find_divergence(a, b, 1000, 10, nullptr, 16, &divergence);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_INVALID_ARGUMENT);
+    BOOST_CHECK_EQUAL(std::string(cm_get_last_error_message()), std::string("mcycle_end is before mcycle_begin"));
+    BOOST_CHECK(divergence == nullptr);
+    error_code = cm_find_divergence(a, nullptr, 0, 10, nullptr, 16, &divergence);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_INVALID_ARGUMENT);
+    BOOST_CHECK_EQUAL(std::string(cm_get_last_error_message()), std::string("invalid machine template"));
+    error_code = cm_find_divergence(a, b, 0, 10, nullptr, 16, nullptr);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_INVALID_ARGUMENT);
+
+    cm_delete_template(a);
+    cm_delete_template(b);
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(find_divergence_halt_test, ordinary_machine_fixture) {
+    // writes to 16 pages, then halts through HTIF
+    const std::array<uint32_t, 11> program{
+        0x00010297, // auipc t0, 0x10
+        0x01000313, // li t1, 16
+        0x0062b023, // sd t1, 0(t0)
+        0x000013b7, // lui t2, 0x1
+        0x007282b3, // add t0, t0, t2
+        0xfff30313, // addi t1, t1, -1
+        0xfe0318e3, // bnez t1, -16
+        0x40008337, // lui t1, 0x40008
+        0x00100393, // li t2, 1
+        0x00733023, // sd t2, 0(t1)
+        0x0000006f, // j .
+    };
+    BOOST_REQUIRE_EQUAL(cm_write_memory(_machine, 0x80000000, reinterpret_cast<const uint8_t *>(program.data()),
+                            program.size() * sizeof(uint32_t)),
+        CM_ERROR_OK);
+    BOOST_REQUIRE_EQUAL(cm_write_reg(_machine, CM_REG_PC, 0x80000000), CM_ERROR_OK);
+    cm_machine_template *t{};
+    BOOST_REQUIRE_EQUAL(cm_new_template(_machine, &t), CM_ERROR_OK);
+
+    // where a machine run straight from the template stops
+    cm_machine *m{};
+    BOOST_REQUIRE_EQUAL(cm_create_new_from_template(t, nullptr, &m), CM_ERROR_OK);
+    cm_break_reason break_reason{};
+    BOOST_REQUIRE_EQUAL(cm_run(m, 1000, &break_reason), CM_ERROR_OK);
+    BOOST_REQUIRE_EQUAL(break_reason, CM_BREAK_REASON_HALTED);
+    uint64_t halt_mcycle{};
+    BOOST_REQUIRE_EQUAL(cm_read_reg(m, CM_REG_MCYCLE, &halt_mcycle), CM_ERROR_OK);
+    BOOST_REQUIRE_LT(halt_mcycle, 1000);
+    cm_hash halt_hash{};
+    BOOST_REQUIRE_EQUAL(cm_get_root_hash(m, &halt_hash), CM_ERROR_OK);
+    cm_delete(m);
+
+    // the search ends where both machines halted, in the state reached through checkpoints
+    const char *divergence{};
+    BOOST_REQUIRE_EQUAL(cm_find_divergence(t, t, 10, 1000, nullptr, 16, &divergence), CM_ERROR_OK);
+    const auto j = nlohmann::json::parse(divergence);
+    BOOST_CHECK(!j["diverged"].get<bool>());
+    BOOST_CHECK_EQUAL(j["mcycle"].get<uint64_t>(), halt_mcycle);
+    BOOST_CHECK_EQUAL(j["mcycle_a"].get<uint64_t>(), halt_mcycle);
+    BOOST_CHECK_EQUAL(j["mcycle_b"].get<uint64_t>(), halt_mcycle);
+    BOOST_CHECK_EQUAL(j["break_reason_a"].get<std::string>(), "halted");
+    BOOST_CHECK_EQUAL(j["break_reason_b"].get<std::string>(), "halted");
+    cartesi::machine_merkle_tree::hash_type expected_hash{};
+    memcpy(expected_hash.data(), halt_hash, sizeof(halt_hash));
+    BOOST_CHECK_EQUAL(j["root_hash_a"], nlohmann::json(expected_hash));
+    BOOST_CHECK_EQUAL(j["root_hash_a"], j["root_hash_b"]);
+
+    cm_delete_template(t);
+}
+
 BOOST_AUTO_TEST_CASE_NOLINT(get_root_hash_null_machine_test) {
     cm_hash restored_hash;
     cm_error error_code = cm_get_root_hash(nullptr, &restored_hash);
@@ -622,6 +2211,66 @@ BOOST_FIXTURE_TEST_CASE_NOLINT(read_write_memory_massive_test, ordinary_machine_
     BOOST_CHECK_EQUAL_COLLECTIONS(write_data.begin(), write_data.end(), read_data.begin(), read_data.end());
 }
 
+BOOST_FIXTURE_TEST_CASE_NOLINT(host_memory_basic_test, ordinary_machine_fixture) {
+    // data crosses a page boundary
+    uint64_t address = 0x80004000 - 2;
+    const std::array<uint8_t, 4> write_data{0xde, 0xad, 0xbe, 0xef};
+    std::array<uint8_t, 4> read_data{};
+
+    cm_hash origin_hash{};
+    BOOST_REQUIRE_EQUAL(cm_get_root_hash(_machine, &origin_hash), CM_ERROR_OK);
+
+    uint8_t *host_memory{};
+    cm_error error_code = cm_get_host_memory(_machine, address, write_data.size(), &host_memory);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_REQUIRE_EQUAL(std::string(cm_get_last_error_message()), std::string(""));
+    BOOST_REQUIRE(host_memory != nullptr);
+    memcpy(host_memory, write_data.data(), write_data.size());
+    error_code = cm_mark_dirty_memory(_machine, address, write_data.size());
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+
+    error_code = cm_read_memory(_machine, address, read_data.data(), read_data.size());
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK_EQUAL_COLLECTIONS(write_data.begin(), write_data.end(), read_data.begin(), read_data.end());
+
+    // both pages touched through the pointer must be accounted for in the root hash
+    cm_hash written_hash{};
+    BOOST_REQUIRE_EQUAL(cm_get_root_hash(_machine, &written_hash), CM_ERROR_OK);
+    BOOST_CHECK_NE(0, memcmp(origin_hash, written_hash, sizeof(cm_hash)));
+    memset(host_memory, 0, write_data.size());
+    BOOST_REQUIRE_EQUAL(cm_mark_dirty_memory(_machine, address, write_data.size()), CM_ERROR_OK);
+    cm_hash restored_hash{};
+    BOOST_REQUIRE_EQUAL(cm_get_root_hash(_machine, &restored_hash), CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(0, memcmp(origin_hash, restored_hash, sizeof(cm_hash)));
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(host_memory_invalid_address_range_test, ordinary_machine_fixture) {
+    uint8_t *host_memory{};
+    cm_error error_code = cm_get_host_memory(_machine, 0x100, 8, &host_memory);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_INVALID_ARGUMENT);
+    BOOST_CHECK_EQUAL(std::string(cm_get_last_error_message()),
+        std::string("address range not entirely in memory PMA"));
+    BOOST_CHECK(host_memory == nullptr);
+    error_code = cm_get_host_memory(_machine, 0x80000000, 8, nullptr);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_INVALID_ARGUMENT);
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(mark_dirty_memory_invalid_address_range_test, ordinary_machine_fixture) {
+    // unmapped range
+    cm_error error_code = cm_mark_dirty_memory(_machine, 0x100, 8);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_INVALID_ARGUMENT);
+    BOOST_CHECK_EQUAL(std::string(cm_get_last_error_message()),
+        std::string("address range not entirely in memory PMA"));
+    // device range (CLINT)
+    error_code = cm_mark_dirty_memory(_machine, 0x2000000, 8);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_INVALID_ARGUMENT);
+    BOOST_CHECK_EQUAL(std::string(cm_get_last_error_message()),
+        std::string("address range not entirely in memory PMA"));
+    // range crossing the end of RAM
+    error_code = cm_mark_dirty_memory(_machine, 0x80000000 + (1 << 20) - 4, 8);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_INVALID_ARGUMENT);
+}
+
 BOOST_FIXTURE_TEST_CASE_NOLINT(write_virtual_memory_invalid_address_range_test, ordinary_machine_fixture) {
     uint64_t write_value = 0x1234;
     uint64_t address = 0x100;
@@ -1006,6 +2655,31 @@ BOOST_FIXTURE_TEST_CASE_NOLINT(read_reg_null_output_test, ordinary_machine_fixtu
     BOOST_CHECK_EQUAL(error_code, CM_ERROR_INVALID_ARGUMENT);
 }
 
+BOOST_FIXTURE_TEST_CASE_NOLINT(read_regs_basic_test, ordinary_machine_fixture) {
+    BOOST_REQUIRE_EQUAL(cm_write_reg(_machine, CM_REG_X2, 42), CM_ERROR_OK);
+    const std::array<cm_reg, 4> regs{CM_REG_X2, CM_REG_PC, CM_REG_MCYCLE, CM_REG_MVENDORID};
+    std::array<uint64_t, regs.size()> vals{};
+    cm_error error_code = cm_read_regs(_machine, regs.data(), regs.size(), vals.data());
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(vals[0], 42);
+    for (size_t i = 0; i < regs.size(); ++i) {
+        uint64_t val{};
+        BOOST_REQUIRE_EQUAL(cm_read_reg(_machine, regs[i], &val), CM_ERROR_OK);
+        BOOST_CHECK_EQUAL(vals[i], val);
+    }
+    error_code = cm_read_regs(_machine, regs.data(), 0, nullptr);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_OK);
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(read_regs_null_output_test, ordinary_machine_fixture) {
+    const cm_reg reg = CM_REG_MCYCLE;
+    cm_error error_code = cm_read_regs(_machine, &reg, 1, nullptr);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_INVALID_ARGUMENT);
+    uint64_t val{};
+    error_code = cm_read_regs(_machine, nullptr, 1, &val);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_INVALID_ARGUMENT);
+}
+
 BOOST_AUTO_TEST_CASE_NOLINT(write_reg_null_machine_test) {
     cm_error error_code = cm_write_reg(nullptr, CM_REG_MCYCLE, 3);
     BOOST_CHECK_EQUAL(error_code, CM_ERROR_INVALID_ARGUMENT);
@@ -1048,6 +2722,95 @@ BOOST_FIXTURE_TEST_CASE_NOLINT(verify_merkle_tree_basic_test, ordinary_machine_f
     BOOST_CHECK(ret);
 }
 
+BOOST_FIXTURE_TEST_CASE_NOLINT(verify_steps_chain_test, ordinary_machine_fixture) {
+    constexpr uint64_t count = 4;
+    std::array<cm_hash, count> roots_before{};
+    std::array<cm_hash, count> roots_after{};
+    std::array<uint64_t, count> mcycle_counts{};
+    std::array<std::string, count> filenames;
+    std::array<const char *, count> c_filenames{};
+    for (uint64_t i = 0; i < count; ++i) {
+        const auto name = "verify-steps-" + std::to_string(i) + ".log";
+        filenames[i] = (std::filesystem::temp_directory_path() / name).string();
+        std::filesystem::remove(filenames[i]);
+        c_filenames[i] = filenames[i].c_str();
+        mcycle_counts[i] = i + 1;
+        BOOST_REQUIRE_EQUAL(cm_get_root_hash(_machine, &roots_before[i]), CM_ERROR_OK);
+        BOOST_REQUIRE_EQUAL(cm_log_step(_machine, mcycle_counts[i], c_filenames[i], nullptr), CM_ERROR_OK);
+        BOOST_REQUIRE_EQUAL(cm_get_root_hash(_machine, &roots_after[i]), CM_ERROR_OK);
+    }
+
+    std::array<cm_break_reason, count> break_reasons{};
+    cm_error error_code = cm_verify_steps(nullptr, count, roots_before.data(), c_filenames.data(),
+        mcycle_counts.data(), roots_after.data(), true, 2, break_reasons.data());
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(std::string(cm_get_last_error_message()), std::string(""));
+    for (auto break_reason : break_reasons) {
+        BOOST_CHECK_EQUAL(break_reason, CM_BREAK_REASON_REACHED_TARGET_MCYCLE);
+    }
+
+    // out of order, steps are still individually valid, but no longer form a chain
+    std::swap(roots_before[1], roots_before[2]);
+    std::swap(c_filenames[1], c_filenames[2]);
+    std::swap(mcycle_counts[1], mcycle_counts[2]);
+    std::swap(roots_after[1], roots_after[2]);
+    error_code = cm_verify_steps(nullptr, count, roots_before.data(), c_filenames.data(), mcycle_counts.data(),
+        roots_after.data(), false, 0, nullptr);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_OK);
+    error_code = cm_verify_steps(nullptr, count, roots_before.data(), c_filenames.data(), mcycle_counts.data(),
+        roots_after.data(), true, 0, break_reasons.data());
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_INVALID_ARGUMENT);
+    BOOST_CHECK_EQUAL(std::string(cm_get_last_error_message()),
+        std::string("step log 1 does not start where step log 0 ends"));
+    BOOST_CHECK_EQUAL(break_reasons[0], CM_BREAK_REASON_FAILED);
+
+    // the first invalid step is reported
+    std::swap(roots_after[2], roots_after[3]);
+    error_code = cm_verify_steps(nullptr, count, roots_before.data(), c_filenames.data(), mcycle_counts.data(),
+        roots_after.data(), false, 0, nullptr);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_RUNTIME_ERROR);
+    BOOST_CHECK_EQUAL(std::string(cm_get_last_error_message()),
+        "step log 2 ('" + filenames[1] + "'): final root hash mismatch");
+
+    for (const auto &filename : filenames) {
+        std::filesystem::remove(filename);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(log_step_long_window_test, ordinary_machine_fixture) {
+    const auto filename = (std::filesystem::temp_directory_path() / "log-step-long-window.log").string();
+    std::filesystem::remove(filename);
+    constexpr uint64_t mcycle_count = 100000;
+    cm_hash root_hash_before{};
+    cm_hash root_hash_after{};
+    BOOST_REQUIRE_EQUAL(cm_get_root_hash(_machine, &root_hash_before), CM_ERROR_OK);
+    cm_break_reason break_reason{};
+    cm_error error_code = cm_log_step(_machine, mcycle_count, filename.c_str(), &break_reason);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_REQUIRE_EQUAL(cm_get_root_hash(_machine, &root_hash_after), CM_ERROR_OK);
+    cm_break_reason verify_break_reason{};
+    error_code = cm_verify_step(nullptr, &root_hash_before, filename.c_str(), mcycle_count, &root_hash_after,
+        &verify_break_reason);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(verify_break_reason, break_reason);
+
+    // an existing log file is neither overwritten nor removed
+    error_code = cm_log_step(_machine, 1, filename.c_str(), nullptr);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_RUNTIME_ERROR);
+    BOOST_CHECK_EQUAL(std::string(cm_get_last_error_message()), std::string("file already exists"));
+    error_code = cm_verify_step(nullptr, &root_hash_before, filename.c_str(), mcycle_count, &root_hash_after, nullptr);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_OK);
+
+    std::filesystem::remove(filename);
+}
+
+BOOST_AUTO_TEST_CASE_NOLINT(verify_steps_null_arrays_test) {
+    cm_error error_code = cm_verify_steps(nullptr, 1, nullptr, nullptr, nullptr, nullptr, false, 0, nullptr);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_INVALID_ARGUMENT);
+    error_code = cm_verify_steps(nullptr, 0, nullptr, nullptr, nullptr, nullptr, true, 0, nullptr);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_OK);
+}
+
 BOOST_FIXTURE_TEST_CASE_NOLINT(verify_step_uarch_log_null_log_test, default_machine_fixture) {
     cm_error error_code = cm_verify_step_uarch(nullptr, nullptr, nullptr, nullptr);
     BOOST_CHECK_EQUAL(error_code, CM_ERROR_INVALID_ARGUMENT);
@@ -1238,6 +3001,57 @@ BOOST_FIXTURE_TEST_CASE_NOLINT(step_complex_test, access_log_machine_fixture) {
     BOOST_CHECK_EQUAL(std::string(""), std::string(cm_get_last_error_message()));
 }
 
+BOOST_FIXTURE_TEST_CASE_NOLINT(step_binary_log_test, access_log_machine_fixture) {
+    cm_hash hash0{};
+    cm_hash hash1{};
+    cm_hash hash2{};
+    BOOST_REQUIRE_EQUAL(cm_get_root_hash(_machine, &hash0), CM_ERROR_OK);
+
+    const int32_t log_type = CM_ACCESS_LOG_TYPE_ANNOTATIONS | CM_ACCESS_LOG_TYPE_LARGE_DATA | CM_ACCESS_LOG_TYPE_BINARY;
+    cm_error error_code = cm_log_step_uarch(_machine, log_type, &_access_log);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    const std::string binary_log = _access_log;
+    BOOST_REQUIRE_EQUAL(cm_get_root_hash(_machine, &hash1), CM_ERROR_OK);
+    // the log is a single base64 string
+    BOOST_CHECK(nlohmann::json::parse(binary_log).is_string());
+
+    error_code = cm_verify_step_uarch(nullptr, &hash0, binary_log.c_str(), &hash1);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(std::string(""), std::string(cm_get_last_error_message()));
+    error_code = cm_verify_step_uarch(nullptr, &hash1, binary_log.c_str(), &hash0);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_INVALID_ARGUMENT);
+
+    // the same step logged as JSON is much larger
+    error_code = cm_log_step_uarch(_machine, log_type & ~CM_ACCESS_LOG_TYPE_BINARY, &_access_log);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK_LT(2 * binary_log.size(), std::string(_access_log).size());
+    BOOST_REQUIRE_EQUAL(cm_get_root_hash(_machine, &hash2), CM_ERROR_OK);
+    error_code = cm_verify_step_uarch(nullptr, &hash1, _access_log, &hash2);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_OK);
+
+    // truncated logs are rejected
+    auto truncated = nlohmann::json::parse(binary_log).get<std::string>();
+    truncated.resize(truncated.size() - 8);
+    error_code = cm_verify_step_uarch(nullptr, &hash0, nlohmann::json(truncated).dump().c_str(), &hash1);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_INVALID_ARGUMENT);
+
+    // an access without sibling hashes decodes, but is rejected by verification like in the JSON form
+    // magic, version, type flags, access count, access flags (read data), log2_size, address delta, hash, word data
+    std::string no_siblings{"CMAL\x01\x00\x01\x02\x05\x00", 10};
+    no_siblings.append(2 * sizeof(cm_hash), '\0');
+    error_code = cm_verify_step_uarch(nullptr, &hash0, nlohmann::json(cartesi::encode_base64(
+        reinterpret_cast<const unsigned char *>(no_siblings.data()), no_siblings.size())).dump().c_str(), &hash1);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_INVALID_ARGUMENT);
+    BOOST_CHECK(std::string(cm_get_last_error_message()).find("missing sibling hashes") != std::string::npos);
+
+    // the notes section must hold one note per access
+    std::string bad_notes{"CMAL\x01\x01\x00\x01", 8};
+    error_code = cm_verify_step_uarch(nullptr, &hash0, nlohmann::json(cartesi::encode_base64(
+        reinterpret_cast<const unsigned char *>(bad_notes.data()), bad_notes.size())).dump().c_str(), &hash1);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_INVALID_ARGUMENT);
+    BOOST_CHECK(std::string(cm_get_last_error_message()).find("1 notes for 0 accesses") != std::string::npos);
+}
+
 BOOST_FIXTURE_TEST_CASE_NOLINT(step_hash_test, access_log_machine_fixture) {
 
     cm_error error_code = cm_log_step_uarch(_machine, _log_type, &_access_log);
@@ -1322,6 +3136,152 @@ BOOST_FIXTURE_TEST_CASE_NOLINT(machine_run_long_cycle_test, ordinary_machine_fix
     BOOST_CHECK_EQUAL_COLLECTIONS(verification.begin(), verification.end(), hash_end, hash_end + sizeof(cm_hash));
 }
 
+namespace {
+
+struct async_run_result {
+    int calls{0};
+    cm_error error{CM_ERROR_OK};
+    cm_break_reason break_reason{CM_BREAK_REASON_FAILED};
+    std::string message;
+};
+
+void on_async_run_completion(void *context, cm_error error, cm_break_reason break_reason) {
+    auto *result = static_cast<async_run_result *>(context);
+    ++result->calls;
+    result->error = error;
+    result->break_reason = break_reason;
+    result->message = cm_get_last_error_message();
+}
+
+void on_async_run_inspect(void *context, cm_machine *m) {
+    BOOST_CHECK_EQUAL(cm_read_reg(m, CM_REG_MCYCLE, static_cast<uint64_t *>(context)), CM_ERROR_OK);
+}
+
+} // namespace
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(machine_run_async_test, ordinary_machine_fixture) {
+    const uint64_t mcycle_end = (UINT64_C(3) << 20) + 5;
+    async_run_result result;
+    cm_async_run *run{};
+    cm_error error_code = cm_run_async(_machine, mcycle_end, on_async_run_completion, &result, &run);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    uint64_t inspected_mcycle = UINT64_MAX;
+    BOOST_REQUIRE_EQUAL(cm_async_run_inspect(run, on_async_run_inspect, &inspected_mcycle), CM_ERROR_OK);
+    cm_break_reason break_reason{};
+    error_code = cm_async_run_wait(run, &break_reason);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(break_reason, CM_BREAK_REASON_REACHED_TARGET_MCYCLE);
+    bool done = false;
+    BOOST_REQUIRE_EQUAL(cm_async_run_is_done(run, &done), CM_ERROR_OK);
+    BOOST_CHECK(done);
+    // Deleting the run waits for the completion callback to return
+    cm_delete_async_run(run);
+    BOOST_CHECK_EQUAL(result.calls, 1);
+    BOOST_CHECK_EQUAL(result.error, CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(result.break_reason, CM_BREAK_REASON_REACHED_TARGET_MCYCLE);
+    BOOST_CHECK_LE(inspected_mcycle, mcycle_end);
+
+    uint64_t read_mcycle{};
+    BOOST_REQUIRE_EQUAL(cm_read_reg(_machine, CM_REG_MCYCLE, &read_mcycle), CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(read_mcycle, mcycle_end);
+    auto verification = calculate_emulator_hash(_machine);
+    cm_hash hash_end;
+    BOOST_REQUIRE_EQUAL(cm_get_root_hash(_machine, &hash_end), CM_ERROR_OK);
+    BOOST_CHECK_EQUAL_COLLECTIONS(verification.begin(), verification.end(), hash_end, hash_end + sizeof(cm_hash));
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(machine_run_async_pause_test, ordinary_machine_fixture) {
+    cm_async_run *run{};
+    cm_error error_code = cm_run_async(_machine, UINT64_MAX, nullptr, nullptr, &run);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_REQUIRE_EQUAL(cm_async_run_pause(run), CM_ERROR_OK);
+    cm_break_reason break_reason{};
+    error_code = cm_async_run_wait(run, &break_reason);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(break_reason, CM_BREAK_REASON_PAUSED);
+    cm_delete_async_run(run);
+
+    // A paused run continues by starting another one
+    uint64_t mcycle{};
+    BOOST_REQUIRE_EQUAL(cm_read_reg(_machine, CM_REG_MCYCLE, &mcycle), CM_ERROR_OK);
+    BOOST_REQUIRE_EQUAL(cm_run_async(_machine, mcycle + 1000, nullptr, nullptr, &run), CM_ERROR_OK);
+    error_code = cm_async_run_wait(run, &break_reason);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(break_reason, CM_BREAK_REASON_REACHED_TARGET_MCYCLE);
+    cm_delete_async_run(run);
+    uint64_t read_mcycle{};
+    BOOST_REQUIRE_EQUAL(cm_read_reg(_machine, CM_REG_MCYCLE, &read_mcycle), CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(read_mcycle, mcycle + 1000);
+
+    // Deleting an active run pauses it
+    BOOST_REQUIRE_EQUAL(cm_run_async(_machine, UINT64_MAX, nullptr, nullptr, &run), CM_ERROR_OK);
+    cm_delete_async_run(run);
+}
+
+namespace {
+
+struct self_deleting_run {
+    cm_async_run *run{};
+    std::promise<cm_break_reason> completed;
+};
+
+void on_async_run_completion_delete(void *context, cm_error /*error*/, cm_break_reason break_reason) {
+    auto *self = static_cast<self_deleting_run *>(context);
+    cm_delete_async_run(self->run);
+    self->completed.set_value(break_reason);
+}
+
+} // namespace
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(machine_run_async_delete_from_completion_test, ordinary_machine_fixture) {
+    self_deleting_run self;
+    auto completed = self.completed.get_future();
+    // The run cannot complete before it is paused, so the callback always finds its handle
+    BOOST_REQUIRE_EQUAL(cm_run_async(_machine, UINT64_MAX, on_async_run_completion_delete, &self, &self.run),
+        CM_ERROR_OK);
+    BOOST_REQUIRE_EQUAL(cm_async_run_pause(self.run), CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(completed.get(), CM_BREAK_REASON_PAUSED);
+    // The machine is idle again
+    uint64_t mcycle{};
+    BOOST_CHECK_EQUAL(cm_read_reg(_machine, CM_REG_MCYCLE, &mcycle), CM_ERROR_OK);
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(machine_run_async_to_past_test, ordinary_machine_fixture) {
+    BOOST_REQUIRE_EQUAL(cm_run(_machine, 1000, nullptr), CM_ERROR_OK);
+    async_run_result result;
+    cm_async_run *run{};
+    cm_error error_code = cm_run_async(_machine, 100, on_async_run_completion, &result, &run);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    cm_break_reason break_reason{};
+    error_code = cm_async_run_wait(run, &break_reason);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_INVALID_ARGUMENT);
+    BOOST_CHECK_EQUAL(break_reason, CM_BREAK_REASON_FAILED);
+    BOOST_CHECK_EQUAL(std::string("mcycle is past"), std::string(cm_get_last_error_message()));
+    cm_delete_async_run(run);
+    BOOST_CHECK_EQUAL(result.calls, 1);
+    BOOST_CHECK_EQUAL(result.error, CM_ERROR_INVALID_ARGUMENT);
+    BOOST_CHECK_EQUAL(result.break_reason, CM_BREAK_REASON_FAILED);
+    BOOST_CHECK_EQUAL(result.message, std::string("mcycle is past"));
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(machine_run_async_null_arguments_test, ordinary_machine_fixture) {
+    cm_async_run *run{};
+    cm_error error_code = cm_run_async(nullptr, 1000, nullptr, nullptr, &run);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_INVALID_ARGUMENT);
+    BOOST_CHECK(run == nullptr);
+    error_code = cm_run_async(_machine, 1000, nullptr, nullptr, nullptr);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_INVALID_ARGUMENT);
+    BOOST_CHECK_EQUAL(cm_async_run_pause(nullptr), CM_ERROR_INVALID_ARGUMENT);
+    BOOST_CHECK_EQUAL(cm_async_run_inspect(nullptr, on_async_run_inspect, nullptr), CM_ERROR_INVALID_ARGUMENT);
+    cm_break_reason break_reason{};
+    BOOST_CHECK_EQUAL(cm_async_run_wait(nullptr, &break_reason), CM_ERROR_INVALID_ARGUMENT);
+    BOOST_CHECK_EQUAL(break_reason, CM_BREAK_REASON_FAILED);
+    bool done = true;
+    BOOST_CHECK_EQUAL(cm_async_run_is_done(nullptr, &done), CM_ERROR_INVALID_ARGUMENT);
+    BOOST_CHECK(!done);
+    cm_delete_async_run(nullptr);
+}
+
 BOOST_AUTO_TEST_CASE_NOLINT(machine_run_uarch_null_machine_test) {
     auto status{CM_UARCH_BREAK_REASON_REACHED_TARGET_CYCLE};
     cm_error error_code = cm_run_uarch(nullptr, 1000, &status);
@@ -1408,6 +3368,35 @@ BOOST_FIXTURE_TEST_CASE_NOLINT(machine_run_uarch_advance_until_halt, access_log_
     BOOST_REQUIRE_EQUAL(halt, 1);
 }
 
+BOOST_FIXTURE_TEST_CASE_NOLINT(machine_run_uarch_modified_code_test, access_log_machine_fixture) {
+    auto status{CM_UARCH_BREAK_REASON_REACHED_TARGET_CYCLE};
+    cm_error error_code = cm_run_uarch(_machine, 100, &status);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_REQUIRE_EQUAL(status, CM_UARCH_BREAK_REASON_UARCH_HALTED);
+    uint64_t a0{};
+    error_code = cm_read_reg(_machine, CM_REG_UARCH_X10, &a0);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_REQUIRE_EQUAL(a0, 123);
+
+    // overwrite the first instruction and run the program again: stale decoded code must not be reused
+    std::array<uint8_t, 4> li_a0_45{0x13, 0x05, 0xd0, 0x02}; // li a0,45
+    error_code = cm_write_memory(_machine, cartesi::PMA_UARCH_RAM_START, li_a0_45.data(), li_a0_45.size());
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_REQUIRE_EQUAL(cm_write_reg(_machine, CM_REG_UARCH_PC, cartesi::PMA_UARCH_RAM_START), CM_ERROR_OK);
+    BOOST_REQUIRE_EQUAL(cm_write_reg(_machine, CM_REG_UARCH_HALT_FLAG, 0), CM_ERROR_OK);
+    BOOST_REQUIRE_EQUAL(cm_write_reg(_machine, CM_REG_UARCH_CYCLE, 0), CM_ERROR_OK);
+    error_code = cm_run_uarch(_machine, 100, &status);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_REQUIRE_EQUAL(status, CM_UARCH_BREAK_REASON_UARCH_HALTED);
+    error_code = cm_read_reg(_machine, CM_REG_UARCH_X10, &a0);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_REQUIRE_EQUAL(a0, 45);
+    uint64_t cycle{};
+    error_code = cm_read_reg(_machine, CM_REG_UARCH_CYCLE, &cycle);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_REQUIRE_EQUAL(cycle, 3);
+}
+
 BOOST_FIXTURE_TEST_CASE_NOLINT(machine_reset_uarch, ordinary_machine_fixture) {
     // ensure that uarch cycle is 0
     uint64_t halt_cycle{};
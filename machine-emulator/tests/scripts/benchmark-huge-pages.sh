@@ -0,0 +1,22 @@
+#!/bin/bash
+
+# Compares host dTLB misses of a memory-heavy guest workload with and without --huge-pages.
+# Requires perf with access to hardware counters (e.g. kernel.perf_event_paranoid <= 1).
+# Explicit huge pages are only used if reserved beforehand, e.g. with
+#   echo 1100 | sudo tee /proc/sys/vm/nr_hugepages
+# otherwise the emulator falls back to transparent huge pages.
+
+set -e
+
+cartesi_machine=${1:-cartesi-machine}
+ram_length=${2:-2Gi}
+workload=${3:-"dd if=/dev/zero of=/dev/shm/bench bs=1M count=1024 && sha256sum /dev/shm/bench"}
+
+run() {
+    perf stat -x, -e dTLB-load-misses,dTLB-store-misses,task-clock -- \
+        bash -c "$cartesi_machine --quiet --ram-length=$ram_length $1 -- '$workload'" 2>&1 >/dev/null |
+        awk -F, -v label="$2" '/dTLB|task-clock/ { printf "%-12s %-20s %s\n", label, $3, $1 }'
+}
+
+run "" "4KiB pages"
+run "--huge-pages" "huge pages"
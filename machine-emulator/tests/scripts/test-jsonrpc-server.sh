@@ -26,23 +26,52 @@ lua=$4
 test_path=${CARTESI_TESTS_PATH}
 
 server_address=127.0.0.1:6001
+unix_server_address=unix:${TMPDIR:-/tmp}/cartesi-jsonrpc-test.sock
 
 tests=(
     "$cartesi_machine_tests --remote-address=$server_address --test-path=\"$test_path\" --test='.*' run"
     "$lua $script_dir/../lua/machine-bind.lua jsonrpc --remote-address=$server_address"
     "$lua $script_dir/../lua/machine-test.lua jsonrpc --remote-address=$server_address"
     "$lua $script_dir/../lua/test-jsonrpc-fork.lua --remote-address=$server_address"
+    "$lua $script_dir/../lua/test-jsonrpc-binary.lua --remote-address=$server_address"
+    "$lua $script_dir/../lua/test-jsonrpc-binary.lua --remote-address=$server_address"
+    "$lua $script_dir/../lua/test-jsonrpc-hosted.lua --remote-address=$server_address"
+    "$lua $script_dir/../lua/test-jsonrpc-unix.lua --remote-address=$unix_server_address"
+)
+
+# Extra server options for each test
+server_options=(
+    ""
+    ""
+    ""
+    ""
+    ""
+    "--no-binary-transport"
+    "--workers=2"
+    ""
+)
+
+# Address each server listens at
+server_addresses=(
+    "$server_address"
+    "$server_address"
+    "$server_address"
+    "$server_address"
+    "$server_address"
+    "$server_address"
+    "$server_address"
+    "$unix_server_address"
 )
 
 is_server_running () {
-    echo $cartesi_machine --remote-address=$server_address --remote-health-check
-    eval $cartesi_machine --remote-address=$server_address --remote-health-check
+    echo $cartesi_machine --remote-address=$1 --remote-health-check
+    eval $cartesi_machine --remote-address=$1 --remote-health-check
 }
 
 wait_for_server () {
     for i in $(seq 1 10)
     do
-        if is_server_running
+        if is_server_running $1
         then
             return 0
         fi
@@ -65,12 +94,14 @@ wait_for_shutdown () {
     fi
 }
 
-for test_cmd in "${tests[@]}"
+for i in "${!tests[@]}"
 do
-    echo $remote_cartesi_machine --server-address=$server_address
-    $remote_cartesi_machine --server-address=$server_address &
+    test_cmd=${tests[$i]}
+    address=${server_addresses[$i]}
+    echo $remote_cartesi_machine --server-address=$address ${server_options[$i]}
+    $remote_cartesi_machine --server-address=$address ${server_options[$i]} &
     server_pid=$!
-    wait_for_server
+    wait_for_server $address
     eval $test_cmd
     retcode=$?
     wait_for_shutdown $server_pid
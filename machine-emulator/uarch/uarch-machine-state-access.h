@@ -558,12 +558,24 @@ private:
         return false;
     }
 
+    bool do_discard_memory(uint64_t /*paddr*/, uint64_t /*length*/) {
+        // This is not implemented yet because it's not being used
+        abort();
+        return false;
+    }
+
     bool do_write_memory(uint64_t /*paddr*/, const unsigned char */*data*/, uint64_t /*length*/) {
         // This is not implemented yet because it's not being used
         abort();
         return false;
     }
 
+    unsigned char *do_get_host_memory_range(uint64_t /*paddr*/, uint64_t /*length*/, bool /*writable*/) {
+        // This is not implemented yet because it's not being used
+        abort();
+        return nullptr;
+    }
+
     template <typename T>
     void do_write_memory_word(uint64_t paddr, const unsigned char */*hpage*/, uint64_t /*hoffset*/, T val) {
         raw_write_memory(paddr, val);